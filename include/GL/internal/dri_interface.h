@@ -437,7 +437,7 @@ struct __DRIdamageExtensionRec {
  * SWRast Loader extension.
  */
 #define __DRI_SWRAST_LOADER "DRI_SWRastLoader"
-#define __DRI_SWRAST_LOADER_VERSION 2
+#define __DRI_SWRAST_LOADER_VERSION 3
 struct __DRIswrastLoaderExtensionRec {
     __DRIextension base;
 
@@ -468,6 +468,21 @@ struct __DRIswrastLoaderExtensionRec {
     void (*putImage2)(__DRIdrawable *drawable, int op,
                       int x, int y, int width, int height, int stride,
                       char *data, void *loaderPrivate);
+
+    /**
+     * Put image to drawable from a shared memory segment
+     *
+     * The pixel at \c x, \c y is \c offset bytes into the segment \c shmid,
+     * which the driver has attached at \c shmaddr, and rows are \c stride
+     * bytes apart.  The loader may ask the X server to read it from there
+     * directly, without waiting for the server to finish.
+     *
+     * \since 3
+     */
+    void (*putImageShm)(__DRIdrawable *drawable, int op,
+                        int x, int y, int width, int height, int stride,
+                        int shmid, char *shmaddr, unsigned offset,
+                        void *loaderPrivate);
 };
 
 /**
@@ -36,7 +36,10 @@
   */
 
 #include "pipe/p_state.h"
+#include "os/os_thread.h"
+#include "util/u_atomic.h"
 #include "util/u_draw.h"
+#include "util/u_dynarray.h"
 #include "util/u_framebuffer.h"
 #include "util/u_inlines.h"
 #include "util/u_math.h"
@@ -76,11 +79,79 @@ struct sampler_info
 
 
 
+/**
+ * State objects shared by all the contexts of a screen.
+ *
+ * Only used if the driver advertises PIPE_CAP_SHAREABLE_CSOS, i.e. state
+ * objects may be bound and deleted through any context of the screen.
+ * Contexts look objects up in their front cache first and only take the
+ * mutex on a miss.
+ */
+struct cso_shared_cache {
+   struct pipe_screen *screen;
+
+   /** Number of cso_contexts using this cache, protected by
+    * cso_shared_caches_mutex */
+   unsigned num_contexts;
+
+   /** Protects cache and the refcounts of the entries in it */
+   pipe_mutex mutex;
+   struct cso_cache *cache;
+
+   /** Context of the cso_context inserting into the cache, which entries
+    * evicted by the insertion are deleted with.  Only set while the mutex
+    * is held, as other contexts may be destroyed at any time. */
+   struct pipe_context *pipe;
+
+   struct cso_shared_cache *next;
+};
+
+/**
+ * An entry in the shared cache.  The cso_* struct comes first so the
+ * usual template comparison works on it.
+ */
+struct cso_shared_entry {
+   union {
+      struct cso_blend blend;
+      struct cso_depth_stencil_alpha dsa;
+      struct cso_rasterizer rasterizer;
+      struct cso_sampler sampler;
+      struct cso_velements velements;
+   } cso;
+
+   enum cso_cache_type type;
+
+   /** The driver object.  The cso struct's own delete_state is left NULL
+    * so that cso_cache_delete() only frees the entry. */
+   void *data;
+   cso_state_callback delete_state;
+
+   /** Number of front cache slots and pins holding the entry.  Entries
+    * are only evicted from the shared cache when this is zero. */
+   int32_t refcount;
+};
+
+/** Per-context, direct-mapped cache of shared entries, for each type */
+#define CSO_FRONT_CACHE_SIZE 64
+
+struct cso_front_slot {
+   unsigned hash_key;
+   struct cso_shared_entry *entry;
+};
+
+
 struct cso_context {
    struct pipe_context *pipe;
    struct cso_cache *cache;
    struct u_vbuf *vbuf;
 
+   /* Used instead of cache if the driver's state objects can be shared. */
+   struct cso_shared_cache *shared;
+   struct cso_front_slot front[CSO_CACHE_MAX][CSO_FRONT_CACHE_SIZE];
+
+   /** Entries dropped from the front cache while still bound */
+   struct util_dynarray pinned;
+
    boolean has_geometry_shader;
    boolean has_streamout;
 
@@ -234,6 +305,314 @@ sanitize_hash(struct cso_hash *hash, enum cso_cache_type type,
    }
 }
 
+
+pipe_static_mutex(cso_shared_caches_mutex);
+static struct cso_shared_cache *cso_shared_caches = NULL;
+
+
+/**
+ * Called when the shared cache is about to grow past its maximum size.
+ * Like sanitize_hash(), but only entries no context holds are removed.
+ */
+static void
+sanitize_shared_hash(struct cso_hash *hash, enum cso_cache_type type,
+                     int max_size, void *user_data)
+{
+   struct cso_shared_cache *shared = (struct cso_shared_cache *)user_data;
+   int hash_size = cso_hash_size(hash);
+   int to_remove;
+   struct cso_hash_iter iter;
+
+   if (hash_size <= max_size)
+      return;
+
+   to_remove = hash_size / 4 + hash_size - max_size;
+   iter = cso_hash_first_node(hash);
+   while (to_remove && !cso_hash_iter_is_null(iter)) {
+      struct cso_shared_entry *entry = cso_hash_iter_data(iter);
+      if (entry->refcount == 0) {
+         assert(shared->pipe);
+         iter = cso_hash_erase(hash, iter);
+         entry->delete_state(shared->pipe, entry->data);
+         FREE(entry);
+         --to_remove;
+      } else
+         iter = cso_hash_iter_next(iter);
+   }
+}
+
+static void
+delete_shared_entry_data(void *state, void *user_data)
+{
+   struct cso_shared_entry *entry = (struct cso_shared_entry *)state;
+   struct pipe_context *pipe = (struct pipe_context *)user_data;
+
+   entry->delete_state(pipe, entry->data);
+   entry->delete_state = NULL;
+}
+
+static struct cso_shared_cache *
+cso_shared_cache_get(struct pipe_screen *screen)
+{
+   struct cso_shared_cache *shared;
+
+   pipe_mutex_lock(cso_shared_caches_mutex);
+
+   for (shared = cso_shared_caches; shared; shared = shared->next) {
+      if (shared->screen == screen)
+         break;
+   }
+
+   if (!shared) {
+      shared = CALLOC_STRUCT(cso_shared_cache);
+      if (!shared)
+         goto out;
+
+      shared->cache = cso_cache_create();
+      if (!shared->cache) {
+         FREE(shared);
+         shared = NULL;
+         goto out;
+      }
+      cso_cache_set_sanitize_callback(shared->cache,
+                                      sanitize_shared_hash,
+                                      shared);
+      pipe_mutex_init(shared->mutex);
+      shared->screen = screen;
+      shared->next = cso_shared_caches;
+      cso_shared_caches = shared;
+   }
+
+   shared->num_contexts++;
+
+out:
+   pipe_mutex_unlock(cso_shared_caches_mutex);
+   return shared;
+}
+
+/**
+ * Drop the context's references to shared entries, and destroy the shared
+ * cache if this was its last context.
+ */
+static void
+cso_shared_cache_release(struct cso_context *ctx)
+{
+   struct cso_shared_cache *shared = ctx->shared;
+   struct cso_shared_entry **pinned;
+   unsigned i, j, num_pinned;
+
+   for (i = 0; i < CSO_CACHE_MAX; i++) {
+      for (j = 0; j < CSO_FRONT_CACHE_SIZE; j++) {
+         if (ctx->front[i][j].entry) {
+            p_atomic_dec(&ctx->front[i][j].entry->refcount);
+            ctx->front[i][j].entry = NULL;
+         }
+      }
+   }
+
+   pinned = (struct cso_shared_entry **)ctx->pinned.data;
+   num_pinned = ctx->pinned.size / sizeof(*pinned);
+   for (i = 0; i < num_pinned; i++)
+      p_atomic_dec(&pinned[i]->refcount);
+   util_dynarray_fini(&ctx->pinned);
+
+   pipe_mutex_lock(cso_shared_caches_mutex);
+
+   if (--shared->num_contexts == 0) {
+      struct cso_shared_cache **prev = &cso_shared_caches;
+
+      while (*prev != shared)
+         prev = &(*prev)->next;
+      *prev = shared->next;
+
+      /* The contexts which created the objects may be gone already. */
+      for (i = 0; i < CSO_CACHE_MAX; i++)
+         cso_for_each_state(shared->cache, i, delete_shared_entry_data,
+                            ctx->pipe);
+      cso_cache_delete(shared->cache);
+
+      pipe_mutex_destroy(shared->mutex);
+      FREE(shared);
+   }
+
+   pipe_mutex_unlock(cso_shared_caches_mutex);
+
+   ctx->shared = NULL;
+}
+
+static struct cso_shared_entry *
+create_shared_entry(struct cso_context *ctx, enum cso_cache_type type,
+                    const void *templ, unsigned key_size)
+{
+   struct pipe_context *pipe = ctx->pipe;
+   struct cso_shared_entry *entry = CALLOC_STRUCT(cso_shared_entry);
+
+   if (!entry)
+      return NULL;
+
+   /* The state is the first member of every cso struct. */
+   memcpy(&entry->cso, templ, key_size);
+   entry->type = type;
+
+   switch (type) {
+   case CSO_BLEND:
+      entry->data = pipe->create_blend_state(pipe, &entry->cso.blend.state);
+      entry->delete_state = (cso_state_callback)pipe->delete_blend_state;
+      break;
+   case CSO_DEPTH_STENCIL_ALPHA:
+      entry->data = pipe->create_depth_stencil_alpha_state(pipe,
+                                                           &entry->cso.dsa.state);
+      entry->delete_state =
+         (cso_state_callback)pipe->delete_depth_stencil_alpha_state;
+      break;
+   case CSO_RASTERIZER:
+      entry->data = pipe->create_rasterizer_state(pipe,
+                                                  &entry->cso.rasterizer.state);
+      entry->delete_state = (cso_state_callback)pipe->delete_rasterizer_state;
+      break;
+   case CSO_SAMPLER:
+      entry->data = pipe->create_sampler_state(pipe, &entry->cso.sampler.state);
+      entry->delete_state = (cso_state_callback)pipe->delete_sampler_state;
+      break;
+   case CSO_VELEMENTS:
+      entry->data = pipe->create_vertex_elements_state(pipe,
+                                    entry->cso.velements.state.count,
+                                    &entry->cso.velements.state.velems[0]);
+      entry->delete_state =
+         (cso_state_callback)pipe->delete_vertex_elements_state;
+      break;
+   default:
+      assert(0);
+      FREE(entry);
+      return NULL;
+   }
+
+   return entry;
+}
+
+/**
+ * Whether a state object is bound or saved in the context.
+ */
+static boolean
+cso_is_bound(const struct cso_context *ctx, enum cso_cache_type type,
+             const void *data)
+{
+   unsigned sh, i;
+
+   switch (type) {
+   case CSO_BLEND:
+      return ctx->blend == data || ctx->blend_saved == data;
+   case CSO_DEPTH_STENCIL_ALPHA:
+      return ctx->depth_stencil == data || ctx->depth_stencil_saved == data;
+   case CSO_RASTERIZER:
+      return ctx->rasterizer == data || ctx->rasterizer_saved == data;
+   case CSO_VELEMENTS:
+      return ctx->velements == data || ctx->velements_saved == data;
+   case CSO_SAMPLER:
+      for (sh = 0; sh < PIPE_SHADER_TYPES; sh++) {
+         const struct sampler_info *info = &ctx->samplers[sh];
+         for (i = 0; i < PIPE_MAX_SAMPLERS; i++) {
+            if (info->samplers[i] == data ||
+                info->hw.samplers[i] == data ||
+                info->samplers_saved[i] == data)
+               return TRUE;
+         }
+      }
+      return FALSE;
+   default:
+      assert(0);
+      return FALSE;
+   }
+}
+
+/**
+ * Drop the references to pinned entries which are no longer bound.
+ */
+static void
+cso_unpin_entries(struct cso_context *ctx)
+{
+   struct cso_shared_entry **pinned =
+      (struct cso_shared_entry **)ctx->pinned.data;
+   unsigned i = 0, n = ctx->pinned.size / sizeof(*pinned);
+
+   while (i < n) {
+      if (!cso_is_bound(ctx, pinned[i]->type, pinned[i]->data)) {
+         p_atomic_dec(&pinned[i]->refcount);
+         pinned[i] = pinned[--n];
+      } else
+         i++;
+   }
+
+   ctx->pinned.size = n * sizeof(*pinned);
+}
+
+/**
+ * Find or create a state object in the shared cache.  The object stays
+ * valid at least as long as it's bound in the context.
+ */
+static struct cso_shared_entry *
+cso_shared_lookup(struct cso_context *ctx, enum cso_cache_type type,
+                  unsigned hash_key, const void *templ, unsigned key_size)
+{
+   struct cso_shared_cache *shared = ctx->shared;
+   struct cso_front_slot *slot;
+   struct cso_shared_entry *entry;
+   struct cso_hash_iter iter;
+
+   slot = &ctx->front[type][(hash_key ^ (hash_key >> 6) ^ (hash_key >> 12)) %
+                            CSO_FRONT_CACHE_SIZE];
+   entry = slot->entry;
+   if (entry && slot->hash_key == hash_key &&
+       memcmp(&entry->cso, templ, key_size) == 0)
+      return entry;
+
+   if (ctx->pinned.size)
+      cso_unpin_entries(ctx);
+
+   pipe_mutex_lock(shared->mutex);
+
+   iter = cso_find_state_template(shared->cache, hash_key, type,
+                                  (void *)templ, key_size);
+   if (cso_hash_iter_is_null(iter)) {
+      entry = create_shared_entry(ctx, type, templ, key_size);
+      if (entry) {
+         shared->pipe = ctx->pipe;
+         iter = cso_insert_state(shared->cache, hash_key, type, entry);
+         shared->pipe = NULL;
+         if (cso_hash_iter_is_null(iter)) {
+            entry->delete_state(ctx->pipe, entry->data);
+            FREE(entry);
+            entry = NULL;
+         }
+      }
+   }
+   else {
+      entry = cso_hash_iter_data(iter);
+   }
+
+   if (entry)
+      p_atomic_inc(&entry->refcount);
+
+   pipe_mutex_unlock(shared->mutex);
+
+   if (!entry)
+      return NULL;
+
+   /* The old entry may still be bound until the caller binds the new
+    * one, or for longer if it was saved. */
+   if (slot->entry) {
+      if (cso_is_bound(ctx, slot->entry->type, slot->entry->data))
+         util_dynarray_append(&ctx->pinned, struct cso_shared_entry *,
+                              slot->entry);
+      else
+         p_atomic_dec(&slot->entry->refcount);
+   }
+
+   slot->hash_key = hash_key;
+   slot->entry = entry;
+   return entry;
+}
+
 static void cso_init_vbuf(struct cso_context *cso)
 {
    struct u_vbuf_caps caps;
@@ -261,12 +640,23 @@ struct cso_context *cso_create_context( struct pipe_context *pipe )
    if (ctx == NULL)
       goto out;
 
-   ctx->cache = cso_cache_create();
-   if (ctx->cache == NULL)
-      goto out;
-   cso_cache_set_sanitize_callback(ctx->cache,
-                                   sanitize_hash,
-                                   ctx);
+   if (pipe->screen->get_param(pipe->screen, PIPE_CAP_SHAREABLE_CSOS)) {
+      ctx->shared = cso_shared_cache_get(pipe->screen);
+      if (ctx->shared == NULL)
+         goto out;
+      util_dynarray_init(&ctx->pinned);
+   }
+   else {
+      ctx->cache = cso_cache_create();
+      if (ctx->cache == NULL)
+         goto out;
+      cso_cache_set_sanitize_callback(ctx->cache,
+                                      sanitize_hash,
+                                      ctx);
+
+      /* Enable for testing: */
+      if (0) cso_set_maximum_cache_size( ctx->cache, 4 );
+   }
 
    ctx->pipe = pipe;
    ctx->sample_mask = ~0;
@@ -275,9 +665,6 @@ struct cso_context *cso_create_context( struct pipe_context *pipe )
 
    cso_init_vbuf(ctx);
 
-   /* Enable for testing: */
-   if (0) cso_set_maximum_cache_size( ctx->cache, 4 );
-
    if (pipe->screen->get_shader_param(pipe->screen, PIPE_SHADER_GEOMETRY,
                                 PIPE_SHADER_CAP_MAX_INSTRUCTIONS) > 0) {
       ctx->has_geometry_shader = TRUE;
@@ -364,6 +751,9 @@ void cso_release_all( struct cso_context *ctx )
       cso_cache_delete( ctx->cache );
       ctx->cache = NULL;
    }
+
+   if (ctx->shared)
+      cso_shared_cache_release(ctx);
 }
 
 
@@ -402,30 +792,42 @@ enum pipe_error cso_set_blend(struct cso_context *ctx,
       sizeof(struct pipe_blend_state) :
       (char *)&(templ->rt[1]) - (char *)templ;
    hash_key = cso_construct_key((void*)templ, key_size);
-   iter = cso_find_state_template(ctx->cache, hash_key, CSO_BLEND,
-                                  (void*)templ, key_size);
 
-   if (cso_hash_iter_is_null(iter)) {
-      struct cso_blend *cso = MALLOC(sizeof(struct cso_blend));
-      if (!cso)
+   if (ctx->shared) {
+      struct cso_shared_entry *entry =
+         cso_shared_lookup(ctx, CSO_BLEND, hash_key, templ, key_size);
+      if (!entry)
          return PIPE_ERROR_OUT_OF_MEMORY;
 
-      memset(&cso->state, 0, sizeof cso->state);
-      memcpy(&cso->state, templ, key_size);
-      cso->data = ctx->pipe->create_blend_state(ctx->pipe, &cso->state);
-      cso->delete_state = (cso_state_callback)ctx->pipe->delete_blend_state;
-      cso->context = ctx->pipe;
+      handle = entry->data;
+   }
+   else {
+      iter = cso_find_state_template(ctx->cache, hash_key, CSO_BLEND,
+                                     (void*)templ, key_size);
 
-      iter = cso_insert_state(ctx->cache, hash_key, CSO_BLEND, cso);
       if (cso_hash_iter_is_null(iter)) {
-         FREE(cso);
-         return PIPE_ERROR_OUT_OF_MEMORY;
-      }
+         struct cso_blend *cso = MALLOC(sizeof(struct cso_blend));
+         if (!cso)
+            return PIPE_ERROR_OUT_OF_MEMORY;
 
-      handle = cso->data;
-   }
-   else {
-      handle = ((struct cso_blend *)cso_hash_iter_data(iter))->data;
+         memset(&cso->state, 0, sizeof cso->state);
+         memcpy(&cso->state, templ, key_size);
+         cso->data = ctx->pipe->create_blend_state(ctx->pipe, &cso->state);
+         cso->delete_state =
+            (cso_state_callback)ctx->pipe->delete_blend_state;
+         cso->context = ctx->pipe;
+
+         iter = cso_insert_state(ctx->cache, hash_key, CSO_BLEND, cso);
+         if (cso_hash_iter_is_null(iter)) {
+            FREE(cso);
+            return PIPE_ERROR_OUT_OF_MEMORY;
+         }
+
+         handle = cso->data;
+      }
+      else {
+         handle = ((struct cso_blend *)cso_hash_iter_data(iter))->data;
+      }
    }
 
    if (ctx->blend != handle) {
@@ -458,37 +860,50 @@ cso_set_depth_stencil_alpha(struct cso_context *ctx,
 {
    unsigned key_size = sizeof(struct pipe_depth_stencil_alpha_state);
    unsigned hash_key = cso_construct_key((void*)templ, key_size);
-   struct cso_hash_iter iter = cso_find_state_template(ctx->cache,
-                                                       hash_key,
-                                                       CSO_DEPTH_STENCIL_ALPHA,
-                                                       (void*)templ, key_size);
+   struct cso_hash_iter iter;
    void *handle;
 
-   if (cso_hash_iter_is_null(iter)) {
-      struct cso_depth_stencil_alpha *cso =
-         MALLOC(sizeof(struct cso_depth_stencil_alpha));
-      if (!cso)
+   if (ctx->shared) {
+      struct cso_shared_entry *entry =
+         cso_shared_lookup(ctx, CSO_DEPTH_STENCIL_ALPHA, hash_key,
+                           templ, key_size);
+      if (!entry)
          return PIPE_ERROR_OUT_OF_MEMORY;
 
-      memcpy(&cso->state, templ, sizeof(*templ));
-      cso->data = ctx->pipe->create_depth_stencil_alpha_state(ctx->pipe,
-                                                              &cso->state);
-      cso->delete_state =
-         (cso_state_callback)ctx->pipe->delete_depth_stencil_alpha_state;
-      cso->context = ctx->pipe;
+      handle = entry->data;
+   }
+   else {
+      iter = cso_find_state_template(ctx->cache,
+                                     hash_key,
+                                     CSO_DEPTH_STENCIL_ALPHA,
+                                     (void*)templ, key_size);
 
-      iter = cso_insert_state(ctx->cache, hash_key,
-                              CSO_DEPTH_STENCIL_ALPHA, cso);
       if (cso_hash_iter_is_null(iter)) {
-         FREE(cso);
-         return PIPE_ERROR_OUT_OF_MEMORY;
-      }
+         struct cso_depth_stencil_alpha *cso =
+            MALLOC(sizeof(struct cso_depth_stencil_alpha));
+         if (!cso)
+            return PIPE_ERROR_OUT_OF_MEMORY;
 
-      handle = cso->data;
-   }
-   else {
-      handle = ((struct cso_depth_stencil_alpha *)
-                cso_hash_iter_data(iter))->data;
+         memcpy(&cso->state, templ, sizeof(*templ));
+         cso->data = ctx->pipe->create_depth_stencil_alpha_state(ctx->pipe,
+                                                                 &cso->state);
+         cso->delete_state =
+            (cso_state_callback)ctx->pipe->delete_depth_stencil_alpha_state;
+         cso->context = ctx->pipe;
+
+         iter = cso_insert_state(ctx->cache, hash_key,
+                                 CSO_DEPTH_STENCIL_ALPHA, cso);
+         if (cso_hash_iter_is_null(iter)) {
+            FREE(cso);
+            return PIPE_ERROR_OUT_OF_MEMORY;
+         }
+
+         handle = cso->data;
+      }
+      else {
+         handle = ((struct cso_depth_stencil_alpha *)
+                   cso_hash_iter_data(iter))->data;
+      }
    }
 
    if (ctx->depth_stencil != handle) {
@@ -521,33 +936,46 @@ enum pipe_error cso_set_rasterizer(struct cso_context *ctx,
 {
    unsigned key_size = sizeof(struct pipe_rasterizer_state);
    unsigned hash_key = cso_construct_key((void*)templ, key_size);
-   struct cso_hash_iter iter = cso_find_state_template(ctx->cache,
-                                                       hash_key,
-                                                       CSO_RASTERIZER,
-                                                       (void*)templ, key_size);
+   struct cso_hash_iter iter;
    void *handle = NULL;
 
-   if (cso_hash_iter_is_null(iter)) {
-      struct cso_rasterizer *cso = MALLOC(sizeof(struct cso_rasterizer));
-      if (!cso)
+   if (ctx->shared) {
+      struct cso_shared_entry *entry =
+         cso_shared_lookup(ctx, CSO_RASTERIZER, hash_key, templ, key_size);
+      if (!entry)
          return PIPE_ERROR_OUT_OF_MEMORY;
 
-      memcpy(&cso->state, templ, sizeof(*templ));
-      cso->data = ctx->pipe->create_rasterizer_state(ctx->pipe, &cso->state);
-      cso->delete_state =
-         (cso_state_callback)ctx->pipe->delete_rasterizer_state;
-      cso->context = ctx->pipe;
+      handle = entry->data;
+   }
+   else {
+      iter = cso_find_state_template(ctx->cache,
+                                     hash_key,
+                                     CSO_RASTERIZER,
+                                     (void*)templ, key_size);
 
-      iter = cso_insert_state(ctx->cache, hash_key, CSO_RASTERIZER, cso);
       if (cso_hash_iter_is_null(iter)) {
-         FREE(cso);
-         return PIPE_ERROR_OUT_OF_MEMORY;
-      }
+         struct cso_rasterizer *cso = MALLOC(sizeof(struct cso_rasterizer));
+         if (!cso)
+            return PIPE_ERROR_OUT_OF_MEMORY;
 
-      handle = cso->data;
-   }
-   else {
-      handle = ((struct cso_rasterizer *)cso_hash_iter_data(iter))->data;
+         memcpy(&cso->state, templ, sizeof(*templ));
+         cso->data = ctx->pipe->create_rasterizer_state(ctx->pipe,
+                                                        &cso->state);
+         cso->delete_state =
+            (cso_state_callback)ctx->pipe->delete_rasterizer_state;
+         cso->context = ctx->pipe;
+
+         iter = cso_insert_state(ctx->cache, hash_key, CSO_RASTERIZER, cso);
+         if (cso_hash_iter_is_null(iter)) {
+            FREE(cso);
+            return PIPE_ERROR_OUT_OF_MEMORY;
+         }
+
+         handle = cso->data;
+      }
+      else {
+         handle = ((struct cso_rasterizer *)cso_hash_iter_data(iter))->data;
+      }
    }
 
    if (ctx->rasterizer != handle) {
@@ -880,31 +1308,43 @@ cso_set_vertex_elements(struct cso_context *ctx,
    memcpy(velems_state.velems, states,
           sizeof(struct pipe_vertex_element) * count);
    hash_key = cso_construct_key((void*)&velems_state, key_size);
-   iter = cso_find_state_template(ctx->cache, hash_key, CSO_VELEMENTS,
-                                  (void*)&velems_state, key_size);
 
-   if (cso_hash_iter_is_null(iter)) {
-      struct cso_velements *cso = MALLOC(sizeof(struct cso_velements));
-      if (!cso)
+   if (ctx->shared) {
+      struct cso_shared_entry *entry =
+         cso_shared_lookup(ctx, CSO_VELEMENTS, hash_key,
+                           &velems_state, key_size);
+      if (!entry)
          return PIPE_ERROR_OUT_OF_MEMORY;
 
-      memcpy(&cso->state, &velems_state, key_size);
-      cso->data = ctx->pipe->create_vertex_elements_state(ctx->pipe, count,
-                                                      &cso->state.velems[0]);
-      cso->delete_state =
-         (cso_state_callback) ctx->pipe->delete_vertex_elements_state;
-      cso->context = ctx->pipe;
+      handle = entry->data;
+   }
+   else {
+      iter = cso_find_state_template(ctx->cache, hash_key, CSO_VELEMENTS,
+                                     (void*)&velems_state, key_size);
 
-      iter = cso_insert_state(ctx->cache, hash_key, CSO_VELEMENTS, cso);
       if (cso_hash_iter_is_null(iter)) {
-         FREE(cso);
-         return PIPE_ERROR_OUT_OF_MEMORY;
-      }
+         struct cso_velements *cso = MALLOC(sizeof(struct cso_velements));
+         if (!cso)
+            return PIPE_ERROR_OUT_OF_MEMORY;
 
-      handle = cso->data;
-   }
-   else {
-      handle = ((struct cso_velements *)cso_hash_iter_data(iter))->data;
+         memcpy(&cso->state, &velems_state, key_size);
+         cso->data = ctx->pipe->create_vertex_elements_state(ctx->pipe, count,
+                                                         &cso->state.velems[0]);
+         cso->delete_state =
+            (cso_state_callback) ctx->pipe->delete_vertex_elements_state;
+         cso->context = ctx->pipe;
+
+         iter = cso_insert_state(ctx->cache, hash_key, CSO_VELEMENTS, cso);
+         if (cso_hash_iter_is_null(iter)) {
+            FREE(cso);
+            return PIPE_ERROR_OUT_OF_MEMORY;
+         }
+
+         handle = cso->data;
+      }
+      else {
+         handle = ((struct cso_velements *)cso_hash_iter_data(iter))->data;
+      }
    }
 
    if (ctx->velements != handle) {
@@ -1024,7 +1464,17 @@ single_sampler(struct cso_context *ctx,
 {
    void *handle = NULL;
 
-   if (templ != NULL) {
+   if (templ != NULL && ctx->shared) {
+      unsigned key_size = sizeof(struct pipe_sampler_state);
+      unsigned hash_key = cso_construct_key((void*)templ, key_size);
+      struct cso_shared_entry *entry =
+         cso_shared_lookup(ctx, CSO_SAMPLER, hash_key, templ, key_size);
+      if (!entry)
+         return PIPE_ERROR_OUT_OF_MEMORY;
+
+      handle = entry->data;
+   }
+   else if (templ != NULL) {
       unsigned key_size = sizeof(struct pipe_sampler_state);
       unsigned hash_key = cso_construct_key((void*)templ, key_size);
       struct cso_hash_iter iter =
@@ -47,6 +47,7 @@
 #include "gallivm/lp_bld_type.h"
 #include "gallivm/lp_bld_pack.h"
 #include "gallivm/lp_bld_format.h"
+#include "gallivm/lp_bld_shader_time.h"
 
 #include "tgsi/tgsi_exec.h"
 #include "tgsi/tgsi_dump.h"
@@ -542,6 +543,7 @@ draw_llvm_create(struct draw_context *draw)
 
    llvm->nr_variants = 0;
    make_empty_list(&llvm->vs_variants_list);
+   lp_shader_time_report_init(&llvm->vs_time, "vs", "vertices");
 
    llvm->nr_gs_variants = 0;
    make_empty_list(&llvm->gs_variants_list);
@@ -550,12 +552,40 @@ draw_llvm_create(struct draw_context *draw)
 }
 
 
+/**
+ * Add the shader time of a variant to the context's report.
+ */
+static void
+draw_llvm_record_shader_time(const struct draw_llvm_variant *variant)
+{
+   char name[64];
+
+   util_snprintf(name, sizeof name, "vs #%u var #%u",
+                 variant->shader->no, variant->no);
+   lp_shader_time_report_add(&variant->llvm->vs_time, name,
+                             variant->shader->base.state.tokens,
+                             variant->time, 1);
+}
+
+
 /**
  * Free per-context LLVM info.
  */
 void
 draw_llvm_destroy(struct draw_llvm *llvm)
 {
+   struct draw_llvm_variant_list_item *li;
+
+   /* print the shader time of the variants, deleted or still alive */
+   foreach(li, &llvm->vs_variants_list) {
+      if (li->base->time) {
+         draw_llvm_record_shader_time(li->base);
+         memset(li->base->time, 0, sizeof *li->base->time);
+      }
+   }
+   lp_shader_time_report_dump(&llvm->vs_time);
+   lp_shader_time_report_cleanup(&llvm->vs_time);
+
    /* XXX free other draw_llvm data? */
    FREE(llvm);
 }
@@ -581,6 +611,11 @@ draw_llvm_create_variant(struct draw_llvm *llvm,
       return NULL;
 
    variant->llvm = llvm;
+   variant->time = NULL;
+
+   if (lp_shader_time_enabled()) {
+      variant->time = lp_shader_time_create(1);
+   }
 
    variant->gallivm = gallivm_create();
 
@@ -606,7 +641,7 @@ draw_llvm_create_variant(struct draw_llvm *llvm,
    variant->shader = shader;
    variant->list_item_global.base = variant;
    variant->list_item_local.base = variant;
-   /*variant->no = */shader->variants_created++;
+   variant->no = shader->variants_created++;
    variant->list_item_global.base = variant;
 
    return variant;
@@ -1525,6 +1560,7 @@ draw_llvm_generate(struct draw_llvm *llvm, struct draw_llvm_variant *variant,
    struct lp_type vs_type;
    LLVMValueRef end, start;
    LLVMValueRef count, fetch_elts, fetch_elt_max, fetch_count;
+   LLVMValueRef start_time = NULL;
    LLVMValueRef vertex_id_offset;
    LLVMValueRef stride, step, io_itr;
    LLVMValueRef io_ptr, vbuffers_ptr, vb_ptr;
@@ -1631,6 +1667,10 @@ draw_llvm_generate(struct draw_llvm *llvm, struct draw_llvm_variant *variant,
    builder = gallivm->builder;
    LLVMPositionBuilderAtEnd(builder, block);
 
+   if (variant->time) {
+      start_time = lp_build_shader_time_begin(gallivm);
+   }
+
    lp_build_context_init(&bld, gallivm, lp_type_int(32));
 
    memset(&vs_type, 0, sizeof vs_type);
@@ -1821,6 +1861,13 @@ draw_llvm_generate(struct draw_llvm *llvm, struct draw_llvm_variant *variant,
    /* return clipping boolean value for function */
    ret = clipmask_booli32(gallivm, vs_type, clipmask_bool_ptr);
 
+   if (variant->time) {
+      lp_build_shader_time_end(gallivm, variant->time, NULL, start_time,
+                               LLVMBuildZExt(builder, count,
+                                             LLVMInt64TypeInContext(context),
+                                             ""));
+   }
+
    LLVMBuildRet(builder, ret);
 
    gallivm_verify_function(gallivm, variant_func);
@@ -2020,6 +2067,11 @@ draw_llvm_destroy_variant(struct draw_llvm_variant *variant)
 
    gallivm_destroy(variant->gallivm);
 
+   if (variant->time) {
+      draw_llvm_record_shader_time(variant);
+      lp_shader_time_destroy(variant->time);
+   }
+
    remove_from_list(&variant->list_item_local);
    variant->shader->variants_cached--;
    remove_from_list(&variant->list_item_global);
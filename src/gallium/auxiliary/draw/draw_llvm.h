@@ -35,6 +35,7 @@
 
 #include "gallivm/lp_bld_sample.h"
 #include "gallivm/lp_bld_limits.h"
+#include "gallivm/lp_bld_shader_time.h"
 
 #include "pipe/p_context.h"
 #include "util/u_simple_list.h"
@@ -401,12 +402,18 @@ struct draw_llvm_variant
    draw_jit_vert_func jit_func;
    draw_jit_vert_func_elts jit_func_elts;
 
+   /* Shader time counters, or NULL */
+   struct lp_shader_time *time;
+
    struct llvm_vertex_shader *shader;
 
    struct draw_llvm *llvm;
    struct draw_llvm_variant_list_item list_item_global;
    struct draw_llvm_variant_list_item list_item_local;
 
+   /* For debugging/profiling purposes */
+   unsigned no;
+
    /* key is variable-sized, must be last */
    struct draw_llvm_variant_key key;
 };
@@ -444,6 +451,9 @@ struct llvm_vertex_shader {
    struct draw_llvm_variant_list_item variants;
    unsigned variants_created;
    unsigned variants_cached;
+
+   /* For debugging/profiling purposes */
+   unsigned no;
 };
 
 struct llvm_geometry_shader {
@@ -465,6 +475,9 @@ struct draw_llvm {
    struct draw_llvm_variant_list_item vs_variants_list;
    int nr_variants;
 
+   /** Shader time of the vertex shader variants deleted so far */
+   struct lp_shader_time_report vs_time;
+
    struct draw_gs_llvm_variant_list_item gs_variants_list;
    int nr_gs_variants;
 };
@@ -84,6 +84,7 @@ struct draw_vertex_shader *
 draw_create_vs_llvm(struct draw_context *draw,
 		    const struct pipe_shader_state *state)
 {
+   static unsigned vs_no = 0;
    struct llvm_vertex_shader *vs = CALLOC_STRUCT( llvm_vertex_shader );
 
    if (vs == NULL)
@@ -113,5 +114,7 @@ draw_create_vs_llvm(struct draw_context *draw,
 
    make_empty_list(&vs->variants);
 
+   vs->no = vs_no++;
+
    return &vs->base;
 }
@@ -2024,16 +2024,73 @@ lp_build_sample_partial_offset(struct lp_build_context *bld,
 }
 
 
+/**
+ * Compute the partial offset of a texel along the x (axis 0) or y (axis 1)
+ * axis of a tiled texture, see LP_SAMPLER_TILE_SIZE.
+ *
+ * @param texel_bytes  texel size in bytes, a power of two
+ * @param coord   coordinate in texels
+ * @param stride  row stride in bytes, only used for the y axis
+ * @param out_offset  resulting relative offset of the texel in bytes
+ */
+void
+lp_build_sample_tiled_partial_offset(struct lp_build_context *bld,
+                                     unsigned axis,
+                                     unsigned texel_bytes,
+                                     LLVMValueRef coord,
+                                     LLVMValueRef stride,
+                                     LLVMValueRef *out_offset)
+{
+   LLVMBuilderRef builder = bld->gallivm->builder;
+   unsigned texel_shift = util_logbase2(texel_bytes);
+   LLVMValueRef tile_mask;
+   LLVMValueRef tile_coord;
+   LLVMValueRef subcoord;
+   LLVMValueRef offset;
+
+   assert(axis < 2);
+   assert(util_is_power_of_two(texel_bytes));
+
+   tile_mask = lp_build_const_int_vec(bld->gallivm, bld->type,
+                                      LP_SAMPLER_TILE_SIZE - 1);
+   subcoord = LLVMBuildAnd(builder, coord, tile_mask, "");
+   tile_coord = lp_build_andnot(bld, coord, tile_mask);
+
+   if (axis == 0) {
+      /* tile column * tile size + texel column * texel size */
+      offset = LLVMBuildShl(builder, tile_coord,
+                            lp_build_const_int_vec(bld->gallivm, bld->type,
+                                                   LP_SAMPLER_TILE_ORDER +
+                                                   texel_shift), "");
+      subcoord = LLVMBuildShl(builder, subcoord,
+                              lp_build_const_int_vec(bld->gallivm, bld->type,
+                                                     texel_shift), "");
+   }
+   else {
+      /* tile row * tile row size + texel row * tile row pitch */
+      offset = lp_build_mul(bld, tile_coord, stride);
+      subcoord = LLVMBuildShl(builder, subcoord,
+                              lp_build_const_int_vec(bld->gallivm, bld->type,
+                                                     LP_SAMPLER_TILE_ORDER +
+                                                     texel_shift), "");
+   }
+
+   *out_offset = lp_build_add(bld, offset, subcoord);
+}
+
+
 /**
  * Compute the offset of a pixel block.
  *
  * x, y, z, y_stride, z_stride are vectors, and they refer to pixels.
+ * If tiled is set the texture is stored in tiles, see LP_SAMPLER_TILE_SIZE.
  *
  * Returns the relative offset and i,j sub-block coordinates
  */
 void
 lp_build_sample_offset(struct lp_build_context *bld,
                        const struct util_format_description *format_desc,
+                       boolean tiled,
                        LLVMValueRef x,
                        LLVMValueRef y,
                        LLVMValueRef z,
@@ -2049,17 +2106,37 @@ lp_build_sample_offset(struct lp_build_context *bld,
    x_stride = lp_build_const_vec(bld->gallivm, bld->type,
                                  format_desc->block.bits/8);
 
-   lp_build_sample_partial_offset(bld,
-                                  format_desc->block.width,
-                                  x, x_stride,
-                                  &offset, out_i);
+   if (tiled) {
+      assert(format_desc->block.width == 1);
+      assert(format_desc->block.height == 1);
+      lp_build_sample_tiled_partial_offset(bld, 0,
+                                           format_desc->block.bits/8,
+                                           x, x_stride,
+                                           &offset);
+      *out_i = bld->zero;
+   }
+   else {
+      lp_build_sample_partial_offset(bld,
+                                     format_desc->block.width,
+                                     x, x_stride,
+                                     &offset, out_i);
+   }
 
    if (y && y_stride) {
       LLVMValueRef y_offset;
-      lp_build_sample_partial_offset(bld,
-                                     format_desc->block.height,
-                                     y, y_stride,
-                                     &y_offset, out_j);
+      if (tiled) {
+         lp_build_sample_tiled_partial_offset(bld, 1,
+                                              format_desc->block.bits/8,
+                                              y, y_stride,
+                                              &y_offset);
+         *out_j = bld->zero;
+      }
+      else {
+         lp_build_sample_partial_offset(bld,
+                                        format_desc->block.height,
+                                        y, y_stride,
+                                        &y_offset, out_j);
+      }
       offset = lp_build_add(bld, offset, y_offset);
    }
    else {
@@ -68,6 +68,21 @@ enum lp_sampler_lod_property {
 };
 
 
+/**
+ * Textures with lp_static_texture_state::tiled set store each 2D image in
+ * square tiles of LP_SAMPLER_TILE_SIZE x LP_SAMPLER_TILE_SIZE texels.  The
+ * tiles are laid out left to right, top to bottom, and the texels inside a
+ * tile in row-major order, so that bilinear footprints and vertical
+ * neighbours mostly share a cache line.
+ *
+ * A row of tiles takes up LP_SAMPLER_TILE_SIZE rows of the linear layout,
+ * so the row and image strides are the same for both layouts.  Only plain
+ * formats with power of two texel sizes and 1x1 blocks can be tiled.
+ */
+#define LP_SAMPLER_TILE_ORDER 2
+#define LP_SAMPLER_TILE_SIZE (1 << LP_SAMPLER_TILE_ORDER)
+
+
 /**
  * Texture static state.
  *
@@ -89,6 +104,7 @@ struct lp_static_texture_state
    unsigned pot_height:1;
    unsigned pot_depth:1;
    unsigned level_zero_only:1;
+   unsigned tiled:1;         /**< see LP_SAMPLER_TILE_SIZE */
 };
 
 
@@ -485,9 +501,19 @@ lp_build_sample_partial_offset(struct lp_build_context *bld,
                                LLVMValueRef *out_i);
 
 
+void
+lp_build_sample_tiled_partial_offset(struct lp_build_context *bld,
+                                     unsigned axis,
+                                     unsigned texel_bytes,
+                                     LLVMValueRef coord,
+                                     LLVMValueRef stride,
+                                     LLVMValueRef *out_offset);
+
+
 void
 lp_build_sample_offset(struct lp_build_context *bld,
                        const struct util_format_description *format_desc,
+                       boolean tiled,
                        LLVMValueRef x,
                        LLVMValueRef y,
                        LLVMValueRef z,
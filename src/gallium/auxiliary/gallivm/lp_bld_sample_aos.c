@@ -59,9 +59,37 @@
 #include "lp_bld_quad.h"
 
 
+/**
+ * Compute the partial offset of a pixel block along the given axis
+ * (0 = x, 1 = y, 2 = z), taking tiled textures into account.
+ */
+static void
+lp_build_sample_aos_partial_offset(struct lp_build_sample_context *bld,
+                                   unsigned axis,
+                                   unsigned block_length,
+                                   LLVMValueRef coord,
+                                   LLVMValueRef stride,
+                                   LLVMValueRef *out_offset,
+                                   LLVMValueRef *out_subcoord)
+{
+   if (bld->static_texture_state->tiled && axis < 2) {
+      lp_build_sample_tiled_partial_offset(&bld->int_coord_bld, axis,
+                                           bld->format_desc->block.bits/8,
+                                           coord, stride, out_offset);
+      *out_subcoord = bld->int_coord_bld.zero;
+   }
+   else {
+      lp_build_sample_partial_offset(&bld->int_coord_bld, block_length,
+                                     coord, stride,
+                                     out_offset, out_subcoord);
+   }
+}
+
+
 /**
  * Build LLVM code for texture coord wrapping, for nearest filtering,
  * for scaled integer texcoords.
+ * \param axis  the coordinate axis (0 = x, 1 = y, 2 = z)
  * \param block_length  is the length of the pixel block along the
  *                      coordinate axis
  * \param coord  the incoming texcoord (s,t or r) scaled to the texture size
@@ -76,6 +104,7 @@
  */
 static void
 lp_build_sample_wrap_nearest_int(struct lp_build_sample_context *bld,
+                                 unsigned axis,
                                  unsigned block_length,
                                  LLVMValueRef coord,
                                  LLVMValueRef coord_f,
@@ -126,8 +155,8 @@ lp_build_sample_wrap_nearest_int(struct lp_build_sample_context *bld,
       assert(0);
    }
 
-   lp_build_sample_partial_offset(int_coord_bld, block_length, coord, stride,
-                                  out_offset, out_i);
+   lp_build_sample_aos_partial_offset(bld, axis, block_length, coord, stride,
+                                      out_offset, out_i);
 }
 
 
@@ -196,6 +225,7 @@ lp_build_sample_wrap_nearest_float(struct lp_build_sample_context *bld,
 /**
  * Build LLVM code for texture coord wrapping, for linear filtering,
  * for scaled integer texcoords.
+ * \param axis  the coordinate axis (0 = x, 1 = y, 2 = z)
  * \param block_length  is the length of the pixel block along the
  *                      coordinate axis
  * \param coord0  the incoming texcoord (s,t or r) scaled to the texture size
@@ -212,6 +242,7 @@ lp_build_sample_wrap_nearest_float(struct lp_build_sample_context *bld,
  */
 static void
 lp_build_sample_wrap_linear_int(struct lp_build_sample_context *bld,
+                                unsigned axis,
                                 unsigned block_length,
                                 LLVMValueRef coord0,
                                 LLVMValueRef *weight_i,
@@ -232,15 +263,16 @@ lp_build_sample_wrap_linear_int(struct lp_build_sample_context *bld,
    LLVMValueRef lmask, umask, mask;
 
    /*
-    * If the pixel block covers more than one pixel then there is no easy
-    * way to calculate offset1 relative to offset0. Instead, compute them
-    * independently. Otherwise, try to compute offset0 and offset1 with
-    * a single stride multiplication.
+    * If the pixel block covers more than one pixel, or the texture is
+    * tiled, then there is no easy way to calculate offset1 relative to
+    * offset0. Instead, compute them independently. Otherwise, try to
+    * compute offset0 and offset1 with a single stride multiplication.
     */
 
    length_minus_one = lp_build_sub(int_coord_bld, length, int_coord_bld->one);
 
-   if (block_length != 1) {
+   if (block_length != 1 ||
+       (bld->static_texture_state->tiled && axis < 2)) {
       LLVMValueRef coord1;
       switch(wrap_mode) {
       case PIPE_TEX_WRAP_REPEAT:
@@ -292,10 +324,10 @@ lp_build_sample_wrap_linear_int(struct lp_build_sample_context *bld,
          coord1 = int_coord_bld->zero;
          break;
       }
-      lp_build_sample_partial_offset(int_coord_bld, block_length, coord0, stride,
-                                     offset0, i0);
-      lp_build_sample_partial_offset(int_coord_bld, block_length, coord1, stride,
-                                     offset1, i1);
+      lp_build_sample_aos_partial_offset(bld, axis, block_length,
+                                         coord0, stride, offset0, i0);
+      lp_build_sample_aos_partial_offset(bld, axis, block_length,
+                                         coord1, stride, offset1, i1);
       return;
    }
 
@@ -645,6 +677,7 @@ lp_build_sample_image_nearest(struct lp_build_sample_context *bld,
 
    /* Do texcoord wrapping, compute texel offset */
    lp_build_sample_wrap_nearest_int(bld,
+                                    0,
                                     bld->format_desc->block.width,
                                     s_ipart, s_float,
                                     width_vec, x_stride, offsets[0],
@@ -655,6 +688,7 @@ lp_build_sample_image_nearest(struct lp_build_sample_context *bld,
    if (dims >= 2) {
       LLVMValueRef y_offset;
       lp_build_sample_wrap_nearest_int(bld,
+                                       1,
                                        bld->format_desc->block.height,
                                        t_ipart, t_float,
                                        height_vec, row_stride_vec, offsets[1],
@@ -665,6 +699,7 @@ lp_build_sample_image_nearest(struct lp_build_sample_context *bld,
       if (dims >= 3) {
          LLVMValueRef z_offset;
          lp_build_sample_wrap_nearest_int(bld,
+                                          2,
                                           1, /* block length (depth) */
                                           r_ipart, r_float,
                                           depth_vec, img_stride_vec, offsets[2],
@@ -769,6 +804,7 @@ lp_build_sample_image_nearest_afloat(struct lp_build_sample_context *bld,
     */
    lp_build_sample_offset(&bld->int_coord_bld,
                           bld->format_desc,
+                          bld->static_texture_state->tiled,
                           x_icoord, y_icoord,
                           z_icoord,
                           row_stride_vec, img_stride_vec,
@@ -1089,6 +1125,7 @@ lp_build_sample_image_linear(struct lp_build_sample_context *bld,
 
    /* do texcoord wrapping and compute texel offsets */
    lp_build_sample_wrap_linear_int(bld,
+                                   0,
                                    bld->format_desc->block.width,
                                    s_ipart, &s_fpart, s_float,
                                    width_vec, x_stride, offsets[0],
@@ -1121,6 +1158,7 @@ lp_build_sample_image_linear(struct lp_build_sample_context *bld,
 
    if (dims >= 2) {
       lp_build_sample_wrap_linear_int(bld,
+                                      1,
                                       bld->format_desc->block.height,
                                       t_ipart, &t_fpart, t_float,
                                       height_vec, y_stride, offsets[1],
@@ -1141,6 +1179,7 @@ lp_build_sample_image_linear(struct lp_build_sample_context *bld,
 
    if (dims >= 3) {
       lp_build_sample_wrap_linear_int(bld,
+                                      2,
                                       1, /* block length (depth) */
                                       r_ipart, &r_fpart, r_float,
                                       depth_vec, z_stride, offsets[2],
@@ -1259,14 +1298,14 @@ lp_build_sample_image_linear_afloat(struct lp_build_sample_context *bld,
     * cannot do offset calc with floats, difficult for block-based formats,
     * and not enough precision anyway.
     */
-   lp_build_sample_partial_offset(&bld->int_coord_bld,
-                                  bld->format_desc->block.width,
-                                  x_icoord0, x_stride,
-                                  &x_offset0, &x_subcoord[0]);
-   lp_build_sample_partial_offset(&bld->int_coord_bld,
-                                  bld->format_desc->block.width,
-                                  x_icoord1, x_stride,
-                                  &x_offset1, &x_subcoord[1]);
+   lp_build_sample_aos_partial_offset(bld, 0,
+                                      bld->format_desc->block.width,
+                                      x_icoord0, x_stride,
+                                      &x_offset0, &x_subcoord[0]);
+   lp_build_sample_aos_partial_offset(bld, 0,
+                                      bld->format_desc->block.width,
+                                      x_icoord1, x_stride,
+                                      &x_offset1, &x_subcoord[1]);
 
    /* add potential cube/array/mip offsets now as they are constant per pixel */
    if (bld->static_texture_state->target == PIPE_TEXTURE_CUBE ||
@@ -1291,14 +1330,14 @@ lp_build_sample_image_linear_afloat(struct lp_build_sample_context *bld,
    }
 
    if (dims >= 2) {
-      lp_build_sample_partial_offset(&bld->int_coord_bld,
-                                     bld->format_desc->block.height,
-                                     y_icoord0, y_stride,
-                                     &y_offset0, &y_subcoord[0]);
-      lp_build_sample_partial_offset(&bld->int_coord_bld,
-                                     bld->format_desc->block.height,
-                                     y_icoord1, y_stride,
-                                     &y_offset1, &y_subcoord[1]);
+      lp_build_sample_aos_partial_offset(bld, 1,
+                                         bld->format_desc->block.height,
+                                         y_icoord0, y_stride,
+                                         &y_offset0, &y_subcoord[0]);
+      lp_build_sample_aos_partial_offset(bld, 1,
+                                         bld->format_desc->block.height,
+                                         y_icoord1, y_stride,
+                                         &y_offset1, &y_subcoord[1]);
       for (z = 0; z < 2; z++) {
          for (x = 0; x < 2; x++) {
             offset[z][0][x] = lp_build_add(&bld->int_coord_bld,
@@ -0,0 +1,317 @@
+/**************************************************************************
+ *
+ * Copyright 2013 agent <agent@local>
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * @file
+ * Shader time instrumentation.
+ *
+ * The cycle counter is read with the llvm.readcyclecounter intrinsic,
+ * which is RDTSC on x86.  The counters are updated with plain loads and
+ * stores: each thread owns its own struct lp_shader_time, and they are
+ * only summed up once the shaders are idle.
+ */
+
+#include <stdlib.h>
+
+#include "util/u_debug.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "util/u_string.h"
+#include "tgsi/tgsi_dump.h"
+#include "tgsi/tgsi_parse.h"
+#include "lp_bld_const.h"
+#include "lp_bld_intr.h"
+#include "lp_bld_shader_time.h"
+
+
+/** Number of hottest variants whose TGSI is dumped with the report */
+#define LP_SHADER_TIME_DUMP_TGSI 3
+
+
+DEBUG_GET_ONCE_BOOL_OPTION(shader_time, "GALLIVM_SHADER_TIME", FALSE)
+
+
+/**
+ * Whether shaders should be built with timing instrumentation.  This is
+ * available in release builds too, as those are the ones worth profiling.
+ */
+boolean
+lp_shader_time_enabled(void)
+{
+   return debug_get_option_shader_time();
+}
+
+
+/**
+ * Allocate zeroed counters for nr_threads threads.
+ */
+struct lp_shader_time *
+lp_shader_time_create(unsigned nr_threads)
+{
+   struct lp_shader_time *time;
+
+   time = align_malloc(nr_threads * sizeof *time, 64);
+   if (time)
+      memset(time, 0, nr_threads * sizeof *time);
+
+   return time;
+}
+
+
+void
+lp_shader_time_destroy(struct lp_shader_time *time)
+{
+   align_free(time);
+}
+
+
+static LLVMValueRef
+lp_build_read_cycle_counter(struct gallivm_state *gallivm)
+{
+   return lp_build_intrinsic(gallivm->builder, "llvm.readcyclecounter",
+                             LLVMInt64TypeInContext(gallivm->context),
+                             NULL, 0);
+}
+
+
+/**
+ * Read the cycle counter at the start of a shader.
+ */
+LLVMValueRef
+lp_build_shader_time_begin(struct gallivm_state *gallivm)
+{
+   return lp_build_read_cycle_counter(gallivm);
+}
+
+
+static void
+lp_build_counter_add(struct gallivm_state *gallivm,
+                     LLVMValueRef base,
+                     LLVMValueRef index,
+                     unsigned member,
+                     LLVMValueRef value)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef ptr;
+   LLVMValueRef counter;
+
+   index = LLVMBuildAdd(builder, index,
+                        lp_build_const_int32(gallivm, member), "");
+   ptr = LLVMBuildGEP(builder, base, &index, 1, "");
+   counter = LLVMBuildLoad(builder, ptr, "");
+   counter = LLVMBuildAdd(builder, counter, value, "");
+   LLVMBuildStore(builder, counter, ptr);
+}
+
+
+/**
+ * Read the cycle counter at the end of a shader and accumulate the time
+ * elapsed since start into time[thread_index].
+ *
+ * \param thread_index  index of the calling thread (i32), or NULL for 0
+ * \param items  number of items processed (i64), or NULL
+ */
+void
+lp_build_shader_time_end(struct gallivm_state *gallivm,
+                         struct lp_shader_time *time,
+                         LLVMValueRef thread_index,
+                         LLVMValueRef start,
+                         LLVMValueRef items)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef int64_type = LLVMInt64TypeInContext(gallivm->context);
+   const unsigned words = sizeof *time / sizeof(uint64_t);
+   LLVMValueRef base;
+   LLVMValueRef index;
+   LLVMValueRef cycles;
+
+   cycles = lp_build_read_cycle_counter(gallivm);
+   cycles = LLVMBuildSub(builder, cycles, start, "cycles");
+
+   base = lp_build_const_int_pointer(gallivm, time);
+   base = LLVMBuildBitCast(builder, base, LLVMPointerType(int64_type, 0), "");
+
+   if (thread_index) {
+      index = LLVMBuildMul(builder, thread_index,
+                           lp_build_const_int32(gallivm, words), "");
+   }
+   else {
+      index = lp_build_const_int32(gallivm, 0);
+   }
+
+   lp_build_counter_add(gallivm, base, index,
+                        offsetof(struct lp_shader_time, cycles) / 8,
+                        cycles);
+   lp_build_counter_add(gallivm, base, index,
+                        offsetof(struct lp_shader_time, invocations) / 8,
+                        LLVMConstInt(int64_type, 1, 0));
+   if (items) {
+      lp_build_counter_add(gallivm, base, index,
+                           offsetof(struct lp_shader_time, items) / 8,
+                           items);
+   }
+}
+
+
+void
+lp_shader_time_report_init(struct lp_shader_time_report *report,
+                           const char *title,
+                           const char *item_name)
+{
+   memset(report, 0, sizeof *report);
+   report->title = title;
+   report->item_name = item_name;
+}
+
+
+/**
+ * Sum up the per-thread counters of a variant into the report.  Variants
+ * that never ran are left out.  The tokens are copied, as the shader is
+ * usually deleted before the report is printed.
+ */
+void
+lp_shader_time_report_add(struct lp_shader_time_report *report,
+                          const char *name,
+                          const struct tgsi_token *tokens,
+                          const struct lp_shader_time *time,
+                          unsigned nr_threads)
+{
+   struct lp_shader_time_entry *entry;
+   struct lp_shader_time total;
+   unsigned i;
+
+   memset(&total, 0, sizeof total);
+   for (i = 0; i < nr_threads; i++) {
+      total.cycles += time[i].cycles;
+      total.invocations += time[i].invocations;
+      total.items += time[i].items;
+   }
+
+   if (!total.invocations)
+      return;
+
+   if (report->nr_entries == report->max_entries) {
+      unsigned max_entries = MAX2(16, report->max_entries * 2);
+      struct lp_shader_time_entry *entries;
+
+      entries = REALLOC(report->entries,
+                        report->max_entries * sizeof *entries,
+                        max_entries * sizeof *entries);
+      if (!entries)
+         return;
+
+      report->entries = entries;
+      report->max_entries = max_entries;
+   }
+
+   entry = &report->entries[report->nr_entries++];
+   util_snprintf(entry->name, sizeof entry->name, "%s", name);
+   entry->tokens = tokens ? tgsi_dup_tokens(tokens) : NULL;
+   entry->total = total;
+}
+
+
+static int
+compare_entries(const void *a, const void *b)
+{
+   const struct lp_shader_time_entry *ea = a;
+   const struct lp_shader_time_entry *eb = b;
+
+   if (ea->total.cycles > eb->total.cycles)
+      return -1;
+   if (ea->total.cycles < eb->total.cycles)
+      return 1;
+   return 0;
+}
+
+
+/**
+ * Sort the variants by total cycles, in place, and print them, followed by
+ * the TGSI of the hottest ones.  Unlike debug_printf, _debug_printf and
+ * tgsi_dump also print in release builds.
+ */
+void
+lp_shader_time_report_dump(struct lp_shader_time_report *report)
+{
+   uint64_t total_cycles = 0;
+   unsigned i;
+
+   if (!report->nr_entries)
+      return;
+
+   qsort(report->entries, report->nr_entries, sizeof report->entries[0],
+         compare_entries);
+
+   for (i = 0; i < report->nr_entries; i++) {
+      total_cycles += report->entries[i].total.cycles;
+   }
+
+   _debug_printf("%s shader time:\n", report->title);
+   _debug_printf("  %-24s %14s %6s %12s %10s %14s %10s\n",
+                 "variant", "cycles", "%", "invocations", "cyc/inv",
+                 report->item_name, "cyc/item");
+
+   for (i = 0; i < report->nr_entries; i++) {
+      const struct lp_shader_time_entry *entry = &report->entries[i];
+      const struct lp_shader_time *t = &entry->total;
+
+      _debug_printf("  %-24s %14llu %5.1f%% %12llu %10.1f %14llu %10.2f\n",
+                    entry->name,
+                    (unsigned long long) t->cycles,
+                    total_cycles ? 100.0 * t->cycles / total_cycles : 0.0,
+                    (unsigned long long) t->invocations,
+                    (double) t->cycles / t->invocations,
+                    (unsigned long long) t->items,
+                    t->items ? (double) t->cycles / t->items : 0.0);
+   }
+
+   for (i = 0; i < MIN2(report->nr_entries, LP_SHADER_TIME_DUMP_TGSI); i++) {
+      const struct lp_shader_time_entry *entry = &report->entries[i];
+
+      if (entry->tokens) {
+         _debug_printf("%s %s:\n", report->title, entry->name);
+         tgsi_dump(entry->tokens, 0);
+      }
+   }
+}
+
+
+void
+lp_shader_time_report_cleanup(struct lp_shader_time_report *report)
+{
+   unsigned i;
+
+   for (i = 0; i < report->nr_entries; i++) {
+      FREE(report->entries[i].tokens);
+   }
+   FREE(report->entries);
+
+   report->entries = NULL;
+   report->nr_entries = 0;
+   report->max_entries = 0;
+}
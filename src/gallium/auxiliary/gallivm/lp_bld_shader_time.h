@@ -0,0 +1,130 @@
+/**************************************************************************
+ *
+ * Copyright 2013 agent <agent@local>
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * @file
+ * Shader time instrumentation.
+ *
+ * When GALLIVM_SHADER_TIME is set, JIT'd shaders read the CPU cycle
+ * counter on entry and exit and accumulate the elapsed cycles, the number
+ * of invocations and the number of items processed (pixels, vertices) into
+ * counters owned by the shader variant.  The counters of all variants are
+ * gathered into a report which is printed, hottest variant first, when the
+ * context is destroyed.
+ */
+
+#ifndef LP_BLD_SHADER_TIME_H
+#define LP_BLD_SHADER_TIME_H
+
+
+#include "pipe/p_compiler.h"
+#include "lp_bld.h"
+#include "lp_bld_init.h"
+
+
+struct tgsi_token;
+
+
+/**
+ * Per-thread counters.  Padded to a cache line so that the rasterizer
+ * threads don't contend for the same line.
+ */
+struct lp_shader_time
+{
+   uint64_t cycles;
+   uint64_t invocations;
+   uint64_t items;
+   uint64_t pad[5];
+};
+
+
+struct lp_shader_time_entry
+{
+   char name[64];
+   struct tgsi_token *tokens;
+   struct lp_shader_time total;
+};
+
+
+struct lp_shader_time_report
+{
+   const char *title;
+   const char *item_name;
+   struct lp_shader_time_entry *entries;
+   unsigned nr_entries;
+   unsigned max_entries;
+};
+
+
+boolean
+lp_shader_time_enabled(void);
+
+
+struct lp_shader_time *
+lp_shader_time_create(unsigned nr_threads);
+
+
+void
+lp_shader_time_destroy(struct lp_shader_time *time);
+
+
+LLVMValueRef
+lp_build_shader_time_begin(struct gallivm_state *gallivm);
+
+
+void
+lp_build_shader_time_end(struct gallivm_state *gallivm,
+                         struct lp_shader_time *time,
+                         LLVMValueRef thread_index,
+                         LLVMValueRef start,
+                         LLVMValueRef items);
+
+
+void
+lp_shader_time_report_init(struct lp_shader_time_report *report,
+                           const char *title,
+                           const char *item_name);
+
+
+void
+lp_shader_time_report_add(struct lp_shader_time_report *report,
+                          const char *name,
+                          const struct tgsi_token *tokens,
+                          const struct lp_shader_time *time,
+                          unsigned nr_threads);
+
+
+void
+lp_shader_time_report_dump(struct lp_shader_time_report *report);
+
+
+void
+lp_shader_time_report_cleanup(struct lp_shader_time_report *report);
+
+
+#endif /* !LP_BLD_SHADER_TIME_H */
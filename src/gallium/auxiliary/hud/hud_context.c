@@ -31,15 +31,21 @@
  *
  * The HUD is controlled with the GALLIUM_HUD environment variable.
  * Set GALLIUM_HUD=help for more info.
+ *
+ * GALLIUM_HUD_CSV=filename also appends the CPU timers of hud_timer.h to
+ * the file, one line per frame.  Each context of the process gets its own
+ * file.  It works without GALLIUM_HUD, in which case nothing is drawn.
  */
 
 #include <stdio.h>
+#include <inttypes.h>
 
 #include "hud/hud_context.h"
 #include "hud/hud_private.h"
 #include "hud/font.h"
 
 #include "cso_cache/cso_context.h"
+#include "os/os_thread.h"
 #include "util/u_draw_quad.h"
 #include "util/u_inlines.h"
 #include "util/u_memory.h"
@@ -84,6 +90,12 @@ struct hud_context {
 
    unsigned fb_width, fb_height;
 
+   /* CSV log */
+   FILE *csv;
+   uint64_t csv_frame;
+   int64_t csv_start, csv_last_time;
+   int32_t csv_last_ns[HUD_NUM_TIMERS];
+
    /* vertices for text and background drawing are accumulated here and then
     * drawn all at once */
    struct vertex_queue {
@@ -388,6 +400,73 @@ hud_alloc_vertices(struct hud_context *hud, struct vertex_queue *v,
                   (void**)&v->vertices);
 }
 
+/**
+ * Append a line with the time spent in the CPU timers since the last frame
+ * to the CSV log.
+ */
+static void
+hud_csv_log_frame(struct hud_context *hud)
+{
+   int64_t now = os_time_get();
+   unsigned i;
+
+   fprintf(hud->csv, "%"PRIu64",%"PRId64",%"PRId64, hud->csv_frame++,
+           now - hud->csv_start, now - hud->csv_last_time);
+
+   for (i = 0; i < HUD_NUM_TIMERS; i++) {
+      int32_t ns = p_atomic_read(&hud_timer_ns[i]);
+
+      fprintf(hud->csv, ",%u", (uint32_t) (ns - hud->csv_last_ns[i]) / 1000);
+      hud->csv_last_ns[i] = ns;
+   }
+
+   fputc('\n', hud->csv);
+   hud->csv_last_time = now;
+}
+
+pipe_static_mutex(hud_csv_mutex);
+static unsigned hud_csv_contexts = 0;
+
+/**
+ * Open the CSV log for appending.  The first context of the process logs to
+ * \p filename itself, later ones to filename.1, filename.2, etc, so that
+ * contexts don't interleave their lines.
+ */
+static void
+hud_csv_open(struct hud_context *hud, const char *filename)
+{
+   char name[512];
+   unsigned i, index;
+
+   pipe_mutex_lock(hud_csv_mutex);
+   index = hud_csv_contexts++;
+   pipe_mutex_unlock(hud_csv_mutex);
+
+   if (index)
+      util_snprintf(name, sizeof(name), "%s.%u", filename, index);
+   else
+      util_snprintf(name, sizeof(name), "%s", filename);
+
+   hud->csv = fopen(name, "a");
+   if (!hud->csv) {
+      fprintf(stderr, "gallium_hud: can't open %s for writing\n", name);
+      return;
+   }
+
+   /* write complete lines, so that the log can be followed */
+   setvbuf(hud->csv, NULL, _IOLBF, 0);
+
+   fputs("frame,time_us,frame_us", hud->csv);
+   for (i = 0; i < HUD_NUM_TIMERS; i++) {
+      fprintf(hud->csv, ",%s_us", hud_timer_names[i]);
+      hud->csv_last_ns[i] = p_atomic_read(&hud_timer_ns[i]);
+   }
+   fputc('\n', hud->csv);
+
+   hud->csv_start = hud->csv_last_time = os_time_get();
+   p_atomic_inc(&hud_timer_users);
+}
+
 /**
  * Draw the HUD to the texture \p tex.
  * The texture is usually the back buffer being displayed.
@@ -405,6 +484,12 @@ hud_draw(struct hud_context *hud, struct pipe_resource *tex)
    struct hud_pane *pane;
    struct hud_graph *gr;
 
+   if (hud->csv)
+      hud_csv_log_frame(hud);
+
+   if (LIST_IS_EMPTY(&hud->pane_list))
+      return;
+
    hud->fb_width = tex->width0;
    hud->fb_height = tex->height0;
    hud->constants.two_div_fb_width = 2.0f / hud->fb_width;
@@ -699,6 +784,26 @@ has_pipeline_stats_query(struct pipe_screen *screen)
    return screen->get_param(screen, PIPE_CAP_QUERY_PIPELINE_STATISTICS) != 0;
 }
 
+/**
+ * Look up the timer of a "<timer>-time" graph name.
+ */
+static boolean
+hud_find_timer(const char *name, unsigned *timer)
+{
+   char timer_name[128];
+   unsigned i;
+
+   for (i = 0; i < HUD_NUM_TIMERS; i++) {
+      util_snprintf(timer_name, sizeof(timer_name), "%s-time",
+                    hud_timer_names[i]);
+      if (strcmp(name, timer_name) == 0) {
+         *timer = i;
+         return TRUE;
+      }
+   }
+   return FALSE;
+}
+
 static void
 hud_parse_env_var(struct hud_context *hud, const char *env)
 {
@@ -743,6 +848,9 @@ hud_parse_env_var(struct hud_context *hud, const char *env)
       else if (sscanf(name, "cpu%u%s", &i, s) == 1) {
          hud_cpu_graph_install(pane, i);
       }
+      else if (hud_find_timer(name, &i)) {
+         hud_timer_graph_install(pane, i);
+      }
       else if (strcmp(name, "samples-passed") == 0 &&
                has_occlusion_query(hud->pipe->screen)) {
          hud_pipe_query_install(pane, hud->pipe, "samples-passed",
@@ -883,6 +991,10 @@ print_help(struct pipe_screen *screen)
    for (i = 0; i < num_cpus; i++)
       printf("    cpu%i\n", i);
 
+   /* CPU timers, in microseconds per frame */
+   for (i = 0; i < HUD_NUM_TIMERS; i++)
+      printf("    %s-time\n", hud_timer_names[i]);
+
    if (has_occlusion_query(screen))
       puts("    samples-passed");
    if (has_streamout(screen))
@@ -913,6 +1025,14 @@ print_help(struct pipe_screen *screen)
    }
 
    puts("");
+   puts("  The *-time graphs show the CPU time spent in state validation,");
+   puts("  shader compilation, draw submission, flushes and fence waits, and");
+   puts("  buffer mapping, in microseconds per frame.");
+   puts("");
+   puts("  GALLIUM_HUD_CSV=filename appends the same timers to a CSV file, one");
+   puts("  line per frame, even if GALLIUM_HUD isn't set.  Contexts other");
+   puts("  than the first one log to filename.1, filename.2, etc.");
+   puts("");
 }
 
 struct hud_context *
@@ -922,11 +1042,17 @@ hud_create(struct pipe_context *pipe, struct cso_context *cso)
    struct pipe_sampler_view view_templ;
    unsigned i;
    const char *env = debug_get_option("GALLIUM_HUD", NULL);
+   const char *csv = debug_get_option("GALLIUM_HUD_CSV", NULL);
 
-   if (!env || !*env)
+   if (env && !*env)
+      env = NULL;
+   if (csv && !*csv)
+      csv = NULL;
+
+   if (!env && !csv)
       return NULL;
 
-   if (strcmp(env, "help") == 0) {
+   if (env && strcmp(env, "help") == 0) {
       print_help(pipe->screen);
       return NULL;
    }
@@ -1068,7 +1194,10 @@ hud_create(struct pipe_context *pipe, struct cso_context *cso)
 
    LIST_INITHEAD(&hud->pane_list);
 
-   hud_parse_env_var(hud, env);
+   if (env)
+      hud_parse_env_var(hud, env);
+   if (csv)
+      hud_csv_open(hud, csv);
    return hud;
 }
 
@@ -1088,6 +1217,11 @@ hud_destroy(struct hud_context *hud)
       FREE(pane);
    }
 
+   if (hud->csv) {
+      fclose(hud->csv);
+      p_atomic_dec(&hud_timer_users);
+   }
+
    pipe->delete_fs_state(pipe, hud->fs_color);
    pipe->delete_fs_state(pipe, hud->fs_text);
    pipe->delete_vs_state(pipe, hud->vs);
@@ -30,6 +30,7 @@
 
 #include "pipe/p_context.h"
 #include "util/u_double_list.h"
+#include "hud/hud_timer.h"
 
 struct hud_graph {
    /* initialized by common code */
@@ -82,6 +83,7 @@ int hud_get_num_cpus(void);
 
 void hud_fps_graph_install(struct hud_pane *pane);
 void hud_cpu_graph_install(struct hud_pane *pane, unsigned cpu_index);
+void hud_timer_graph_install(struct hud_pane *pane, enum hud_timer timer);
 void hud_pipe_query_install(struct hud_pane *pane, struct pipe_context *pipe,
                             const char *name, unsigned query_type,
                             unsigned result_index,
@@ -0,0 +1,124 @@
+/**************************************************************************
+ *
+ * Copyright 2013 agent <agent@local>
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/* This file contains code for graphing the CPU time spent in the timers of
+ * hud_timer.h, in microseconds per frame.
+ */
+
+#include "hud/hud_private.h"
+#include "hud/hud_timer.h"
+#include "os/os_time.h"
+#include "util/u_memory.h"
+#include "util/u_string.h"
+
+int32_t hud_timer_users;
+int32_t hud_timer_ns[HUD_NUM_TIMERS];
+
+const char *hud_timer_names[HUD_NUM_TIMERS] = {
+   "validate",
+   "shader",
+   "draw",
+   "flush",
+   "map"
+};
+
+struct timer_info {
+   enum hud_timer timer;
+   int32_t last_ns;
+   uint64_t sum_ns;
+   unsigned frames;
+   uint64_t last_time;
+};
+
+static void
+query_timer(struct hud_graph *gr)
+{
+   struct timer_info *info = gr->query_data;
+   int32_t ns = p_atomic_read(&hud_timer_ns[info->timer]);
+   uint64_t now = os_time_get();
+
+   info->sum_ns += (uint32_t) (ns - info->last_ns);
+   info->last_ns = ns;
+   info->frames++;
+
+   if (info->last_time) {
+      if (info->last_time + gr->pane->period <= now) {
+         hud_graph_add_value(gr, info->sum_ns / 1000 / info->frames);
+         info->sum_ns = 0;
+         info->frames = 0;
+         info->last_time = now;
+      }
+   }
+   else {
+      /* initialize */
+      info->sum_ns = 0;
+      info->frames = 0;
+      info->last_time = now;
+   }
+}
+
+static void
+free_query_data(void *p)
+{
+   p_atomic_dec(&hud_timer_users);
+   FREE(p);
+}
+
+/**
+ * Install a graph of the given timer, named "<timer>-time".
+ */
+void
+hud_timer_graph_install(struct hud_pane *pane, enum hud_timer timer)
+{
+   struct hud_graph *gr = CALLOC_STRUCT(hud_graph);
+   struct timer_info *info;
+
+   if (!gr)
+      return;
+
+   util_snprintf(gr->name, sizeof(gr->name), "%s-time",
+                 hud_timer_names[timer]);
+   gr->query_data = CALLOC_STRUCT(timer_info);
+   if (!gr->query_data) {
+      FREE(gr);
+      return;
+   }
+
+   gr->query_new_value = query_timer;
+
+   /* Don't use free() as our callback as that messes up Gallium's
+    * memory debugger.  Use simple free_query_data() wrapper.
+    */
+   gr->free_query_data = free_query_data;
+
+   info = gr->query_data;
+   info->timer = timer;
+   info->last_ns = p_atomic_read(&hud_timer_ns[timer]);
+   p_atomic_inc(&hud_timer_users);
+
+   hud_pane_add_graph(pane, gr);
+}
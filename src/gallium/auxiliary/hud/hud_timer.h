@@ -0,0 +1,92 @@
+/**************************************************************************
+ *
+ * Copyright 2013 agent <agent@local>
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/* CPU-side timers for the work done by state trackers and drivers, which
+ * the HUD can draw as graphs and log to a CSV file.
+ *
+ * The timers are process-wide and only running while a HUD uses them:
+ *
+ *    int64_t start = hud_timer_begin();
+ *    ...
+ *    hud_timer_end(HUD_TIMER_VALIDATE, start);
+ */
+
+#ifndef HUD_TIMER_H
+#define HUD_TIMER_H
+
+#include "pipe/p_compiler.h"
+#include "os/os_time.h"
+#include "util/u_atomic.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum hud_timer {
+   HUD_TIMER_VALIDATE,  /**< state validation */
+   HUD_TIMER_SHADER,    /**< shader compilation and variant creation */
+   HUD_TIMER_DRAW,      /**< draw submission */
+   HUD_TIMER_FLUSH,     /**< flushes and fence waits */
+   HUD_TIMER_MAP,       /**< buffer mapping and uploads */
+   HUD_NUM_TIMERS
+};
+
+/* Number of HUD graphs and logs using the timers. */
+extern int32_t hud_timer_users;
+
+/* Nanoseconds spent in each timer.  They wrap around, only the
+ * difference between two readings is meaningful.
+ */
+extern int32_t hud_timer_ns[HUD_NUM_TIMERS];
+
+extern const char *hud_timer_names[HUD_NUM_TIMERS];
+
+static INLINE int64_t
+hud_timer_begin(void)
+{
+   return p_atomic_read(&hud_timer_users) ? os_time_get_nano() : 0;
+}
+
+static INLINE void
+hud_timer_end(enum hud_timer timer, int64_t start)
+{
+   if (start) {
+      uint32_t elapsed = (uint32_t) (os_time_get_nano() - start);
+      int32_t old;
+
+      do {
+         old = p_atomic_read(&hud_timer_ns[timer]);
+      } while (p_atomic_cmpxchg(&hud_timer_ns[timer], old,
+                                (int32_t) ((uint32_t) old + elapsed)) != old);
+   }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -470,6 +470,18 @@ pipe_tsd_init(pipe_tsd *tsd)
    tsd->initMagic = PIPE_TSD_INIT_MAGIC;
 }
 
+static INLINE void
+pipe_tsd_destroy(pipe_tsd *tsd)
+{
+   if (tsd->initMagic != (int) PIPE_TSD_INIT_MAGIC) {
+      return;
+   }
+#if defined(PIPE_OS_LINUX) || defined(PIPE_OS_BSD) || defined(PIPE_OS_SOLARIS) || defined(PIPE_OS_APPLE) || defined(PIPE_OS_HAIKU) || defined(PIPE_OS_CYGWIN) || defined(PIPE_OS_HURD)
+   pthread_key_delete(tsd->key);
+#endif
+   tsd->initMagic = 0;
+}
+
 static INLINE void *
 pipe_tsd_get(pipe_tsd *tsd)
 {
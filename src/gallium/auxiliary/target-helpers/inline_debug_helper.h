@@ -10,6 +10,10 @@
  * one or more debug driver: rbug, trace.
  */
 
+#ifdef GALLIUM_THREADED
+#include "threaded/th_public.h"
+#endif
+
 #ifdef GALLIUM_TRACE
 #include "trace/tr_public.h"
 #endif
@@ -29,6 +33,10 @@
 static INLINE struct pipe_screen *
 debug_screen_wrap(struct pipe_screen *screen)
 {
+#if defined(GALLIUM_THREADED)
+   screen = threaded_screen_create(screen);
+#endif
+
 #if defined(GALLIUM_RBUG)
    screen = rbug_screen_create(screen);
 #endif
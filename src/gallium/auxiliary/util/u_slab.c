@@ -103,7 +103,13 @@ static void util_slab_free_st(struct util_slab_mempool *pool, void *ptr)
    pool->first_free = block;
 }
 
-static void *util_slab_alloc_mt(struct util_slab_mempool *pool)
+#if defined(PIPE_OS_LINUX) || defined(PIPE_OS_BSD) || defined(PIPE_OS_SOLARIS) || defined(PIPE_OS_APPLE) || defined(PIPE_OS_HAIKU) || defined(PIPE_OS_CYGWIN) || defined(PIPE_OS_HURD)
+#define UTIL_SLAB_HAVE_TSD 1
+#else
+#define UTIL_SLAB_HAVE_TSD 0
+#endif
+
+static void *util_slab_alloc_locked(struct util_slab_mempool *pool)
 {
    void *mem;
 
@@ -113,19 +119,149 @@ static void *util_slab_alloc_mt(struct util_slab_mempool *pool)
    return mem;
 }
 
-static void util_slab_free_mt(struct util_slab_mempool *pool, void *ptr)
+static void util_slab_free_locked(struct util_slab_mempool *pool, void *ptr)
 {
    pipe_mutex_lock(pool->mutex);
    util_slab_free_st(pool, ptr);
    pipe_mutex_unlock(pool->mutex);
 }
 
+#if UTIL_SLAB_HAVE_TSD
+
+static struct util_slab_magazine *
+util_slab_get_magazine(struct util_slab_mempool *pool)
+{
+   struct util_slab_magazine *mag = pipe_tsd_get(&pool->magazine_tsd);
+
+   if (!mag) {
+      mag = CALLOC_STRUCT(util_slab_magazine);
+      if (!mag)
+         return NULL;
+
+      pipe_mutex_lock(pool->mutex);
+      mag->next = pool->magazines;
+      pool->magazines = mag;
+      pipe_mutex_unlock(pool->mutex);
+
+      pipe_tsd_set(&pool->magazine_tsd, mag);
+   }
+   return mag;
+}
+
+static void *util_slab_alloc_mt(struct util_slab_mempool *pool)
+{
+   struct util_slab_magazine *mag = util_slab_get_magazine(pool);
+   struct util_slab_block *block;
+   unsigned i;
+
+   if (!mag)
+      return util_slab_alloc_locked(pool);
+
+   if (!mag->first_free) {
+      /* Refill half of the magazine from the pool. */
+      pipe_mutex_lock(pool->mutex);
+      for (i = 0; i < UTIL_SLAB_MAGAZINE_SIZE / 2; i++) {
+         if (!pool->first_free)
+            util_slab_add_new_page(pool);
+
+         block = pool->first_free;
+         pool->first_free = block->next_free;
+         block->next_free = mag->first_free;
+         mag->first_free = block;
+      }
+      pipe_mutex_unlock(pool->mutex);
+      mag->num_free = UTIL_SLAB_MAGAZINE_SIZE / 2;
+   }
+
+   block = mag->first_free;
+   assert(block->magic == UTIL_SLAB_MAGIC);
+   mag->first_free = block->next_free;
+   mag->num_free--;
+
+   return (uint8_t*)block + sizeof(struct util_slab_block);
+}
+
+static void util_slab_free_mt(struct util_slab_mempool *pool, void *ptr)
+{
+   struct util_slab_magazine *mag = util_slab_get_magazine(pool);
+   struct util_slab_block *block =
+         (struct util_slab_block*)
+         ((uint8_t*)ptr - sizeof(struct util_slab_block));
+   struct util_slab_block *last, *rest;
+   unsigned i;
+
+   if (!mag) {
+      util_slab_free_locked(pool, ptr);
+      return;
+   }
+
+   assert(block->magic == UTIL_SLAB_MAGIC);
+
+   if (mag->num_free == UTIL_SLAB_MAGAZINE_SIZE) {
+      /* Keep the first half of the magazine and give the rest back,
+       * so that a thread which only frees doesn't hoard blocks. */
+      last = mag->first_free;
+      for (i = 1; i < UTIL_SLAB_MAGAZINE_SIZE / 2; i++)
+         last = last->next_free;
+      rest = last->next_free;
+      last->next_free = NULL;
+      mag->num_free = UTIL_SLAB_MAGAZINE_SIZE / 2;
+
+      for (last = rest; last->next_free; last = last->next_free);
+
+      pipe_mutex_lock(pool->mutex);
+      last->next_free = pool->first_free;
+      pool->first_free = rest;
+      pipe_mutex_unlock(pool->mutex);
+   }
+
+   block->next_free = mag->first_free;
+   mag->first_free = block;
+   mag->num_free++;
+}
+
+#else
+
+#define util_slab_alloc_mt util_slab_alloc_locked
+#define util_slab_free_mt  util_slab_free_locked
+
+#endif
+
+/* Return the blocks cached by all threads to the pool.  The pool must not
+ * be in use by other threads.
+ */
+static void util_slab_drain_magazines(struct util_slab_mempool *pool)
+{
+   struct util_slab_magazine *mag;
+   struct util_slab_block *block;
+
+   for (mag = pool->magazines; mag; mag = mag->next) {
+      while (mag->first_free) {
+         block = mag->first_free;
+         mag->first_free = block->next_free;
+         block->next_free = pool->first_free;
+         pool->first_free = block;
+      }
+      mag->num_free = 0;
+   }
+}
+
 void util_slab_set_thread_safety(struct util_slab_mempool *pool,
                                     enum util_slab_threading threading)
 {
+   if (pool->threading && !threading)
+      util_slab_drain_magazines(pool);
+
    pool->threading = threading;
 
    if (threading) {
+#if UTIL_SLAB_HAVE_TSD
+      /* Thread-specific keys are a scarce resource, so only pools that are
+       * actually shared between threads get one.  It lives until the pool
+       * is destroyed, as the magazines stay registered with it. */
+      if (pool->magazine_tsd.initMagic != (int) PIPE_TSD_INIT_MAGIC)
+         pipe_tsd_init(&pool->magazine_tsd);
+#endif
       pool->alloc = util_slab_alloc_mt;
       pool->free = util_slab_free_mt;
    } else {
@@ -148,17 +284,30 @@ void util_slab_create(struct util_slab_mempool *pool,
    pool->page_size = sizeof(struct util_slab_page) +
                      num_blocks * pool->block_size;
    pool->first_free = NULL;
+   pool->threading = UTIL_SLAB_SINGLETHREADED;
+   pool->magazines = NULL;
 
    make_empty_list(&pool->list);
 
    pipe_mutex_init(pool->mutex);
 
+   memset(&pool->magazine_tsd, 0, sizeof(pool->magazine_tsd));
+
    util_slab_set_thread_safety(pool, threading);
 }
 
 void util_slab_destroy(struct util_slab_mempool *pool)
 {
    struct util_slab_page *page, *temp;
+   struct util_slab_magazine *mag, *next_mag;
+
+   /* The cached blocks live in the pages freed below. */
+   for (mag = pool->magazines; mag; mag = next_mag) {
+      next_mag = mag->next;
+      FREE(mag);
+   }
+   pool->magazines = NULL;
+   pipe_tsd_destroy(&pool->magazine_tsd);
 
    if (pool->list.next) {
       foreach_s(page, temp, &pool->list) {
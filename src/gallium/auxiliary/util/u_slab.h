@@ -30,6 +30,11 @@
  *
  * Candidates: transfer_map
  *
+ * In multithreaded mode, each thread keeps a small cache ("magazine") of
+ * free blocks, so most allocations and frees don't touch the pool mutex.
+ * Blocks may be freed by a different thread than the one that allocated
+ * them.
+ *
  * @author Marek Olšák
  */
 
@@ -52,6 +57,18 @@ struct util_slab_page {
     * The allocated size is always larger than this structure. */
 };
 
+/* Number of free blocks each thread may cache in multithreaded mode. */
+#define UTIL_SLAB_MAGAZINE_SIZE 32
+
+/* A thread's cache of free blocks. */
+struct util_slab_magazine {
+   struct util_slab_block *first_free;
+   unsigned num_free;
+
+   /* All magazines of the pool. */
+   struct util_slab_magazine *next;
+};
+
 struct util_slab_mempool {
    /* Public members. */
    void *(*alloc)(struct util_slab_mempool *pool);
@@ -69,6 +86,10 @@ struct util_slab_mempool {
    enum util_slab_threading threading;
 
    pipe_mutex mutex;
+
+   /* Multithreaded mode: the calling thread's util_slab_magazine. */
+   pipe_tsd magazine_tsd;
+   struct util_slab_magazine *magazines;
 };
 
 void util_slab_create(struct util_slab_mempool *pool,
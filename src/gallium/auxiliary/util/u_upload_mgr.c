@@ -32,12 +32,16 @@
 #include "pipe/p_defines.h"
 #include "util/u_inlines.h"
 #include "pipe/p_context.h"
+#include "pipe/p_screen.h"
 #include "util/u_memory.h"
 #include "util/u_math.h"
 
 #include "u_upload_mgr.h"
 
 
+#define U_UPLOAD_MAX_FENCES 16
+
+
 struct u_upload_mgr {
    struct pipe_context *pipe;
 
@@ -51,6 +55,20 @@ struct u_upload_mgr {
    unsigned size;   /* Actual size of the upload buffer. */
    unsigned offset; /* Aligned offset to the upload buffer, pointing
                      * at the first unused byte. */
+
+   /* Ring-buffer mode.  Bytes [busy_start, offset), wrapping around the
+    * end of the buffer, may still be in use by the GPU; the rest of the
+    * buffer is free.  busy_start == offset means the whole buffer is free.
+    */
+   boolean ring;
+   unsigned busy_start;
+   boolean unfenced;  /* Allocations made since the last u_upload_fence() */
+
+   /* Fences guarding the busy bytes, oldest first.  Once fences[i]
+    * signals, everything allocated before fence_ends[i] is free. */
+   struct pipe_fence_handle *fences[U_UPLOAD_MAX_FENCES];
+   unsigned fence_ends[U_UPLOAD_MAX_FENCES];
+   unsigned num_fences;
 };
 
 
@@ -87,6 +105,17 @@ void u_upload_unmap( struct u_upload_mgr *upload )
    }
 }
 
+static void
+u_upload_release_fences( struct u_upload_mgr *upload )
+{
+   struct pipe_screen *screen = upload->pipe->screen;
+   unsigned i;
+
+   for (i = 0; i < upload->num_fences; i++)
+      screen->fence_reference(screen, &upload->fences[i], NULL);
+   upload->num_fences = 0;
+}
+
 /* Release old buffer.
  * 
  * This must usually be called prior to firing the command stream
@@ -95,6 +124,7 @@ void u_upload_unmap( struct u_upload_mgr *upload )
  *
  * Can improve this with a change to pipe_buffer_write to use the
  * DONT_WAIT bit, but for now, it's easiest just to grab a new buffer.
+ * In ring mode, u_upload_fence() lets the buffer be kept instead.
  */
 void u_upload_flush( struct u_upload_mgr *upload )
 {
@@ -102,6 +132,123 @@ void u_upload_flush( struct u_upload_mgr *upload )
    u_upload_unmap(upload);
    pipe_resource_reference( &upload->buffer, NULL );
    upload->size = 0;
+
+   /* Fences only guard the old buffer. */
+   u_upload_release_fences(upload);
+   upload->busy_start = 0;
+   upload->unfenced = FALSE;
+}
+
+
+void u_upload_enable_ring( struct u_upload_mgr *upload, unsigned ring_size )
+{
+   u_upload_flush(upload);
+   upload->ring = TRUE;
+   upload->default_size = MAX2(upload->default_size, ring_size);
+}
+
+
+void u_upload_fence( struct u_upload_mgr *upload,
+                     struct pipe_fence_handle *fence )
+{
+   struct pipe_screen *screen = upload->pipe->screen;
+   unsigned i;
+
+   if (!upload->ring || !fence || !screen->fence_signalled)
+      return;
+
+   if (!upload->unfenced)
+      return;
+
+   if (upload->num_fences == U_UPLOAD_MAX_FENCES) {
+      /* Fences signal in order, so the newest one can guard everything
+       * the last entry guarded too. */
+      i = upload->num_fences - 1;
+   }
+   else {
+      i = upload->num_fences++;
+   }
+
+   screen->fence_reference(screen, &upload->fences[i], fence);
+   upload->fence_ends[i] = upload->offset;
+   upload->unfenced = FALSE;
+}
+
+
+/* Free the ring space guarded by fences which have signalled.
+ */
+static void
+u_upload_retire_fences( struct u_upload_mgr *upload )
+{
+   struct pipe_screen *screen = upload->pipe->screen;
+   unsigned i, n = 0;
+
+   while (n < upload->num_fences &&
+          screen->fence_signalled(screen, upload->fences[n])) {
+      upload->busy_start = upload->fence_ends[n];
+      screen->fence_reference(screen, &upload->fences[n], NULL);
+      n++;
+   }
+
+   if (n) {
+      for (i = n; i < upload->num_fences; i++) {
+         upload->fences[i - n] = upload->fences[i];
+         upload->fence_ends[i - n] = upload->fence_ends[i];
+         upload->fences[i] = NULL;
+      }
+      upload->num_fences -= n;
+   }
+}
+
+
+/* Find room for a sub-allocation in the ring without waiting on the GPU.
+ * Returns the offset, or ~0 if there's no room.
+ */
+static unsigned
+u_upload_ring_offset( struct u_upload_mgr *upload,
+                      unsigned alloc_offset,
+                      unsigned alloc_size )
+{
+   unsigned offset;
+
+   if (!upload->buffer)
+      return ~0;
+
+   if (upload->num_fences)
+      u_upload_retire_fences(upload);
+
+   if (upload->busy_start == upload->offset) {
+      /* Everything is free; start over from the beginning. */
+      if (alloc_offset + alloc_size <= upload->size) {
+         if (upload->offset > alloc_offset)
+            u_upload_unmap(upload);
+         upload->busy_start = 0;
+         return alloc_offset;
+      }
+      return ~0;
+   }
+
+   offset = MAX2(upload->offset, alloc_offset);
+
+   if (upload->offset > upload->busy_start) {
+      /* Free space is at the end, then at the beginning. */
+      if (offset + alloc_size <= upload->size)
+         return offset;
+
+      /* Wrap around.  The busy region must not be reached, so that
+       * offset == busy_start keeps meaning "empty". */
+      if (alloc_offset + alloc_size < upload->busy_start) {
+         u_upload_unmap(upload);
+         return alloc_offset;
+      }
+      return ~0;
+   }
+
+   /* Already wrapped: free space is up to busy_start. */
+   if (offset + alloc_size < upload->busy_start)
+      return offset;
+
+   return ~0;
 }
 
 
@@ -170,16 +317,31 @@ enum pipe_error u_upload_alloc( struct u_upload_mgr *upload,
    pipe_resource_reference(outbuf, NULL);
    *ptr = NULL;
 
-   /* Make sure we have enough space in the upload buffer
-    * for the sub-allocation. */
-   if (MAX2(upload->offset, alloc_offset) + alloc_size > upload->size) {
-      enum pipe_error ret = u_upload_alloc_buffer(upload,
-                                                  alloc_offset + alloc_size);
-      if (ret != PIPE_OK)
-         return ret;
+   if (upload->ring) {
+      /* Reuse ring space whose fences have signalled, or start a new
+       * buffer like the non-ring path if the GPU still has it all. */
+      offset = u_upload_ring_offset(upload, alloc_offset, alloc_size);
+      if (offset == ~0) {
+         enum pipe_error ret = u_upload_alloc_buffer(upload,
+                                                     alloc_offset + alloc_size);
+         if (ret != PIPE_OK)
+            return ret;
+
+         offset = alloc_offset;
+      }
    }
+   else {
+      /* Make sure we have enough space in the upload buffer
+       * for the sub-allocation. */
+      if (MAX2(upload->offset, alloc_offset) + alloc_size > upload->size) {
+         enum pipe_error ret = u_upload_alloc_buffer(upload,
+                                                     alloc_offset + alloc_size);
+         if (ret != PIPE_OK)
+            return ret;
+      }
 
-   offset = MAX2(upload->offset, alloc_offset);
+      offset = MAX2(upload->offset, alloc_offset);
+   }
 
    if (!upload->map) {
       upload->map = pipe_buffer_map_range(upload->pipe, upload->buffer,
@@ -206,6 +368,7 @@ enum pipe_error u_upload_alloc( struct u_upload_mgr *upload,
    *out_offset = offset;
 
    upload->offset = offset + alloc_size;
+   upload->unfenced = TRUE;
    return PIPE_OK;
 }
 
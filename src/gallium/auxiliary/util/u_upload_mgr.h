@@ -36,6 +36,7 @@
 
 struct pipe_context;
 struct pipe_resource;
+struct pipe_fence_handle;
 
 
 /**
@@ -66,6 +67,29 @@ void u_upload_destroy( struct u_upload_mgr *upload );
  */
 void u_upload_flush( struct u_upload_mgr *upload );
 
+/**
+ * Use the upload buffer as a ring.
+ *
+ * \param upload     Upload manager
+ * \param ring_size  Minimum size of the ring buffer, in bytes.
+ *
+ * Normally a new upload buffer is allocated whenever the current one is
+ * full.  In ring mode, space is instead reused from the start of the
+ * buffer once the fences passed to u_upload_fence() show the GPU is done
+ * with it.  A new buffer is still allocated if no space has been retired.
+ * Relies on PIPE_TRANSFER_UNSYNCHRONIZED maps, like the normal mode.
+ */
+void u_upload_enable_ring( struct u_upload_mgr *upload, unsigned ring_size );
+
+/**
+ * Guard everything allocated so far with a fence.
+ *
+ * This should be called with the fence of every hardware flush which may
+ * reference the upload buffer.  Does nothing unless ring mode is enabled.
+ */
+void u_upload_fence( struct u_upload_mgr *upload,
+                     struct pipe_fence_handle *fence );
+
 /**
  * Unmap upload buffer
  *
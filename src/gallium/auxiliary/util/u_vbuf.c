@@ -91,6 +91,7 @@
 #include "util/u_format.h"
 #include "util/u_inlines.h"
 #include "util/u_memory.h"
+#include "util/u_sse.h"
 #include "util/u_upload_mgr.h"
 #include "translate/translate.h"
 #include "translate/translate_cache.h"
@@ -1011,6 +1012,133 @@ static boolean u_vbuf_mapping_vertex_buffer_blocks(struct u_vbuf *mgr)
             mgr->nonzero_stride_vb_mask)) != 0;
 }
 
+/* Scan 32-bit indices for their min and max, skipping the restart index if
+ * primitive restart is enabled. */
+static void u_vbuf_minmax_uint(const unsigned *ui_indices, unsigned count,
+                               boolean restart, unsigned restart_index,
+                               int *out_min_index, int *out_max_index)
+{
+   unsigned max_ui = 0;
+   unsigned min_ui = ~0U;
+   unsigned i = 0;
+
+#if defined(PIPE_ARCH_SSE)
+   if (count >= 8) {
+      /* SSE2 only has signed compares. Flip the sign bits to get unsigned
+       * ordering, and mask restart indices out of the updates. */
+      const __m128i bias = _mm_set1_epi32(0x80000000);
+      const __m128i restart4 = _mm_set1_epi32(restart_index);
+      __m128i vmin = _mm_xor_si128(_mm_set1_epi32(~0), bias);
+      __m128i vmax = bias;
+      unsigned lanes[4];
+      int j;
+
+      for (; i + 4 <= count; i += 4) {
+         __m128i v = _mm_loadu_si128((const __m128i *)&ui_indices[i]);
+         __m128i skip = restart ? _mm_cmpeq_epi32(v, restart4)
+                                : _mm_setzero_si128();
+         __m128i lt, gt;
+
+         v = _mm_xor_si128(v, bias);
+         lt = _mm_andnot_si128(skip, _mm_cmplt_epi32(v, vmin));
+         gt = _mm_andnot_si128(skip, _mm_cmpgt_epi32(v, vmax));
+         vmin = _mm_or_si128(_mm_and_si128(lt, v), _mm_andnot_si128(lt, vmin));
+         vmax = _mm_or_si128(_mm_and_si128(gt, v), _mm_andnot_si128(gt, vmax));
+      }
+
+      _mm_storeu_si128((__m128i *)lanes, _mm_xor_si128(vmin, bias));
+      for (j = 0; j < 4; j++)
+         min_ui = MIN2(min_ui, lanes[j]);
+      _mm_storeu_si128((__m128i *)lanes, _mm_xor_si128(vmax, bias));
+      for (j = 0; j < 4; j++)
+         max_ui = MAX2(max_ui, lanes[j]);
+   }
+#endif
+
+   for (; i < count; i++) {
+      if (restart && ui_indices[i] == restart_index)
+         continue;
+      if (ui_indices[i] > max_ui) max_ui = ui_indices[i];
+      if (ui_indices[i] < min_ui) min_ui = ui_indices[i];
+   }
+
+   *out_min_index = min_ui;
+   *out_max_index = max_ui;
+}
+
+/* Scan 16-bit indices for their min and max, skipping the restart index if
+ * primitive restart is enabled. */
+static void u_vbuf_minmax_ushort(const unsigned short *us_indices,
+                                 unsigned count,
+                                 boolean restart, unsigned restart_index,
+                                 int *out_min_index, int *out_max_index)
+{
+   unsigned max_us = 0;
+   unsigned min_us = ~0U;
+   unsigned i = 0;
+
+   /* A 16-bit index can never match a larger restart index. */
+   if (restart_index > 0xffff)
+      restart = FALSE;
+
+#if defined(PIPE_ARCH_SSE)
+   if (count >= 16) {
+      /* Same as above with signed 16-bit min/max. Restart indices are
+       * replaced by values that don't affect the result. */
+      const __m128i bias = _mm_set1_epi16((short)0x8000);
+      const __m128i restart8 = _mm_set1_epi16((short)restart_index);
+      const __m128i min_identity = _mm_set1_epi16(0x7fff);
+      const __m128i max_identity = bias;
+      __m128i vmin = min_identity;
+      __m128i vmax = max_identity;
+      unsigned short lanes[8];
+      int j;
+
+      for (; i + 8 <= count; i += 8) {
+         __m128i v = _mm_loadu_si128((const __m128i *)&us_indices[i]);
+
+         if (restart) {
+            __m128i skip = _mm_cmpeq_epi16(v, restart8);
+
+            v = _mm_xor_si128(v, bias);
+            vmin = _mm_min_epi16(vmin,
+                                 _mm_or_si128(_mm_and_si128(skip, min_identity),
+                                              _mm_andnot_si128(skip, v)));
+            vmax = _mm_max_epi16(vmax,
+                                 _mm_or_si128(_mm_and_si128(skip, max_identity),
+                                              _mm_andnot_si128(skip, v)));
+         } else {
+            v = _mm_xor_si128(v, bias);
+            vmin = _mm_min_epi16(vmin, v);
+            vmax = _mm_max_epi16(vmax, v);
+         }
+      }
+
+      _mm_storeu_si128((__m128i *)lanes, _mm_xor_si128(vmin, bias));
+      for (j = 0; j < 8; j++)
+         min_us = MIN2(min_us, lanes[j]);
+      _mm_storeu_si128((__m128i *)lanes, _mm_xor_si128(vmax, bias));
+      for (j = 0; j < 8; j++)
+         max_us = MAX2(max_us, lanes[j]);
+   }
+#endif
+
+   for (; i < count; i++) {
+      if (restart && us_indices[i] == restart_index)
+         continue;
+      if (us_indices[i] > max_us) max_us = us_indices[i];
+      if (us_indices[i] < min_us) min_us = us_indices[i];
+   }
+
+   /* If every index was a restart index, the vector path leaves 0xffff as
+    * the minimum. Report ~0 like the scalar loop would. */
+   if (min_us > max_us)
+      min_us = ~0U;
+
+   *out_min_index = min_us;
+   *out_max_index = max_us;
+}
+
 static void u_vbuf_get_minmax_index(struct pipe_context *pipe,
                                     struct pipe_index_buffer *ib,
                                     const struct pipe_draw_info *info,
@@ -1033,50 +1161,16 @@ static void u_vbuf_get_minmax_index(struct pipe_context *pipe,
    }
 
    switch (ib->index_size) {
-   case 4: {
-      const unsigned *ui_indices = (const unsigned*)indices;
-      unsigned max_ui = 0;
-      unsigned min_ui = ~0U;
-      if (info->primitive_restart) {
-         for (i = 0; i < info->count; i++) {
-            if (ui_indices[i] != restart_index) {
-               if (ui_indices[i] > max_ui) max_ui = ui_indices[i];
-               if (ui_indices[i] < min_ui) min_ui = ui_indices[i];
-            }
-         }
-      }
-      else {
-         for (i = 0; i < info->count; i++) {
-            if (ui_indices[i] > max_ui) max_ui = ui_indices[i];
-            if (ui_indices[i] < min_ui) min_ui = ui_indices[i];
-         }
-      }
-      *out_min_index = min_ui;
-      *out_max_index = max_ui;
+   case 4:
+      u_vbuf_minmax_uint((const unsigned*)indices, info->count,
+                         info->primitive_restart, restart_index,
+                         out_min_index, out_max_index);
       break;
-   }
-   case 2: {
-      const unsigned short *us_indices = (const unsigned short*)indices;
-      unsigned max_us = 0;
-      unsigned min_us = ~0U;
-      if (info->primitive_restart) {
-         for (i = 0; i < info->count; i++) {
-            if (us_indices[i] != restart_index) {
-               if (us_indices[i] > max_us) max_us = us_indices[i];
-               if (us_indices[i] < min_us) min_us = us_indices[i];
-            }
-         }
-      }
-      else {
-         for (i = 0; i < info->count; i++) {
-            if (us_indices[i] > max_us) max_us = us_indices[i];
-            if (us_indices[i] < min_us) min_us = us_indices[i];
-         }
-      }
-      *out_min_index = min_us;
-      *out_max_index = max_us;
+   case 2:
+      u_vbuf_minmax_ushort((const unsigned short*)indices, info->count,
+                           info->primitive_restart, restart_index,
+                           out_min_index, out_max_index);
       break;
-   }
    case 1: {
       const unsigned char *ub_indices = (const unsigned char*)indices;
       unsigned max_ub = 0;
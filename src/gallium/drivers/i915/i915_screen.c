@@ -223,6 +223,7 @@ i915_get_param(struct pipe_screen *screen, enum pipe_cap cap)
    case PIPE_CAP_VERTEX_BUFFER_STRIDE_4BYTE_ALIGNED_ONLY:
    case PIPE_CAP_VERTEX_ELEMENT_SRC_OFFSET_4BYTE_ALIGNED_ONLY:
    case PIPE_CAP_TGSI_VS_LAYER:
+   case PIPE_CAP_SHAREABLE_CSOS:
        return 0;
 
    case PIPE_CAP_GLSL_FEATURE_LEVEL:
@@ -67,6 +67,8 @@ static void llvmpipe_destroy( struct pipe_context *pipe )
    if (llvmpipe->draw)
       draw_destroy( llvmpipe->draw );
 
+   llvmpipe_dump_shader_time(llvmpipe);
+
    for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++) {
       pipe_surface_reference(&llvmpipe->framebuffer.cbufs[i], NULL);
    }
@@ -136,6 +138,7 @@ llvmpipe_create_context( struct pipe_screen *screen, void *priv )
    memset(llvmpipe, 0, sizeof *llvmpipe);
 
    make_empty_list(&llvmpipe->fs_variants_list);
+   lp_shader_time_report_init(&llvmpipe->fs_time, "fs", "pixels");
 
    make_empty_list(&llvmpipe->setup_variants_list);
 
@@ -146,6 +146,9 @@ struct llvmpipe_context {
    unsigned nr_fs_variants;
    unsigned nr_fs_instrs;
 
+   /** Shader time of the fragment shader variants deleted so far */
+   struct lp_shader_time_report fs_time;
+
    struct lp_setup_variant_list_item setup_variants_list;
    unsigned nr_setup_variants;
 
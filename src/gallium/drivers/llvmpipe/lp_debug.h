@@ -59,6 +59,11 @@ st_print_current(void);
 #define PERF_NO_BLEND       0x20  	/* disable blending */
 #define PERF_NO_DEPTH       0x40  	/* disable depth buffering entirely */
 #define PERF_NO_ALPHATEST   0x80  	/* disable alpha testing */
+#define PERF_NO_HIZ         0x100  	/* disable hierarchical z culling */
+#define PERF_NO_FAST_CLEAR  0x200  	/* write clears immediately */
+#define PERF_NO_AVX2        0x400  	/* no AVX2 triangle rasterization */
+#define PERF_NO_TEX_TILING  0x800  	/* store all textures linearly */
+#define PERF_NO_DAMAGE      0x1000 	/* present display targets in whole */
 
 
 extern int LP_PERF;
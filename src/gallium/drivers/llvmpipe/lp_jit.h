@@ -197,12 +197,16 @@ struct lp_jit_thread_data
    struct {
       uint32_t viewport_index;
    } raster_state;
+
+   /* Index of the rasterizer thread, for per-thread shader time counters */
+   uint32_t thread_index;
 };
 
 
 enum {
    LP_JIT_THREAD_DATA_COUNTER = 0,
    LP_JIT_THREAD_DATA_RASTER_STATE_VIEWPORT_INDEX,
+   LP_JIT_THREAD_DATA_THREAD_INDEX,
    LP_JIT_THREAD_DATA_COUNT
 };
 
@@ -214,6 +218,10 @@ enum {
    lp_build_struct_get(_gallivm, _ptr, \
                        LP_JIT_THREAD_DATA_RASTER_STATE_VIEWPORT_INDEX, \
                        "raster_state.viewport_index")
+
+#define lp_jit_thread_data_thread_index(_gallivm, _ptr) \
+   lp_build_struct_get(_gallivm, _ptr, LP_JIT_THREAD_DATA_THREAD_INDEX, \
+                       "thread_index")
  
 /**
  * typedef for fragment shader function
@@ -227,10 +235,12 @@ enum {
  * @param dady          shader input dady
  * @param color         color buffer
  * @param depth         depth buffer
- * @param mask          mask of visible pixels in block
+ * @param mask          mask of visible pixels in block, 16 bits per sample
  * @param thread_data   task thread data
  * @param stride        color buffer row stride in bytes
  * @param depth_stride  depth buffer row stride in bytes
+ * @param sample_stride color buffer sample stride in bytes
+ * @param depth_sample_stride  depth buffer sample stride in bytes
  */
 typedef void
 (*lp_jit_frag_func)(const struct lp_jit_context *context,
@@ -242,10 +252,12 @@ typedef void
                     const void *dady,
                     uint8_t **color,
                     uint8_t *depth,
-                    uint32_t mask,
+                    uint64_t mask,
                     struct lp_jit_thread_data *thread_data,
                     unsigned *stride,
-                    unsigned depth_stride);
+                    unsigned depth_stride,
+                    unsigned *sample_stride,
+                    unsigned depth_sample_stride);
 
 
 void
@@ -64,6 +64,13 @@
 #define LP_MAX_THREADS 16
 
 
+/**
+ * Samples per pixel of multisampled render targets (the only sample count
+ * other than one which is supported).
+ */
+#define LP_MAX_SAMPLES 4
+
+
 /**
  * Max bytes per scene.  This may be replaced by a runtime parameter.
  */
@@ -98,10 +98,30 @@ lp_print_counters(void)
       debug_printf("llvmpipe:   nr_empty_4x4:               %9u (%3.0f%% of %u)\n", lp_count.nr_empty_4, p1, total_4);
       debug_printf("llvmpipe:   nr_non_empty_4x4:           %9u (%3.0f%% of %u)\n", lp_count.nr_non_empty_4, p4, total_4);
 
+      debug_printf("llvmpipe: nr_hiz_culled_64x64:          %9u\n", lp_count.nr_hiz_culled_64);
+      debug_printf("llvmpipe: nr_hiz_culled_16x16:          %9u\n", lp_count.nr_hiz_culled_16);
+
       debug_printf("llvmpipe: nr_color_tile_clear:          %9u\n", lp_count.nr_color_tile_clear);
+      debug_printf("llvmpipe: nr_tile_clear_elided:         %9u (%.1f MB)\n",
+                   lp_count.nr_tile_clear_elided,
+                   lp_count.tile_clear_bytes_elided / (1024.0 * 1024.0));
       debug_printf("llvmpipe: nr_color_tile_load:           %9u\n", lp_count.nr_color_tile_load);
       debug_printf("llvmpipe: nr_color_tile_store:          %9u\n", lp_count.nr_color_tile_store);
 
+      debug_printf("llvmpipe: nr_presents:                  %9u\n", lp_count.nr_presents);
+      debug_printf("llvmpipe:   nr_present_rects:           %9u\n", lp_count.nr_present_rects);
+      if (lp_count.nr_presents) {
+         debug_printf("llvmpipe:   bytes presented per frame:  %9.0f (%.0f skipped)\n",
+                      (double) lp_count.present_bytes / lp_count.nr_presents,
+                      (double) lp_count.present_bytes_skipped / lp_count.nr_presents);
+      }
+
+      debug_printf("llvmpipe: nr_fs_variant_lookups:        %9u\n",
+                   lp_count.nr_fs_variant_hits + lp_count.nr_fs_variant_misses);
+      debug_printf("llvmpipe:   nr_fs_variant_hits:         %9u\n", lp_count.nr_fs_variant_hits);
+      debug_printf("llvmpipe:   nr_fs_variant_misses:       %9u\n", lp_count.nr_fs_variant_misses);
+      debug_printf("llvmpipe:   nr_fs_variants_culled:      %9u\n", lp_count.nr_fs_variants_culled);
+
       debug_printf("llvmpipe: nr_llvm_compiles:             %u\n", lp_count.nr_llvm_compiles);
       debug_printf("llvmpipe: total LLVM compile time:      %.2f sec\n", lp_count.llvm_compile_time / 1000000.0);
       debug_printf("llvmpipe: average LLVM compile time:    %.2f sec\n", lp_count.llvm_compile_time / 1000000.0 / lp_count.nr_llvm_compiles);
@@ -56,12 +56,24 @@ struct lp_counters
    unsigned nr_fully_covered_4;
    unsigned nr_partially_covered_4;
    unsigned nr_non_empty_4;
+   unsigned nr_hiz_culled_64;  /**< tiles culled by depth bounds in setup */
+   unsigned nr_hiz_culled_16;  /**< blocks culled by depth bounds in rast */
    unsigned nr_llvm_compiles;
    int64_t llvm_compile_time;  /**< total, in microseconds */
+   unsigned nr_fs_variant_hits;
+   unsigned nr_fs_variant_misses;
+   unsigned nr_fs_variants_culled;
 
    unsigned nr_color_tile_clear;
+   unsigned nr_tile_clear_elided;  /**< tile clears never written to memory */
+   uint64_t tile_clear_bytes_elided;
    unsigned nr_color_tile_load;
    unsigned nr_color_tile_store;
+
+   unsigned nr_presents;
+   unsigned nr_present_rects;  /**< damage rectangles of partial presents */
+   uint64_t present_bytes;
+   uint64_t present_bytes_skipped;  /**< unchanged, not presented again */
 };
 
 
@@ -31,6 +31,7 @@
 #include "util/u_rect.h"
 #include "util/u_surface.h"
 #include "util/u_pack_color.h"
+#include "util/u_cpu_detect.h"
 
 #include "os/os_time.h"
 
@@ -54,6 +55,349 @@ const struct lp_rasterizer_task *jit_task = NULL;
 #endif
 
 
+/**
+ * Set the depth bounds of all blocks of the current tile.
+ */
+static void
+lp_rast_hiz_set(struct lp_rasterizer_task *task, float zmax)
+{
+   unsigned i, j;
+
+   for (i = 0; i < TILE_SIZE / LP_HIZ_BLOCK_SIZE; i++) {
+      for (j = 0; j < TILE_SIZE / LP_HIZ_BLOCK_SIZE; j++) {
+         task->hiz_zmax[i][j] = zmax;
+      }
+   }
+}
+
+
+/**
+ * Update the tile's depth bounds for a depth/stencil clear.
+ */
+static void
+lp_rast_hiz_clear(struct lp_rasterizer_task *task,
+                  uint64_t clear_value64, uint64_t clear_mask64)
+{
+   const struct lp_scene *scene = task->scene;
+
+   if (scene->hiz) {
+      enum pipe_format format = scene->fb.zsbuf->format;
+      uint64_t zmask = util_pack64_mask_z(format, ~0);
+
+      if ((clear_mask64 & zmask) == zmask) {
+         float depth;
+
+         util_format_description(format)->unpack_z_float(
+            &depth, 0, (const uint8_t *) &clear_value64, 0, 1, 1);
+         lp_rast_hiz_set(task, depth + scene->hiz_slack);
+      }
+   }
+}
+
+
+/**
+ * Count a tile clear which is dropped without being written to memory.
+ */
+static void
+lp_rast_elide_clear(const struct lp_rasterizer_task *task,
+                    enum pipe_format format)
+{
+   LP_COUNT(nr_tile_clear_elided);
+   LP_COUNT_ADD(tile_clear_bytes_elided,
+                (uint64_t) task->width * task->height *
+                util_format_get_blocksize(format) *
+                (task->scene->fb_max_layer + 1));
+}
+
+
+/**
+ * Record a clear of a color buffer in the current tile, replacing any
+ * clear still pending there.
+ */
+static void
+lp_rast_defer_color_clear(struct lp_rasterizer_task *task,
+                          unsigned buf,
+                          const union util_color *uc)
+{
+   if (task->clear.color_mask & (1 << buf)) {
+      lp_rast_elide_clear(task, task->scene->fb.cbufs[buf]->format);
+   }
+
+   task->clear.color_mask |= 1 << buf;
+   task->clear.color[buf] = *uc;
+}
+
+
+/**
+ * Write the pending color clears of the current tile to memory.
+ */
+static void
+lp_rast_write_color_clears(struct lp_rasterizer_task *task)
+{
+   const struct lp_scene *scene = task->scene;
+   unsigned i, s;
+
+   for (i = 0; i < scene->fb.nr_cbufs; i++) {
+      if (task->clear.color_mask & (1 << i)) {
+         for (s = 0; s < scene->nr_samples; s++) {
+            util_fill_box(scene->cbufs[i].map +
+                          s * scene->cbufs[i].sample_stride,
+                          scene->fb.cbufs[i]->format,
+                          scene->cbufs[i].stride,
+                          scene->cbufs[i].layer_stride,
+                          task->x,
+                          task->y,
+                          0,
+                          task->width,
+                          task->height,
+                          scene->fb_max_layer + 1,
+                          &task->clear.color[i]);
+         }
+      }
+   }
+
+   task->clear.color_mask = 0;
+}
+
+
+/**
+ * Write the pending z/stencil clear of the current tile to memory.
+ */
+static void
+lp_rast_write_zstencil_clear(struct lp_rasterizer_task *task)
+{
+   const struct lp_scene *scene = task->scene;
+   uint64_t clear_value64 = task->clear.zs_value;
+   uint64_t clear_mask64 = task->clear.zs_mask;
+   uint32_t clear_value = (uint32_t) clear_value64;
+   uint32_t clear_mask = (uint32_t) clear_mask64;
+   const unsigned height = task->height;
+   const unsigned width = task->width;
+   const unsigned dst_stride = scene->zsbuf.stride;
+   uint8_t *dst;
+   unsigned i, j;
+   unsigned block_size;
+   unsigned layer, sample;
+   uint8_t *dst_tile = lp_rast_get_unswizzled_depth_tile_pointer(task, LP_TEX_USAGE_READ_WRITE);
+
+   block_size = util_format_get_blocksize(scene->fb.zsbuf->format);
+
+   clear_value &= clear_mask;
+
+   for (sample = 0; sample < scene->nr_samples; sample++) {
+      for (layer = 0; layer <= scene->fb_max_layer; layer++) {
+         dst = dst_tile + sample * scene->zsbuf.sample_stride +
+               layer * scene->zsbuf.layer_stride;
+
+         switch (block_size) {
+         case 1:
+            assert(clear_mask == 0xff);
+            memset(dst, (uint8_t) clear_value, height * width);
+            break;
+         case 2:
+            if (clear_mask == 0xffff) {
+               for (i = 0; i < height; i++) {
+                  uint16_t *row = (uint16_t *)dst;
+                  for (j = 0; j < width; j++)
+                     *row++ = (uint16_t) clear_value;
+                  dst += dst_stride;
+               }
+            }
+            else {
+               for (i = 0; i < height; i++) {
+                  uint16_t *row = (uint16_t *)dst;
+                  for (j = 0; j < width; j++) {
+                     uint16_t tmp = ~clear_mask & *row;
+                     *row++ = clear_value | tmp;
+                  }
+                  dst += dst_stride;
+               }
+            }
+            break;
+         case 4:
+            if (clear_mask == 0xffffffff) {
+               for (i = 0; i < height; i++) {
+                  uint32_t *row = (uint32_t *)dst;
+                  for (j = 0; j < width; j++)
+                     *row++ = clear_value;
+                  dst += dst_stride;
+               }
+            }
+            else {
+               for (i = 0; i < height; i++) {
+                  uint32_t *row = (uint32_t *)dst;
+                  for (j = 0; j < width; j++) {
+                     uint32_t tmp = ~clear_mask & *row;
+                     *row++ = clear_value | tmp;
+                  }
+                  dst += dst_stride;
+               }
+            }
+            break;
+         case 8:
+            clear_value64 &= clear_mask64;
+            if (clear_mask64 == 0xffffffffffULL) {
+               for (i = 0; i < height; i++) {
+                  uint64_t *row = (uint64_t *)dst;
+                  for (j = 0; j < width; j++)
+                     *row++ = clear_value64;
+                  dst += dst_stride;
+               }
+            }
+            else {
+               for (i = 0; i < height; i++) {
+                  uint64_t *row = (uint64_t *)dst;
+                  for (j = 0; j < width; j++) {
+                     uint64_t tmp = ~clear_mask64 & *row;
+                     *row++ = clear_value64 | tmp;
+                  }
+                  dst += dst_stride;
+               }
+            }
+            break;
+
+         default:
+            assert(0);
+            break;
+         }
+      }
+   }
+
+   task->clear.zs_mask = 0;
+}
+
+
+/**
+ * Write the pending clears of the current tile which a command depends
+ * on to memory, and drop the ones it completely overwrites.
+ */
+static void
+lp_rast_resolve_clears(struct lp_rasterizer_task *task,
+                       unsigned cmd,
+                       const union lp_rast_cmd_arg arg)
+{
+   const struct lp_scene *scene = task->scene;
+   const struct lp_fragment_shader_variant *variant;
+   unsigned i;
+
+   switch (cmd) {
+   case LP_RAST_OP_CLEAR_COLOR:
+   case LP_RAST_OP_CLEAR_ZSTENCIL:
+   case LP_RAST_OP_BEGIN_QUERY:
+   case LP_RAST_OP_END_QUERY:
+   case LP_RAST_OP_SET_STATE:
+      return;
+   case LP_RAST_OP_SHADE_TILE_OPAQUE:
+      if (arg.shade_tile->disable)
+         return;
+      if (scene->fb_max_layer == 0) {
+         /* Every color pixel gets overwritten, and opaque shaders don't
+          * touch the depth/stencil buffer.
+          */
+         for (i = 0; i < scene->fb.nr_cbufs; i++) {
+            if (task->clear.color_mask & (1 << i))
+               lp_rast_elide_clear(task, scene->fb.cbufs[i]->format);
+         }
+         task->clear.color_mask = 0;
+         return;
+      }
+      break;
+   default:
+      break;
+   }
+
+   if (task->clear.color_mask)
+      lp_rast_write_color_clears(task);
+
+   variant = task->state ? task->state->variant : NULL;
+   if (task->clear.zs_mask &&
+       (!variant ||
+        variant->key.depth.enabled ||
+        variant->key.stencil[0].enabled)) {
+      lp_rast_write_zstencil_clear(task);
+   }
+}
+
+
+/**
+ * Take over the clears which earlier scenes left in the current tile.
+ */
+static void
+lp_rast_get_tile_clears(struct lp_rasterizer_task *task, int x, int y)
+{
+   const struct lp_scene *scene = task->scene;
+   const unsigned tile = y * scene->tiles_x + x;
+   struct llvmpipe_tile_clear *clear;
+   unsigned i;
+
+   for (i = 0; i < scene->fb.nr_cbufs; i++) {
+      if (scene->cbufs[i].tile_clears) {
+         clear = &scene->cbufs[i].tile_clears[tile];
+         if (clear->pending) {
+            task->clear.color_mask |= 1 << i;
+            task->clear.color[i] = clear->value.color;
+            clear->pending = FALSE;
+         }
+      }
+   }
+
+   if (scene->zsbuf.tile_clears) {
+      clear = &scene->zsbuf.tile_clears[tile];
+      if (clear->pending) {
+         task->clear.zs_value = clear->value.zs;
+         task->clear.zs_mask =
+            util_pack64_mask_z_stencil(scene->fb.zsbuf->format, ~0, 0xff);
+         clear->pending = FALSE;
+
+         lp_rast_hiz_clear(task, task->clear.zs_value, task->clear.zs_mask);
+      }
+   }
+}
+
+
+/**
+ * Leave the clears still pending at the end of the current tile to later
+ * scenes, or write them to memory if the resource can't keep them.
+ */
+static void
+lp_rast_put_tile_clears(struct lp_rasterizer_task *task)
+{
+   const struct lp_scene *scene = task->scene;
+   const unsigned tile = task->y / TILE_SIZE * scene->tiles_x +
+                         task->x / TILE_SIZE;
+   struct llvmpipe_tile_clear *clear;
+   unsigned i;
+
+   for (i = 0; i < scene->fb.nr_cbufs; i++) {
+      if ((task->clear.color_mask & (1 << i)) &&
+          scene->cbufs[i].tile_clears) {
+         clear = &scene->cbufs[i].tile_clears[tile];
+         clear->pending = TRUE;
+         clear->value.color = task->clear.color[i];
+         task->clear.color_mask &= ~(1 << i);
+      }
+   }
+
+   if (task->clear.color_mask)
+      lp_rast_write_color_clears(task);
+
+   if (task->clear.zs_mask) {
+      /* partial clears have to be merged with the buffer contents */
+      if (scene->zsbuf.tile_clears &&
+          task->clear.zs_mask ==
+             util_pack64_mask_z_stencil(scene->fb.zsbuf->format, ~0, 0xff)) {
+         clear = &scene->zsbuf.tile_clears[tile];
+         clear->pending = TRUE;
+         clear->value.zs = task->clear.zs_value;
+         task->clear.zs_mask = 0;
+      }
+      else {
+         lp_rast_write_zstencil_clear(task);
+      }
+   }
+}
+
+
 /**
  * Begin rasterizing a scene.
  * Called once per scene by one thread.
@@ -106,6 +450,12 @@ lp_rast_tile_begin(struct lp_rasterizer_task *task,
    /* reset pointers to color and depth tile(s) */
    memset(task->color_tiles, 0, sizeof(task->color_tiles));
    task->depth_tile = NULL;
+
+   lp_rast_hiz_set(task, LP_HIZ_UNKNOWN);
+
+   task->clear.color_mask = 0;
+   task->clear.zs_mask = 0;
+   lp_rast_get_tile_clears(task, x, y);
 }
 
 
@@ -131,6 +481,7 @@ is_fb_pure_integer(const struct pipe_framebuffer_state *fb)
 /**
  * Clear the rasterizer's current color tile.
  * This is a bin command called during bin processing.
+ * The clear is only recorded, see lp_rast_resolve_clears().
  * Clear commands always clear all bound layers.
  */
 static void
@@ -166,17 +517,7 @@ lp_rast_clear_color(struct lp_rasterizer_task *task,
                util_format_write_4ui(format, arg.clear_color.ui, 0, &uc, 0, 0, 0, 1, 1);
             }
 
-            util_fill_box(scene->cbufs[i].map,
-                          format,
-                          scene->cbufs[i].stride,
-                          scene->cbufs[i].layer_stride,
-                          task->x,
-                          task->y,
-                          0,
-                          task->width,
-                          task->height,
-                          scene->fb_max_layer + 1,
-                          &uc);
+            lp_rast_defer_color_clear(task, i, &uc);
          }
       }
       else {
@@ -197,20 +538,13 @@ lp_rast_clear_color(struct lp_rasterizer_task *task,
                util_pack_color(arg.clear_color.f,
                                scene->fb.cbufs[i]->format, &uc);
 
-               util_fill_box(scene->cbufs[i].map,
-                             scene->fb.cbufs[i]->format,
-                             scene->cbufs[i].stride,
-                             scene->cbufs[i].layer_stride,
-                             task->x,
-                             task->y,
-                             0,
-                             task->width,
-                             task->height,
-                             scene->fb_max_layer + 1,
-                             &uc);
+               lp_rast_defer_color_clear(task, i, &uc);
             }
          }
       }
+
+      if (LP_PERF & PERF_NO_FAST_CLEAR)
+         lp_rast_write_color_clears(task);
    }
 
    LP_COUNT(nr_color_tile_clear);
@@ -231,105 +565,29 @@ lp_rast_clear_zstencil(struct lp_rasterizer_task *task,
    const struct lp_scene *scene = task->scene;
    uint64_t clear_value64 = arg.clear_zstencil.value;
    uint64_t clear_mask64 = arg.clear_zstencil.mask;
-   uint32_t clear_value = (uint32_t) clear_value64;
-   uint32_t clear_mask = (uint32_t) clear_mask64;
-   const unsigned height = task->height;
-   const unsigned width = task->width;
-   const unsigned dst_stride = scene->zsbuf.stride;
-   uint8_t *dst;
-   unsigned i, j;
-   unsigned block_size;
 
    LP_DBG(DEBUG_RAST, "%s: value=0x%08x, mask=0x%08x\n",
-           __FUNCTION__, clear_value, clear_mask);
+           __FUNCTION__, (uint32_t) clear_value64, (uint32_t) clear_mask64);
 
    /*
-    * Clear the area of the depth/depth buffer matching this tile.
+    * Merge with any clear still pending in the tile.  The depth/stencil
+    * buffer is only written once it's read or at the end of the tile.
     */
 
    if (scene->fb.zsbuf) {
-      unsigned layer;
-      uint8_t *dst_layer = lp_rast_get_unswizzled_depth_tile_pointer(task, LP_TEX_USAGE_READ_WRITE);
-      block_size = util_format_get_blocksize(scene->fb.zsbuf->format);
-
-      clear_value &= clear_mask;
+      if (task->clear.zs_mask &&
+          (task->clear.zs_mask & ~clear_mask64) == 0) {
+         lp_rast_elide_clear(task, scene->fb.zsbuf->format);
+      }
 
-      for (layer = 0; layer <= scene->fb_max_layer; layer++) {
-         dst = dst_layer;
+      task->clear.zs_value = (task->clear.zs_value & ~clear_mask64) |
+                             (clear_value64 & clear_mask64);
+      task->clear.zs_mask |= clear_mask64;
 
-         switch (block_size) {
-         case 1:
-            assert(clear_mask == 0xff);
-            memset(dst, (uint8_t) clear_value, height * width);
-            break;
-         case 2:
-            if (clear_mask == 0xffff) {
-               for (i = 0; i < height; i++) {
-                  uint16_t *row = (uint16_t *)dst;
-                  for (j = 0; j < width; j++)
-                     *row++ = (uint16_t) clear_value;
-                  dst += dst_stride;
-               }
-            }
-            else {
-               for (i = 0; i < height; i++) {
-                  uint16_t *row = (uint16_t *)dst;
-                  for (j = 0; j < width; j++) {
-                     uint16_t tmp = ~clear_mask & *row;
-                     *row++ = clear_value | tmp;
-                  }
-                  dst += dst_stride;
-               }
-            }
-            break;
-         case 4:
-            if (clear_mask == 0xffffffff) {
-               for (i = 0; i < height; i++) {
-                  uint32_t *row = (uint32_t *)dst;
-                  for (j = 0; j < width; j++)
-                     *row++ = clear_value;
-                  dst += dst_stride;
-               }
-            }
-            else {
-               for (i = 0; i < height; i++) {
-                  uint32_t *row = (uint32_t *)dst;
-                  for (j = 0; j < width; j++) {
-                     uint32_t tmp = ~clear_mask & *row;
-                     *row++ = clear_value | tmp;
-                  }
-                  dst += dst_stride;
-               }
-            }
-            break;
-         case 8:
-            clear_value64 &= clear_mask64;
-            if (clear_mask64 == 0xffffffffffULL) {
-               for (i = 0; i < height; i++) {
-                  uint64_t *row = (uint64_t *)dst;
-                  for (j = 0; j < width; j++)
-                     *row++ = clear_value64;
-                  dst += dst_stride;
-               }
-            }
-            else {
-               for (i = 0; i < height; i++) {
-                  uint64_t *row = (uint64_t *)dst;
-                  for (j = 0; j < width; j++) {
-                     uint64_t tmp = ~clear_mask64 & *row;
-                     *row++ = clear_value64 | tmp;
-                  }
-                  dst += dst_stride;
-               }
-            }
-            break;
+      if (LP_PERF & PERF_NO_FAST_CLEAR)
+         lp_rast_write_zstencil_clear(task);
 
-         default:
-            assert(0);
-            break;
-         }
-         dst_layer += scene->zsbuf.layer_stride;
-      }
+      lp_rast_hiz_clear(task, clear_value64, clear_mask64);
    }
 }
 
@@ -338,6 +596,7 @@ lp_rast_clear_zstencil(struct lp_rasterizer_task *task,
 /**
  * Run the shader on all blocks in a tile.  This is used when a tile is
  * completely contained inside a triangle.
+ * 16x16 blocks known to be occluded by earlier rendering are skipped.
  * This is a bin command called during bin processing.
  */
 static void
@@ -349,7 +608,8 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
    const struct lp_rast_state *state;
    struct lp_fragment_shader_variant *variant;
    const unsigned tile_x = task->x, tile_y = task->y;
-   unsigned x, y;
+   unsigned bx, by, x, y;
+   boolean hiz;
 
    if (inputs->disable) {
       /* This command was partially binned and has been disabled */
@@ -365,47 +625,82 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
    }
    variant = state->variant;
 
-   /* render the whole 64x64 tile in 4x4 chunks */
-   for (y = 0; y < task->height; y += 4){
-      for (x = 0; x < task->width; x += 4) {
-         uint8_t *color[PIPE_MAX_COLOR_BUFS];
-         unsigned stride[PIPE_MAX_COLOR_BUFS];
-         uint8_t *depth = NULL;
-         unsigned depth_stride = 0;
-         unsigned i;
-
-         /* color buffer */
-         for (i = 0; i < scene->fb.nr_cbufs; i++){
-            stride[i] = scene->cbufs[i].stride;
-            color[i] = lp_rast_get_unswizzled_color_block_pointer(task, i, tile_x + x,
-                                                                  tile_y + y, inputs->layer);
-         }
+   hiz = scene->hiz && (variant->hiz_mode == LP_HIZ_CULL ||
+                        variant->hiz_mode == LP_HIZ_CULL_UPDATE);
+
+   /* render the whole 64x64 tile in 16x16 blocks of 4x4 chunks */
+   for (by = 0; by < task->height; by += LP_HIZ_BLOCK_SIZE) {
+      for (bx = 0; bx < task->width; bx += LP_HIZ_BLOCK_SIZE) {
+         const unsigned x1 = MIN2(bx + LP_HIZ_BLOCK_SIZE, task->width);
+         const unsigned y1 = MIN2(by + LP_HIZ_BLOCK_SIZE, task->height);
+
+         if (hiz) {
+            float *zmax = &task->hiz_zmax[by / LP_HIZ_BLOCK_SIZE]
+                                         [bx / LP_HIZ_BLOCK_SIZE];
+            float block_zmin, block_zmax;
 
-         /* depth buffer */
-         if (scene->zsbuf.map) {
-            depth = lp_rast_get_unswizzled_depth_block_pointer(task, tile_x + x,
-                                                               tile_y + y, inputs->layer);
-            depth_stride = scene->zsbuf.stride;
+            lp_rast_depth_bounds(inputs,
+                                 tile_x + bx, tile_y + by,
+                                 tile_x + x1 - 1, tile_y + y1 - 1,
+                                 &block_zmin, &block_zmax);
+
+            if (block_zmin > *zmax) {
+               LP_COUNT(nr_hiz_culled_16);
+               continue;
+            }
+
+            if (variant->hiz_mode == LP_HIZ_CULL_UPDATE)
+               *zmax = MIN2(*zmax, block_zmax + scene->hiz_slack);
          }
 
-         /* Propagate non-interpolated raster state. */
-         task->thread_data.raster_state.viewport_index = inputs->viewport_index;
+         for (y = by; y < y1; y += 4) {
+            for (x = bx; x < x1; x += 4) {
+               uint8_t *color[PIPE_MAX_COLOR_BUFS];
+               unsigned stride[PIPE_MAX_COLOR_BUFS];
+               unsigned sample_stride[PIPE_MAX_COLOR_BUFS];
+               uint8_t *depth = NULL;
+               unsigned depth_stride = 0;
+               unsigned depth_sample_stride = 0;
+               unsigned i;
+
+               /* color buffer */
+               for (i = 0; i < scene->fb.nr_cbufs; i++){
+                  stride[i] = scene->cbufs[i].stride;
+                  sample_stride[i] = scene->cbufs[i].sample_stride;
+                  color[i] = lp_rast_get_unswizzled_color_block_pointer(task, i, tile_x + x,
+                                                                        tile_y + y, inputs->layer);
+               }
 
-         /* run shader on 4x4 block */
-         BEGIN_JIT_CALL(state, task);
-         variant->jit_function[RAST_WHOLE]( &state->jit_context,
-                                            tile_x + x, tile_y + y,
-                                            inputs->frontfacing,
-                                            GET_A0(inputs),
-                                            GET_DADX(inputs),
-                                            GET_DADY(inputs),
-                                            color,
-                                            depth,
-                                            0xffff,
-                                            &task->thread_data,
-                                            stride,
-                                            depth_stride);
-         END_JIT_CALL();
+               /* depth buffer */
+               if (scene->zsbuf.map) {
+                  depth = lp_rast_get_unswizzled_depth_block_pointer(task, tile_x + x,
+                                                                     tile_y + y, inputs->layer);
+                  depth_stride = scene->zsbuf.stride;
+                  depth_sample_stride = scene->zsbuf.sample_stride;
+               }
+
+               /* Propagate non-interpolated raster state. */
+               task->thread_data.raster_state.viewport_index = inputs->viewport_index;
+
+               /* run shader on 4x4 block */
+               BEGIN_JIT_CALL(state, task);
+               variant->jit_function[RAST_WHOLE]( &state->jit_context,
+                                                  tile_x + x, tile_y + y,
+                                                  inputs->frontfacing,
+                                                  GET_A0(inputs),
+                                                  GET_DADX(inputs),
+                                                  GET_DADY(inputs),
+                                                  color,
+                                                  depth,
+                                                  lp_rast_full_mask(scene),
+                                                  &task->thread_data,
+                                                  stride,
+                                                  depth_stride,
+                                                  sample_stride,
+                                                  depth_sample_stride);
+               END_JIT_CALL();
+            }
+         }
       }
    }
 }
@@ -441,15 +736,17 @@ void
 lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
                          const struct lp_rast_shader_inputs *inputs,
                          unsigned x, unsigned y,
-                         unsigned mask)
+                         uint64_t mask)
 {
    const struct lp_rast_state *state = task->state;
    struct lp_fragment_shader_variant *variant = state->variant;
    const struct lp_scene *scene = task->scene;
    uint8_t *color[PIPE_MAX_COLOR_BUFS];
    unsigned stride[PIPE_MAX_COLOR_BUFS];
+   unsigned sample_stride[PIPE_MAX_COLOR_BUFS];
    uint8_t *depth = NULL;
    unsigned depth_stride = 0;
+   unsigned depth_sample_stride = 0;
    unsigned i;
 
    assert(state);
@@ -467,11 +764,13 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
    for (i = 0; i < scene->fb.nr_cbufs; i++) {
       if (scene->fb.cbufs[i]) {
          stride[i] = scene->cbufs[i].stride;
+         sample_stride[i] = scene->cbufs[i].sample_stride;
          color[i] = lp_rast_get_unswizzled_color_block_pointer(task, i, x, y,
                                                                inputs->layer);
       }
       else {
          stride[i] = 0;
+         sample_stride[i] = 0;
          color[i] = NULL;
       }
    }
@@ -479,6 +778,7 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
    /* depth buffer */
    if (scene->zsbuf.map) {
       depth_stride = scene->zsbuf.stride;
+      depth_sample_stride = scene->zsbuf.sample_stride;
       depth = lp_rast_get_unswizzled_depth_block_pointer(task, x, y, inputs->layer);
    }
 
@@ -509,7 +809,9 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
                                             mask,
                                             &task->thread_data,
                                             stride,
-                                            depth_stride);
+                                            depth_stride,
+                                            sample_stride,
+                                            depth_sample_stride);
       END_JIT_CALL();
    }
 }
@@ -580,6 +882,12 @@ lp_rast_set_state(struct lp_rasterizer_task *task,
                   const union lp_rast_cmd_arg arg)
 {
    task->state = arg.state;
+
+   /* Depth values may be raised by anything drawn with this state. */
+   if (task->scene->hiz && task->state &&
+       task->state->variant->hiz_mode == LP_HIZ_INVALIDATE) {
+      lp_rast_hiz_set(task, LP_HIZ_UNKNOWN);
+   }
 }
 
 
@@ -592,6 +900,8 @@ lp_rast_tile_end(struct lp_rasterizer_task *task)
 {
    unsigned i;
 
+   lp_rast_put_tile_clears(task);
+
    for (i = 0; i < task->scene->num_active_queries; ++i) {
       lp_rast_end_query(task, lp_rast_arg_query(task->scene->active_queries[i]));
    }
@@ -633,16 +943,29 @@ static lp_rast_cmd_func dispatch[LP_RAST_OP_MAX] =
    lp_rast_triangle_32_8,
    lp_rast_triangle_32_3_4,
    lp_rast_triangle_32_3_16,
-   lp_rast_triangle_32_4_16
+   lp_rast_triangle_32_4_16,
+   lp_rast_triangle_ms_1,
+   lp_rast_triangle_ms_2,
+   lp_rast_triangle_ms_3,
+   lp_rast_triangle_ms_4,
+   lp_rast_triangle_ms_5,
+   lp_rast_triangle_ms_6,
+   lp_rast_triangle_ms_7,
+   lp_rast_triangle_ms_8
 };
 
 
-static void
+/**
+ * Execute the commands of a bin.
+ * \return whether any command may have written to the color buffers
+ */
+static boolean
 do_rasterize_bin(struct lp_rasterizer_task *task,
                  const struct cmd_bin *bin,
                  int x, int y)
 {
    const struct cmd_block *block;
+   boolean color_written = FALSE;
    unsigned k;
 
    if (0)
@@ -650,7 +973,38 @@ do_rasterize_bin(struct lp_rasterizer_task *task,
 
    for (block = bin->head; block; block = block->next) {
       for (k = 0; k < block->count; k++) {
-         dispatch[block->cmd[k]]( task, block->arg[k] );
+         const unsigned cmd = block->cmd[k];
+
+         if (task->clear.color_mask || task->clear.zs_mask)
+            lp_rast_resolve_clears(task, cmd, block->arg[k]);
+
+         dispatch[cmd]( task, block->arg[k] );
+
+         color_written |= (cmd != LP_RAST_OP_CLEAR_ZSTENCIL &&
+                           cmd != LP_RAST_OP_BEGIN_QUERY &&
+                           cmd != LP_RAST_OP_END_QUERY &&
+                           cmd != LP_RAST_OP_SET_STATE);
+      }
+   }
+
+   return color_written;
+}
+
+
+/**
+ * Mark the current tile of the display target color buffers as changed.
+ */
+static void
+lp_rast_damage_tile(struct lp_rasterizer_task *task)
+{
+   const struct lp_scene *scene = task->scene;
+   unsigned i;
+
+   for (i = 0; i < scene->fb.nr_cbufs; i++) {
+      if (scene->cbufs[i].dirty_tiles) {
+         scene->cbufs[i].dirty_tiles[task->y / TILE_SIZE *
+                                     scene->cbufs[i].dirty_tiles_stride +
+                                     task->x / TILE_SIZE] = 1;
       }
    }
 }
@@ -669,7 +1023,8 @@ rasterize_bin(struct lp_rasterizer_task *task,
 {
    lp_rast_tile_begin( task, bin, x, y );
 
-   do_rasterize_bin(task, bin, x, y);
+   if (do_rasterize_bin(task, bin, x, y))
+      lp_rast_damage_tile(task);
 
    lp_rast_tile_end(task);
 
@@ -906,12 +1261,37 @@ lp_rast_create( unsigned num_threads )
       struct lp_rasterizer_task *task = &rast->tasks[i];
       task->rast = rast;
       task->thread_index = i;
+      task->thread_data.thread_index = i;
    }
 
    rast->num_threads = num_threads;
 
    rast->no_rast = debug_get_bool_option("LP_NO_RAST", FALSE);
 
+#ifdef USE_AVX2
+   /* Use the 8-wide edge evaluation when the CPU supports it.
+    */
+   if (util_cpu_caps.has_avx2 && !(LP_PERF & PERF_NO_AVX2)) {
+      dispatch[LP_RAST_OP_TRIANGLE_1] = lp_rast_triangle_1_avx2;
+      dispatch[LP_RAST_OP_TRIANGLE_2] = lp_rast_triangle_2_avx2;
+      dispatch[LP_RAST_OP_TRIANGLE_3] = lp_rast_triangle_3_avx2;
+      dispatch[LP_RAST_OP_TRIANGLE_4] = lp_rast_triangle_4_avx2;
+      dispatch[LP_RAST_OP_TRIANGLE_5] = lp_rast_triangle_5_avx2;
+      dispatch[LP_RAST_OP_TRIANGLE_6] = lp_rast_triangle_6_avx2;
+      dispatch[LP_RAST_OP_TRIANGLE_7] = lp_rast_triangle_7_avx2;
+      dispatch[LP_RAST_OP_TRIANGLE_8] = lp_rast_triangle_8_avx2;
+      dispatch[LP_RAST_OP_TRIANGLE_32_1] = lp_rast_triangle_32_1_avx2;
+      dispatch[LP_RAST_OP_TRIANGLE_32_2] = lp_rast_triangle_32_2_avx2;
+      dispatch[LP_RAST_OP_TRIANGLE_32_3] = lp_rast_triangle_32_3_avx2;
+      dispatch[LP_RAST_OP_TRIANGLE_32_4] = lp_rast_triangle_32_4_avx2;
+      dispatch[LP_RAST_OP_TRIANGLE_32_5] = lp_rast_triangle_32_5_avx2;
+      dispatch[LP_RAST_OP_TRIANGLE_32_6] = lp_rast_triangle_32_6_avx2;
+      dispatch[LP_RAST_OP_TRIANGLE_32_7] = lp_rast_triangle_32_7_avx2;
+      dispatch[LP_RAST_OP_TRIANGLE_32_8] = lp_rast_triangle_32_8_avx2;
+      dispatch[LP_RAST_OP_TRIANGLE_32_3_16] = lp_rast_triangle_32_3_16_avx2;
+   }
+#endif
+
    create_rast_threads(rast);
 
    /* for synchronizing rasterization threads */
@@ -38,6 +38,7 @@
 #define LP_RAST_H
 
 #include "pipe/p_compiler.h"
+#include "util/u_math.h"
 #include "lp_jit.h"
 
 
@@ -67,6 +68,15 @@ struct cmd_bin;
 
 #define LP_MAX_ACTIVE_BINNED_QUERIES 16
 
+/* Size of the blocks the rasterizer keeps depth bounds for, width/height */
+#define LP_HIZ_BLOCK_SIZE 16
+
+/** Depth bound of a tile or block whose depth values aren't known */
+#define LP_HIZ_UNKNOWN FLT_MAX
+
+/** Relative error of the fragment shader's z interpolation */
+#define LP_HIZ_EPSILON (1.0f / (1 << 20))
+
 #define IMUL64(a, b) (((int64_t)(a)) * ((int64_t)(b)))
 
 struct lp_rasterizer_task;
@@ -142,6 +152,85 @@ struct lp_rast_triangle {
 #define GET_PLANES(tri) ((struct lp_rast_plane *)((char *)(&(tri)->inputs + 1) + 3 * (tri)->inputs.stride))
 
 
+/**
+ * Compute bounds of the interpolated z of a primitive over the pixels
+ * [x0, x1] x [y0, y1], widened by the interpolation error.
+ * Position is always the first coefficient, and z is linear.
+ */
+static INLINE void
+lp_rast_depth_bounds(const struct lp_rast_shader_inputs *inputs,
+                     int x0, int y0, int x1, int y1,
+                     float *zmin, float *zmax)
+{
+   const float a0 = GET_A0(inputs)[0][2];
+   const float dzdx = GET_DADX(inputs)[0][2];
+   const float dzdy = GET_DADY(inputs)[0][2];
+   const float zx0 = dzdx * x0, zx1 = dzdx * x1;
+   const float zy0 = dzdy * y0, zy1 = dzdy * y1;
+   float err;
+
+   err = (fabsf(a0) +
+          MAX2(fabsf(zx0), fabsf(zx1)) +
+          MAX2(fabsf(zy0), fabsf(zy1))) * LP_HIZ_EPSILON;
+
+   *zmin = a0 + MIN2(zx0, zx1) + MIN2(zy0, zy1) - err;
+   *zmax = a0 + MAX2(zx0, zx1) + MAX2(zy0, zy1) + err;
+}
+
+
+/**
+ * Position of a sample of a multisampled pixel, in 1/16ths of a pixel
+ * relative to the pixel center.  This is the usual rotated grid pattern
+ * for four samples.
+ */
+static INLINE void
+lp_rast_sample_pos(unsigned sample, int *x, int *y)
+{
+   static const int pos[LP_MAX_SAMPLES][2] = {
+      { -2, -6 }, {  6, -2 }, { -6,  2 }, {  2,  6 }
+   };
+
+   assert(sample < LP_MAX_SAMPLES);
+   *x = pos[sample][0];
+   *y = pos[sample][1];
+}
+
+
+/**
+ * Change of a plane's edge function from the pixel center to a sample.
+ * This is exact for the edges of primitives, whose steps are multiples of
+ * FIXED_ONE, and zero for the scissor planes, which only need to be
+ * evaluated at pixel granularity.
+ */
+static INLINE int64_t
+lp_rast_sample_offset(const struct lp_rast_plane *plane, unsigned sample)
+{
+   int sx, sy;
+
+   lp_rast_sample_pos(sample, &sx, &sy);
+   return (IMUL64(plane->dcdy, sy) - IMUL64(plane->dcdx, sx)) / 16;
+}
+
+
+/**
+ * Range of a plane's edge function changes over all samples, for the
+ * trivial accept and reject tests of multisampled rasterization.
+ */
+static INLINE void
+lp_rast_sample_offset_range(const struct lp_rast_plane *plane,
+                            int64_t *lo, int64_t *hi)
+{
+   unsigned s;
+
+   *lo = *hi = lp_rast_sample_offset(plane, 0);
+   for (s = 1; s < LP_MAX_SAMPLES; s++) {
+      int64_t offset = lp_rast_sample_offset(plane, s);
+      *lo = MIN2(*lo, offset);
+      *hi = MAX2(*hi, offset);
+   }
+}
+
+
 
 struct lp_rasterizer *
 lp_rast_create( unsigned num_threads );
@@ -289,8 +378,16 @@ lp_rast_arg_null( void )
 #define LP_RAST_OP_TRIANGLE_32_3_4   0x1a
 #define LP_RAST_OP_TRIANGLE_32_3_16  0x1b
 #define LP_RAST_OP_TRIANGLE_32_4_16  0x1c
-
-#define LP_RAST_OP_MAX               0x1d
+#define LP_RAST_OP_TRIANGLE_MS_1     0x1d
+#define LP_RAST_OP_TRIANGLE_MS_2     0x1e
+#define LP_RAST_OP_TRIANGLE_MS_3     0x1f
+#define LP_RAST_OP_TRIANGLE_MS_4     0x20
+#define LP_RAST_OP_TRIANGLE_MS_5     0x21
+#define LP_RAST_OP_TRIANGLE_MS_6     0x22
+#define LP_RAST_OP_TRIANGLE_MS_7     0x23
+#define LP_RAST_OP_TRIANGLE_MS_8     0x24
+
+#define LP_RAST_OP_MAX               0x25
 #define LP_RAST_OP_MASK              0xff
 
 void
@@ -91,6 +91,17 @@ struct lp_rasterizer_task
    uint8_t *color_tiles[PIPE_MAX_COLOR_BUFS];
    uint8_t *depth_tile;
 
+   /** Clears of the tile which haven't been written to memory yet */
+   struct {
+      unsigned color_mask;  /**< one bit per color buffer */
+      union util_color color[PIPE_MAX_COLOR_BUFS];
+      uint64_t zs_value;
+      uint64_t zs_mask;     /**< zero if no depth/stencil clear is pending */
+   } clear;
+
+   /** Upper bounds of the depth values of the tile's blocks, when scene->hiz */
+   float hiz_zmax[TILE_SIZE / LP_HIZ_BLOCK_SIZE][TILE_SIZE / LP_HIZ_BLOCK_SIZE];
+
    /** "back" pointer */
    struct lp_rasterizer *rast;
 
@@ -138,7 +149,7 @@ void
 lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
                          const struct lp_rast_shader_inputs *inputs,
                          unsigned x, unsigned y,
-                         unsigned mask);
+                         uint64_t mask);
 
 
 
@@ -271,6 +282,17 @@ lp_rast_get_unswizzled_depth_block_pointer(struct lp_rasterizer_task *task,
 }
 
 
+/**
+ * Coverage mask of a fully covered 4x4 block.  The shader for whole blocks
+ * may be the edge test one, which takes 16 bits per sample when
+ * multisampling.
+ */
+static INLINE uint64_t
+lp_rast_full_mask(const struct lp_scene *scene)
+{
+   return scene->nr_samples > 1 ? ~(uint64_t)0 : 0xffff;
+}
+
 
 /**
  * Shade all pixels in a 4x4 block.  The fragment code omits the
@@ -287,19 +309,23 @@ lp_rast_shade_quads_all( struct lp_rasterizer_task *task,
    struct lp_fragment_shader_variant *variant = state->variant;
    uint8_t *color[PIPE_MAX_COLOR_BUFS];
    unsigned stride[PIPE_MAX_COLOR_BUFS];
+   unsigned sample_stride[PIPE_MAX_COLOR_BUFS];
    uint8_t *depth = NULL;
    unsigned depth_stride = 0;
+   unsigned depth_sample_stride = 0;
    unsigned i;
 
    /* color buffer */
    for (i = 0; i < scene->fb.nr_cbufs; i++) {
       if (scene->fb.cbufs[i]) {
          stride[i] = scene->cbufs[i].stride;
+         sample_stride[i] = scene->cbufs[i].sample_stride;
          color[i] = lp_rast_get_unswizzled_color_block_pointer(task, i, x, y,
                                                                inputs->layer);
       }
       else {
          stride[i] = 0;
+         sample_stride[i] = 0;
          color[i] = NULL;
       }
    }
@@ -307,6 +333,7 @@ lp_rast_shade_quads_all( struct lp_rasterizer_task *task,
    if (scene->zsbuf.map) {
       depth = lp_rast_get_unswizzled_depth_block_pointer(task, x, y, inputs->layer);
       depth_stride = scene->zsbuf.stride;
+      depth_sample_stride = scene->zsbuf.sample_stride;
    }
 
    /*
@@ -331,10 +358,12 @@ lp_rast_shade_quads_all( struct lp_rasterizer_task *task,
                                          GET_DADY(inputs),
                                          color,
                                          depth,
-                                         0xffff,
+                                         lp_rast_full_mask(scene),
                                          &task->thread_data,
                                          stride,
-                                         depth_stride);
+                                         depth_stride,
+                                         sample_stride,
+                                         depth_sample_stride);
       END_JIT_CALL();
    }
 }
@@ -392,6 +421,65 @@ void lp_rast_triangle_32_3_16( struct lp_rasterizer_task *,
 void lp_rast_triangle_32_4_16( struct lp_rasterizer_task *, 
                             const union lp_rast_cmd_arg );
 
+void lp_rast_triangle_ms_1( struct lp_rasterizer_task *,
+                            const union lp_rast_cmd_arg );
+void lp_rast_triangle_ms_2( struct lp_rasterizer_task *,
+                            const union lp_rast_cmd_arg );
+void lp_rast_triangle_ms_3( struct lp_rasterizer_task *,
+                            const union lp_rast_cmd_arg );
+void lp_rast_triangle_ms_4( struct lp_rasterizer_task *,
+                            const union lp_rast_cmd_arg );
+void lp_rast_triangle_ms_5( struct lp_rasterizer_task *,
+                            const union lp_rast_cmd_arg );
+void lp_rast_triangle_ms_6( struct lp_rasterizer_task *,
+                            const union lp_rast_cmd_arg );
+void lp_rast_triangle_ms_7( struct lp_rasterizer_task *,
+                            const union lp_rast_cmd_arg );
+void lp_rast_triangle_ms_8( struct lp_rasterizer_task *,
+                            const union lp_rast_cmd_arg );
+
+/* Only callable if util_cpu_caps.has_avx2, see lp_rast_tri_avx2.c */
+#ifdef USE_AVX2
+
+void lp_rast_triangle_1_avx2( struct lp_rasterizer_task *,
+                              const union lp_rast_cmd_arg );
+void lp_rast_triangle_2_avx2( struct lp_rasterizer_task *,
+                              const union lp_rast_cmd_arg );
+void lp_rast_triangle_3_avx2( struct lp_rasterizer_task *,
+                              const union lp_rast_cmd_arg );
+void lp_rast_triangle_4_avx2( struct lp_rasterizer_task *,
+                              const union lp_rast_cmd_arg );
+void lp_rast_triangle_5_avx2( struct lp_rasterizer_task *,
+                              const union lp_rast_cmd_arg );
+void lp_rast_triangle_6_avx2( struct lp_rasterizer_task *,
+                              const union lp_rast_cmd_arg );
+void lp_rast_triangle_7_avx2( struct lp_rasterizer_task *,
+                              const union lp_rast_cmd_arg );
+void lp_rast_triangle_8_avx2( struct lp_rasterizer_task *,
+                              const union lp_rast_cmd_arg );
+
+void lp_rast_triangle_32_1_avx2( struct lp_rasterizer_task *,
+                                 const union lp_rast_cmd_arg );
+void lp_rast_triangle_32_2_avx2( struct lp_rasterizer_task *,
+                                 const union lp_rast_cmd_arg );
+void lp_rast_triangle_32_3_avx2( struct lp_rasterizer_task *,
+                                 const union lp_rast_cmd_arg );
+void lp_rast_triangle_32_4_avx2( struct lp_rasterizer_task *,
+                                 const union lp_rast_cmd_arg );
+void lp_rast_triangle_32_5_avx2( struct lp_rasterizer_task *,
+                                 const union lp_rast_cmd_arg );
+void lp_rast_triangle_32_6_avx2( struct lp_rasterizer_task *,
+                                 const union lp_rast_cmd_arg );
+void lp_rast_triangle_32_7_avx2( struct lp_rasterizer_task *,
+                                 const union lp_rast_cmd_arg );
+void lp_rast_triangle_32_8_avx2( struct lp_rasterizer_task *,
+                                 const union lp_rast_cmd_arg );
+
+void lp_rast_triangle_32_3_16_avx2( struct lp_rasterizer_task *,
+                                    const union lp_rast_cmd_arg );
+
+#endif
+
 void
 lp_rast_set_state(struct lp_rasterizer_task *task,
                   const union lp_rast_cmd_arg arg);
@@ -0,0 +1,378 @@
+/**************************************************************************
+ *
+ * Copyright 2013 agent <agent@local>
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * AVX2 rasterization for binned triangles within a tile.
+ *
+ * This file is built with -mavx2 and the functions in it must only be
+ * called when util_cpu_caps.has_avx2 is set, see lp_rast_create().
+ *
+ * The edge functions are evaluated 8 at a time.  The 32-bit variants
+ * compute the trivial reject and accept masks of a block in one pass, and
+ * lp_rast_triangle_32_3_16_avx2 tests two rows of a 4x4 block per
+ * register.  Triangles too large for 32-bit fixed point get one row of
+ * four 64-bit values per register instead of the scalar build_masks().
+ */
+
+#include <limits.h>
+#include <immintrin.h>
+#include "util/u_math.h"
+#include "lp_debug.h"
+#include "lp_perf.h"
+#include "lp_rast_priv.h"
+
+
+/**
+ * Shade all pixels in a 4x4 block.
+ */
+static void
+block_full_4(struct lp_rasterizer_task *task,
+             const struct lp_rast_triangle *tri,
+             int x, int y)
+{
+   lp_rast_shade_quads_all(task, &tri->inputs, x, y);
+}
+
+
+/**
+ * Shade all pixels in a 16x16 block.
+ */
+static void
+block_full_16(struct lp_rasterizer_task *task,
+              const struct lp_rast_triangle *tri,
+              int x, int y)
+{
+   unsigned ix, iy;
+   assert(x % 16 == 0);
+   assert(y % 16 == 0);
+   for (iy = 0; iy < 16; iy += 4)
+      for (ix = 0; ix < 16; ix += 4)
+	 block_full_4(task, tri, x + ix, y + iy);
+}
+
+
+/**
+ * Sign bits of 16 64-bit values, one row of four per register.
+ */
+static INLINE unsigned
+sign_bits16_epi64(__m256i c0, __m256i c1, __m256i c2, __m256i c3)
+{
+   return (_mm256_movemask_pd(_mm256_castsi256_pd(c0)) |
+           (_mm256_movemask_pd(_mm256_castsi256_pd(c1)) << 4) |
+           (_mm256_movemask_pd(_mm256_castsi256_pd(c2)) << 8) |
+           (_mm256_movemask_pd(_mm256_castsi256_pd(c3)) << 12));
+}
+
+
+/**
+ * Sign bits of 16 32-bit values, two rows of four per register.
+ */
+static INLINE unsigned
+sign_bits16_epi32(__m256i c01, __m256i c23)
+{
+   return (_mm256_movemask_ps(_mm256_castsi256_ps(c01)) |
+           (_mm256_movemask_ps(_mm256_castsi256_ps(c23)) << 8));
+}
+
+
+/**
+ * The 0, dcdx, 2*dcdx, 3*dcdx, dcdy, dcdy + dcdx, ... offsets of the first
+ * two rows of a 4x4 block.
+ */
+static INLINE __m256i
+block_span_epi32(__m256i xdcdx, __m256i xdcdy)
+{
+   const __m256i zero = _mm256_setzero_si256();
+   __m256i xdcdx2 = _mm256_add_epi32(xdcdx, xdcdx);
+   __m256i xdcdx3 = _mm256_add_epi32(xdcdx2, xdcdx);
+   __m256i span;
+
+   span = _mm256_blend_epi32(zero, xdcdx, 0x22);
+   span = _mm256_blend_epi32(span, xdcdx2, 0x44);
+   span = _mm256_blend_epi32(span, xdcdx3, 0x88);
+
+   return _mm256_add_epi32(span, _mm256_blend_epi32(zero, xdcdy, 0xf0));
+}
+
+
+static INLINE unsigned
+build_mask_linear_avx2(int64_t c, int64_t dcdx, int64_t dcdy)
+{
+   __m256i xdcdy = _mm256_set1_epi64x(dcdy);
+   __m256i cstep0 = _mm256_setr_epi64x(c, c + dcdx, c + 2 * dcdx, c + 3 * dcdx);
+   __m256i cstep1 = _mm256_add_epi64(cstep0, xdcdy);
+   __m256i cstep2 = _mm256_add_epi64(cstep1, xdcdy);
+   __m256i cstep3 = _mm256_add_epi64(cstep2, xdcdy);
+
+   return sign_bits16_epi64(cstep0, cstep1, cstep2, cstep3);
+}
+
+
+static INLINE void
+build_masks_avx2(int64_t c,
+                 int64_t cdiff,
+                 int64_t dcdx,
+                 int64_t dcdy,
+                 unsigned *outmask,
+                 unsigned *partmask)
+{
+   __m256i xdcdy = _mm256_set1_epi64x(dcdy);
+   __m256i cio = _mm256_set1_epi64x(cdiff);
+   __m256i cstep0 = _mm256_setr_epi64x(c, c + dcdx, c + 2 * dcdx, c + 3 * dcdx);
+   __m256i cstep1 = _mm256_add_epi64(cstep0, xdcdy);
+   __m256i cstep2 = _mm256_add_epi64(cstep1, xdcdy);
+   __m256i cstep3 = _mm256_add_epi64(cstep2, xdcdy);
+
+   *outmask |= sign_bits16_epi64(cstep0, cstep1, cstep2, cstep3);
+
+   *partmask |= sign_bits16_epi64(_mm256_add_epi64(cstep0, cio),
+                                  _mm256_add_epi64(cstep1, cio),
+                                  _mm256_add_epi64(cstep2, cio),
+                                  _mm256_add_epi64(cstep3, cio));
+}
+
+
+/**
+ * A single 16-value mask gains nothing from the wider registers, so this
+ * is the same as the SSE2 version, just VEX encoded.
+ */
+static INLINE unsigned
+build_mask_linear_32_avx2(int c, int dcdx, int dcdy)
+{
+   __m128i cstep0 = _mm_setr_epi32(c, c+dcdx, c+dcdx*2, c+dcdx*3);
+   __m128i xdcdy = _mm_set1_epi32(dcdy);
+   __m128i cstep1 = _mm_add_epi32(cstep0, xdcdy);
+   __m128i cstep2 = _mm_add_epi32(cstep1, xdcdy);
+   __m128i cstep3 = _mm_add_epi32(cstep2, xdcdy);
+
+   __m128i cstep01 = _mm_packs_epi32(cstep0, cstep1);
+   __m128i cstep23 = _mm_packs_epi32(cstep2, cstep3);
+   __m128i result = _mm_packs_epi16(cstep01, cstep23);
+
+   return _mm_movemask_epi8(result);
+}
+
+
+/**
+ * Evaluate the trivial reject and trivial accept masks together: each
+ * register holds a row of c values in the low half and the same row of
+ * c + cdiff values in the high half.  The packs work within each half,
+ * so a single movemask yields outmask in the low 16 bits and partmask
+ * in the high 16 bits.
+ */
+static INLINE void
+build_masks_32_avx2(int c,
+                    int cdiff,
+                    int dcdx,
+                    int dcdy,
+                    unsigned *outmask,
+                    unsigned *partmask)
+{
+   __m128i row = _mm_setr_epi32(c, c+dcdx, c+dcdx*2, c+dcdx*3);
+   __m256i cio = _mm256_inserti128_si256(_mm256_setzero_si256(),
+                                         _mm_set1_epi32(cdiff), 1);
+   __m256i xdcdy = _mm256_set1_epi32(dcdy);
+
+   __m256i cstep0 = _mm256_add_epi32(_mm256_broadcastsi128_si256(row), cio);
+   __m256i cstep1 = _mm256_add_epi32(cstep0, xdcdy);
+   __m256i cstep2 = _mm256_add_epi32(cstep1, xdcdy);
+   __m256i cstep3 = _mm256_add_epi32(cstep2, xdcdy);
+
+   __m256i cstep01 = _mm256_packs_epi32(cstep0, cstep1);
+   __m256i cstep23 = _mm256_packs_epi32(cstep2, cstep3);
+   __m256i result = _mm256_packs_epi16(cstep01, cstep23);
+
+   unsigned mask = _mm256_movemask_epi8(result);
+
+   *outmask |= mask & 0xffff;
+   *partmask |= mask >> 16;
+}
+
+
+/**
+ * 3-plane triangle contained in a 16x16 block.
+ *
+ * The trivial reject test is done for eight 4x4 sub-blocks at a time,
+ * and the pixels of each surviving sub-block are tested against all
+ * three planes with two 8-wide evaluations per plane.
+ */
+void
+lp_rast_triangle_32_3_16_avx2(struct lp_rasterizer_task *task,
+                              const union lp_rast_cmd_arg arg)
+{
+   const struct lp_rast_triangle *tri = arg.triangle.tri;
+   const struct lp_rast_plane *plane = GET_PLANES(tri);
+   int x = (arg.triangle.plane_mask & 0xff) + task->x;
+   int y = (arg.triangle.plane_mask >> 8) + task->y;
+   unsigned i, k;
+
+   struct { unsigned mask:16; unsigned i:8; unsigned j:8; } out[16];
+   unsigned nr = 0;
+
+   PIPE_ALIGN_VAR(32) int cblock[3][16];  /* c at each 4x4 sub-block */
+   __m256i span[3];                       /* pixel offsets, rows 0-1 */
+   __m256i dcdy2[3];                      /* two row step */
+   unsigned rejmask = 0;
+
+   for (k = 0; k < 3; k++) {
+      const int dcdx = -plane[k].dcdx;
+      const int dcdy = plane[k].dcdy;
+
+      /* Adjust so we can just check the sign bit (< 0 comparison),
+       * instead of having to do a less efficient <= 0 comparison.
+       */
+      const int c = (int)(plane[k].c + IMUL64(dcdx, x) + IMUL64(dcdy, y)) - 1;
+      const int rej4 = (int)plane[k].eo * 4 + 1;
+
+      __m256i xdcdx = _mm256_set1_epi32(dcdx);
+      __m256i xdcdy = _mm256_set1_epi32(dcdy);
+      __m256i cblock01, cblock23, xrej4;
+
+      span[k] = block_span_epi32(xdcdx, xdcdy);
+      dcdy2[k] = _mm256_add_epi32(xdcdy, xdcdy);
+
+      /* The sub-blocks are four pixels apart */
+      cblock01 = _mm256_add_epi32(_mm256_set1_epi32(c),
+                                  _mm256_slli_epi32(span[k], 2));
+      cblock23 = _mm256_add_epi32(cblock01, _mm256_slli_epi32(dcdy2[k], 2));
+      xrej4 = _mm256_set1_epi32(rej4);
+
+      _mm256_store_si256((__m256i *)&cblock[k][0], cblock01);
+      _mm256_store_si256((__m256i *)&cblock[k][8], cblock23);
+
+      rejmask |= sign_bits16_epi32(_mm256_add_epi32(cblock01, xrej4),
+                                   _mm256_add_epi32(cblock23, xrej4));
+   }
+
+   for (i = 0; i < 16; i++) {
+      __m256i c01, c23;
+      unsigned mask;
+
+      if (rejmask & (1 << i))
+         continue;
+
+      c01 = _mm256_add_epi32(_mm256_set1_epi32(cblock[0][i]), span[0]);
+      c23 = _mm256_add_epi32(c01, dcdy2[0]);
+
+      for (k = 1; k < 3; k++) {
+         __m256i ck01 = _mm256_add_epi32(_mm256_set1_epi32(cblock[k][i]),
+                                         span[k]);
+         __m256i ck23 = _mm256_add_epi32(ck01, dcdy2[k]);
+
+         c01 = _mm256_or_si256(c01, ck01);
+         c23 = _mm256_or_si256(c23, ck23);
+      }
+
+      mask = sign_bits16_epi32(c01, c23);
+
+      out[nr].i = i >> 2;
+      out[nr].j = i & 3;
+      out[nr].mask = mask;
+      if (mask != 0xffff)
+         nr++;
+   }
+
+   for (i = 0; i < nr; i++)
+      lp_rast_shade_quads_mask(task,
+                               &tri->inputs,
+                               x + 4 * out[i].j,
+                               y + 4 * out[i].i,
+                               0xffff & ~out[i].mask);
+}
+
+
+#define BUILD_MASKS(c, cdiff, dcdx, dcdy, omask, pmask) build_masks_avx2(c, cdiff, dcdx, dcdy, omask, pmask)
+#define BUILD_MASK_LINEAR(c, dcdx, dcdy) build_mask_linear_avx2(c, dcdx, dcdy)
+
+#define TAG(x) x##_1_avx2
+#define NR_PLANES 1
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_2_avx2
+#define NR_PLANES 2
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_3_avx2
+#define NR_PLANES 3
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_4_avx2
+#define NR_PLANES 4
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_5_avx2
+#define NR_PLANES 5
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_6_avx2
+#define NR_PLANES 6
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_7_avx2
+#define NR_PLANES 7
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_8_avx2
+#define NR_PLANES 8
+#include "lp_rast_tri_tmp.h"
+
+#undef BUILD_MASKS
+#undef BUILD_MASK_LINEAR
+#define BUILD_MASKS(c, cdiff, dcdx, dcdy, omask, pmask) build_masks_32_avx2((int)c, (int)cdiff, dcdx, dcdy, omask, pmask)
+#define BUILD_MASK_LINEAR(c, dcdx, dcdy) build_mask_linear_32_avx2((int)c, dcdx, dcdy)
+
+#define TAG(x) x##_32_1_avx2
+#define NR_PLANES 1
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_32_2_avx2
+#define NR_PLANES 2
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_32_3_avx2
+#define NR_PLANES 3
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_32_4_avx2
+#define NR_PLANES 4
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_32_5_avx2
+#define NR_PLANES 5
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_32_6_avx2
+#define NR_PLANES 6
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_32_7_avx2
+#define NR_PLANES 7
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_32_8_avx2
+#define NR_PLANES 8
+#include "lp_rast_tri_tmp.h"
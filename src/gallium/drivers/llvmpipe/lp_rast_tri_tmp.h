@@ -46,6 +46,26 @@ TAG(do_block_4)(struct lp_rasterizer_task *task,
                 int x, int y,
                 const int64_t *c)
 {
+#ifdef MULTISAMPLE
+   uint64_t mask = 0;
+   unsigned s;
+   int j;
+
+   /* Sample s covers bits [16*s, 16*s+16) of the mask.
+    */
+   for (s = 0; s < LP_MAX_SAMPLES; s++) {
+      unsigned smask = 0xffff;
+
+      for (j = 0; j < NR_PLANES; j++) {
+         smask &= ~BUILD_MASK_LINEAR(c[j] - 1 +
+                                     lp_rast_sample_offset(&plane[j], s),
+                                     -plane[j].dcdx,
+                                     plane[j].dcdy);
+      }
+
+      mask |= (uint64_t) smask << (16 * s);
+   }
+#else
    unsigned mask = 0xffff;
    int j;
 
@@ -54,6 +74,7 @@ TAG(do_block_4)(struct lp_rasterizer_task *task,
 				 -plane[j].dcdx,
 				 plane[j].dcdy);
    }
+#endif
 
    /* Now pass to the shader:
     */
@@ -81,9 +102,21 @@ TAG(do_block_16)(struct lp_rasterizer_task *task,
    for (j = 0; j < NR_PLANES; j++) {
       const int64_t dcdx = -IMUL64(plane[j].dcdx, 4);
       const int64_t dcdy = IMUL64(plane[j].dcdy, 4);
-      const int64_t cox = IMUL64(plane[j].eo, 4);
       const int64_t ei = plane[j].dcdy - plane[j].dcdx - plane[j].eo;
-      const int64_t cio = IMUL64(ei, 4) - 1;
+      int64_t cox = IMUL64(plane[j].eo, 4);
+      int64_t cio = IMUL64(ei, 4) - 1;
+
+#ifdef MULTISAMPLE
+      /* Reject only blocks with all samples outside, accept only blocks
+       * with all samples inside.
+       */
+      {
+         int64_t lo, hi;
+         lp_rast_sample_offset_range(&plane[j], &lo, &hi);
+         cox += hi;
+         cio += lo;
+      }
+#endif
 
       BUILD_MASKS(c[j] + cox,
 		  cio - cox,
@@ -181,9 +214,18 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
       {
          const int64_t dcdx = -IMUL64(plane[j].dcdx, 16);
          const int64_t dcdy = IMUL64(plane[j].dcdy, 16);
-         const int64_t cox = IMUL64(plane[j].eo, 16);
          const int64_t ei = plane[j].dcdy - plane[j].dcdx - plane[j].eo;
-         const int64_t cio = IMUL64(ei, 16) - 1;
+         int64_t cox = IMUL64(plane[j].eo, 16);
+         int64_t cio = IMUL64(ei, 16) - 1;
+
+#ifdef MULTISAMPLE
+         {
+            int64_t lo, hi;
+            lp_rast_sample_offset_range(&plane[j], &lo, &hi);
+            cox += hi;
+            cio += lo;
+         }
+#endif
 
          BUILD_MASKS(c[j] + cox,
                      cio - cox,
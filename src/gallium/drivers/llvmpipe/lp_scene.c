@@ -146,20 +146,61 @@ lp_scene_bin_reset(struct lp_scene *scene, unsigned x, unsigned y)
 }
 
 
+/**
+ * Return the deferred clears of the resource behind a surface if the
+ * scene's tiles match the resource's, otherwise write them to memory.
+ */
+static struct llvmpipe_tile_clear *
+lp_scene_get_tile_clears(const struct lp_scene *scene,
+                         struct pipe_surface *surf)
+{
+   struct llvmpipe_resource *lpr = llvmpipe_resource(surf->texture);
+
+   if (!lpr->tile_clears)
+      return NULL;
+
+   if (!(LP_PERF & PERF_NO_FAST_CLEAR) &&
+       surf->format == lpr->base.format &&
+       surf->u.tex.level == 0 &&
+       surf->u.tex.first_layer == 0 &&
+       surf->u.tex.last_layer == 0 &&
+       scene->fb.width == lpr->base.width0 &&
+       scene->fb.height == lpr->base.height0) {
+      /* the rasterizer may leave clears behind in any tile */
+      lpr->clears_pending = TRUE;
+      return lpr->tile_clears;
+   }
+
+   llvmpipe_resource_resolve_clears(lpr);
+   return NULL;
+}
+
+
 void
 lp_scene_begin_rasterization(struct lp_scene *scene)
 {
    const struct pipe_framebuffer_state *fb = &scene->fb;
+   const struct resource_ref *ref;
    int i;
 
    //LP_DBG(DEBUG_RAST, "%s\n", __FUNCTION__);
 
+   /* Textures sampled by the scene must hold their data in memory. */
+   for (ref = scene->resources; ref; ref = ref->next) {
+      for (i = 0; i < ref->count; i++)
+         llvmpipe_resource_resolve_clears(llvmpipe_resource(ref->resource[i]));
+   }
+
    for (i = 0; i < scene->fb.nr_cbufs; i++) {
       struct pipe_surface *cbuf = scene->fb.cbufs[i];
 
+      scene->cbufs[i].tile_clears = NULL;
+      scene->cbufs[i].dirty_tiles = NULL;
+
       if (!cbuf) {
          scene->cbufs[i].stride = 0;
          scene->cbufs[i].layer_stride = 0;
+         scene->cbufs[i].sample_stride = 0;
          scene->cbufs[i].map = NULL;
          continue;
       }
@@ -169,7 +210,13 @@ lp_scene_begin_rasterization(struct lp_scene *scene)
                                                            cbuf->u.tex.level);
          scene->cbufs[i].layer_stride = llvmpipe_layer_stride(cbuf->texture,
                                                               cbuf->u.tex.level);
+         scene->cbufs[i].sample_stride = llvmpipe_sample_stride(cbuf->texture);
 
+         scene->cbufs[i].tile_clears = lp_scene_get_tile_clears(scene, cbuf);
+         /* display targets have a single level and layer */
+         scene->cbufs[i].dirty_tiles = llvmpipe_resource(cbuf->texture)->dirty_tiles;
+         scene->cbufs[i].dirty_tiles_stride =
+            align(cbuf->texture->width0, TILE_SIZE) / TILE_SIZE;
          scene->cbufs[i].map = llvmpipe_resource_map(cbuf->texture,
                                                      cbuf->u.tex.level,
                                                      cbuf->u.tex.first_layer,
@@ -180,15 +227,20 @@ lp_scene_begin_rasterization(struct lp_scene *scene)
          unsigned pixstride = util_format_get_blocksize(cbuf->format);
          scene->cbufs[i].stride = cbuf->texture->width0;
          scene->cbufs[i].layer_stride = 0;
+         scene->cbufs[i].sample_stride = 0;
          scene->cbufs[i].map = lpr->data;
          scene->cbufs[i].map += cbuf->u.buf.first_element * pixstride;
       }
    }
 
+   scene->zsbuf.tile_clears = NULL;
+
    if (fb->zsbuf) {
       struct pipe_surface *zsbuf = scene->fb.zsbuf;
+      scene->zsbuf.tile_clears = lp_scene_get_tile_clears(scene, zsbuf);
       scene->zsbuf.stride = llvmpipe_resource_stride(zsbuf->texture, zsbuf->u.tex.level);
       scene->zsbuf.layer_stride = llvmpipe_layer_stride(zsbuf->texture, zsbuf->u.tex.level);
+      scene->zsbuf.sample_stride = llvmpipe_sample_stride(zsbuf->texture);
 
       scene->zsbuf.map = llvmpipe_resource_map(zsbuf->texture,
                                                zsbuf->u.tex.level,
@@ -544,6 +596,48 @@ void lp_scene_begin_binning( struct lp_scene *scene,
       max_layer = MIN2(max_layer, zsbuf->u.tex.last_layer - zsbuf->u.tex.first_layer);
    }
    scene->fb_max_layer = max_layer;
+
+   scene->nr_samples = util_framebuffer_get_num_samples(fb);
+   assert(scene->nr_samples == 1 || scene->nr_samples == LP_MAX_SAMPLES);
+
+   scene->hiz = lp_scene_fb_hiz(fb, &scene->hiz_slack);
+}
+
+
+/**
+ * Whether depth bounds can be kept for the depth buffer of \p fb, and the
+ * largest difference between a depth value and the one stored in it.
+ *
+ * Depth bounds are only kept for depth buffers with a single layer, as
+ * primitives on other layers would need bounds of their own.  Unorm
+ * depth values get rounded to the format's precision when stored, and
+ * 32 bit ones are only converted with float precision.  The bounds are
+ * computed at pixel centers, so they don't hold for multisampling.
+ */
+boolean
+lp_scene_fb_hiz( const struct pipe_framebuffer_state *fb, float *slack )
+{
+   const struct util_format_description *desc;
+   const struct util_format_channel_description *chan;
+
+   *slack = 0.0f;
+
+   if (!fb->zsbuf || (LP_PERF & PERF_NO_HIZ) ||
+       util_framebuffer_get_num_samples(fb) != 1 ||
+       fb->zsbuf->u.tex.first_layer != fb->zsbuf->u.tex.last_layer)
+      return FALSE;
+
+   desc = util_format_description(fb->zsbuf->format);
+   if (!util_format_has_depth(desc))
+      return FALSE;
+
+   chan = &desc->channel[desc->swizzle[0]];
+   if (chan->type != UTIL_FORMAT_TYPE_FLOAT) {
+      *slack = MAX2(1.0 / ((1ULL << chan->size) - 1),
+                    1.0 / (1 << 22));
+   }
+
+   return TRUE;
 }
 
 
@@ -116,6 +116,7 @@ struct data_block_list {
 };
 
 struct resource_ref;
+struct llvmpipe_tile_clear;
 
 /**
  * All bins and bin data are contained here.
@@ -142,11 +143,25 @@ struct lp_scene {
       uint8_t *map;
       unsigned stride;
       unsigned layer_stride;
+      unsigned sample_stride;
+      /** Deferred clears of the resource's tiles, or NULL */
+      struct llvmpipe_tile_clear *tile_clears;
+      /** Changed tiles of a display target, or NULL */
+      uint8_t *dirty_tiles;
+      unsigned dirty_tiles_stride;
    } zsbuf, cbufs[PIPE_MAX_COLOR_BUFS];
 
    /* The amount of layers in the fb (minimum of all attachments) */
    unsigned fb_max_layer;
 
+   /** Samples per pixel of the fb attachments, 1 or LP_MAX_SAMPLES */
+   unsigned nr_samples;
+
+   /** Whether depth bounds are kept for the depth buffer (hierarchical z) */
+   boolean hiz;
+   /** Largest difference between a depth value and the one stored */
+   float hiz_slack;
+
    /** the framebuffer to render the scene into */
    struct pipe_framebuffer_state fb;
 
@@ -396,6 +411,9 @@ lp_scene_begin_binning( struct lp_scene *scene,
 void
 lp_scene_end_binning( struct lp_scene *scene );
 
+boolean
+lp_scene_fb_hiz( const struct pipe_framebuffer_state *fb, float *slack );
+
 
 /* Begin/end rasterization of a scene
  */
@@ -28,6 +28,7 @@
 
 #include "util/u_memory.h"
 #include "util/u_math.h"
+#include "util/u_box.h"
 #include "util/u_cpu_detect.h"
 #include "util/u_format.h"
 #include "util/u_string.h"
@@ -44,6 +45,7 @@
 #include "lp_screen.h"
 #include "lp_context.h"
 #include "lp_debug.h"
+#include "lp_perf.h"
 #include "lp_public.h"
 #include "lp_limits.h"
 #include "lp_rast.h"
@@ -80,6 +82,11 @@ static const struct debug_named_value lp_perf_flags[] = {
    { "no_blend",       PERF_NO_BLEND, NULL },
    { "no_depth",       PERF_NO_DEPTH, NULL },
    { "no_alphatest",   PERF_NO_ALPHATEST, NULL },
+   { "no_hiz",         PERF_NO_HIZ, NULL },
+   { "no_fast_clear",  PERF_NO_FAST_CLEAR, NULL },
+   { "no_avx2",        PERF_NO_AVX2, NULL },
+   { "no_tex_tiling",  PERF_NO_TEX_TILING, NULL },
+   { "no_damage",      PERF_NO_DAMAGE, NULL },
    DEBUG_NAMED_VALUE_END
 };
 
@@ -236,6 +243,9 @@ llvmpipe_get_param(struct pipe_screen *screen, enum pipe_cap param)
       return PIPE_ENDIAN_NATIVE;
    case PIPE_CAP_TGSI_VS_LAYER:
       return 0;
+   case PIPE_CAP_SHAREABLE_CSOS:
+      /* State objects are plain copies of the templates. */
+      return 1;
    }
    /* should only get here on unhandled cases */
    debug_printf("Unexpected PIPE_CAP %d query\n", param);
@@ -334,8 +344,22 @@ llvmpipe_is_format_supported( struct pipe_screen *_screen,
           target == PIPE_TEXTURE_3D ||
           target == PIPE_TEXTURE_CUBE);
 
-   if (sample_count > 1)
-      return FALSE;
+   /*
+    * Multisampled resources can only be rendered to and resolved, with
+    * the sample positions of lp_rast_sample_pos().
+    */
+   if (sample_count > 1) {
+      if (sample_count != LP_MAX_SAMPLES)
+         return FALSE;
+      if (target != PIPE_TEXTURE_2D && target != PIPE_TEXTURE_RECT)
+         return FALSE;
+      if (!(bind & (PIPE_BIND_RENDER_TARGET | PIPE_BIND_DEPTH_STENCIL)) ||
+          (bind & (PIPE_BIND_SAMPLER_VIEW |
+                   PIPE_BIND_DISPLAY_TARGET |
+                   PIPE_BIND_SCANOUT |
+                   PIPE_BIND_SHARED)))
+         return FALSE;
+   }
 
    if (bind & PIPE_BIND_RENDER_TARGET) {
       if (format_desc->colorspace == UTIL_FORMAT_COLORSPACE_SRGB) {
@@ -407,6 +431,165 @@ llvmpipe_is_format_supported( struct pipe_screen *_screen,
 
 
 
+/**
+ * Collect the changed tiles of a display target within a region into
+ * rectangles, and mark the tiles wholly inside the region as unchanged.
+ * Runs of tiles in a row are merged, and so are rows with the same runs.
+ * \return the number of rectangles
+ */
+static unsigned
+llvmpipe_collect_damage(struct llvmpipe_resource *lpr,
+                        const struct pipe_box *region,
+                        struct pipe_box *rects)
+{
+   const unsigned tiles_x = align(lpr->base.width0, TILE_SIZE) / TILE_SIZE;
+   const unsigned tiles_y = align(lpr->base.height0, TILE_SIZE) / TILE_SIZE;
+   const int x1 = region->x + region->width;
+   const int y1 = region->y + region->height;
+   unsigned prev_first = 0, prev_count = 0;
+   unsigned nr_rects = 0;
+   unsigned tx, ty, i;
+
+   for (ty = 0; ty < tiles_y; ty++) {
+      const int ty0 = MAX2((int) (ty * TILE_SIZE), region->y);
+      const int ty1 = MIN2((int) ((ty + 1) * TILE_SIZE), y1);
+      const unsigned row_first = nr_rects;
+      boolean same_runs;
+
+      if (ty0 >= ty1)
+         continue;
+
+      for (tx = 0; tx < tiles_x; tx++) {
+         const int tx0 = MAX2((int) (tx * TILE_SIZE), region->x);
+         const int tx1 = MIN2((int) ((tx + 1) * TILE_SIZE), x1);
+         uint8_t *dirty = &lpr->dirty_tiles[ty * tiles_x + tx];
+
+         if (tx0 >= tx1 || !*dirty)
+            continue;
+
+         if (tx1 - tx0 == TILE_SIZE && ty1 - ty0 == TILE_SIZE)
+            *dirty = 0;
+
+         if (nr_rects > row_first &&
+             rects[nr_rects - 1].x + rects[nr_rects - 1].width == tx0) {
+            rects[nr_rects - 1].width += tx1 - tx0;
+         }
+         else {
+            u_box_2d(tx0, ty0, tx1 - tx0, ty1 - ty0, &rects[nr_rects++]);
+         }
+      }
+
+      /* extend the previous row's rectangles down if the runs match */
+      same_runs = nr_rects - row_first == prev_count && prev_count &&
+                  rects[prev_first].y + rects[prev_first].height == ty0;
+      for (i = 0; same_runs && i < prev_count; i++) {
+         same_runs = rects[prev_first + i].x == rects[row_first + i].x &&
+                     rects[prev_first + i].width == rects[row_first + i].width;
+      }
+
+      if (same_runs) {
+         for (i = 0; i < prev_count; i++)
+            rects[prev_first + i].height += ty1 - ty0;
+         nr_rects = row_first;
+      }
+      else {
+         prev_first = row_first;
+         prev_count = nr_rects - row_first;
+      }
+   }
+
+   return nr_rects;
+}
+
+
+/**
+ * Present a display target with damage tracking: only its tiles which
+ * changed since it was last presented in whole to the same drawable are
+ * copied.  Called with the present mutex held.
+ */
+static void
+llvmpipe_present_damage(struct llvmpipe_screen *screen,
+                        struct llvmpipe_resource *lpr,
+                        void *drawable,
+                        struct pipe_box *sub_box)
+{
+   struct sw_winsys *winsys = screen->winsys;
+   const unsigned tiles_x = align(lpr->base.width0, TILE_SIZE) / TILE_SIZE;
+   const unsigned tiles_y = align(lpr->base.height0, TILE_SIZE) / TILE_SIZE;
+   const unsigned cpp = util_format_get_blocksize(lpr->base.format);
+   struct pipe_box region, *rects;
+   unsigned nr_rects, bytes, i, slot;
+
+   u_box_2d(0, 0, lpr->base.width0, lpr->base.height0, &region);
+   if (sub_box) {
+      u_box_2d(MAX2(sub_box->x, 0), MAX2(sub_box->y, 0),
+               MIN2(sub_box->x + sub_box->width, (int) lpr->base.width0),
+               MIN2(sub_box->y + sub_box->height, (int) lpr->base.height0),
+               &region);
+      region.width = MAX2(region.width - region.x, 0);
+      region.height = MAX2(region.height - region.y, 0);
+   }
+
+   for (slot = 0; slot < LP_MAX_PRESENT_DRAWABLES; slot++) {
+      if (screen->presents[slot].drawable == drawable)
+         break;
+   }
+
+   rects = NULL;
+   if (slot < LP_MAX_PRESENT_DRAWABLES &&
+       screen->presents[slot].resource == lpr &&
+       lpr->presented_to == drawable) {
+      /* worst case is every other tile */
+      rects = MALLOC(tiles_x * tiles_y * sizeof *rects);
+   }
+
+   if (!rects) {
+      winsys->displaytarget_display(winsys, lpr->dt, drawable, sub_box);
+      bytes = region.width * region.height * cpp;
+
+      if (!sub_box) {
+         if (slot == LP_MAX_PRESENT_DRAWABLES) {
+            slot = screen->next_present;
+            screen->next_present = (slot + 1) % LP_MAX_PRESENT_DRAWABLES;
+            screen->presents[slot].drawable = drawable;
+         }
+         screen->presents[slot].resource = lpr;
+         lpr->presented_to = drawable;
+         memset(lpr->dirty_tiles, 0, tiles_x * tiles_y);
+      }
+      else if (slot < LP_MAX_PRESENT_DRAWABLES) {
+         /* the drawable shows parts of several display targets now */
+         screen->presents[slot].resource = NULL;
+      }
+
+      LP_DBG(DEBUG_SCREEN, "llvmpipe: present of texture %u: whole, %u bytes\n",
+             lpr->id, bytes);
+   }
+   else {
+      nr_rects = llvmpipe_collect_damage(lpr, &region, rects);
+      if (nr_rects) {
+         winsys->displaytarget_display_damage(winsys, lpr->dt, drawable,
+                                              rects, nr_rects);
+      }
+
+      bytes = 0;
+      for (i = 0; i < nr_rects; i++)
+         bytes += rects[i].width * rects[i].height * cpp;
+
+      LP_COUNT_ADD(nr_present_rects, nr_rects);
+      LP_COUNT_ADD(present_bytes_skipped,
+                   region.width * region.height * cpp - bytes);
+      LP_DBG(DEBUG_SCREEN, "llvmpipe: present of texture %u: %u rects, %u bytes\n",
+             lpr->id, nr_rects, bytes);
+
+      FREE(rects);
+   }
+
+   LP_COUNT(nr_presents);
+   LP_COUNT_ADD(present_bytes, bytes);
+}
+
+
 static void
 llvmpipe_flush_frontbuffer(struct pipe_screen *_screen,
                            struct pipe_resource *resource,
@@ -419,8 +602,23 @@ llvmpipe_flush_frontbuffer(struct pipe_screen *_screen,
    struct llvmpipe_resource *texture = llvmpipe_resource(resource);
 
    assert(texture->dt);
-   if (texture->dt)
-      winsys->displaytarget_display(winsys, texture->dt, context_private, sub_box);
+   if (texture->dt) {
+      llvmpipe_resource_resolve_clears(texture);
+
+      if (texture->dirty_tiles) {
+         pipe_mutex_lock(screen->present_mutex);
+         llvmpipe_present_damage(screen, texture, context_private, sub_box);
+         pipe_mutex_unlock(screen->present_mutex);
+      }
+      else {
+         winsys->displaytarget_display(winsys, texture->dt, context_private, sub_box);
+         LP_COUNT(nr_presents);
+         LP_COUNT_ADD(present_bytes,
+                      (sub_box ? sub_box->width * sub_box->height :
+                                 resource->width0 * resource->height0) *
+                      util_format_get_blocksize(resource->format));
+      }
+   }
 }
 
 static void
@@ -438,6 +636,7 @@ llvmpipe_destroy_screen( struct pipe_screen *_screen )
       winsys->destroy(winsys);
 
    pipe_mutex_destroy(screen->rast_mutex);
+   pipe_mutex_destroy(screen->present_mutex);
 
    FREE(screen);
 }
@@ -556,6 +755,7 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
       return NULL;
    }
    pipe_mutex_init(screen->rast_mutex);
+   pipe_mutex_init(screen->present_mutex);
 
    util_format_s3tc_init();
 
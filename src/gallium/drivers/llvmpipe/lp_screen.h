@@ -41,6 +41,11 @@
 
 
 struct sw_winsys;
+struct llvmpipe_resource;
+
+
+/** Number of drawables whose last presented display target is remembered */
+#define LP_MAX_PRESENT_DRAWABLES 8
 
 
 struct llvmpipe_screen
@@ -57,6 +62,18 @@ struct llvmpipe_screen
 
    struct lp_rasterizer *rast;
    pipe_mutex rast_mutex;
+
+   /**
+    * The display target last presented in whole to each of a few recently
+    * used drawables.  Only the display target's changes since then need to
+    * be presented to the drawable again.
+    */
+   struct {
+      void *drawable;
+      const struct llvmpipe_resource *resource;
+   } presents[LP_MAX_PRESENT_DRAWABLES];
+   unsigned next_present;
+   pipe_mutex present_mutex;
 };
 
 
@@ -116,6 +116,22 @@ first_point( struct lp_setup_context *setup,
    setup->point( setup, v0 );
 }
 
+/**
+ * Set the depth bounds of all tiles.
+ */
+static void
+lp_setup_hiz_set( struct lp_setup_context *setup, float zmax )
+{
+   unsigned i, j;
+
+   for (i = 0; i < TILES_X; i++) {
+      for (j = 0; j < TILES_Y; j++) {
+         setup->hiz_zmax[i][j] = zmax;
+      }
+   }
+}
+
+
 void lp_setup_reset( struct lp_setup_context *setup )
 {
    unsigned i;
@@ -137,6 +153,11 @@ void lp_setup_reset( struct lp_setup_context *setup )
     */
    memset(&setup->clear, 0, sizeof setup->clear);
 
+   /* The depth buffer may get written outside of scenes, e.g. by
+    * transfers, so nothing is known about it anymore.
+    */
+   lp_setup_hiz_set( setup, LP_HIZ_UNKNOWN );
+
    /* Have an explicit "start-binning" call and get rid of this
     * pointer twiddling?
     */
@@ -447,6 +468,16 @@ lp_setup_try_clear( struct lp_setup_context *setup,
                 sizeof setup->clear.color.clear_color);
       }
    }
+
+   /* In the cleared state the scene hasn't been set up for setup->fb yet,
+    * so its hiz fields can't be used.
+    */
+   if (flags & PIPE_CLEAR_DEPTH) {
+      float slack;
+
+      if (lp_scene_fb_hiz( &setup->fb, &slack ))
+         lp_setup_hiz_set( setup, (float) depth + slack );
+   }
    
    return TRUE;
 }
@@ -476,7 +507,8 @@ lp_setup_set_triangle_state( struct lp_setup_context *setup,
                              boolean ccw_is_frontface,
                              boolean scissor,
                              boolean half_pixel_center,
-                             boolean bottom_edge_rule)
+                             boolean bottom_edge_rule,
+                             boolean multisample)
 {
    LP_DBG(DEBUG_SETUP, "%s\n", __FUNCTION__);
 
@@ -485,6 +517,7 @@ lp_setup_set_triangle_state( struct lp_setup_context *setup,
    setup->triangle = first_triangle;
    setup->pixel_offset = half_pixel_center ? 0.5f : 0.0f;
    setup->bottom_edge_rule = bottom_edge_rule;
+   setup->multisample = multisample;
 
    if (setup->scissor_test != scissor) {
       setup->dirty |= LP_SETUP_NEW_SCISSOR;
@@ -1250,6 +1283,8 @@ lp_setup_create( struct pipe_context *pipe,
    
    setup->dirty = ~0;
 
+   lp_setup_hiz_set( setup, LP_HIZ_UNKNOWN );
+
    return setup;
 
 no_scenes:
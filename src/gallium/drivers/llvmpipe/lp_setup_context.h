@@ -98,6 +98,7 @@ struct lp_setup_context
    boolean scissor_test;
    boolean point_size_per_vertex;
    boolean rasterizer_discard;
+   boolean multisample;         /**< rasterize at the sample positions */
    unsigned cullmode;
    unsigned bottom_edge_rule;
    float pixel_offset;
@@ -114,6 +115,12 @@ struct lp_setup_context
    struct u_rect draw_regions[PIPE_MAX_VIEWPORTS];   /* intersection of fb & scissor */
    struct lp_jit_viewport viewports[PIPE_MAX_VIEWPORTS];
 
+   /**
+    * Conservative upper bounds of the depth values of each tile, as of the
+    * commands binned so far (hierarchical z).  Only valid with scene->hiz.
+    */
+   float hiz_zmax[TILES_X][TILES_Y];
+
    struct {
       unsigned flags;
       union lp_rast_cmd_arg color;    /**< lp_rast_clear_color() cmd */
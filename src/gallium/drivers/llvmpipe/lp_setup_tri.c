@@ -202,6 +202,19 @@ lp_rast_32_tri_tab[MAX_PLANES+1] = {
    LP_RAST_OP_TRIANGLE_32_8
 };
 
+static unsigned
+lp_rast_ms_tri_tab[MAX_PLANES+1] = {
+   0,               /* should be impossible */
+   LP_RAST_OP_TRIANGLE_MS_1,
+   LP_RAST_OP_TRIANGLE_MS_2,
+   LP_RAST_OP_TRIANGLE_MS_3,
+   LP_RAST_OP_TRIANGLE_MS_4,
+   LP_RAST_OP_TRIANGLE_MS_5,
+   LP_RAST_OP_TRIANGLE_MS_6,
+   LP_RAST_OP_TRIANGLE_MS_7,
+   LP_RAST_OP_TRIANGLE_MS_8
+};
+
 
 
 /**
@@ -254,6 +267,54 @@ lp_setup_whole_tile(struct lp_setup_context *setup,
 }
 
 
+/**
+ * Test the part of a primitive within a tile against the tile's depth
+ * bounds, and update the bounds for it.
+ *
+ * \param tx, ty  the tile position in tiles, not pixels
+ * \param covered  whether the primitive covers the whole tile
+ * \return FALSE if all the primitive's fragments in the tile are known to
+ * fail the depth test
+ */
+static boolean
+lp_setup_hiz_tile(struct lp_setup_context *setup,
+                  const struct lp_rast_shader_inputs *inputs,
+                  const struct u_rect *bbox,
+                  int tx, int ty,
+                  boolean covered)
+{
+   const struct lp_scene *scene = setup->scene;
+   enum lp_hiz_mode mode = setup->fs.current.variant->hiz_mode;
+   float *zmax = &setup->hiz_zmax[tx][ty];
+   float tri_zmin, tri_zmax;
+
+   if (!scene->hiz || mode == LP_HIZ_IGNORE)
+      return TRUE;
+
+   if (mode == LP_HIZ_INVALIDATE) {
+      *zmax = LP_HIZ_UNKNOWN;
+      return TRUE;
+   }
+
+   lp_rast_depth_bounds(inputs,
+                        MAX2(bbox->x0, tx * TILE_SIZE),
+                        MAX2(bbox->y0, ty * TILE_SIZE),
+                        MIN2(bbox->x1, tx * TILE_SIZE + TILE_SIZE - 1),
+                        MIN2(bbox->y1, ty * TILE_SIZE + TILE_SIZE - 1),
+                        &tri_zmin, &tri_zmax);
+
+   if (tri_zmin > *zmax) {
+      LP_COUNT(nr_hiz_culled_64);
+      return FALSE;
+   }
+
+   if (covered && mode == LP_HIZ_CULL_UPDATE)
+      *zmax = MIN2(*zmax, tri_zmax + scene->hiz_slack);
+
+   return TRUE;
+}
+
+
 /**
  * Do basic setup for triangle rasterization and determine which
  * framebuffer tiles are touched.  Put the triangle in the scene's
@@ -314,6 +375,17 @@ do_triangle_ccw(struct lp_setup_context *setup,
       /* Inclusive / exclusive depending upon adj (bottom-left or top-right) */
       bbox.y0 = (MIN3(position->y[0], position->y[1], position->y[2]) + adj) >> FIXED_ORDER;
       bbox.y1 = (MAX3(position->y[0], position->y[1], position->y[2]) - 1 + adj) >> FIXED_ORDER;
+
+      /* Samples are less than half a pixel away from the pixel center, so
+       * the pixels next to the ones with their center covered may have
+       * covered samples too.
+       */
+      if (scene->nr_samples > 1 && setup->multisample) {
+         bbox.x0 -= 1;
+         bbox.y0 -= 1;
+         bbox.x1 += 1;
+         bbox.y1 += 1;
+      }
    }
 
    if (bbox.x1 < bbox.x0 ||
@@ -623,6 +695,14 @@ lp_setup_bin_triangle( struct lp_setup_context *setup,
                  (bbox->y1 - (bbox->y0 & ~3)));
    int sz = floor_pot(max_sz);
    boolean use_32bits = max_sz <= MAX_FIXED_LENGTH32;
+   /* Multisampled rasterization has no special cases for small triangles.
+    * Without rasterizer multisampling the pixel centers are tested, and the
+    * shader applies their coverage to all samples.
+    */
+   const boolean multisample = scene->nr_samples > 1 && setup->multisample;
+   const unsigned *tri_tab = multisample ? lp_rast_ms_tri_tab :
+                             use_32bits ? lp_rast_32_tri_tab :
+                             lp_rast_tri_tab;
 
    /* Now apply scissor, etc to the bounding box.  Could do this
     * earlier, but it confuses the logic for tri-16 and would force
@@ -644,7 +724,14 @@ lp_setup_bin_triangle( struct lp_setup_context *setup,
       assert(iy0 == bbox->y1 / TILE_SIZE &&
 	     ix0 == bbox->x1 / TILE_SIZE);
 
-      if (nr_planes == 3) {
+      if (!lp_setup_hiz_tile(setup, &tri->inputs, &trimmed_box,
+                             ix0, iy0, FALSE))
+         return TRUE;
+
+      if (multisample) {
+         /* use the general case below */
+      }
+      else if (nr_planes == 3) {
          if (sz < 4)
          {
             /* Triangle is contained in a single 4x4 stamp:
@@ -704,7 +791,7 @@ lp_setup_bin_triangle( struct lp_setup_context *setup,
        */
       return lp_scene_bin_cmd_with_state(
          scene, ix0, iy0, setup->fs.stored,
-         use_32bits ? lp_rast_32_tri_tab[nr_planes] : lp_rast_tri_tab[nr_planes],
+         tri_tab[nr_planes],
          lp_rast_arg_triangle(tri, (1<<nr_planes)-1));
    }
    else
@@ -735,6 +822,14 @@ lp_setup_bin_triangle( struct lp_setup_context *setup,
          eo[i] = plane[i].eo << TILE_ORDER;
          xstep[i] = -(((int64_t)plane[i].dcdx) << TILE_ORDER);
          ystep[i] = ((int64_t)plane[i].dcdy) << TILE_ORDER;
+
+         /* Only tiles with all samples covered may be shaded whole */
+         if (multisample) {
+            int64_t lo, hi;
+            lp_rast_sample_offset_range(&plane[i], &lo, &hi);
+            ei[i] += lo;
+            eo[i] += hi;
+         }
       }
 
 
@@ -770,6 +865,11 @@ lp_setup_bin_triangle( struct lp_setup_context *setup,
                   break;  /* exiting triangle, all done with this row */
                LP_COUNT(nr_empty_64);
             }
+            else if (!lp_setup_hiz_tile(setup, &tri->inputs, &trimmed_box,
+                                        x, y, !partial)) {
+               /* occluded by what was drawn before */
+               in = TRUE;
+            }
             else if (partial) {
                /* Not trivially accepted by at least one plane -
                 * rasterize/shade partial tile
@@ -779,9 +879,7 @@ lp_setup_bin_triangle( struct lp_setup_context *setup,
                
                if (!lp_scene_bin_cmd_with_state( scene, x, y,
                                                  setup->fs.stored,
-                                                 use_32bits ?
-                                                 lp_rast_32_tri_tab[count] :
-                                                 lp_rast_tri_tab[count],
+                                                 tri_tab[count],
                                                  lp_rast_arg_triangle(tri, partial) ))
                   goto fail;
 
@@ -27,11 +27,13 @@
 
 #include "util/u_math.h"
 #include "util/u_memory.h"
+#include "util/u_framebuffer.h"
 #include "pipe/p_shader_tokens.h"
 #include "draw/draw_context.h"
 #include "draw/draw_vertex.h"
 #include "draw/draw_private.h"
 #include "lp_context.h"
+#include "lp_limits.h"
 #include "lp_screen.h"
 #include "lp_setup.h"
 #include "lp_state.h"
@@ -185,9 +187,15 @@ void llvmpipe_update_derived( struct llvmpipe_context *llvmpipe )
                           LP_NEW_OCCLUSION_QUERY))
       llvmpipe_update_fs( llvmpipe );
 
-   if (llvmpipe->dirty & (LP_NEW_RASTERIZER)) {
+   if (llvmpipe->dirty & (LP_NEW_RASTERIZER |
+                          LP_NEW_FRAMEBUFFER)) {
+      /* With multisampling all samples have to be masked off. */
+      unsigned samples_mask =
+         llvmpipe->rasterizer && llvmpipe->rasterizer->multisample &&
+         util_framebuffer_get_num_samples(&llvmpipe->framebuffer) > 1 ?
+         (1 << LP_MAX_SAMPLES) - 1 : 1;
       boolean discard =
-         (llvmpipe->sample_mask & 1) == 0 ||
+         (llvmpipe->sample_mask & samples_mask) == 0 ||
          (llvmpipe->rasterizer ? llvmpipe->rasterizer->rasterizer_discard : FALSE);
 
       lp_setup_set_rasterizer_discard(llvmpipe->setup, discard);
@@ -67,12 +67,15 @@
 #include "util/u_string.h"
 #include "util/u_simple_list.h"
 #include "util/u_dual_blend.h"
+#include "util/u_framebuffer.h"
 #include "os/os_time.h"
 #include "pipe/p_shader_tokens.h"
 #include "draw/draw_context.h"
 #include "tgsi/tgsi_dump.h"
 #include "tgsi/tgsi_scan.h"
 #include "tgsi/tgsi_parse.h"
+#include "cso_cache/cso_cache.h"
+#include "cso_cache/cso_hash.h"
 #include "gallivm/lp_bld_type.h"
 #include "gallivm/lp_bld_const.h"
 #include "gallivm/lp_bld_conv.h"
@@ -87,6 +90,7 @@
 #include "gallivm/lp_bld_pack.h"
 #include "gallivm/lp_bld_format.h"
 #include "gallivm/lp_bld_quad.h"
+#include "gallivm/lp_bld_shader_time.h"
 
 #include "lp_bld_alpha.h"
 #include "lp_bld_blend.h"
@@ -252,9 +256,12 @@ generate_fs_loop(struct gallivm_state *gallivm,
                  struct lp_build_interp_soa_context *interp,
                  struct lp_build_sampler_soa *sampler,
                  LLVMValueRef mask_store,
+                 LLVMValueRef sample_mask_store,
                  LLVMValueRef (*out_color)[4],
                  LLVMValueRef depth_ptr,
                  LLVMValueRef depth_stride,
+                 LLVMValueRef depth_sample_stride,
+                 const LLVMValueRef *z_sample_offsets,
                  LLVMValueRef facing,
                  LLVMValueRef thread_data_ptr)
 {
@@ -265,6 +272,7 @@ generate_fs_loop(struct gallivm_state *gallivm,
    LLVMValueRef consts_ptr, num_consts_ptr;
    LLVMValueRef z;
    LLVMValueRef z_value, s_value;
+   LLVMValueRef coverage_alpha = NULL;
    LLVMValueRef z_fb, s_fb;
    LLVMValueRef stencil_refs[2];
    LLVMValueRef outputs[PIPE_MAX_SHADER_OUTPUTS][TGSI_NUM_CHANNELS];
@@ -319,6 +327,12 @@ generate_fs_loop(struct gallivm_state *gallivm,
          depth_mode = LATE_DEPTH_TEST | LATE_DEPTH_WRITE;
       }
 
+      /* The shader runs once for all samples of a pixel, the depth and
+       * stencil tests are done per sample afterwards.
+       */
+      if (key->multisample)
+         depth_mode = LATE_DEPTH_TEST | LATE_DEPTH_WRITE;
+
       if (!(key->depth.enabled && key->depth.writemask) &&
           !(key->stencil[0].enabled && (key->stencil[0].writemask ||
                                         (key->stencil[1].enabled &&
@@ -441,7 +455,9 @@ generate_fs_loop(struct gallivm_state *gallivm,
       }
    }
 
-   /* Emulate Alpha to Coverage with Alpha test */
+   /* Alpha to Coverage is applied per sample when multisampling, and
+    * emulated with Alpha test otherwise.
+    */
    if (key->blend.alpha_to_coverage) {
       int color0 = find_output_by_semantic(&shader->info.base,
                                            TGSI_SEMANTIC_COLOR,
@@ -450,9 +466,14 @@ generate_fs_loop(struct gallivm_state *gallivm,
       if (color0 != -1 && outputs[color0][3]) {
          LLVMValueRef alpha = LLVMBuildLoad(builder, outputs[color0][3], "alpha");
 
-         lp_build_alpha_to_coverage(gallivm, type,
-                                    &mask, alpha,
-                                    (depth_mode & LATE_DEPTH_TEST) != 0);
+         if (key->multisample) {
+            coverage_alpha = alpha;
+         }
+         else {
+            lp_build_alpha_to_coverage(gallivm, type,
+                                       &mask, alpha,
+                                       (depth_mode & LATE_DEPTH_TEST) != 0);
+         }
       }
    }
 
@@ -511,29 +532,31 @@ generate_fs_loop(struct gallivm_state *gallivm,
          }
       }
 
-      lp_build_depth_stencil_load_swizzled(gallivm, type,
-                                           zs_format_desc, key->resource_1d,
-                                           depth_ptr, depth_stride,
-                                           &z_fb, &s_fb, loop_state.counter);
-
-      lp_build_depth_stencil_test(gallivm,
-                                  &key->depth,
-                                  key->stencil,
-                                  type,
-                                  zs_format_desc,
-                                  &mask,
-                                  stencil_refs,
-                                  z, z_fb, s_fb,
-                                  facing,
-                                  &z_value, &s_value,
-                                  !simple_shader);
-      /* Late Z write */
-      if (depth_mode & LATE_DEPTH_WRITE) {
-         lp_build_depth_stencil_write_swizzled(gallivm, type,
-                                               zs_format_desc, key->resource_1d,
-                                               NULL, NULL, NULL, loop_state.counter,
-                                               depth_ptr, depth_stride,
-                                               z_value, s_value);
+      if (!key->multisample) {
+         lp_build_depth_stencil_load_swizzled(gallivm, type,
+                                              zs_format_desc, key->resource_1d,
+                                              depth_ptr, depth_stride,
+                                              &z_fb, &s_fb, loop_state.counter);
+
+         lp_build_depth_stencil_test(gallivm,
+                                     &key->depth,
+                                     key->stencil,
+                                     type,
+                                     zs_format_desc,
+                                     &mask,
+                                     stencil_refs,
+                                     z, z_fb, s_fb,
+                                     facing,
+                                     &z_value, &s_value,
+                                     !simple_shader);
+         /* Late Z write */
+         if (depth_mode & LATE_DEPTH_WRITE) {
+            lp_build_depth_stencil_write_swizzled(gallivm, type,
+                                                  zs_format_desc, key->resource_1d,
+                                                  NULL, NULL, NULL, loop_state.counter,
+                                                  depth_ptr, depth_stride,
+                                                  z_value, s_value);
+         }
       }
    }
    else if ((depth_mode & EARLY_DEPTH_TEST) &&
@@ -574,7 +597,103 @@ generate_fs_loop(struct gallivm_state *gallivm,
       }
    }
 
-   if (key->occlusion_count) {
+   /*
+    * Multisampling: restrict the coverage of each sample to the pixels
+    * which survived the shader, the sample mask and alpha to coverage,
+    * then do the depth/stencil test of the sample against its own plane of
+    * the depth buffer, with z moved from the pixel center to the sample
+    * position.
+    */
+   if (key->multisample) {
+      LLVMValueRef pixel_mask = lp_build_mask_value(&mask);
+      struct lp_build_context f32_bld;
+      unsigned s;
+
+      lp_build_context_init(&f32_bld, gallivm, type);
+
+      for (s = 0; s < LP_MAX_SAMPLES; s++) {
+         LLVMValueRef sample = lp_build_const_int32(gallivm, s);
+         LLVMValueRef sample_index, sample_mask_ptr, sample_mask;
+
+         sample_index = LLVMBuildMul(builder, num_loop, sample, "");
+         sample_index = LLVMBuildAdd(builder, sample_index,
+                                     loop_state.counter, "");
+         sample_mask_ptr = LLVMBuildGEP(builder, sample_mask_store,
+                                        &sample_index, 1, "sample_mask_ptr");
+
+         if (!(key->sample_mask & (1 << s))) {
+            LLVMBuildStore(builder, lp_build_const_int_vec(gallivm, type, 0),
+                           sample_mask_ptr);
+            continue;
+         }
+
+         sample_mask = LLVMBuildLoad(builder, sample_mask_ptr, "");
+         sample_mask = LLVMBuildAnd(builder, sample_mask, pixel_mask, "");
+
+         /* Alpha covers round(alpha * LP_MAX_SAMPLES) of the samples. */
+         if (coverage_alpha) {
+            LLVMValueRef ref =
+               lp_build_const_vec(gallivm, type,
+                                  (s + 0.5) / LP_MAX_SAMPLES);
+            LLVMValueRef covered =
+               lp_build_cmp(&f32_bld, PIPE_FUNC_GREATER, coverage_alpha, ref);
+
+            sample_mask = LLVMBuildAnd(builder, sample_mask, covered,
+                                       "alpha_to_coverage");
+         }
+
+         if (depth_mode & LATE_DEPTH_TEST) {
+            struct lp_build_mask_context sample_mask_ctx;
+            LLVMValueRef sample_depth_ptr, sample_z, offset;
+
+            offset = LLVMBuildMul(builder, depth_sample_stride, sample, "");
+            sample_depth_ptr = LLVMBuildGEP(builder, depth_ptr, &offset, 1, "");
+
+            sample_z = z;
+            if (!shader->info.base.writes_z && key->sample_coverage) {
+               sample_z = LLVMBuildFAdd(builder, z, z_sample_offsets[s], "");
+            }
+
+            lp_build_mask_begin(&sample_mask_ctx, gallivm, type, sample_mask);
+
+            lp_build_depth_stencil_load_swizzled(gallivm, type,
+                                                 zs_format_desc, key->resource_1d,
+                                                 sample_depth_ptr, depth_stride,
+                                                 &z_fb, &s_fb, loop_state.counter);
+
+            lp_build_depth_stencil_test(gallivm,
+                                        &key->depth,
+                                        key->stencil,
+                                        type,
+                                        zs_format_desc,
+                                        &sample_mask_ctx,
+                                        stencil_refs,
+                                        sample_z, z_fb, s_fb,
+                                        facing,
+                                        &z_value, &s_value,
+                                        FALSE);
+
+            if (depth_mode & LATE_DEPTH_WRITE) {
+               lp_build_depth_stencil_write_swizzled(gallivm, type,
+                                                     zs_format_desc, key->resource_1d,
+                                                     NULL, NULL, NULL, loop_state.counter,
+                                                     sample_depth_ptr, depth_stride,
+                                                     z_value, s_value);
+            }
+
+            sample_mask = lp_build_mask_end(&sample_mask_ctx);
+         }
+
+         LLVMBuildStore(builder, sample_mask, sample_mask_ptr);
+
+         if (key->occlusion_count) {
+            LLVMValueRef counter = lp_jit_thread_data_counter(gallivm, thread_data_ptr);
+            lp_build_name(counter, "counter");
+            lp_build_occlusion_count(gallivm, type, sample_mask, counter);
+         }
+      }
+   }
+   else if (key->occlusion_count) {
       LLVMValueRef counter = lp_jit_thread_data_counter(gallivm, thread_data_ptr);
       lp_build_name(counter, "counter");
       lp_build_occlusion_count(gallivm, type,
@@ -2121,9 +2240,10 @@ generate_fragment(struct llvmpipe_context *lp,
    struct lp_type blend_type;
    LLVMTypeRef fs_elem_type;
    LLVMTypeRef blend_vec_type;
-   LLVMTypeRef arg_types[13];
+   LLVMTypeRef arg_types[15];
    LLVMTypeRef func_type;
    LLVMTypeRef int32_type = LLVMInt32TypeInContext(gallivm->context);
+   LLVMTypeRef int64_type = LLVMInt64TypeInContext(gallivm->context);
    LLVMTypeRef int8_type = LLVMInt8TypeInContext(gallivm->context);
    LLVMValueRef context_ptr;
    LLVMValueRef x;
@@ -2137,16 +2257,21 @@ generate_fragment(struct llvmpipe_context *lp,
    LLVMValueRef depth_stride;
    LLVMValueRef mask_input;
    LLVMValueRef thread_data_ptr;
+   LLVMValueRef sample_stride_ptr;
+   LLVMValueRef depth_sample_stride;
    LLVMBasicBlockRef block;
    LLVMBuilderRef builder;
    struct lp_build_sampler_soa *sampler;
    struct lp_build_interp_soa_context interp;
    LLVMValueRef fs_mask[16 / 4];
+   LLVMValueRef fs_sample_mask[LP_MAX_SAMPLES][16 / 4];
    LLVMValueRef fs_out_color[PIPE_MAX_COLOR_BUFS][TGSI_NUM_CHANNELS][16 / 4];
    LLVMValueRef function;
    LLVMValueRef facing;
+   LLVMValueRef start_time = NULL;
    unsigned num_fs;
-   unsigned i;
+   unsigned nr_samples = key->multisample ? LP_MAX_SAMPLES : 1;
+   unsigned i, s;
    unsigned chan;
    unsigned cbuf;
    boolean cbuf0_write_all;
@@ -2215,10 +2340,12 @@ generate_fragment(struct llvmpipe_context *lp,
    arg_types[6] = LLVMPointerType(fs_elem_type, 0);    /* dady */
    arg_types[7] = LLVMPointerType(LLVMPointerType(blend_vec_type, 0), 0);  /* color */
    arg_types[8] = LLVMPointerType(int8_type, 0);       /* depth */
-   arg_types[9] = int32_type;                          /* mask_input */
+   arg_types[9] = int64_type;                          /* mask_input */
    arg_types[10] = variant->jit_thread_data_ptr_type;  /* per thread data */
    arg_types[11] = LLVMPointerType(int32_type, 0);     /* stride */
    arg_types[12] = int32_type;                         /* depth_stride */
+   arg_types[13] = LLVMPointerType(int32_type, 0);     /* sample_stride */
+   arg_types[14] = int32_type;                         /* depth_sample_stride */
 
    func_type = LLVMFunctionType(LLVMVoidTypeInContext(gallivm->context),
                                 arg_types, Elements(arg_types), 0);
@@ -2248,6 +2375,8 @@ generate_fragment(struct llvmpipe_context *lp,
    thread_data_ptr  = LLVMGetParam(function, 10);
    stride_ptr   = LLVMGetParam(function, 11);
    depth_stride = LLVMGetParam(function, 12);
+   sample_stride_ptr = LLVMGetParam(function, 13);
+   depth_sample_stride = LLVMGetParam(function, 14);
 
    lp_build_name(context_ptr, "context");
    lp_build_name(x, "x");
@@ -2261,6 +2390,8 @@ generate_fragment(struct llvmpipe_context *lp,
    lp_build_name(mask_input, "mask_input");
    lp_build_name(stride_ptr, "stride_ptr");
    lp_build_name(depth_stride, "depth_stride");
+   lp_build_name(sample_stride_ptr, "sample_stride_ptr");
+   lp_build_name(depth_sample_stride, "depth_sample_stride");
 
    /*
     * Function body
@@ -2271,6 +2402,10 @@ generate_fragment(struct llvmpipe_context *lp,
    assert(builder);
    LLVMPositionBuilderAtEnd(builder, block);
 
+   if (variant->time) {
+      start_time = lp_build_shader_time_begin(gallivm);
+   }
+
    /* code generated texture sampling */
    sampler = lp_llvm_sampler_soa_create(key->state, context_ptr);
 
@@ -2284,8 +2419,46 @@ generate_fragment(struct llvmpipe_context *lp,
       LLVMTypeRef mask_type = lp_build_int_vec_type(gallivm, fs_type);
       LLVMValueRef mask_store = lp_build_array_alloca(gallivm, mask_type,
                                                       num_loop, "mask_store");
+      LLVMValueRef sample_mask_store = NULL;
+      LLVMValueRef z_sample_offsets[LP_MAX_SAMPLES];
       LLVMValueRef color_store[PIPE_MAX_COLOR_BUFS][TGSI_NUM_CHANNELS];
 
+      if (key->multisample) {
+         sample_mask_store =
+            lp_build_array_alloca(gallivm, mask_type,
+                                  lp_build_const_int32(gallivm, num_fs * nr_samples),
+                                  "sample_mask_store");
+      }
+
+      if (key->sample_coverage) {
+         LLVMValueRef index = lp_build_const_int32(gallivm, 2);
+         LLVMValueRef dzdx, dzdy;
+
+         /* z of the position attribute, for moving depth to the samples */
+         dzdx = LLVMBuildLoad(builder,
+                              LLVMBuildGEP(builder, dadx_ptr, &index, 1, ""),
+                              "dzdx");
+         dzdy = LLVMBuildLoad(builder,
+                              LLVMBuildGEP(builder, dady_ptr, &index, 1, ""),
+                              "dzdy");
+
+         for (s = 0; s < nr_samples; s++) {
+            LLVMValueRef offset;
+            int sx, sy;
+
+            lp_rast_sample_pos(s, &sx, &sy);
+            offset = LLVMBuildFAdd(builder,
+                                   LLVMBuildFMul(builder, dzdx,
+                                                 lp_build_const_float(gallivm, sx / 16.0), ""),
+                                   LLVMBuildFMul(builder, dzdy,
+                                                 lp_build_const_float(gallivm, sy / 16.0), ""),
+                                   "");
+            z_sample_offsets[s] = lp_build_broadcast(gallivm,
+                                                     lp_build_vec_type(gallivm, fs_type),
+                                                     offset);
+         }
+      }
+
       /*
        * The shader input interpolation info is not explicitely baked in the
        * shader key, but everything it derives from (TGSI, and flatshade) is
@@ -2306,12 +2479,58 @@ generate_fragment(struct llvmpipe_context *lp,
          LLVMValueRef mask_ptr = LLVMBuildGEP(builder, mask_store,
                                               &indexi, 1, "mask_ptr");
 
-         if (partial_mask) {
+         if (!partial_mask) {
+            mask = lp_build_const_int_vec(gallivm, fs_type, ~0);
+            for (s = 0; s < nr_samples && key->multisample; s++) {
+               LLVMValueRef sample_index =
+                  lp_build_const_int32(gallivm, s * num_fs + i);
+               LLVMBuildStore(builder, mask,
+                              LLVMBuildGEP(builder, sample_mask_store,
+                                           &sample_index, 1, ""));
+            }
+         }
+         else if (!key->multisample) {
+            mask = generate_quad_mask(gallivm, fs_type,
+                                      i*fs_type.length/4,
+                                      LLVMBuildTrunc(builder, mask_input,
+                                                     int32_type, ""));
+         }
+         else if (!key->sample_coverage) {
+            /* Only the pixel centers were tested, for all samples */
             mask = generate_quad_mask(gallivm, fs_type,
-                                      i*fs_type.length/4, mask_input);
+                                      i*fs_type.length/4,
+                                      LLVMBuildTrunc(builder, mask_input,
+                                                     int32_type, ""));
+            for (s = 0; s < nr_samples; s++) {
+               LLVMValueRef sample_index =
+                  lp_build_const_int32(gallivm, s * num_fs + i);
+               LLVMBuildStore(builder, mask,
+                              LLVMBuildGEP(builder, sample_mask_store,
+                                           &sample_index, 1, ""));
+            }
          }
          else {
-            mask = lp_build_const_int_vec(gallivm, fs_type, ~0);
+            /* 16 bits per sample; the pixels run for any covered sample */
+            mask = NULL;
+            for (s = 0; s < nr_samples; s++) {
+               LLVMValueRef sample_index =
+                  lp_build_const_int32(gallivm, s * num_fs + i);
+               LLVMValueRef sample_input, sample_mask;
+
+               sample_input = LLVMBuildLShr(builder, mask_input,
+                                            LLVMConstInt(int64_type, 16 * s, 0),
+                                            "");
+               sample_input = LLVMBuildTrunc(builder, sample_input,
+                                             int32_type, "");
+               sample_mask = generate_quad_mask(gallivm, fs_type,
+                                                i*fs_type.length/4,
+                                                sample_input);
+               LLVMBuildStore(builder, sample_mask,
+                              LLVMBuildGEP(builder, sample_mask_store,
+                                           &sample_index, 1, ""));
+               mask = mask ? LLVMBuildOr(builder, mask, sample_mask, "")
+                           : sample_mask;
+            }
          }
          LLVMBuildStore(builder, mask, mask_ptr);
       }
@@ -2325,9 +2544,12 @@ generate_fragment(struct llvmpipe_context *lp,
                        &interp,
                        sampler,
                        mask_store, /* output */
+                       sample_mask_store, /* output */
                        color_store,
                        depth_ptr,
                        depth_stride,
+                       depth_sample_stride,
+                       z_sample_offsets,
                        facing,
                        thread_data_ptr);
 
@@ -2336,6 +2558,16 @@ generate_fragment(struct llvmpipe_context *lp,
          LLVMValueRef ptr = LLVMBuildGEP(builder, mask_store,
                                          &indexi, 1, "");
          fs_mask[i] = LLVMBuildLoad(builder, ptr, "mask");
+         /* Pixels killed by the shader are cleared in the pixel mask only */
+         for (s = 0; s < nr_samples && key->multisample; s++) {
+            LLVMValueRef sample_index =
+               lp_build_const_int32(gallivm, s * num_fs + i);
+            ptr = LLVMBuildGEP(builder, sample_mask_store,
+                               &sample_index, 1, "");
+            fs_sample_mask[s][i] = LLVMBuildAnd(builder, fs_mask[i],
+                                                LLVMBuildLoad(builder, ptr, ""),
+                                                "sample_mask");
+         }
          /* This is fucked up need to reorganize things */
          for (cbuf = 0; cbuf < key->nr_cbufs; cbuf++) {
             for (chan = 0; chan < TGSI_NUM_CHANNELS; ++chan) {
@@ -2383,12 +2615,67 @@ generate_fragment(struct llvmpipe_context *lp,
                                 LLVMBuildGEP(builder, stride_ptr, &index, 1, ""),
                                 "");
 
-         generate_unswizzled_blend(gallivm, cbuf, variant,
-                                   key->cbuf_format[cbuf],
-                                   num_fs, fs_type, fs_mask, fs_out_color,
-                                   context_ptr, color_ptr, stride,
-                                   partial_mask, do_branch);
+         if (!key->multisample) {
+            generate_unswizzled_blend(gallivm, cbuf, variant,
+                                      key->cbuf_format[cbuf],
+                                      num_fs, fs_type, fs_mask, fs_out_color,
+                                      context_ptr, color_ptr, stride,
+                                      partial_mask, do_branch);
+         }
+         else {
+            /*
+             * The same color is blended into every sample plane, each
+             * under its own coverage.
+             */
+            LLVMValueRef sample_stride =
+               LLVMBuildLoad(builder,
+                             LLVMBuildGEP(builder, sample_stride_ptr,
+                                          &index, 1, ""),
+                             "");
+
+            for (s = 0; s < nr_samples; s++) {
+               LLVMValueRef offset =
+                  LLVMBuildMul(builder, sample_stride,
+                               lp_build_const_int32(gallivm, s), "");
+               LLVMValueRef sample_color_ptr =
+                  LLVMBuildBitCast(builder,
+                                   LLVMBuildGEP(builder,
+                                                LLVMBuildBitCast(builder, color_ptr,
+                                                                 LLVMPointerType(int8_type, 0), ""),
+                                                &offset, 1, ""),
+                                   LLVMTypeOf(color_ptr), "");
+
+               generate_unswizzled_blend(gallivm, cbuf, variant,
+                                         key->cbuf_format[cbuf],
+                                         num_fs, fs_type, fs_sample_mask[s],
+                                         fs_out_color,
+                                         context_ptr, sample_color_ptr, stride,
+                                         TRUE, do_branch);
+            }
+         }
+      }
+   }
+
+   if (variant->time) {
+      LLVMValueRef covered = mask_input;
+      LLVMValueRef pixels;
+
+      /* a pixel is shaded if any of its samples is covered */
+      for (s = 1; s < nr_samples; s++) {
+         covered = LLVMBuildOr(builder, covered,
+                               LLVMBuildLShr(builder, mask_input,
+                                             LLVMConstInt(int64_type, 16 * s, 0),
+                                             ""), "");
       }
+      covered = LLVMBuildAnd(builder, covered,
+                             LLVMConstInt(int64_type, 0xffff, 0), "");
+      pixels = lp_build_intrinsic_unary(builder, "llvm.ctpop.i64",
+                                        int64_type, covered);
+
+      lp_build_shader_time_end(gallivm, variant->time,
+                               lp_jit_thread_data_thread_index(gallivm,
+                                                               thread_data_ptr),
+                               start_time, pixels);
    }
 
    LLVMBuildRetVoid(builder);
@@ -2437,6 +2724,12 @@ dump_fs_variant_key(const struct lp_fragment_shader_variant_key *key)
       debug_printf("occlusion_count = 1\n");
    }
 
+   if (key->multisample) {
+      debug_printf("multisample = 1\n");
+      debug_printf("sample_coverage = %u\n", key->sample_coverage);
+      debug_printf("sample_mask = 0x%x\n", key->sample_mask);
+   }
+
    if (key->blend.logicop_enable) {
       debug_printf("blend.logicop_func = %s\n", util_dump_logicop(key->blend.logicop_func, TRUE));
    }
@@ -2486,6 +2779,7 @@ dump_fs_variant_key(const struct lp_fragment_shader_variant_key *key)
                    texture->pot_width,
                    texture->pot_height,
                    texture->pot_depth);
+      debug_printf("  .tiled = %u\n", texture->tiled);
    }
 }
 
@@ -2498,10 +2792,56 @@ lp_debug_fs_variant(const struct lp_fragment_shader_variant *variant)
    tgsi_dump(variant->shader->base.tokens, 0);
    dump_fs_variant_key(&variant->key);
    debug_printf("variant->opaque = %u\n", variant->opaque);
+   debug_printf("variant->hiz_mode = %u\n", variant->hiz_mode);
    debug_printf("\n");
 }
 
 
+/**
+ * Determine how the hierarchical z bounds may be used and must be
+ * maintained for a variant.
+ *
+ * Culling relies on the fragments being tested with the interpolated z,
+ * and on failing fragments having no side effects, so shader depth
+ * writes, depth clamping and stencil all prevent it.  With a LESS or LEQUAL
+ * test depth values can only decrease, which keeps the bounds valid.
+ */
+static enum lp_hiz_mode
+choose_hiz_mode(const struct lp_fragment_shader *shader,
+                const struct lp_fragment_shader_variant_key *key)
+{
+   if (!key->depth.enabled) {
+      return LP_HIZ_IGNORE;
+   }
+
+   if (key->depth.func == PIPE_FUNC_LESS ||
+       key->depth.func == PIPE_FUNC_LEQUAL) {
+      if (key->stencil[0].enabled ||
+          key->depth_clamp ||
+          shader->info.base.writes_z) {
+         return LP_HIZ_IGNORE;
+      }
+
+      if (key->depth.writemask &&
+          !key->alpha.enabled &&
+          !key->blend.alpha_to_coverage &&
+          !shader->info.base.uses_kill) {
+         return LP_HIZ_CULL_UPDATE;
+      }
+
+      return LP_HIZ_CULL;
+   }
+
+   if (!key->depth.writemask ||
+       key->depth.func == PIPE_FUNC_NEVER ||
+       (key->depth.func == PIPE_FUNC_EQUAL && !shader->info.base.writes_z)) {
+      return LP_HIZ_IGNORE;
+   }
+
+   return LP_HIZ_INVALIDATE;
+}
+
+
 /**
  * Generate a new fragment shader variant from the shader code and
  * other state indicated by the key.
@@ -2552,6 +2892,8 @@ generate_variant(struct llvmpipe_context *lp,
          !shader->info.base.uses_kill
       ? TRUE : FALSE;
 
+   variant->hiz_mode = choose_hiz_mode(shader, key);
+
    if ((shader->info.base.num_tokens <= 1) &&
        !key->depth.enabled && !key->stencil[0].enabled) {
       variant->ps_inv_multiplier = 0;
@@ -2563,6 +2905,10 @@ generate_variant(struct llvmpipe_context *lp,
       lp_debug_fs_variant(variant);
    }
 
+   if (lp_shader_time_enabled()) {
+      variant->time = lp_shader_time_create(LP_MAX_THREADS);
+   }
+
    lp_jit_init_types(variant);
    
    if (variant->jit_function[RAST_EDGE_TEST] == NULL)
@@ -2613,6 +2959,12 @@ llvmpipe_create_fs_state(struct pipe_context *pipe,
    if (!shader)
       return NULL;
 
+   shader->variant_hash = cso_hash_create();
+   if (!shader->variant_hash) {
+      FREE(shader);
+      return NULL;
+   }
+
    shader->no = fs_no++;
    make_empty_list(&shader->variants);
 
@@ -2624,6 +2976,7 @@ llvmpipe_create_fs_state(struct pipe_context *pipe,
 
    shader->draw_data = draw_create_fragment_shader(llvmpipe->draw, templ);
    if (shader->draw_data == NULL) {
+      cso_hash_delete(shader->variant_hash);
       FREE((void *) shader->base.tokens);
       FREE(shader);
       return NULL;
@@ -2711,6 +3064,44 @@ llvmpipe_bind_fs_state(struct pipe_context *pipe, void *fs)
 }
 
 
+/**
+ * Add the shader time of a variant to the context's report.
+ */
+static void
+record_shader_time(struct llvmpipe_context *lp,
+                   const struct lp_fragment_shader_variant *variant)
+{
+   char name[64];
+
+   util_snprintf(name, sizeof name, "fs #%u var #%u",
+                 variant->shader->no, variant->no);
+   lp_shader_time_report_add(&lp->fs_time, name,
+                             variant->shader->base.tokens,
+                             variant->time, LP_MAX_THREADS);
+}
+
+
+/**
+ * Print the shader time of all the fragment shader variants, deleted or
+ * still alive.  The rasterizer must be idle.
+ */
+void
+llvmpipe_dump_shader_time(struct llvmpipe_context *lp)
+{
+   struct lp_fs_variant_list_item *li;
+
+   foreach(li, &lp->fs_variants_list) {
+      if (li->base->time) {
+         record_shader_time(lp, li->base);
+         memset(li->base->time, 0, LP_MAX_THREADS * sizeof *li->base->time);
+      }
+   }
+
+   lp_shader_time_report_dump(&lp->fs_time);
+   lp_shader_time_report_cleanup(&lp->fs_time);
+}
+
+
 /**
  * Remove shader variant from two lists: the shader's variant list
  * and the context's variant list.
@@ -2742,10 +3133,27 @@ llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
 
    gallivm_destroy(variant->gallivm);
 
-   /* remove from shader's list */
+   if (variant->time) {
+      record_shader_time(lp, variant);
+      lp_shader_time_destroy(variant->time);
+   }
+
+   /* remove from shader's list and hash */
    remove_from_list(&variant->list_item_local);
    variant->shader->variants_cached--;
 
+   {
+      struct cso_hash_iter iter = cso_hash_find(variant->shader->variant_hash,
+                                                variant->hash_key);
+      while (!cso_hash_iter_is_null(iter)) {
+         if (cso_hash_iter_data(iter) == variant) {
+            cso_hash_erase(variant->shader->variant_hash, iter);
+            break;
+         }
+         iter = cso_hash_iter_next(iter);
+      }
+   }
+
    /* remove from context's list */
    remove_from_list(&variant->list_item_global);
    lp->nr_fs_variants--;
@@ -2783,6 +3191,7 @@ llvmpipe_delete_fs_state(struct pipe_context *pipe, void *fs)
    draw_delete_fragment_shader(llvmpipe->draw, shader->draw_data);
 
    assert(shader->variants_cached == 0);
+   cso_hash_delete(shader->variant_hash);
    FREE((void *) shader->base.tokens);
    FREE(shader);
 }
@@ -2856,6 +3265,119 @@ force_dst_alpha_one(unsigned factor, boolean clamped_zero)
 }
 
 
+/**
+ * Initialize the static texture state of a fragment shader sampler view,
+ * which unlike other shader stages may sample tiled textures.
+ */
+static void
+lp_fs_static_texture_state(struct lp_static_texture_state *state,
+                           const struct pipe_sampler_view *view)
+{
+   lp_sampler_static_texture_state(state, view);
+
+   if (view && view->texture)
+      state->tiled = llvmpipe_resource_const(view->texture)->tiled;
+}
+
+
+/**
+ * Reset the parts of the key which can't affect the generated code, given
+ * the shader and the bound framebuffer, so that state changes the shader
+ * can't observe map to the same variant.
+ */
+static void
+canonicalize_variant_key(const struct lp_fragment_shader *shader,
+                         struct lp_fragment_shader_variant_key *key)
+{
+   unsigned i;
+
+   /* A depth test which always passes and writes nothing is a no-op. */
+   if (key->depth.enabled &&
+       key->depth.func == PIPE_FUNC_ALWAYS &&
+       !key->depth.writemask) {
+      memset(&key->depth, 0, sizeof key->depth);
+   }
+
+   for (i = 0; i < 2; i++) {
+      struct pipe_stencil_state *stencil = &key->stencil[i];
+
+      if (!stencil->enabled) {
+         memset(stencil, 0, sizeof *stencil);
+         continue;
+      }
+
+      /* The ops don't matter if nothing is written, and vice versa. */
+      if (!stencil->writemask ||
+          (stencil->fail_op == PIPE_STENCIL_OP_KEEP &&
+           stencil->zfail_op == PIPE_STENCIL_OP_KEEP &&
+           stencil->zpass_op == PIPE_STENCIL_OP_KEEP)) {
+         stencil->writemask = 0;
+         stencil->fail_op = PIPE_STENCIL_OP_KEEP;
+         stencil->zfail_op = PIPE_STENCIL_OP_KEEP;
+         stencil->zpass_op = PIPE_STENCIL_OP_KEEP;
+      }
+
+      /* Nor does the value mask if the test doesn't compare anything. */
+      if (stencil->func == PIPE_FUNC_ALWAYS ||
+          stencil->func == PIPE_FUNC_NEVER) {
+         stencil->valuemask = 0xff;
+      }
+   }
+
+   if (!key->depth.enabled && !key->stencil[0].enabled) {
+      key->zsbuf_format = PIPE_FORMAT_NONE;
+   }
+
+   /* The shader only clamps the depth it writes, but choose_hiz_mode() must
+    * still know about clamping, as unclipped fragments can lie outside the
+    * depth range, so keep it whenever depth is tested.
+    */
+   if (!key->depth.enabled) {
+      key->depth_clamp = 0;
+   }
+
+   if (key->alpha.enabled && key->alpha.func == PIPE_FUNC_ALWAYS) {
+      key->alpha.enabled = 0;
+      key->alpha.func = 0;
+   }
+
+   if (key->flatshade) {
+      boolean has_color_inputs = FALSE;
+
+      for (i = 0; i < shader->info.base.num_inputs; i++) {
+         if (shader->inputs[i].interp == LP_INTERP_COLOR) {
+            has_color_inputs = TRUE;
+            break;
+         }
+      }
+
+      key->flatshade = has_color_inputs;
+   }
+
+   /* Neither dithering nor alpha-to-one are implemented. */
+   key->blend.dither = 0;
+   key->blend.alpha_to_one = 0;
+
+   if (!key->blend.logicop_enable) {
+      key->blend.logicop_func = 0;
+   }
+
+   for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++) {
+      struct pipe_rt_blend_state *blend_rt = &key->blend.rt[i];
+
+      if (i >= key->nr_cbufs || !blend_rt->colormask) {
+         memset(blend_rt, 0, sizeof *blend_rt);
+      }
+      else if (!blend_rt->blend_enable) {
+         unsigned colormask = blend_rt->colormask;
+
+         memset(blend_rt, 0, sizeof *blend_rt);
+         blend_rt->colormask = colormask;
+      }
+   }
+}
+
+
 /**
  * We need to generate several variants of the fragment pipeline to match
  * all the combinations of the contributing state atoms.
@@ -2915,6 +3437,12 @@ make_variant_key(struct llvmpipe_context *lp,
    /* alpha.ref_value is passed in jit_context */
 
    key->flatshade = lp->rasterizer->flatshade;
+   key->multisample = util_framebuffer_get_num_samples(&lp->framebuffer) > 1;
+   key->sample_mask = (1 << LP_MAX_SAMPLES) - 1;
+   if (key->multisample && lp->rasterizer->multisample) {
+      key->sample_coverage = 1;
+      key->sample_mask &= lp->sample_mask;
+   }
    if (lp->active_occlusion_queries) {
       key->occlusion_count = TRUE;
    }
@@ -2923,6 +3451,13 @@ make_variant_key(struct llvmpipe_context *lp,
       memcpy(&key->blend, lp->blend, sizeof key->blend);
    }
 
+   /* Alpha to coverage is a multisample operation, which is disabled for
+    * multisampled framebuffers along with rasterizer multisampling.
+    */
+   if (key->multisample && !key->sample_coverage) {
+      key->blend.alpha_to_coverage = 0;
+   }
+
    key->nr_cbufs = lp->framebuffer.nr_cbufs;
 
    if (!key->blend.independent_blend_enable) {
@@ -3025,8 +3560,8 @@ make_variant_key(struct llvmpipe_context *lp,
       key->nr_sampler_views = shader->info.base.file_max[TGSI_FILE_SAMPLER_VIEW] + 1;
       for(i = 0; i < key->nr_sampler_views; ++i) {
          if(shader->info.base.file_mask[TGSI_FILE_SAMPLER_VIEW] & (1 << i)) {
-            lp_sampler_static_texture_state(&key->state[i].texture_state,
-                                            lp->sampler_views[PIPE_SHADER_FRAGMENT][i]);
+            lp_fs_static_texture_state(&key->state[i].texture_state,
+                                       lp->sampler_views[PIPE_SHADER_FRAGMENT][i]);
          }
       }
    }
@@ -3034,11 +3569,13 @@ make_variant_key(struct llvmpipe_context *lp,
       key->nr_sampler_views = key->nr_samplers;
       for(i = 0; i < key->nr_sampler_views; ++i) {
          if(shader->info.base.file_mask[TGSI_FILE_SAMPLER] & (1 << i)) {
-            lp_sampler_static_texture_state(&key->state[i].texture_state,
-                                            lp->sampler_views[PIPE_SHADER_FRAGMENT][i]);
+            lp_fs_static_texture_state(&key->state[i].texture_state,
+                                       lp->sampler_views[PIPE_SHADER_FRAGMENT][i]);
          }
       }
    }
+
+   canonicalize_variant_key(shader, key);
 }
 
 
@@ -3053,21 +3590,20 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
    struct lp_fragment_shader *shader = lp->fs;
    struct lp_fragment_shader_variant_key key;
    struct lp_fragment_shader_variant *variant = NULL;
-   struct lp_fs_variant_list_item *li;
+   unsigned hash_key;
 
    make_variant_key(lp, shader, &key);
 
-   /* Search the variants for one which matches the key */
-   li = first_elem(&shader->variants);
-   while(!at_end(&shader->variants, li)) {
-      if(memcmp(&li->base->key, &key, shader->variant_key_size) == 0) {
-         variant = li->base;
-         break;
-      }
-      li = next_elem(li);
-   }
+   /* Look up a variant which matches the key.  The key is the first member
+    * of the variant, so it can be compared in place.
+    */
+   hash_key = cso_construct_key(&key, shader->variant_key_size);
+   variant = cso_hash_find_data_from_template(shader->variant_hash, hash_key,
+                                              &key, shader->variant_key_size);
 
    if (variant) {
+      LP_COUNT(nr_fs_variant_hits);
+
       /* Move this variant to the head of the list to implement LRU
        * deletion of shader's when we have too many.
        */
@@ -3079,6 +3615,8 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
       unsigned i;
       unsigned variants_to_cull;
 
+      LP_COUNT(nr_fs_variant_misses);
+
       if (0) {
          debug_printf("%u variants,\t%u instrs,\t%u instrs/variant\n",
                       lp->nr_fs_variants,
@@ -3117,6 +3655,7 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
             assert(item);
             assert(item->base);
             llvmpipe_remove_shader_variant(lp, item->base);
+            LP_COUNT(nr_fs_variants_culled);
          }
       }
 
@@ -3134,6 +3673,8 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
 
       /* Put the new variant into the list */
       if (variant) {
+         variant->hash_key = hash_key;
+         cso_hash_insert(shader->variant_hash, hash_key, variant);
          insert_at_head(&shader->variants, &variant->list_item_local);
          insert_at_head(&lp->fs_variants_list, &variant->list_item_global);
          lp->nr_fs_variants++;
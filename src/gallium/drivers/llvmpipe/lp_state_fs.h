@@ -35,10 +35,12 @@
 #include "tgsi/tgsi_scan.h" /* for tgsi_shader_info */
 #include "gallivm/lp_bld_sample.h" /* for struct lp_sampler_static_state */
 #include "gallivm/lp_bld_tgsi.h" /* for lp_tgsi_info */
+#include "gallivm/lp_bld_shader_time.h" /* for lp_shader_time */
 #include "lp_bld_interp.h" /* for struct lp_shader_input */
 
 
 struct tgsi_token;
+struct cso_hash;
 struct lp_fragment_shader;
 
 
@@ -47,6 +49,19 @@ struct lp_fragment_shader;
 #define RAST_EDGE_TEST 1
 
 
+/**
+ * How a variant interacts with the conservative depth bounds kept by
+ * setup and the rasterizer (hierarchical z).
+ */
+enum lp_hiz_mode
+{
+   LP_HIZ_IGNORE,      /**< can't be culled, never raises depth values */
+   LP_HIZ_CULL,        /**< LESS/LEQUAL test on the interpolated z */
+   LP_HIZ_CULL_UPDATE, /**< as above, and writes every covered pixel */
+   LP_HIZ_INVALIDATE   /**< may raise depth values */
+};
+
+
 struct lp_sampler_static_state
 {
    /*
@@ -77,6 +92,9 @@ struct lp_fragment_shader_variant_key
    unsigned occlusion_count:1;
    unsigned resource_1d:1;
    unsigned depth_clamp:1;
+   unsigned multisample:1;      /* 4 samples per pixel, see lp_rast_sample_pos */
+   unsigned sample_coverage:1;  /* coverage and depth at the sample positions */
+   unsigned sample_mask:4;      /* samples which may be written */
 
    enum pipe_format zsbuf_format;
    enum pipe_format cbuf_format[PIPE_MAX_COLOR_BUFS];
@@ -98,6 +116,7 @@ struct lp_fragment_shader_variant
    struct lp_fragment_shader_variant_key key;
 
    boolean opaque;
+   enum lp_hiz_mode hiz_mode;
    uint8_t ps_inv_multiplier;
 
    struct gallivm_state *gallivm;
@@ -113,9 +132,15 @@ struct lp_fragment_shader_variant
    /* Total number of LLVM instructions generated */
    unsigned nr_instrs;
 
+   /* Per rasterizer thread shader time counters, or NULL */
+   struct lp_shader_time *time;
+
    struct lp_fs_variant_list_item list_item_global, list_item_local;
    struct lp_fragment_shader *shader;
 
+   /* Hash of the key, see lp_fragment_shader::variant_hash */
+   unsigned hash_key;
+
    /* For debugging/profiling purposes */
    unsigned no;
 };
@@ -130,6 +155,9 @@ struct lp_fragment_shader
 
    struct lp_fs_variant_list_item variants;
 
+   /** The variants, hashed by key */
+   struct cso_hash *variant_hash;
+
    struct draw_fragment_shader *draw_data;
 
    /* For debugging/profiling purposes */
@@ -153,5 +181,8 @@ llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
 boolean
 llvmpipe_rasterization_disabled(struct llvmpipe_context *lp);
 
+void
+llvmpipe_dump_shader_time(struct llvmpipe_context *lp);
+
 
 #endif /* LP_STATE_FS_H_ */
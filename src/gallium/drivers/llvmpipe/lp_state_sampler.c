@@ -142,6 +142,12 @@ llvmpipe_set_sampler_views(struct pipe_context *pipe,
        */
       pipe_sampler_view_release(pipe,
                                 &llvmpipe->sampler_views[shader][start + i]);
+
+      /* the draw module only samples linear textures */
+      if (views[i] && shader != PIPE_SHADER_FRAGMENT &&
+          llvmpipe_resource_is_texture(views[i]->texture))
+         llvmpipe_resource_untile(pipe, llvmpipe_resource(views[i]->texture));
+
       pipe_sampler_view_reference(&llvmpipe->sampler_views[shader][start + i],
                                   views[i]);
    }
@@ -242,6 +248,9 @@ prepare_shader_sampling(
           */
          pipe_resource_reference(&mapped_tex[i], tex);
 
+         /* vertices are shaded right away, unlike fragments */
+         llvmpipe_resource_resolve_clears(lp_tex);
+
          if (!lp_tex->dt) {
             /* regular texture - setup array of mipmap level offsets */
             struct pipe_resource *res = view->texture;
@@ -25,6 +25,11 @@
  * 
  **************************************************************************/
 
+#include "pipe/p_config.h"
+#include "util/u_box.h"
+#include "util/u_format.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
 #include "util/u_rect.h"
 #include "util/u_surface.h"
 #include "lp_context.h"
@@ -34,6 +39,10 @@
 #include "lp_texture.h"
 #include "lp_query.h"
 
+#if defined(PIPE_ARCH_SSE)
+#include <emmintrin.h>
+#endif
+
 
 /**
  * Adjust x, y, width, height to lie on tile bounds.
@@ -64,7 +73,8 @@ lp_resource_copy(struct pipe_context *pipe,
    unsigned width = src_box->width;
    unsigned height = src_box->height;
    unsigned depth = src_box->depth;
-   unsigned z;
+   unsigned nr_samples = MAX2(src->nr_samples, 1);
+   unsigned z, s;
 
    llvmpipe_flush_resource(pipe,
                            dst, dst_level,
@@ -80,6 +90,12 @@ lp_resource_copy(struct pipe_context *pipe,
                            FALSE, /* do_not_block */
                            "blit src");
 
+   llvmpipe_resource_resolve_clears(dst_tex);
+   llvmpipe_resource_resolve_clears(src_tex);
+
+   llvmpipe_resource_untile(pipe, dst_tex);
+   llvmpipe_resource_untile(pipe, src_tex);
+
    /* Fallback for buffers. */
    if (dst->target == PIPE_BUFFER && src->target == PIPE_BUFFER) {
       util_resource_copy_region(pipe, dst, dst_level, dstx, dsty, dstz,
@@ -87,6 +103,12 @@ lp_resource_copy(struct pipe_context *pipe,
       return;
    }
 
+   {
+      struct pipe_box dst_box;
+      u_box_2d(dstx, dsty, width, height, &dst_box);
+      llvmpipe_resource_damage(dst_tex, &dst_box);
+   }
+
    /*
    printf("surface copy from %u lvl %u to %u lvl %u: %u,%u,%u to %u,%u,%u %u x %u x %u\n",
           src_tex->id, src_level, dst_tex->id, dst_level,
@@ -159,13 +181,18 @@ lp_resource_copy(struct pipe_context *pipe,
          = llvmpipe_get_texture_image_address(dst_tex, dstz,
                                               dst_level);
 
-      if (dst_linear_ptr && src_linear_ptr) {
-         util_copy_box(dst_linear_ptr, format,
+      /* multisampled resources are copied sample by sample */
+      if (MAX2(dst->nr_samples, 1) != nr_samples) {
+         nr_samples = 1;
+      }
+
+      for (s = 0; s < nr_samples && dst_linear_ptr && src_linear_ptr; s++) {
+         util_copy_box(dst_linear_ptr + s * dst_tex->sample_stride, format,
                        llvmpipe_resource_stride(&dst_tex->base, dst_level),
                        dst_tex->img_stride[dst_level],
                        dstx, dsty, 0,
                        width, height, depth,
-                       src_linear_ptr,
+                       src_linear_ptr + s * src_tex->sample_stride,
                        llvmpipe_resource_stride(&src_tex->base, src_level),
                        src_tex->img_stride[src_level],
                        src_box->x, src_box->y, 0);
@@ -174,6 +201,253 @@ lp_resource_copy(struct pipe_context *pipe,
 }
 
 
+/**
+ * Average a row of 8-bit unorm texels over the LP_MAX_SAMPLES sample
+ * planes, rounding to nearest.
+ */
+static void
+resolve_row_8unorm(uint8_t *dst, const uint8_t *src, unsigned sample_stride,
+                   unsigned bytes)
+{
+   const uint8_t *s0 = src;
+   const uint8_t *s1 = src + sample_stride;
+   const uint8_t *s2 = src + 2 * sample_stride;
+   const uint8_t *s3 = src + 3 * sample_stride;
+   unsigned i = 0;
+
+#if defined(PIPE_ARCH_SSE)
+   {
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i two = _mm_set1_epi16(2);
+
+      for (; i + 16 <= bytes; i += 16) {
+         __m128i a = _mm_loadu_si128((const __m128i *)(s0 + i));
+         __m128i b = _mm_loadu_si128((const __m128i *)(s1 + i));
+         __m128i c = _mm_loadu_si128((const __m128i *)(s2 + i));
+         __m128i d = _mm_loadu_si128((const __m128i *)(s3 + i));
+         __m128i lo, hi;
+
+         lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero),
+                            _mm_unpacklo_epi8(b, zero));
+         lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(c, zero));
+         lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(d, zero));
+         lo = _mm_srli_epi16(_mm_add_epi16(lo, two), 2);
+
+         hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero),
+                            _mm_unpackhi_epi8(b, zero));
+         hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(c, zero));
+         hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(d, zero));
+         hi = _mm_srli_epi16(_mm_add_epi16(hi, two), 2);
+
+         _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+      }
+   }
+#endif
+
+   for (; i < bytes; i++) {
+      dst[i] = (s0[i] + s1[i] + s2[i] + s3[i] + 2) >> 2;
+   }
+}
+
+
+/**
+ * Resolve a multisampled color resource by averaging the samples of each
+ * pixel.  Only unscaled, unflipped blits between the same formats are
+ * handled, anything else is left to the caller.
+ */
+static boolean
+lp_resolve_color(struct pipe_context *pipe,
+                 const struct pipe_blit_info *info)
+{
+   struct llvmpipe_resource *src_tex = llvmpipe_resource(info->src.resource);
+   struct llvmpipe_resource *dst_tex = llvmpipe_resource(info->dst.resource);
+   const enum pipe_format format = info->src.format;
+   const struct util_format_description *desc = util_format_description(format);
+   const unsigned width = info->src.box.width;
+   const unsigned height = info->src.box.height;
+   const unsigned bpp = util_format_get_blocksize(format);
+   const unsigned sample_stride = src_tex->sample_stride;
+   unsigned src_stride, dst_stride;
+   const uint8_t *src_map;
+   uint8_t *dst_map;
+   float *tmp = NULL;
+   unsigned y, s;
+
+   if (info->dst.format != format ||
+       info->src.resource->format != format ||
+       info->dst.resource->format != format ||
+       info->src.resource->nr_samples != LP_MAX_SAMPLES ||
+       info->src.box.width <= 0 ||
+       info->src.box.height <= 0 ||
+       info->src.box.depth != 1 ||
+       info->dst.box.width != info->src.box.width ||
+       info->dst.box.height != info->src.box.height ||
+       info->dst.box.depth != 1 ||
+       info->src.level != 0 ||
+       info->src.box.z != 0 ||
+       (info->mask & PIPE_MASK_RGBA) != PIPE_MASK_RGBA ||
+       info->scissor_enable ||
+       desc->layout != UTIL_FORMAT_LAYOUT_PLAIN ||
+       desc->block.width != 1 || desc->block.height != 1) {
+      return FALSE;
+   }
+
+   llvmpipe_flush_resource(pipe, info->dst.resource, info->dst.level,
+                           FALSE, /* read_only */
+                           TRUE, /* cpu_access */
+                           FALSE, /* do_not_block */
+                           "resolve dest");
+   llvmpipe_flush_resource(pipe, info->src.resource, info->src.level,
+                           TRUE, /* read_only */
+                           TRUE, /* cpu_access */
+                           FALSE, /* do_not_block */
+                           "resolve src");
+
+   llvmpipe_resource_resolve_clears(dst_tex);
+   llvmpipe_resource_resolve_clears(src_tex);
+   llvmpipe_resource_untile(pipe, dst_tex);
+
+   src_map = llvmpipe_resource_map(info->src.resource, 0, 0,
+                                   LP_TEX_USAGE_READ);
+   dst_map = llvmpipe_resource_map(info->dst.resource, info->dst.level,
+                                   info->dst.box.z, LP_TEX_USAGE_READ_WRITE);
+   if (!src_map || !dst_map) {
+      goto out;
+   }
+
+   llvmpipe_resource_damage(dst_tex, &info->dst.box);
+
+   src_stride = llvmpipe_resource_stride(info->src.resource, 0);
+   dst_stride = llvmpipe_resource_stride(info->dst.resource, info->dst.level);
+   src_map += info->src.box.y * src_stride + info->src.box.x * bpp;
+   dst_map += info->dst.box.y * dst_stride + info->dst.box.x * bpp;
+
+   if (util_format_is_rgba8_variant(desc) &&
+       desc->colorspace != UTIL_FORMAT_COLORSPACE_SRGB) {
+      for (y = 0; y < height; y++) {
+         resolve_row_8unorm(dst_map + y * dst_stride,
+                            src_map + y * src_stride,
+                            sample_stride, width * bpp);
+      }
+      goto out;
+   }
+
+   /* everything else is averaged in linear float */
+   tmp = MALLOC(2 * width * 4 * sizeof *tmp);
+   if (!tmp) {
+      goto out;
+   }
+
+   for (y = 0; y < height; y++) {
+      float *sum = tmp;
+      float *sample = tmp + width * 4;
+      unsigned i;
+
+      memset(sum, 0, width * 4 * sizeof *sum);
+      for (s = 0; s < LP_MAX_SAMPLES; s++) {
+         desc->unpack_rgba_float(sample, 0,
+                                 src_map + s * sample_stride + y * src_stride,
+                                 0, width, 1);
+         for (i = 0; i < width * 4; i++) {
+            sum[i] += sample[i];
+         }
+      }
+      for (i = 0; i < width * 4; i++) {
+         sum[i] *= 1.0f / LP_MAX_SAMPLES;
+      }
+      desc->pack_rgba_float(dst_map + y * dst_stride, 0, sum, 0, width, 1);
+   }
+
+   FREE(tmp);
+
+out:
+   if (src_map)
+      llvmpipe_resource_unmap(info->src.resource, 0, 0);
+   if (dst_map)
+      llvmpipe_resource_unmap(info->dst.resource, info->dst.level,
+                              info->dst.box.z);
+   return TRUE;
+}
+
+
+/**
+ * Copy sample 0 of the source box of a multisampled blit into a new single
+ * sampled texture, and point the blit at it, so that the resolves which
+ * lp_resolve_color() doesn't handle (scissored, converting, integer or
+ * depth/stencil) can go through the regular blit paths.
+ * Returns the new texture, or NULL on failure.
+ */
+static struct pipe_resource *
+lp_resolve_sample0(struct pipe_context *pipe,
+                   struct pipe_blit_info *info)
+{
+   struct pipe_resource *src = info->src.resource;
+   const enum pipe_format format = src->format;
+   struct pipe_resource templ, *tmp;
+   int x0 = MIN2(info->src.box.x, info->src.box.x + info->src.box.width);
+   int y0 = MIN2(info->src.box.y, info->src.box.y + info->src.box.height);
+   unsigned width = abs(info->src.box.width);
+   unsigned height = abs(info->src.box.height);
+   const uint8_t *src_map;
+   uint8_t *tmp_map;
+
+   if (info->src.box.depth != 1 || width == 0 || height == 0) {
+      return NULL;
+   }
+
+   memset(&templ, 0, sizeof templ);
+   templ.target = PIPE_TEXTURE_2D;
+   templ.format = format;
+   templ.width0 = width;
+   templ.height0 = height;
+   templ.depth0 = 1;
+   templ.array_size = 1;
+   templ.usage = PIPE_USAGE_DEFAULT;
+   templ.bind = PIPE_BIND_SAMPLER_VIEW;
+
+   tmp = pipe->screen->resource_create(pipe->screen, &templ);
+   if (!tmp) {
+      return NULL;
+   }
+
+   llvmpipe_flush_resource(pipe, src, info->src.level,
+                           TRUE, /* read_only */
+                           TRUE, /* cpu_access */
+                           FALSE, /* do_not_block */
+                           "resolve src");
+   llvmpipe_resource_resolve_clears(llvmpipe_resource(src));
+
+   src_map = llvmpipe_resource_map(src, info->src.level, info->src.box.z,
+                                   LP_TEX_USAGE_READ);
+   tmp_map = llvmpipe_resource_map(tmp, 0, 0, LP_TEX_USAGE_WRITE_ALL);
+   if (src_map && tmp_map) {
+      /* sample 0 is the first image of the sample planes */
+      util_copy_rect(tmp_map, format,
+                     llvmpipe_resource_stride(tmp, 0), 0, 0,
+                     width, height,
+                     src_map, llvmpipe_resource_stride(src, info->src.level),
+                     x0, y0);
+   }
+   if (src_map)
+      llvmpipe_resource_unmap(src, info->src.level, info->src.box.z);
+   if (tmp_map)
+      llvmpipe_resource_unmap(tmp, 0, 0);
+
+   if (!src_map || !tmp_map) {
+      pipe_resource_reference(&tmp, NULL);
+      return NULL;
+   }
+
+   info->src.resource = tmp;
+   info->src.level = 0;
+   info->src.box.x -= x0;
+   info->src.box.y -= y0;
+   info->src.box.z = 0;
+
+   return tmp;
+}
+
+
 static void lp_blit(struct pipe_context *pipe,
                     const struct pipe_blit_info *blit_info)
 {
@@ -181,10 +455,26 @@ static void lp_blit(struct pipe_context *pipe,
    struct pipe_blit_info info = *blit_info;
 
    if (info.src.resource->nr_samples > 1 &&
-       info.dst.resource->nr_samples <= 1 &&
-       !util_format_is_depth_or_stencil(info.src.resource->format) &&
-       !util_format_is_pure_integer(info.src.resource->format)) {
-      debug_printf("llvmpipe: color resolve unimplemented\n");
+       info.dst.resource->nr_samples <= 1) {
+      struct pipe_resource *tmp;
+
+      if (!util_format_is_depth_or_stencil(info.src.resource->format) &&
+          !util_format_is_pure_integer(info.src.resource->format) &&
+          lp_resolve_color(pipe, &info)) {
+         return;
+      }
+
+      /* Take sample 0 for everything else. */
+      tmp = lp_resolve_sample0(pipe, &info);
+      if (!tmp) {
+         debug_printf("llvmpipe: resolve of %s -> %s failed\n",
+                      util_format_short_name(info.src.format),
+                      util_format_short_name(info.dst.format));
+         return;
+      }
+
+      lp_blit(pipe, &info);
+      pipe_resource_reference(&tmp, NULL);
       return;
    }
 
@@ -249,6 +539,10 @@ llvmpipe_create_surface(struct pipe_context *pipe,
    if (!(pt->bind & (PIPE_BIND_DEPTH_STENCIL | PIPE_BIND_RENDER_TARGET)))
       debug_printf("Illegal surface creation without bind flag\n");
 
+   /* the rasterizer only writes linear images */
+   if (llvmpipe_resource_is_texture(pt))
+      llvmpipe_resource_untile(pipe, llvmpipe_resource(pt));
+
    ps = CALLOC_STRUCT(pipe_surface);
    if (ps) {
       pipe_reference_init(&ps->reference, 1);
@@ -0,0 +1,818 @@
+/**************************************************************************
+ *
+ * Copyright 2013 agent <agent@local>
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * @file
+ * Unit tests and benchmark for triangle rasterization.
+ *
+ * Random triangles from several size distributions are set up and binned
+ * the same way lp_setup_tri.c does it, and the binned commands are then
+ * run through the rasterizer's triangle functions with a fragment shader
+ * which only records the coverage masks.  The AVX2 paths, when available,
+ * are checked against the default ones and both are timed.
+ *
+ * Besides the three edges, the triangles get up to four scissor planes
+ * and an extra edge, so that every plane count is exercised.
+ *
+ * The multisampled paths are checked against the coverage of each sample
+ * computed directly from the planes, with the edge test shader also used
+ * for whole blocks, as it is for shaders which aren't opaque.
+ */
+
+
+#include "util/u_memory.h"
+#include "util/u_math.h"
+#include "util/u_rect.h"
+#include "util/u_cpu_detect.h"
+#include "lp_rast_priv.h"
+#include "lp_scene.h"
+#include "lp_state_fs.h"
+#include "lp_test.h"
+
+
+/** Size of the fake framebuffer, in pixels */
+#define FB_SIZE 2048
+
+/** Largest number of planes of a triangle: 3 edges, 4 scissor, 1 extra */
+#define MAX_TEST_PLANES 8
+
+
+struct rast_dist
+{
+   const char *name;
+   unsigned min_size;   /**< smallest triangle extent, in pixels */
+   unsigned max_size;   /**< largest triangle extent, in pixels */
+   unsigned num_tris;
+};
+
+
+/*
+ * Triangles up to MAX_FIXED_LENGTH32 pixels take the 32-bit paths, the
+ * larger ones the 64-bit paths.
+ */
+static const struct rast_dist rast_dists[] = {
+   { "tiny",      1,    4, 4096 },
+   { "small",     4,   16, 4096 },
+   { "medium",   16,   64, 1024 },
+   { "large",    64,  128,  512 },
+   { "huge",    128, 1024,   64 },
+};
+
+
+struct rast_cmd
+{
+   unsigned op;
+   unsigned x, y;       /**< tile position in pixels */
+   union lp_rast_cmd_arg arg;
+};
+
+
+struct rast_bins
+{
+   struct rast_cmd *cmds;
+   unsigned num_cmds;
+   unsigned max_cmds;
+};
+
+
+/** Coverage counters, one per pixel, or NULL when timing */
+static uint8_t *coverage = NULL;
+static unsigned num_quads = 0;
+
+/** Samples per pixel, i.e. number of 16 bit masks passed to the shader */
+static unsigned num_samples = 1;
+
+
+static void
+rast_test_fs(const struct lp_jit_context *context,
+             uint32_t x,
+             uint32_t y,
+             uint32_t facing,
+             const void *a0,
+             const void *dadx,
+             const void *dady,
+             uint8_t **color,
+             uint8_t *depth,
+             uint64_t mask,
+             struct lp_jit_thread_data *thread_data,
+             unsigned *stride,
+             unsigned depth_stride,
+             unsigned *sample_stride,
+             unsigned depth_sample_stride)
+{
+   unsigned i, s;
+
+   num_quads++;
+
+   if (!coverage)
+      return;
+
+   for (s = 0; s < num_samples; s++) {
+      for (i = 0; i < 16; i++) {
+         if (mask & ((uint64_t)1 << (16 * s + i)))
+            coverage[(y + (i >> 2)) * FB_SIZE + x + (i & 3)]++;
+      }
+   }
+}
+
+
+static void
+write_tsv_row(FILE *fp,
+              const struct rast_dist *dist,
+              unsigned nr_planes,
+              const char *path,
+              double cycles,
+              boolean success)
+{
+   fprintf(fp, "%s\t", success ? "pass" : "fail");
+
+   fprintf(fp, "%.1f\t", cycles / dist->num_tris);
+
+   fprintf(fp, "%s\t%u\t%s\n", dist->name, nr_planes, path);
+
+   fflush(fp);
+}
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "cycles_per_triangle\t"
+           "distribution\t"
+           "planes\t"
+           "path\n");
+
+   fflush(fp);
+}
+
+
+static INLINE int
+floor_pot(unsigned n)
+{
+   return n ? 1 << util_logbase2(n) : 0;
+}
+
+
+static void
+bin_cmd(struct rast_bins *bins,
+        unsigned op, unsigned tx, unsigned ty,
+        union lp_rast_cmd_arg arg)
+{
+   struct rast_cmd *cmd;
+
+   if (bins->num_cmds == bins->max_cmds) {
+      unsigned max_cmds = MAX2(bins->max_cmds * 2, 1024);
+      bins->cmds = REALLOC(bins->cmds,
+                           bins->max_cmds * sizeof *bins->cmds,
+                           max_cmds * sizeof *bins->cmds);
+      bins->max_cmds = max_cmds;
+   }
+
+   cmd = &bins->cmds[bins->num_cmds++];
+   cmd->op = op;
+   cmd->x = tx * TILE_SIZE;
+   cmd->y = ty * TILE_SIZE;
+   cmd->arg = arg;
+}
+
+
+/**
+ * Same as lp_setup_bin_triangle().  Fully covered tiles are not binned,
+ * as they involve no edge tests, except when multisampling, where they
+ * are binned with all planes so that whole blocks get shaded.
+ */
+static void
+bin_triangle(struct rast_bins *bins,
+             const struct lp_rast_triangle *tri,
+             unsigned nr_planes,
+             boolean multisample,
+             const struct u_rect *bbox)
+{
+   const struct lp_rast_plane *plane = GET_PLANES(tri);
+   int dx = floor_pot((bbox->x0 ^ bbox->x1) |
+                      (bbox->y0 ^ bbox->y1));
+   int max_sz = ((bbox->x1 - (bbox->x0 & ~3)) |
+                 (bbox->y1 - (bbox->y0 & ~3)));
+   int sz = floor_pot(max_sz);
+   boolean use_32bits = max_sz <= MAX_FIXED_LENGTH32;
+   int ix0 = bbox->x0 / TILE_SIZE;
+   int iy0 = bbox->y0 / TILE_SIZE;
+   int ix1 = bbox->x1 / TILE_SIZE;
+   int iy1 = bbox->y1 / TILE_SIZE;
+   int x, y, i;
+
+   if (dx < TILE_SIZE) {
+      unsigned px = bbox->x0 & 63 & ~3;
+      unsigned py = bbox->y0 & 63 & ~3;
+
+      if (multisample) {
+         bin_cmd(bins, LP_RAST_OP_TRIANGLE_MS_1 + nr_planes - 1,
+                 ix0, iy0, lp_rast_arg_triangle(tri, (1 << nr_planes) - 1));
+      }
+      else if (nr_planes == 3 && sz < 4) {
+         bin_cmd(bins,
+                 use_32bits ? LP_RAST_OP_TRIANGLE_32_3_4 :
+                              LP_RAST_OP_TRIANGLE_3_4,
+                 ix0, iy0, lp_rast_arg_triangle_contained(tri, px, py));
+      }
+      else if (nr_planes == 3 && sz < 16) {
+         px = MIN2(px, TILE_SIZE - 16);
+         py = MIN2(py, TILE_SIZE - 16);
+         bin_cmd(bins,
+                 use_32bits ? LP_RAST_OP_TRIANGLE_32_3_16 :
+                              LP_RAST_OP_TRIANGLE_3_16,
+                 ix0, iy0, lp_rast_arg_triangle_contained(tri, px, py));
+      }
+      else if (nr_planes == 4 && sz < 16) {
+         px = MIN2(px, TILE_SIZE - 16);
+         py = MIN2(py, TILE_SIZE - 16);
+         bin_cmd(bins,
+                 use_32bits ? LP_RAST_OP_TRIANGLE_32_4_16 :
+                              LP_RAST_OP_TRIANGLE_4_16,
+                 ix0, iy0, lp_rast_arg_triangle_contained(tri, px, py));
+      }
+      else {
+         bin_cmd(bins,
+                 (use_32bits ? LP_RAST_OP_TRIANGLE_32_1 :
+                               LP_RAST_OP_TRIANGLE_1) + nr_planes - 1,
+                 ix0, iy0, lp_rast_arg_triangle(tri, (1 << nr_planes) - 1));
+      }
+      return;
+   }
+
+   for (y = iy0; y <= iy1; y++) {
+      for (x = ix0; x <= ix1; x++) {
+         int out = 0;
+         int partial = 0;
+
+         for (i = 0; i < nr_planes; i++) {
+            int64_t c = (plane[i].c +
+                         IMUL64(plane[i].dcdy, y) * TILE_SIZE -
+                         IMUL64(plane[i].dcdx, x) * TILE_SIZE);
+            int64_t ei = (int64_t)(plane[i].dcdy -
+                                   plane[i].dcdx -
+                                   plane[i].eo) << TILE_ORDER;
+            int64_t eo = plane[i].eo << TILE_ORDER;
+
+            if (multisample) {
+               int64_t lo, hi;
+               lp_rast_sample_offset_range(&plane[i], &lo, &hi);
+               ei += lo;
+               eo += hi;
+            }
+
+            out |= (c + eo) >> 63;
+            partial |= ((c + ei - 1) >> 63) & (1 << i);
+         }
+
+         if (!out && multisample) {
+            if (!partial)
+               partial = (1 << nr_planes) - 1;
+            bin_cmd(bins,
+                    LP_RAST_OP_TRIANGLE_MS_1 + util_bitcount(partial) - 1,
+                    x, y, lp_rast_arg_triangle(tri, partial));
+         }
+         else if (!out && partial) {
+            unsigned count = util_bitcount(partial);
+            bin_cmd(bins,
+                    (use_32bits ? LP_RAST_OP_TRIANGLE_32_1 :
+                                  LP_RAST_OP_TRIANGLE_1) + count - 1,
+                    x, y, lp_rast_arg_triangle(tri, partial));
+         }
+      }
+   }
+}
+
+
+/**
+ * Set up the plane of the edge from (x0, y0) to (x1, y1), in fixed point,
+ * as do_triangle_ccw() does.
+ */
+static void
+edge_plane(struct lp_rast_plane *plane, int x0, int y0, int x1, int y1)
+{
+   plane->dcdy = x0 - x1;
+   plane->dcdx = y0 - y1;
+   plane->c = (IMUL64(plane->dcdx, x0) -
+               IMUL64(plane->dcdy, y0));
+
+   /* top-left fill convention */
+   if (plane->dcdx < 0 ||
+       (plane->dcdx == 0 && plane->dcdy > 0))
+      plane->c++;
+
+   plane->dcdx <<= FIXED_ORDER;
+   plane->dcdy <<= FIXED_ORDER;
+
+   plane->eo = 0;
+   if (plane->dcdx < 0) plane->eo -= plane->dcdx;
+   if (plane->dcdy > 0) plane->eo += plane->dcdy;
+}
+
+
+/**
+ * Build a random counter-clockwise triangle within a size x size square,
+ * with the planes computed as in do_triangle_ccw().  Planes past the
+ * third are the left, right, top and bottom scissor planes of a random
+ * rectangle overlapping the triangle, then an edge between two random
+ * points of its bounding box.
+ */
+static struct lp_rast_triangle *
+random_triangle(unsigned size, unsigned nr_planes, struct u_rect *bbox)
+{
+   struct lp_rast_triangle *tri;
+   struct lp_rast_plane *plane;
+   struct lp_rast_plane extra[MAX_TEST_PLANES - 3];
+   struct u_rect scissor;
+   int x[3], y[3];
+   int64_t area;
+   int ox, oy, w, h;
+   int i;
+
+   ox = rand() % (FB_SIZE - size);
+   oy = rand() % (FB_SIZE - size);
+
+   do {
+      for (i = 0; i < 3; i++) {
+         x[i] = (ox << FIXED_ORDER) + rand() % (size << FIXED_ORDER);
+         y[i] = (oy << FIXED_ORDER) + rand() % (size << FIXED_ORDER);
+      }
+
+      area = (IMUL64(x[0] - x[1], y[2] - y[0]) -
+              IMUL64(x[2] - x[0], y[0] - y[1]));
+      if (area < 0) {
+         int tmp;
+         tmp = x[1]; x[1] = x[2]; x[2] = tmp;
+         tmp = y[1]; y[1] = y[2]; y[2] = tmp;
+         area = -area;
+      }
+
+      bbox->x0 = MIN3(x[0], x[1], x[2]) >> FIXED_ORDER;
+      bbox->x1 = (MAX3(x[0], x[1], x[2]) - 1) >> FIXED_ORDER;
+      bbox->y0 = MIN3(y[0], y[1], y[2]) >> FIXED_ORDER;
+      bbox->y1 = (MAX3(y[0], y[1], y[2]) - 1) >> FIXED_ORDER;
+   } while (area == 0 || bbox->x1 < bbox->x0 || bbox->y1 < bbox->y0);
+
+   tri = align_malloc(sizeof *tri + nr_planes * sizeof *plane, 16);
+   memset(tri, 0, sizeof *tri);
+   plane = GET_PLANES(tri);
+
+   for (i = 0; i < 3; i++) {
+      int j = (i + 1) % 3;
+      edge_plane(&plane[i], x[i], y[i], x[j], y[j]);
+   }
+
+   /* Trim up to a quarter of the bounding box on each side. */
+   w = bbox->x1 - bbox->x0 + 1;
+   h = bbox->y1 - bbox->y0 + 1;
+   scissor.x0 = bbox->x0 + rand() % (w / 4 + 1);
+   scissor.x1 = bbox->x1 - rand() % (w / 4 + 1);
+   scissor.y0 = bbox->y0 + rand() % (h / 4 + 1);
+   scissor.y1 = bbox->y1 - rand() % (h / 4 + 1);
+
+   /* Same as in do_triangle_ccw() */
+   extra[0].dcdx = -1;
+   extra[0].dcdy = 0;
+   extra[0].c = 1-scissor.x0;
+   extra[0].eo = 1;
+
+   extra[1].dcdx = 1;
+   extra[1].dcdy = 0;
+   extra[1].c = scissor.x1+1;
+   extra[1].eo = 0;
+
+   extra[2].dcdx = 0;
+   extra[2].dcdy = 1;
+   extra[2].c = 1-scissor.y0;
+   extra[2].eo = 1;
+
+   extra[3].dcdx = 0;
+   extra[3].dcdy = -1;
+   extra[3].c = scissor.y1+1;
+   extra[3].eo = 0;
+
+   edge_plane(&extra[4],
+              (bbox->x0 << FIXED_ORDER) + rand() % (w << FIXED_ORDER),
+              (bbox->y0 << FIXED_ORDER) + rand() % (h << FIXED_ORDER),
+              (bbox->x0 << FIXED_ORDER) + rand() % (w << FIXED_ORDER),
+              (bbox->y0 << FIXED_ORDER) + rand() % (h << FIXED_ORDER));
+
+   for (i = 3; i < nr_planes; i++)
+      plane[i] = extra[i - 3];
+
+   return tri;
+}
+
+
+static void
+rasterize(struct lp_rasterizer_task *task,
+          const lp_rast_cmd_func *dispatch,
+          const struct rast_bins *bins)
+{
+   unsigned i;
+
+   for (i = 0; i < bins->num_cmds; i++) {
+      const struct rast_cmd *cmd = &bins->cmds[i];
+      task->x = cmd->x;
+      task->y = cmd->y;
+      dispatch[cmd->op](task, cmd->arg);
+   }
+}
+
+
+/**
+ * Average the cycle counts, leaving out the outliers.
+ */
+static double
+average_cycles(const int64_t *cycles, unsigned n)
+{
+   double sum = 0.0, sum2 = 0.0;
+   double avg, std;
+   unsigned i, m;
+
+   for (i = 0; i < n; ++i) {
+      sum += cycles[i];
+      sum2 += cycles[i]*cycles[i];
+   }
+
+   avg = sum/n;
+   std = sqrtf((sum2 - n*avg*avg)/n);
+
+   m = 0;
+   sum = 0.0;
+   for (i = 0; i < n; ++i) {
+      if (fabs(cycles[i] - avg) <= 4.0*std) {
+         sum += cycles[i];
+         ++m;
+      }
+   }
+
+   return sum/m;
+}
+
+
+static double
+time_rasterize(struct lp_rasterizer_task *task,
+               const lp_rast_cmd_func *dispatch,
+               const struct rast_bins *bins)
+{
+   int64_t cycles[LP_TEST_NUM_SAMPLES];
+   unsigned i;
+
+   for (i = 0; i < LP_TEST_NUM_SAMPLES; i++) {
+      int64_t start_counter = rdtsc();
+      rasterize(task, dispatch, bins);
+      cycles[i] = rdtsc() - start_counter;
+   }
+
+   return average_cycles(cycles, LP_TEST_NUM_SAMPLES);
+}
+
+
+PIPE_ALIGN_STACK
+static boolean
+test_one(unsigned verbose,
+         FILE *fp,
+         const struct rast_dist *dist,
+         unsigned nr_planes)
+{
+   PIPE_ALIGN_VAR(16) uint8_t blend_color[16];
+   lp_rast_cmd_func ref_dispatch[LP_RAST_OP_MAX];
+   struct lp_fragment_shader_variant *variant;
+   struct lp_scene *scene;
+   struct lp_rast_state state;
+   struct lp_rasterizer_task task;
+   struct lp_rast_triangle **tris;
+   struct rast_bins bins;
+   uint8_t *ref_coverage;
+   unsigned ref_quads;
+   double cycles;
+   boolean success = TRUE;
+   unsigned i;
+
+   memset(ref_dispatch, 0, sizeof ref_dispatch);
+   ref_dispatch[LP_RAST_OP_TRIANGLE_1] = lp_rast_triangle_1;
+   ref_dispatch[LP_RAST_OP_TRIANGLE_2] = lp_rast_triangle_2;
+   ref_dispatch[LP_RAST_OP_TRIANGLE_3] = lp_rast_triangle_3;
+   ref_dispatch[LP_RAST_OP_TRIANGLE_4] = lp_rast_triangle_4;
+   ref_dispatch[LP_RAST_OP_TRIANGLE_5] = lp_rast_triangle_5;
+   ref_dispatch[LP_RAST_OP_TRIANGLE_6] = lp_rast_triangle_6;
+   ref_dispatch[LP_RAST_OP_TRIANGLE_7] = lp_rast_triangle_7;
+   ref_dispatch[LP_RAST_OP_TRIANGLE_8] = lp_rast_triangle_8;
+   ref_dispatch[LP_RAST_OP_TRIANGLE_3_4] = lp_rast_triangle_3_4;
+   ref_dispatch[LP_RAST_OP_TRIANGLE_3_16] = lp_rast_triangle_3_16;
+   ref_dispatch[LP_RAST_OP_TRIANGLE_4_16] = lp_rast_triangle_4_16;
+   ref_dispatch[LP_RAST_OP_TRIANGLE_32_1] = lp_rast_triangle_32_1;
+   ref_dispatch[LP_RAST_OP_TRIANGLE_32_2] = lp_rast_triangle_32_2;
+   ref_dispatch[LP_RAST_OP_TRIANGLE_32_3] = lp_rast_triangle_32_3;
+   ref_dispatch[LP_RAST_OP_TRIANGLE_32_4] = lp_rast_triangle_32_4;
+   ref_dispatch[LP_RAST_OP_TRIANGLE_32_5] = lp_rast_triangle_32_5;
+   ref_dispatch[LP_RAST_OP_TRIANGLE_32_6] = lp_rast_triangle_32_6;
+   ref_dispatch[LP_RAST_OP_TRIANGLE_32_7] = lp_rast_triangle_32_7;
+   ref_dispatch[LP_RAST_OP_TRIANGLE_32_8] = lp_rast_triangle_32_8;
+   ref_dispatch[LP_RAST_OP_TRIANGLE_32_3_4] = lp_rast_triangle_32_3_4;
+   ref_dispatch[LP_RAST_OP_TRIANGLE_32_3_16] = lp_rast_triangle_32_3_16;
+   ref_dispatch[LP_RAST_OP_TRIANGLE_32_4_16] = lp_rast_triangle_32_4_16;
+
+   if (verbose >= 1)
+      fprintf(stderr, "%s triangles (%u-%u pixels), %u planes ...\n",
+              dist->name, dist->min_size, dist->max_size, nr_planes);
+
+   variant = CALLOC_STRUCT(lp_fragment_shader_variant);
+   variant->jit_function[RAST_WHOLE] = rast_test_fs;
+   variant->jit_function[RAST_EDGE_TEST] = rast_test_fs;
+   variant->ps_inv_multiplier = 1;
+
+   memset(&state, 0, sizeof state);
+   memset(blend_color, 0, sizeof blend_color);
+   state.jit_context.u8_blend_color = blend_color;
+   state.variant = variant;
+
+   scene = CALLOC_STRUCT(lp_scene);
+   scene->tiles_x = FB_SIZE / TILE_SIZE;
+   scene->tiles_y = FB_SIZE / TILE_SIZE;
+   scene->nr_samples = 1;
+
+   memset(&task, 0, sizeof task);
+   task.scene = scene;
+   task.state = &state;
+   task.width = TILE_SIZE;
+   task.height = TILE_SIZE;
+
+   memset(&bins, 0, sizeof bins);
+   tris = CALLOC(dist->num_tris, sizeof *tris);
+   for (i = 0; i < dist->num_tris; i++) {
+      unsigned size = dist->min_size +
+                      rand() % (dist->max_size - dist->min_size + 1);
+      struct u_rect bbox;
+
+      tris[i] = random_triangle(size, nr_planes, &bbox);
+      bin_triangle(&bins, tris[i], nr_planes, FALSE, &bbox);
+   }
+
+   ref_coverage = CALLOC(FB_SIZE * FB_SIZE, 1);
+   coverage = ref_coverage;
+   num_quads = 0;
+   rasterize(&task, ref_dispatch, &bins);
+   ref_quads = num_quads;
+   coverage = NULL;
+
+   cycles = time_rasterize(&task, ref_dispatch, &bins);
+   if (fp)
+      write_tsv_row(fp, dist, nr_planes, "default", cycles, TRUE);
+   if (verbose >= 1)
+      fprintf(stderr, "%-8s %u %8.1f cycles/triangle default\n",
+              dist->name, nr_planes, cycles / dist->num_tris);
+
+#ifdef USE_AVX2
+   if (util_cpu_caps.has_avx2) {
+      lp_rast_cmd_func avx2_dispatch[LP_RAST_OP_MAX];
+      double avx2_cycles;
+
+      memcpy(avx2_dispatch, ref_dispatch, sizeof avx2_dispatch);
+      avx2_dispatch[LP_RAST_OP_TRIANGLE_1] = lp_rast_triangle_1_avx2;
+      avx2_dispatch[LP_RAST_OP_TRIANGLE_2] = lp_rast_triangle_2_avx2;
+      avx2_dispatch[LP_RAST_OP_TRIANGLE_3] = lp_rast_triangle_3_avx2;
+      avx2_dispatch[LP_RAST_OP_TRIANGLE_4] = lp_rast_triangle_4_avx2;
+      avx2_dispatch[LP_RAST_OP_TRIANGLE_5] = lp_rast_triangle_5_avx2;
+      avx2_dispatch[LP_RAST_OP_TRIANGLE_6] = lp_rast_triangle_6_avx2;
+      avx2_dispatch[LP_RAST_OP_TRIANGLE_7] = lp_rast_triangle_7_avx2;
+      avx2_dispatch[LP_RAST_OP_TRIANGLE_8] = lp_rast_triangle_8_avx2;
+      avx2_dispatch[LP_RAST_OP_TRIANGLE_32_1] = lp_rast_triangle_32_1_avx2;
+      avx2_dispatch[LP_RAST_OP_TRIANGLE_32_2] = lp_rast_triangle_32_2_avx2;
+      avx2_dispatch[LP_RAST_OP_TRIANGLE_32_3] = lp_rast_triangle_32_3_avx2;
+      avx2_dispatch[LP_RAST_OP_TRIANGLE_32_4] = lp_rast_triangle_32_4_avx2;
+      avx2_dispatch[LP_RAST_OP_TRIANGLE_32_5] = lp_rast_triangle_32_5_avx2;
+      avx2_dispatch[LP_RAST_OP_TRIANGLE_32_6] = lp_rast_triangle_32_6_avx2;
+      avx2_dispatch[LP_RAST_OP_TRIANGLE_32_7] = lp_rast_triangle_32_7_avx2;
+      avx2_dispatch[LP_RAST_OP_TRIANGLE_32_8] = lp_rast_triangle_32_8_avx2;
+      avx2_dispatch[LP_RAST_OP_TRIANGLE_32_3_16] = lp_rast_triangle_32_3_16_avx2;
+
+      coverage = CALLOC(FB_SIZE * FB_SIZE, 1);
+      num_quads = 0;
+      rasterize(&task, avx2_dispatch, &bins);
+      if (num_quads != ref_quads ||
+          memcmp(coverage, ref_coverage, FB_SIZE * FB_SIZE) != 0) {
+         fprintf(stderr, "%s triangles, %u planes: AVX2 coverage MISMATCH\n",
+                 dist->name, nr_planes);
+         success = FALSE;
+      }
+      FREE(coverage);
+      coverage = NULL;
+
+      avx2_cycles = time_rasterize(&task, avx2_dispatch, &bins);
+      if (fp)
+         write_tsv_row(fp, dist, nr_planes, "avx2", avx2_cycles, success);
+      if (verbose >= 1)
+         fprintf(stderr, "%-8s %u %8.1f cycles/triangle avx2 (%.2fx)\n",
+                 dist->name, nr_planes, avx2_cycles / dist->num_tris,
+                 cycles / avx2_cycles);
+   }
+#endif
+
+   FREE(ref_coverage);
+   for (i = 0; i < dist->num_tris; i++)
+      align_free(tris[i]);
+   FREE(tris);
+   FREE(bins.cmds);
+   FREE(scene);
+   FREE(variant);
+
+   return success;
+}
+
+
+/**
+ * Count the samples of each pixel inside all the planes, over the tiles
+ * which bin_triangle() visits.
+ */
+static void
+ms_reference_coverage(uint8_t *ref_coverage,
+                      const struct lp_rast_triangle *tri,
+                      unsigned nr_planes,
+                      const struct u_rect *bbox)
+{
+   const struct lp_rast_plane *plane = GET_PLANES(tri);
+   int x0 = bbox->x0 & ~(TILE_SIZE - 1);
+   int y0 = bbox->y0 & ~(TILE_SIZE - 1);
+   int x1 = (bbox->x1 | (TILE_SIZE - 1)) + 1;
+   int y1 = (bbox->y1 | (TILE_SIZE - 1)) + 1;
+   int x, y;
+   unsigned i, s;
+
+   for (y = y0; y < y1; y++) {
+      for (x = x0; x < x1; x++) {
+         for (s = 0; s < num_samples; s++) {
+            boolean inside = TRUE;
+
+            for (i = 0; i < nr_planes; i++) {
+               int64_t c = (plane[i].c +
+                            IMUL64(plane[i].dcdy, y) -
+                            IMUL64(plane[i].dcdx, x) +
+                            lp_rast_sample_offset(&plane[i], s));
+               if (c <= 0)
+                  inside = FALSE;
+            }
+
+            if (inside)
+               ref_coverage[y * FB_SIZE + x]++;
+         }
+      }
+   }
+}
+
+
+/**
+ * Rasterize multisampled triangles, with the edge test shader used for
+ * whole blocks too, i.e. as for a depth tested shader, and compare the
+ * samples passed to the shader against the reference coverage.
+ */
+static boolean
+test_ms_one(unsigned verbose,
+            const struct rast_dist *dist,
+            unsigned nr_planes)
+{
+   PIPE_ALIGN_VAR(16) uint8_t blend_color[16];
+   lp_rast_cmd_func ms_dispatch[LP_RAST_OP_MAX];
+   struct lp_fragment_shader_variant *variant;
+   struct lp_scene *scene;
+   struct lp_rast_state state;
+   struct lp_rasterizer_task task;
+   struct lp_rast_triangle **tris;
+   struct rast_bins bins;
+   uint8_t *ref_coverage;
+   boolean success = TRUE;
+   unsigned i;
+
+   memset(ms_dispatch, 0, sizeof ms_dispatch);
+   ms_dispatch[LP_RAST_OP_TRIANGLE_MS_1] = lp_rast_triangle_ms_1;
+   ms_dispatch[LP_RAST_OP_TRIANGLE_MS_2] = lp_rast_triangle_ms_2;
+   ms_dispatch[LP_RAST_OP_TRIANGLE_MS_3] = lp_rast_triangle_ms_3;
+   ms_dispatch[LP_RAST_OP_TRIANGLE_MS_4] = lp_rast_triangle_ms_4;
+   ms_dispatch[LP_RAST_OP_TRIANGLE_MS_5] = lp_rast_triangle_ms_5;
+   ms_dispatch[LP_RAST_OP_TRIANGLE_MS_6] = lp_rast_triangle_ms_6;
+   ms_dispatch[LP_RAST_OP_TRIANGLE_MS_7] = lp_rast_triangle_ms_7;
+   ms_dispatch[LP_RAST_OP_TRIANGLE_MS_8] = lp_rast_triangle_ms_8;
+
+   if (verbose >= 1)
+      fprintf(stderr, "%s multisampled triangles, %u planes ...\n",
+              dist->name, nr_planes);
+
+   variant = CALLOC_STRUCT(lp_fragment_shader_variant);
+   variant->jit_function[RAST_WHOLE] = rast_test_fs;
+   variant->jit_function[RAST_EDGE_TEST] = rast_test_fs;
+   variant->ps_inv_multiplier = 1;
+
+   memset(&state, 0, sizeof state);
+   memset(blend_color, 0, sizeof blend_color);
+   state.jit_context.u8_blend_color = blend_color;
+   state.variant = variant;
+
+   scene = CALLOC_STRUCT(lp_scene);
+   scene->tiles_x = FB_SIZE / TILE_SIZE;
+   scene->tiles_y = FB_SIZE / TILE_SIZE;
+   scene->nr_samples = LP_MAX_SAMPLES;
+
+   memset(&task, 0, sizeof task);
+   task.scene = scene;
+   task.state = &state;
+   task.width = TILE_SIZE;
+   task.height = TILE_SIZE;
+
+   ref_coverage = CALLOC(FB_SIZE * FB_SIZE, 1);
+   num_samples = LP_MAX_SAMPLES;
+
+   memset(&bins, 0, sizeof bins);
+   tris = CALLOC(dist->num_tris, sizeof *tris);
+   for (i = 0; i < dist->num_tris; i++) {
+      unsigned size = dist->min_size +
+                      rand() % (dist->max_size - dist->min_size + 1);
+      struct u_rect bbox;
+
+      tris[i] = random_triangle(size, nr_planes, &bbox);
+      bin_triangle(&bins, tris[i], nr_planes, TRUE, &bbox);
+      ms_reference_coverage(ref_coverage, tris[i], nr_planes, &bbox);
+   }
+
+   coverage = CALLOC(FB_SIZE * FB_SIZE, 1);
+   rasterize(&task, ms_dispatch, &bins);
+   if (memcmp(coverage, ref_coverage, FB_SIZE * FB_SIZE) != 0) {
+      fprintf(stderr, "%s triangles, %u planes: MSAA coverage MISMATCH\n",
+              dist->name, nr_planes);
+      success = FALSE;
+   }
+   FREE(coverage);
+   coverage = NULL;
+   num_samples = 1;
+
+   FREE(ref_coverage);
+   for (i = 0; i < dist->num_tris; i++)
+      align_free(tris[i]);
+   FREE(tris);
+   FREE(bins.cmds);
+   FREE(scene);
+   FREE(variant);
+
+   return success;
+}
+
+
+boolean
+test_all(unsigned verbose, FILE *fp)
+{
+   boolean success = TRUE;
+   unsigned i, nr_planes;
+
+   for (i = 0; i < Elements(rast_dists); i++) {
+      for (nr_planes = 3; nr_planes <= MAX_TEST_PLANES; nr_planes++) {
+         if (!test_one(verbose, fp, &rast_dists[i], nr_planes))
+            success = FALSE;
+      }
+      if (!test_ms_one(verbose, &rast_dists[i], 3))
+         success = FALSE;
+   }
+
+   return success;
+}
+
+
+boolean
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_all(verbose, fp);
+}
+
+
+boolean
+test_single(unsigned verbose, FILE *fp)
+{
+   return test_one(verbose, fp, &rast_dists[2], 3);
+}
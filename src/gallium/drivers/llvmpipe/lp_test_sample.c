@@ -0,0 +1,1050 @@
+/**************************************************************************
+ *
+ * Copyright 2013 agent <agent@local>
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * @file
+ * Unit tests and benchmark for texture sampling.
+ *
+ * A screen sized area is textured through the fragment shader sampler
+ * code generator, visiting the pixels in rasterization order, for a
+ * matrix of formats, targets, filters, wrap modes and minification
+ * ratios.  The texels are checked against a C reference sampler built on
+ * the u_format unpackers, and the sampling rate is reported.
+ *
+ * Each case is run with the linear and, where llvmpipe would use it, the
+ * tiled texture layout (see LP_SAMPLER_TILE_SIZE), which must return the
+ * very same texels.
+ */
+
+
+#include "util/u_memory.h"
+#include "util/u_math.h"
+#include "util/u_format.h"
+#include "util/u_dump.h"
+#include "os/os_time.h"
+
+#include "gallivm/lp_bld_const.h"
+#include "gallivm/lp_bld_flow.h"
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_sample.h"
+#include "gallivm/lp_bld_tgsi.h"
+
+#include "lp_jit.h"
+#include "lp_rast.h"
+#include "lp_state_fs.h"
+#include "lp_tex_sample.h"
+#include "lp_test.h"
+
+
+/** Size of the textured screen area, in pixels */
+#define SCREEN_SIZE 128
+
+/** Number of layers of array textures */
+#define ARRAY_LAYERS 4
+
+/** Depth of level 0 of 3D textures */
+#define VOLUME_DEPTH 8
+
+#define MAX_CASES 256
+
+
+struct sample_filter
+{
+   const char *name;
+   unsigned img_filter;   /**< PIPE_TEX_FILTER_x */
+   unsigned mip_filter;   /**< PIPE_TEX_MIPFILTER_x */
+};
+
+
+static const struct sample_filter sample_filters[] = {
+   { "nearest",   PIPE_TEX_FILTER_NEAREST, PIPE_TEX_MIPFILTER_NONE },
+   { "linear",    PIPE_TEX_FILTER_LINEAR,  PIPE_TEX_MIPFILTER_NONE },
+   { "mipmap",    PIPE_TEX_FILTER_NEAREST, PIPE_TEX_MIPFILTER_NEAREST },
+   { "trilinear", PIPE_TEX_FILTER_LINEAR,  PIPE_TEX_MIPFILTER_LINEAR },
+};
+
+
+static const enum pipe_format sample_formats[] = {
+   PIPE_FORMAT_B8G8R8A8_UNORM,      /* takes the AoS path */
+   PIPE_FORMAT_R8G8B8A8_UNORM,
+   PIPE_FORMAT_B5G6R5_UNORM,
+   PIPE_FORMAT_R8_UNORM,
+   PIPE_FORMAT_L8A8_UNORM,
+   PIPE_FORMAT_R16G16B16A16_UNORM,
+   PIPE_FORMAT_R16G16B16A16_FLOAT,
+   PIPE_FORMAT_R32_FLOAT,
+   PIPE_FORMAT_R32G32B32A32_FLOAT,  /* takes the SoA path */
+};
+
+
+static const unsigned sample_targets[] = {
+   PIPE_TEXTURE_1D,
+   PIPE_TEXTURE_2D,
+   PIPE_TEXTURE_RECT,
+   PIPE_TEXTURE_2D_ARRAY,
+   PIPE_TEXTURE_3D,
+};
+
+
+/** Wrap modes tested besides PIPE_TEX_WRAP_REPEAT */
+static const unsigned sample_wraps[] = {
+   PIPE_TEX_WRAP_CLAMP_TO_EDGE,
+   PIPE_TEX_WRAP_CLAMP_TO_BORDER,
+   PIPE_TEX_WRAP_MIRROR_REPEAT,
+};
+
+
+/** Texture to screen size ratios */
+static const unsigned sample_ratios[] = { 1, 2, 4, 8 };
+
+
+static const float sample_border_color[4] = { 0.25f, 0.5f, 0.75f, 1.0f };
+
+
+struct sample_case
+{
+   enum pipe_format format;
+   unsigned target;       /**< PIPE_TEXTURE_x */
+   const struct sample_filter *filter;
+   unsigned wrap;         /**< PIPE_TEX_WRAP_x, for all coordinates */
+   unsigned ratio;
+};
+
+
+struct sample_texture
+{
+   enum pipe_format format;
+   unsigned target;
+   unsigned width;        /**< of level 0 */
+   unsigned height;
+   unsigned depth;        /**< of level 0, or number of layers */
+   unsigned last_level;
+   boolean tiled;
+   uint8_t *data;
+   uint32_t row_stride[LP_MAX_TEXTURE_LEVELS];
+   uint32_t img_stride[LP_MAX_TEXTURE_LEVELS];
+   uint32_t mip_offsets[LP_MAX_TEXTURE_LEVELS];
+};
+
+
+typedef void
+(*sample_ptr_t)(const struct lp_jit_context *context,
+                const void *s, const void *t, const void *r,
+                void *rgba, uint32_t count);
+
+
+static void
+write_tsv_row(FILE *fp,
+              const struct sample_case *c,
+              boolean tiled,
+              double cycles,
+              double texels_per_second,
+              boolean success)
+{
+   fprintf(fp, "%s\t", success ? "pass" : "fail");
+
+   fprintf(fp, "%.2f\t", cycles / (SCREEN_SIZE * SCREEN_SIZE));
+
+   fprintf(fp, "%.2f\t", texels_per_second / 1e6);
+
+   fprintf(fp, "%s\t%s\t%s\t%s\t%u\t%s\n",
+           util_format_short_name(c->format),
+           util_dump_tex_target(c->target, TRUE),
+           c->filter->name,
+           util_dump_tex_wrap(c->wrap, TRUE),
+           c->ratio,
+           tiled ? "tiled" : "linear");
+
+   fflush(fp);
+}
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "cycles_per_pixel\t"
+           "mtexels_per_second\t"
+           "format\t"
+           "target\t"
+           "filter\t"
+           "wrap\t"
+           "ratio\t"
+           "layout\n");
+
+   fflush(fp);
+}
+
+
+/**
+ * Texel value in [0, 1] which only depends on the texel's position, so
+ * that both layouts hold the same image.
+ */
+static float
+texel_value(unsigned level, unsigned x, unsigned y, unsigned z,
+            unsigned chan)
+{
+   uint32_t h = (level * 0x9e3779b1) ^ (x * 0x85ebca6b) ^
+                (y * 0xc2b2ae35) ^ (z * 0x165667b1) ^ (chan * 0x27d4eb2f);
+   h ^= h >> 15;
+   h *= 0x2c1b3c6d;
+   h ^= h >> 12;
+   return (h & 0xff) / 255.0f;
+}
+
+
+static unsigned
+texel_offset(const struct sample_texture *tex, unsigned level,
+             unsigned x, unsigned y, unsigned texel_bytes)
+{
+   const unsigned mask = LP_SAMPLER_TILE_SIZE - 1;
+
+   if (!tex->tiled)
+      return y * tex->row_stride[level] + x * texel_bytes;
+
+   return (y & ~mask) * tex->row_stride[level] +
+          ((x & ~mask) * LP_SAMPLER_TILE_SIZE +
+           (y & mask) * LP_SAMPLER_TILE_SIZE +
+           (x & mask)) * texel_bytes;
+}
+
+
+static const uint8_t *
+texel_ptr(const struct sample_texture *tex, unsigned level,
+          unsigned x, unsigned y, unsigned z)
+{
+   const unsigned texel_bytes = util_format_get_blocksize(tex->format);
+
+   return tex->data + tex->mip_offsets[level] +
+          z * tex->img_stride[level] +
+          texel_offset(tex, level, x, y, texel_bytes);
+}
+
+
+/**
+ * Number of images of a level: its depth for 3D textures, the number of
+ * layers for arrays.
+ */
+static unsigned
+level_images(const struct sample_texture *tex, unsigned level)
+{
+   if (tex->target == PIPE_TEXTURE_3D)
+      return u_minify(tex->depth, level);
+   return tex->depth;
+}
+
+
+/**
+ * Lay out and fill a texture with a full mipmap chain the way
+ * llvmpipe_texture_layout() does.
+ *
+ * The texture is sized so that it is minified by the case's ratio over
+ * the screen area.  Rectangle textures have a fixed NPOT size instead.
+ */
+static boolean
+create_texture(struct sample_texture *tex, const struct sample_case *c,
+               boolean tiled)
+{
+   const unsigned texel_bytes = util_format_get_blocksize(c->format);
+   unsigned level, x, y, z, chan;
+   unsigned offset = 0;
+   float *row;
+   uint8_t *packed;
+
+   memset(tex, 0, sizeof *tex);
+   tex->format = c->format;
+   tex->target = c->target;
+   tex->tiled = tiled;
+
+   switch (c->target) {
+   case PIPE_TEXTURE_1D:
+      tex->width = SCREEN_SIZE * c->ratio;
+      tex->height = 1;
+      tex->depth = 1;
+      break;
+   case PIPE_TEXTURE_RECT:
+      tex->width = SCREEN_SIZE * 3 / 4;
+      tex->height = SCREEN_SIZE * 5 / 8;
+      tex->depth = 1;
+      break;
+   case PIPE_TEXTURE_2D_ARRAY:
+      tex->width = SCREEN_SIZE * c->ratio;
+      tex->height = SCREEN_SIZE * c->ratio;
+      tex->depth = ARRAY_LAYERS;
+      break;
+   case PIPE_TEXTURE_3D:
+      tex->width = SCREEN_SIZE * c->ratio;
+      tex->height = SCREEN_SIZE * c->ratio;
+      tex->depth = VOLUME_DEPTH;
+      break;
+   default:
+      tex->width = SCREEN_SIZE * c->ratio;
+      tex->height = SCREEN_SIZE * c->ratio;
+      tex->depth = 1;
+      break;
+   }
+
+   if (c->target == PIPE_TEXTURE_RECT)
+      tex->last_level = 0;
+   else if (c->target == PIPE_TEXTURE_3D)
+      tex->last_level = util_logbase2(MAX3(tex->width, tex->height,
+                                           tex->depth));
+   else
+      tex->last_level = util_logbase2(MAX2(tex->width, tex->height));
+
+   for (level = 0; level <= tex->last_level; level++) {
+      unsigned width = align(u_minify(tex->width, level),
+                             LP_RASTER_BLOCK_SIZE);
+      unsigned height = u_minify(tex->height, level);
+      if (c->target != PIPE_TEXTURE_1D)
+         height = align(height, LP_RASTER_BLOCK_SIZE);
+      tex->row_stride[level] = align(width * texel_bytes, 64);
+      tex->img_stride[level] = tex->row_stride[level] * height;
+      tex->mip_offsets[level] = offset;
+      offset += align(tex->img_stride[level] * level_images(tex, level), 64);
+   }
+
+   tex->data = align_malloc(offset, 64);
+   row = MALLOC(tex->width * 4 * sizeof *row);
+   packed = MALLOC(tex->width * texel_bytes);
+   if (!tex->data || !row || !packed) {
+      align_free(tex->data);
+      FREE(row);
+      FREE(packed);
+      return FALSE;
+   }
+
+   memset(tex->data, 0, offset);
+
+   for (level = 0; level <= tex->last_level; level++) {
+      unsigned width = u_minify(tex->width, level);
+      unsigned height = u_minify(tex->height, level);
+
+      for (z = 0; z < level_images(tex, level); z++) {
+         for (y = 0; y < height; y++) {
+            for (x = 0; x < width; x++) {
+               for (chan = 0; chan < 4; chan++)
+                  row[x * 4 + chan] = texel_value(level, x, y, z, chan);
+            }
+
+            util_format_write_4f(c->format, row, 0, packed, 0, 0, 0,
+                                 width, 1);
+
+            for (x = 0; x < width; x++) {
+               memcpy((uint8_t *) texel_ptr(tex, level, x, y, z),
+                      packed + x * texel_bytes, texel_bytes);
+            }
+         }
+      }
+   }
+
+   FREE(row);
+   FREE(packed);
+   return TRUE;
+}
+
+
+/**
+ * Texture coordinates of the screen pixels, in the order the fragment
+ * shader sees them: tiles of 4x4 blocks of 2x2 quads.
+ *
+ * The texture is offset by a quarter of its size and a fraction of a
+ * texel, so that the wrap modes matter and that linear filtering never
+ * degenerates into nearest.  Array layers change per quad; the 3D
+ * coordinate is constant, so that it does not take part in the LOD.
+ */
+static void
+init_coords(const struct sample_case *c, const struct sample_texture *tex,
+            float *s, float *t, float *r)
+{
+   const boolean normalized = c->target != PIPE_TEXTURE_RECT;
+   const float origin_s = -(float) (tex->width / 4) + 0.3f;
+   const float origin_t = -(float) (tex->height / 4) + 0.7f;
+   unsigned tx, ty, bx, by, q, p;
+   unsigned i = 0;
+
+   for (ty = 0; ty < SCREEN_SIZE; ty += TILE_SIZE) {
+      for (tx = 0; tx < SCREEN_SIZE; tx += TILE_SIZE) {
+         for (by = 0; by < TILE_SIZE; by += LP_RASTER_BLOCK_SIZE) {
+            for (bx = 0; bx < TILE_SIZE; bx += LP_RASTER_BLOCK_SIZE) {
+               for (q = 0; q < 4; q++) {
+                  for (p = 0; p < 4; p++) {
+                     unsigned x = tx + bx + (q & 1) * 2 + (p & 1);
+                     unsigned y = ty + by + (q >> 1) * 2 + (p >> 1);
+
+                     s[i] = origin_s + (x + 0.5f) * c->ratio;
+                     t[i] = origin_t + (y + 0.5f) * c->ratio;
+                     if (normalized) {
+                        s[i] /= tex->width;
+                        t[i] /= tex->height;
+                     }
+
+                     if (c->target == PIPE_TEXTURE_1D)
+                        t[i] = 0.0f;
+
+                     if (c->target == PIPE_TEXTURE_2D_ARRAY)
+                        r[i] = (float) ((x / 2 + y / 2) % tex->depth);
+                     else if (c->target == PIPE_TEXTURE_3D)
+                        r[i] = 2.3f / tex->depth;
+                     else
+                        r[i] = 0.0f;
+
+                     i++;
+                  }
+               }
+            }
+         }
+      }
+   }
+}
+
+
+/**
+ * Apply a wrap mode to an integer texel coordinate, per the GL spec.
+ * Returns -1 for the border.
+ */
+static int
+wrap_texel(unsigned wrap, int i, int size)
+{
+   int m;
+
+   switch (wrap) {
+   case PIPE_TEX_WRAP_REPEAT:
+      return ((i % size) + size) % size;
+   case PIPE_TEX_WRAP_CLAMP_TO_EDGE:
+      return CLAMP(i, 0, size - 1);
+   case PIPE_TEX_WRAP_CLAMP_TO_BORDER:
+      return i < 0 || i >= size ? -1 : i;
+   case PIPE_TEX_WRAP_MIRROR_REPEAT:
+      m = ((i % (2 * size)) + 2 * size) % (2 * size);
+      return m < size ? m : 2 * size - 1 - m;
+   default:
+      assert(0);
+      return 0;
+   }
+}
+
+
+/**
+ * Reference sampler.
+ *
+ * The minification ratios are powers of two, so the LOD is the integer
+ * log2 of the ratio, and linear mipmap filtering reduces to a single
+ * level.
+ */
+static void
+ref_sample(const struct sample_case *c, const struct sample_texture *tex,
+           float s, float t, float r, float *rgba)
+{
+   const struct util_format_description *desc =
+      util_format_description(tex->format);
+   const unsigned dims = c->target == PIPE_TEXTURE_1D ? 1 :
+                         c->target == PIPE_TEXTURE_3D ? 3 : 2;
+   const float coord[3] = { s, t, r };
+   unsigned level = 0;
+   int size[3];
+   int i0[3], i1[3];
+   float w[3];
+   unsigned d, corner, chan;
+
+   if (c->filter->mip_filter != PIPE_TEX_MIPFILTER_NONE)
+      level = MIN2(util_logbase2(c->ratio), tex->last_level);
+
+   size[0] = u_minify(tex->width, level);
+   size[1] = u_minify(tex->height, level);
+   size[2] = level_images(tex, level);
+
+   for (d = 0; d < 3; d++) {
+      float u = coord[d];
+      float u0;
+
+      i0[d] = i1[d] = 0;
+      w[d] = 0.0f;
+
+      if (d >= dims)
+         continue;
+
+      if (c->target != PIPE_TEXTURE_RECT)
+         u *= size[d];
+
+      if (c->filter->img_filter == PIPE_TEX_FILTER_NEAREST) {
+         i0[d] = i1[d] = wrap_texel(c->wrap, (int) floorf(u), size[d]);
+      }
+      else {
+         u -= 0.5f;
+         u0 = floorf(u);
+         w[d] = u - u0;
+         i0[d] = wrap_texel(c->wrap, (int) u0, size[d]);
+         i1[d] = wrap_texel(c->wrap, (int) u0 + 1, size[d]);
+      }
+   }
+
+   if (c->target == PIPE_TEXTURE_2D_ARRAY)
+      i0[2] = i1[2] = CLAMP((int) floorf(r + 0.5f), 0, size[2] - 1);
+
+   rgba[0] = rgba[1] = rgba[2] = rgba[3] = 0.0f;
+
+   for (corner = 0; corner < 8; corner++) {
+      float weight = 1.0f;
+      int x = corner & 1 ? i1[0] : i0[0];
+      int y = corner & 2 ? i1[1] : i0[1];
+      int z = corner & 4 ? i1[2] : i0[2];
+      float texel[4];
+
+      for (d = 0; d < 3; d++)
+         weight *= corner & (1 << d) ? w[d] : 1.0f - w[d];
+      if (weight == 0.0f)
+         continue;
+
+      if (x < 0 || y < 0 || z < 0)
+         memcpy(texel, sample_border_color, sizeof texel);
+      else
+         desc->unpack_rgba_float(texel, 0, texel_ptr(tex, level, x, y, z), 0,
+                                 1, 1);
+
+      for (chan = 0; chan < 4; chan++)
+         rgba[chan] += weight * texel[chan];
+   }
+}
+
+
+/**
+ * Build a function which samples texture unit 0 at count vectors of
+ * coordinates and stores the texels as SoA vectors.
+ */
+static LLVMValueRef
+add_sample_test(struct gallivm_state *gallivm,
+                struct lp_fragment_shader_variant *variant,
+                const struct lp_sampler_static_state *state,
+                struct lp_type type)
+{
+   LLVMContextRef context = gallivm->context;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef vec_ptr_type;
+   LLVMTypeRef args[6];
+   LLVMValueRef func;
+   LLVMValueRef context_ptr, s_ptr, t_ptr, r_ptr, rgba_ptr, count;
+   LLVMBasicBlockRef block;
+   struct lp_build_sampler_soa *sampler;
+   struct lp_build_loop_state loop;
+
+   vec_ptr_type = LLVMPointerType(lp_build_vec_type(gallivm, type), 0);
+
+   args[0] = variant->jit_context_ptr_type;
+   args[1] = vec_ptr_type;
+   args[2] = vec_ptr_type;
+   args[3] = vec_ptr_type;
+   args[4] = vec_ptr_type;
+   args[5] = LLVMInt32TypeInContext(context);
+
+   func = LLVMAddFunction(gallivm->module, "sample",
+                          LLVMFunctionType(LLVMVoidTypeInContext(context),
+                                           args, Elements(args), 0));
+   LLVMSetFunctionCallConv(func, LLVMCCallConv);
+   context_ptr = LLVMGetParam(func, 0);
+   s_ptr = LLVMGetParam(func, 1);
+   t_ptr = LLVMGetParam(func, 2);
+   r_ptr = LLVMGetParam(func, 3);
+   rgba_ptr = LLVMGetParam(func, 4);
+   count = LLVMGetParam(func, 5);
+
+   block = LLVMAppendBasicBlockInContext(context, func, "entry");
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   sampler = lp_llvm_sampler_soa_create(state, context_ptr);
+
+   lp_build_loop_begin(&loop, gallivm, lp_build_const_int32(gallivm, 0));
+   {
+      LLVMValueRef index = loop.counter;
+      LLVMValueRef coords[5];
+      LLVMValueRef offsets[3] = { NULL };
+      LLVMValueRef texel[4];
+      unsigned chan;
+
+      coords[0] = LLVMBuildLoad(builder,
+                                LLVMBuildGEP(builder, s_ptr, &index, 1, ""),
+                                "s");
+      coords[1] = LLVMBuildLoad(builder,
+                                LLVMBuildGEP(builder, t_ptr, &index, 1, ""),
+                                "t");
+      coords[2] = LLVMBuildLoad(builder,
+                                LLVMBuildGEP(builder, r_ptr, &index, 1, ""),
+                                "r");
+      for (chan = 3; chan < 5; chan++)
+         coords[chan] = lp_build_undef(gallivm, type);
+
+      sampler->emit_fetch_texel(sampler, gallivm, type,
+                                FALSE, 0, 0,
+                                coords, offsets,
+                                NULL, NULL, NULL,
+                                LP_SAMPLER_LOD_SCALAR,
+                                texel);
+
+      for (chan = 0; chan < 4; chan++) {
+         LLVMValueRef out_index =
+            LLVMBuildAdd(builder,
+                         LLVMBuildMul(builder, index,
+                                      lp_build_const_int32(gallivm, 4), ""),
+                         lp_build_const_int32(gallivm, chan), "");
+         LLVMBuildStore(builder, texel[chan],
+                        LLVMBuildGEP(builder, rgba_ptr, &out_index, 1, ""));
+      }
+   }
+   lp_build_loop_end(&loop, count, NULL);
+
+   LLVMBuildRetVoid(builder);
+
+   sampler->destroy(sampler);
+
+   gallivm_verify_function(gallivm, func);
+
+   return func;
+}
+
+
+/**
+ * Average the cycle counts, leaving out the outliers.
+ */
+static double
+average_cycles(const int64_t *cycles, unsigned n)
+{
+   double sum = 0.0, sum2 = 0.0;
+   double avg, std;
+   unsigned i, m;
+
+   for (i = 0; i < n; ++i) {
+      sum += cycles[i];
+      sum2 += cycles[i]*cycles[i];
+   }
+
+   avg = sum/n;
+   std = sqrtf((sum2 - n*avg*avg)/n);
+
+   m = 0;
+   sum = 0.0;
+   for (i = 0; i < n; ++i) {
+      if (fabs(cycles[i] - avg) <= 4.0*std) {
+         sum += cycles[i];
+         ++m;
+      }
+   }
+
+   return sum/m;
+}
+
+
+/**
+ * Sample the texture over the whole screen area into rgba, and return the
+ * average number of cycles this takes, and its rate in texels per second.
+ */
+PIPE_ALIGN_STACK
+static double
+run_sample_test(const struct sample_case *c,
+                const struct sample_texture *tex,
+                const float *s, const float *t, const float *r,
+                float *rgba, double *texels_per_second)
+{
+   struct lp_type type;
+   struct gallivm_state *gallivm;
+   struct lp_fragment_shader_variant *variant;
+   struct lp_sampler_static_state state;
+   struct pipe_sampler_state sampler;
+   struct lp_jit_context jit_context;
+   struct lp_jit_texture *jit_tex;
+   LLVMValueRef func;
+   sample_ptr_t sample_ptr;
+   int64_t cycles[LP_TEST_NUM_SAMPLES];
+   int64_t start_time;
+   unsigned count;
+   unsigned i;
+
+   memset(&type, 0, sizeof type);
+   type.floating = TRUE;
+   type.sign = TRUE;
+   type.width = 32;
+   type.length = lp_native_vector_width / 32;
+   count = SCREEN_SIZE * SCREEN_SIZE / type.length;
+
+   memset(&sampler, 0, sizeof sampler);
+   sampler.wrap_s = c->wrap;
+   sampler.wrap_t = c->wrap;
+   sampler.wrap_r = c->wrap;
+   sampler.min_img_filter = c->filter->img_filter;
+   sampler.mag_img_filter = c->filter->img_filter;
+   sampler.min_mip_filter = c->filter->mip_filter;
+   sampler.normalized_coords = c->target != PIPE_TEXTURE_RECT;
+   sampler.max_lod = (float) tex->last_level;
+   memcpy(sampler.border_color.f, sample_border_color,
+          sizeof sample_border_color);
+
+   memset(&state, 0, sizeof state);
+   lp_sampler_static_sampler_state(&state.sampler_state, &sampler);
+   state.texture_state.format = tex->format;
+   state.texture_state.swizzle_r = UTIL_FORMAT_SWIZZLE_X;
+   state.texture_state.swizzle_g = UTIL_FORMAT_SWIZZLE_Y;
+   state.texture_state.swizzle_b = UTIL_FORMAT_SWIZZLE_Z;
+   state.texture_state.swizzle_a = UTIL_FORMAT_SWIZZLE_W;
+   state.texture_state.target = tex->target;
+   state.texture_state.pot_width = util_is_power_of_two(tex->width);
+   state.texture_state.pot_height = util_is_power_of_two(tex->height);
+   state.texture_state.pot_depth =
+      tex->target != PIPE_TEXTURE_3D || util_is_power_of_two(tex->depth);
+   state.texture_state.level_zero_only = !tex->last_level;
+   state.texture_state.tiled = tex->tiled;
+
+   memset(&jit_context, 0, sizeof jit_context);
+   jit_tex = &jit_context.textures[0];
+   jit_tex->width = tex->width;
+   jit_tex->height = tex->height;
+   jit_tex->depth = tex->depth;
+   jit_tex->first_level = 0;
+   jit_tex->last_level = tex->last_level;
+   jit_tex->base = tex->data;
+   memcpy(jit_tex->row_stride, tex->row_stride, sizeof tex->row_stride);
+   memcpy(jit_tex->img_stride, tex->img_stride, sizeof tex->img_stride);
+   memcpy(jit_tex->mip_offsets, tex->mip_offsets, sizeof tex->mip_offsets);
+   jit_context.samplers[0].min_lod = sampler.min_lod;
+   jit_context.samplers[0].max_lod = sampler.max_lod;
+   jit_context.samplers[0].lod_bias = sampler.lod_bias;
+   memcpy(jit_context.samplers[0].border_color, sample_border_color,
+          sizeof sample_border_color);
+
+   gallivm = gallivm_create();
+
+   variant = CALLOC_STRUCT(lp_fragment_shader_variant);
+   variant->gallivm = gallivm;
+   lp_jit_init_types(variant);
+
+   func = add_sample_test(gallivm, variant, &state, type);
+
+   gallivm_compile_module(gallivm);
+
+   sample_ptr = (sample_ptr_t) gallivm_jit_function(gallivm, func);
+
+   start_time = os_time_get_nano();
+
+   for (i = 0; i < LP_TEST_NUM_SAMPLES; i++) {
+      int64_t start_counter = rdtsc();
+      sample_ptr(&jit_context, s, t, r, rgba, count);
+      cycles[i] = rdtsc() - start_counter;
+   }
+
+   *texels_per_second = (double) SCREEN_SIZE * SCREEN_SIZE *
+                        LP_TEST_NUM_SAMPLES * 1e9 /
+                        MAX2(os_time_get_nano() - start_time, 1);
+
+   gallivm_free_function(gallivm, func, sample_ptr);
+
+   gallivm_destroy(gallivm);
+
+   FREE(variant);
+
+   return average_cycles(cycles, LP_TEST_NUM_SAMPLES);
+}
+
+
+static float
+format_tolerance(enum pipe_format format)
+{
+   /*
+    * The AoS path filters 8 bit formats with 8 bit weights, so allow for a
+    * couple of units of error there.
+    */
+   if (util_format_is_float(format))
+      return 1e-3f;
+   return 3.0f / 255.0f;
+}
+
+
+/**
+ * Compare the sampled texels, which are stored as SoA vectors, against
+ * the reference ones, and report the first mismatch.
+ */
+static boolean
+check_texels(unsigned verbose,
+             const struct sample_case *c, boolean tiled,
+             const float *s, const float *t, const float *r,
+             const float *expected, const float *rgba)
+{
+   const unsigned length = lp_native_vector_width / 32;
+   const float tolerance = format_tolerance(c->format);
+   unsigned i, chan;
+
+   for (i = 0; i < SCREEN_SIZE * SCREEN_SIZE; i++) {
+      const float *ref = &expected[i * 4];
+      float texel[4];
+      boolean match = TRUE;
+
+      for (chan = 0; chan < 4; chan++) {
+         texel[chan] = rgba[((i / length) * 4 + chan) * length + i % length];
+         if (!(fabsf(texel[chan] - ref[chan]) <= tolerance))
+            match = FALSE;
+      }
+
+      if (!match) {
+         fprintf(stderr,
+                 "%s %s %s %s 1:%u %s: MISMATCH at (%f, %f, %f)\n"
+                 "  sampled  %f %f %f %f\n"
+                 "  expected %f %f %f %f\n",
+                 util_format_short_name(c->format),
+                 util_dump_tex_target(c->target, TRUE),
+                 c->filter->name,
+                 util_dump_tex_wrap(c->wrap, TRUE),
+                 c->ratio,
+                 tiled ? "tiled" : "linear",
+                 s[i], t[i], r[i],
+                 texel[0], texel[1], texel[2], texel[3],
+                 ref[0], ref[1], ref[2], ref[3]);
+         return FALSE;
+      }
+   }
+
+   return TRUE;
+}
+
+
+static boolean
+test_one(unsigned verbose, FILE *fp, const struct sample_case *c)
+{
+   const unsigned num_pixels = SCREEN_SIZE * SCREEN_SIZE;
+   const unsigned num_layouts = c->target == PIPE_TEXTURE_1D ? 1 : 2;
+   struct sample_texture tex;
+   float *s, *t, *r, *expected, *rgba[2];
+   double cycles[2] = { 0.0, 0.0 };
+   double rate[2] = { 0.0, 0.0 };
+   boolean passed[2] = { TRUE, TRUE };
+   boolean success = TRUE;
+   unsigned i, layout;
+
+   if (verbose >= 1)
+      fprintf(stderr, "%s %s %s %s 1:%u ...\n",
+              util_format_short_name(c->format),
+              util_dump_tex_target(c->target, TRUE),
+              c->filter->name,
+              util_dump_tex_wrap(c->wrap, TRUE),
+              c->ratio);
+
+   s = align_malloc(num_pixels * sizeof *s, 64);
+   t = align_malloc(num_pixels * sizeof *t, 64);
+   r = align_malloc(num_pixels * sizeof *r, 64);
+   expected = MALLOC(num_pixels * 4 * sizeof *expected);
+   rgba[0] = align_malloc(num_pixels * 4 * sizeof *rgba[0], 64);
+   rgba[1] = align_malloc(num_pixels * 4 * sizeof *rgba[1], 64);
+
+   for (layout = 0; layout < num_layouts; layout++) {
+      if (!create_texture(&tex, c, layout)) {
+         fprintf(stderr, "out of memory\n");
+         success = FALSE;
+         break;
+      }
+
+      if (layout == 0) {
+         init_coords(c, &tex, s, t, r);
+         for (i = 0; i < num_pixels; i++)
+            ref_sample(c, &tex, s[i], t[i], r[i], &expected[i * 4]);
+      }
+
+      cycles[layout] = run_sample_test(c, &tex, s, t, r, rgba[layout],
+                                       &rate[layout]);
+
+      align_free(tex.data);
+
+      passed[layout] = check_texels(verbose, c, layout, s, t, r,
+                                    expected, rgba[layout]);
+      if (!passed[layout])
+         success = FALSE;
+   }
+
+   if (success && num_layouts == 2 &&
+       memcmp(rgba[0], rgba[1], num_pixels * 4 * sizeof *rgba[0]) != 0) {
+      fprintf(stderr, "%s %s %s %s 1:%u: tiled texels MISMATCH\n",
+              util_format_short_name(c->format),
+              util_dump_tex_target(c->target, TRUE),
+              c->filter->name,
+              util_dump_tex_wrap(c->wrap, TRUE),
+              c->ratio);
+      passed[1] = FALSE;
+      success = FALSE;
+   }
+
+   if (cycles[0]) {
+      if (fp) {
+         for (layout = 0; layout < num_layouts; layout++)
+            write_tsv_row(fp, c, layout, cycles[layout], rate[layout],
+                          passed[layout]);
+      }
+
+      printf("%-20s %-8s %-9s %-15s 1:%u %8.2f Mtexels/s",
+             util_format_short_name(c->format),
+             util_dump_tex_target(c->target, TRUE),
+             c->filter->name,
+             util_dump_tex_wrap(c->wrap, TRUE),
+             c->ratio,
+             rate[0] / 1e6);
+      if (cycles[1])
+         printf(", %8.2f tiled (%.2fx)", rate[1] / 1e6, rate[1] / rate[0]);
+      printf("%s\n", success ? "" : " FAILED");
+   }
+
+   align_free(s);
+   align_free(t);
+   align_free(r);
+   FREE(expected);
+   align_free(rgba[0]);
+   align_free(rgba[1]);
+
+   return success;
+}
+
+
+static unsigned
+add_case(struct sample_case *cases, unsigned num_cases,
+         enum pipe_format format, unsigned target,
+         const struct sample_filter *filter, unsigned wrap, unsigned ratio)
+{
+   assert(num_cases < MAX_CASES);
+   cases[num_cases].format = format;
+   cases[num_cases].target = target;
+   cases[num_cases].filter = filter;
+   cases[num_cases].wrap = wrap;
+   cases[num_cases].ratio = ratio;
+   return num_cases + 1;
+}
+
+
+/**
+ * Build the test matrix:
+ * - every format, target and filter, minified when mipmapping;
+ * - every wrap mode, with a 8 bit and a float format;
+ * - a range of minification ratios, to compare the texture layouts.
+ */
+static unsigned
+build_cases(struct sample_case *cases)
+{
+   static const enum pipe_format wrap_formats[] = {
+      PIPE_FORMAT_B8G8R8A8_UNORM,
+      PIPE_FORMAT_R32G32B32A32_FLOAT,
+   };
+   unsigned num_cases = 0;
+   unsigned i, j, k, l;
+
+   for (i = 0; i < Elements(sample_formats); i++) {
+      for (j = 0; j < Elements(sample_targets); j++) {
+         for (k = 0; k < Elements(sample_filters); k++) {
+            const struct sample_filter *filter = &sample_filters[k];
+            boolean mipmap = filter->mip_filter != PIPE_TEX_MIPFILTER_NONE;
+
+            /* Rectangles have no mipmaps, and can't repeat */
+            if (sample_targets[j] == PIPE_TEXTURE_RECT) {
+               if (!mipmap)
+                  num_cases = add_case(cases, num_cases, sample_formats[i],
+                                       sample_targets[j], filter,
+                                       PIPE_TEX_WRAP_CLAMP_TO_EDGE, 1);
+               continue;
+            }
+
+            num_cases = add_case(cases, num_cases, sample_formats[i],
+                                 sample_targets[j], filter,
+                                 PIPE_TEX_WRAP_REPEAT, mipmap ? 4 : 1);
+         }
+      }
+   }
+
+   for (i = 0; i < Elements(wrap_formats); i++) {
+      for (j = 0; j < Elements(sample_wraps); j++) {
+         for (k = 0; k < 2; k++) {
+            num_cases = add_case(cases, num_cases, wrap_formats[i],
+                                 PIPE_TEXTURE_2D, &sample_filters[k],
+                                 sample_wraps[j], 1);
+         }
+      }
+   }
+
+   for (i = 0; i < Elements(wrap_formats); i++) {
+      for (k = 1; k < Elements(sample_filters); k += 2) {
+         for (l = 0; l < Elements(sample_ratios); l++) {
+            num_cases = add_case(cases, num_cases, wrap_formats[i],
+                                 PIPE_TEXTURE_2D, &sample_filters[k],
+                                 PIPE_TEX_WRAP_REPEAT, sample_ratios[l]);
+         }
+      }
+   }
+
+   return num_cases;
+}
+
+
+boolean
+test_all(unsigned verbose, FILE *fp)
+{
+   struct sample_case cases[MAX_CASES];
+   unsigned num_cases = build_cases(cases);
+   boolean success = TRUE;
+   unsigned i;
+
+   for (i = 0; i < num_cases; i++) {
+      if (!test_one(verbose, fp, &cases[i]))
+         success = FALSE;
+   }
+
+   return success;
+}
+
+
+boolean
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   struct sample_case cases[MAX_CASES];
+   unsigned num_cases = build_cases(cases);
+   boolean success = TRUE;
+   unsigned long i;
+
+   for (i = 0; i < n; i++) {
+      if (!test_one(verbose, fp, &cases[rand() % num_cases]))
+         success = FALSE;
+   }
+
+   return success;
+}
+
+
+boolean
+test_single(unsigned verbose, FILE *fp)
+{
+   struct sample_case c;
+
+   c.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+   c.target = PIPE_TEXTURE_2D;
+   c.filter = &sample_filters[3];
+   c.wrap = PIPE_TEX_WRAP_REPEAT;
+   c.ratio = 4;
+
+   return test_one(verbose, fp, &c);
+}
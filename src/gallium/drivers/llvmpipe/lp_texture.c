@@ -41,9 +41,12 @@
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/u_simple_list.h"
+#include "util/u_surface.h"
 #include "util/u_transfer.h"
 
+#include "gallivm/lp_bld_sample.h"
 #include "lp_context.h"
+#include "lp_debug.h"
 #include "lp_flush.h"
 #include "lp_screen.h"
 #include "lp_texture.h"
@@ -159,6 +162,18 @@ llvmpipe_texture_layout(struct llvmpipe_screen *screen,
       depth = u_minify(depth, 1);
    }
 
+   /* The samples are stored in whole copies of the image, one after the
+    * other.
+    */
+   lpr->sample_stride = 0;
+   if (pt->nr_samples > 1) {
+      if (pt->last_level != 0 ||
+          total_size * pt->nr_samples > LP_MAX_TEXTURE_SIZE) {
+         goto fail;
+      }
+      lpr->sample_stride = (unsigned) total_size;
+   }
+
    return TRUE;
 
 fail:
@@ -193,6 +208,10 @@ llvmpipe_displaytarget_layout(struct llvmpipe_screen *screen,
    const unsigned width = MAX2(1, align(lpr->base.width0, TILE_SIZE));
    const unsigned height = MAX2(1, align(lpr->base.height0, TILE_SIZE));
 
+   /* the winsys only knows about single-sampled images */
+   if (lpr->base.nr_samples > 1)
+      return FALSE;
+
    lpr->num_slices_faces[0] = 1;
    lpr->img_stride[0] = 0;
 
@@ -220,6 +239,67 @@ llvmpipe_displaytarget_layout(struct llvmpipe_screen *screen,
 }
 
 
+/**
+ * Whether the rasterizer may defer the clears of a resource, see
+ * llvmpipe_tile_clear.
+ */
+static boolean
+llvmpipe_can_defer_clears(const struct pipe_resource *res)
+{
+   return (res->bind & (PIPE_BIND_RENDER_TARGET |
+                        PIPE_BIND_DEPTH_STENCIL)) &&
+          !(res->bind & PIPE_BIND_SHARED) &&
+          (res->target == PIPE_TEXTURE_2D ||
+           res->target == PIPE_TEXTURE_RECT) &&
+          res->last_level == 0 &&
+          res->depth0 == 1 &&
+          res->array_size == 1 &&
+          res->nr_samples <= 1;
+}
+
+
+/**
+ * Whether a texture may be stored in tiles, see llvmpipe_resource::tiled.
+ */
+static boolean
+llvmpipe_can_tile(const struct pipe_resource *res)
+{
+   const struct util_format_description *desc =
+      util_format_description(res->format);
+
+   /* the tiles must not straddle the image size alignment */
+   STATIC_ASSERT(LP_RASTER_BLOCK_SIZE % LP_SAMPLER_TILE_SIZE == 0);
+
+   if (LP_PERF & PERF_NO_TEX_TILING)
+      return FALSE;
+
+   if (!(res->bind & PIPE_BIND_SAMPLER_VIEW) ||
+       (res->bind & (PIPE_BIND_DISPLAY_TARGET |
+                     PIPE_BIND_SCANOUT |
+                     PIPE_BIND_SHARED)) ||
+       res->nr_samples > 1)
+      return FALSE;
+
+   switch (res->target) {
+   case PIPE_TEXTURE_2D:
+   case PIPE_TEXTURE_2D_ARRAY:
+   case PIPE_TEXTURE_RECT:
+   case PIPE_TEXTURE_3D:
+   case PIPE_TEXTURE_CUBE:
+      break;
+   default:
+      return FALSE;
+   }
+
+   return desc->layout == UTIL_FORMAT_LAYOUT_PLAIN &&
+          desc->block.width == 1 &&
+          desc->block.height == 1 &&
+          desc->block.bits >= 8 &&
+          util_is_power_of_two(desc->block.bits / 8) &&
+          !util_format_is_depth_or_stencil(res->format);
+}
+
+
 static struct pipe_resource *
 llvmpipe_resource_create(struct pipe_screen *_screen,
                          const struct pipe_resource *templat)
@@ -247,6 +327,28 @@ llvmpipe_resource_create(struct pipe_screen *_screen,
          /* texture map */
          if (!llvmpipe_texture_layout(screen, lpr))
             goto fail;
+
+         lpr->tiled = llvmpipe_can_tile(&lpr->base);
+      }
+
+      if (llvmpipe_can_defer_clears(&lpr->base)) {
+         unsigned tiles_x = align(lpr->base.width0, TILE_SIZE) / TILE_SIZE;
+         unsigned tiles_y = align(lpr->base.height0, TILE_SIZE) / TILE_SIZE;
+
+         /* clears are just written immediately if this fails */
+         lpr->tile_clears = CALLOC(tiles_x * tiles_y,
+                                   sizeof *lpr->tile_clears);
+      }
+
+      if (lpr->dt && screen->winsys->displaytarget_display_damage &&
+          !(LP_PERF & PERF_NO_DAMAGE)) {
+         unsigned tiles_x = align(lpr->base.width0, TILE_SIZE) / TILE_SIZE;
+         unsigned tiles_y = align(lpr->base.height0, TILE_SIZE) / TILE_SIZE;
+
+         /* presents are just done in whole if this fails */
+         lpr->dirty_tiles = MALLOC(tiles_x * tiles_y);
+         if (lpr->dirty_tiles)
+            memset(lpr->dirty_tiles, 1, tiles_x * tiles_y);
       }
    }
    else {
@@ -316,10 +418,260 @@ llvmpipe_resource_destroy(struct pipe_screen *pscreen,
       remove_from_list(lpr);
 #endif
 
+   FREE(lpr->tile_clears);
+   FREE(lpr->dirty_tiles);
    FREE(lpr);
 }
 
 
+/**
+ * Mark the tiles of a display target touched by a box as changed, for
+ * writes other than by the rasterizer.
+ */
+void
+llvmpipe_resource_damage(struct llvmpipe_resource *lpr,
+                         const struct pipe_box *box)
+{
+   const unsigned tiles_x = align(lpr->base.width0, TILE_SIZE) / TILE_SIZE;
+   const unsigned tiles_y = align(lpr->base.height0, TILE_SIZE) / TILE_SIZE;
+   unsigned tx0, ty0, tx1, ty1, ty;
+
+   if (!lpr->dirty_tiles || box->width <= 0 || box->height <= 0)
+      return;
+
+   tx0 = box->x / TILE_SIZE;
+   ty0 = box->y / TILE_SIZE;
+   tx1 = MIN2((box->x + box->width - 1) / TILE_SIZE, tiles_x - 1);
+   ty1 = MIN2((box->y + box->height - 1) / TILE_SIZE, tiles_y - 1);
+
+   for (ty = ty0; ty <= ty1 && tx0 <= tx1; ty++) {
+      memset(&lpr->dirty_tiles[ty * tiles_x + tx0], 1, tx1 - tx0 + 1);
+   }
+}
+
+
+/**
+ * Write the clears deferred by the rasterizer to memory.
+ * Must be called before the resource's memory is accessed by anything
+ * other than the rasterizer.
+ */
+void
+llvmpipe_resource_resolve_clears(struct llvmpipe_resource *lpr)
+{
+   const enum pipe_format format = lpr->base.format;
+   const unsigned width = lpr->base.width0;
+   const unsigned height = lpr->base.height0;
+   const unsigned tiles_x = align(width, TILE_SIZE) / TILE_SIZE;
+   const unsigned tiles_y = align(height, TILE_SIZE) / TILE_SIZE;
+   const boolean is_zs = util_format_is_depth_or_stencil(format);
+   uint8_t *map;
+   unsigned tx, ty;
+
+   if (!lpr->clears_pending)
+      return;
+
+   map = llvmpipe_resource_map(&lpr->base, 0, 0, LP_TEX_USAGE_READ_WRITE);
+
+   for (ty = 0; ty < tiles_y; ty++) {
+      for (tx = 0; tx < tiles_x; tx++) {
+         struct llvmpipe_tile_clear *tile = &lpr->tile_clears[ty * tiles_x + tx];
+         const unsigned x = tx * TILE_SIZE;
+         const unsigned y = ty * TILE_SIZE;
+         union util_color uc;
+
+         if (!tile->pending)
+            continue;
+
+         tile->pending = FALSE;
+
+         if (!map)
+            continue;
+
+         if (is_zs) {
+            switch (util_format_get_blocksize(format)) {
+            case 1:
+               uc.ub = (uint8_t) tile->value.zs;
+               break;
+            case 2:
+               uc.us = (uint16_t) tile->value.zs;
+               break;
+            case 4:
+               uc.ui = (uint32_t) tile->value.zs;
+               break;
+            default:
+               memcpy(&uc, &tile->value.zs, sizeof tile->value.zs);
+               break;
+            }
+         }
+         else {
+            uc = tile->value.color;
+         }
+
+         util_fill_rect(map, format, lpr->row_stride[0], x, y,
+                        MIN2(TILE_SIZE, width - x),
+                        MIN2(TILE_SIZE, height - y),
+                        &uc);
+      }
+   }
+
+   if (map)
+      llvmpipe_resource_unmap(&lpr->base, 0, 0);
+
+   lpr->clears_pending = FALSE;
+}
+
+
+/**
+ * Copy a box of texels of one image between the tiled layout and a linear
+ * buffer, see LP_SAMPLER_TILE_SIZE.
+ */
+static void
+llvmpipe_copy_tiled_box(uint8_t *tiled, unsigned tiled_stride,
+                        uint8_t *linear, unsigned linear_stride,
+                        unsigned texel_bytes,
+                        unsigned x0, unsigned y0,
+                        unsigned width, unsigned height,
+                        boolean to_tiled)
+{
+   const unsigned tile_mask = LP_SAMPLER_TILE_SIZE - 1;
+   unsigned x, y;
+
+   for (y = 0; y < height; y++) {
+      const unsigned ty = y0 + y;
+      uint8_t *tiled_row = tiled + (ty & ~tile_mask) * tiled_stride +
+                           (ty & tile_mask) * LP_SAMPLER_TILE_SIZE * texel_bytes;
+      uint8_t *linear_row = linear + y * linear_stride;
+
+      for (x = 0; x < width; ) {
+         const unsigned tx = x0 + x;
+         /* texels are contiguous up to the end of the tile row */
+         const unsigned n = MIN2(LP_SAMPLER_TILE_SIZE - (tx & tile_mask),
+                                 width - x);
+         uint8_t *t = tiled_row +
+                      ((tx & ~tile_mask) * LP_SAMPLER_TILE_SIZE +
+                       (tx & tile_mask)) * texel_bytes;
+         uint8_t *l = linear_row + x * texel_bytes;
+
+         if (to_tiled)
+            memcpy(t, l, n * texel_bytes);
+         else
+            memcpy(l, t, n * texel_bytes);
+
+         x += n;
+      }
+   }
+}
+
+
+/**
+ * Convert one row of tiles to the linear layout in place.
+ *
+ * Each tile holds LP_SAMPLER_TILE_SIZE segments of \p seg bytes, one per
+ * texel row, so packing the rows of the \p ntiles tiles densely is a
+ * transpose of a ntiles x LP_SAMPLER_TILE_SIZE matrix of segments.  That
+ * is done by following the cycles of the permutation, and the rows are
+ * then moved apart to \p stride, starting with the last one.
+ */
+static void
+llvmpipe_untile_row(uint8_t *row, unsigned ntiles, unsigned seg,
+                    unsigned stride)
+{
+   const unsigned n = ntiles * LP_SAMPLER_TILE_SIZE;
+   uint32_t moved[LP_MAX_WIDTH / 32];
+   uint8_t tmp[LP_SAMPLER_TILE_SIZE * 16];
+   unsigned start, dst, src, r;
+
+   assert(n <= LP_MAX_WIDTH);
+   assert(seg <= sizeof tmp);
+   assert(ntiles * seg <= stride);
+
+   memset(moved, 0, (n + 31) / 32 * sizeof moved[0]);
+
+   for (start = 0; start < n; start++) {
+      if (moved[start / 32] & (1u << (start % 32)))
+         continue;
+
+      /* Fill each linear position from the tiled position it takes its
+       * segment from, until the cycle gets back to the start.
+       */
+      memcpy(tmp, row + start * seg, seg);
+      dst = start;
+      for (;;) {
+         moved[dst / 32] |= 1u << (dst % 32);
+         src = (dst % ntiles) * LP_SAMPLER_TILE_SIZE + dst / ntiles;
+         if (src == start)
+            break;
+         memcpy(row + dst * seg, row + src * seg, seg);
+         dst = src;
+      }
+      memcpy(row + dst * seg, tmp, seg);
+   }
+
+   for (r = LP_SAMPLER_TILE_SIZE - 1; r > 0; r--)
+      memmove(row + r * stride, row + r * ntiles * seg, ntiles * seg);
+}
+
+
+/**
+ * Switch a tiled texture to the linear layout for good.
+ * Must be called before the texture's memory is accessed by anything
+ * other than the fragment shader sampler or transfers.
+ */
+void
+llvmpipe_resource_untile(struct pipe_context *pipe,
+                         struct llvmpipe_resource *lpr)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(lpr->base.screen);
+   const unsigned texel_bytes = util_format_get_blocksize(lpr->base.format);
+   unsigned level, slice, y;
+
+   if (!lpr->tiled)
+      return;
+
+   /* queued scenes sample the tiled layout */
+   llvmpipe_flush_resource(pipe, &lpr->base, 0,
+                           FALSE, /* read_only */
+                           TRUE, /* cpu_access */
+                           FALSE, /* do_not_block */
+                           __FUNCTION__);
+
+   if (LP_DEBUG & DEBUG_TEX) {
+      debug_printf("llvmpipe: untiling texture %u\n", lpr->id);
+   }
+
+   if (lpr->linear_img.data) {
+      /*
+       * A row of tiles occupies the same bytes as the linear rows it holds,
+       * and the image height is padded to whole tile rows, so each tile row
+       * can be converted on its own.
+       */
+      for (level = 0; level <= lpr->base.last_level; level++) {
+         const unsigned width = u_minify(lpr->base.width0, level);
+         const unsigned height = u_minify(lpr->base.height0, level);
+         const unsigned row_stride = lpr->row_stride[level];
+         const unsigned ntiles = (width + LP_SAMPLER_TILE_SIZE - 1) >>
+                                 LP_SAMPLER_TILE_ORDER;
+
+         for (slice = 0; slice < lpr->num_slices_faces[level]; slice++) {
+            uint8_t *img = llvmpipe_get_texture_image_address(lpr, slice,
+                                                              level);
+
+            for (y = 0; y < height; y += LP_SAMPLER_TILE_SIZE) {
+               llvmpipe_untile_row(img + y * row_stride, ntiles,
+                                   LP_SAMPLER_TILE_SIZE * texel_bytes,
+                                   row_stride);
+            }
+         }
+      }
+   }
+
+   lpr->tiled = FALSE;
+
+   /* have the contexts pick up the new layout */
+   screen->timestamp++;
+}
+
+
 /**
  * Map a resource for read/write.
  */
@@ -474,6 +826,13 @@ llvmpipe_resource_get_handle(struct pipe_screen *screen,
    if (!lpr->dt)
       return FALSE;
 
+   /* others may access the memory at any time from now on */
+   llvmpipe_resource_resolve_clears(lpr);
+   FREE(lpr->tile_clears);
+   lpr->tile_clears = NULL;
+   FREE(lpr->dirty_tiles);
+   lpr->dirty_tiles = NULL;
+
    return winsys->displaytarget_get_handle(winsys, lpr->dt, whandle);
 }
 
@@ -499,6 +858,10 @@ llvmpipe_transfer_map( struct pipe_context *pipe,
    assert(resource);
    assert(level <= resource->last_level);
 
+   if (usage & PIPE_TRANSFER_MAP_DIRECTLY) {
+      llvmpipe_resource_untile(pipe, lpr);
+   }
+
    /*
     * Transfers, like other pipe operations, must happen in order, so flush the
     * context if necessary.
@@ -570,6 +933,8 @@ llvmpipe_transfer_map( struct pipe_context *pipe,
 
    format = lpr->base.format;
 
+   llvmpipe_resource_resolve_clears(lpr);
+
    map = llvmpipe_resource_map(resource,
                                level,
                                box->z,
@@ -583,6 +948,45 @@ llvmpipe_transfer_map( struct pipe_context *pipe,
       /* Do something to notify sharing contexts of a texture change.
        */
       screen->timestamp++;
+
+      llvmpipe_resource_damage(lpr, box);
+   }
+
+   if (lpr->tiled) {
+      /*
+       * Hand out a linear copy of the box, which llvmpipe_transfer_unmap()
+       * writes back.
+       */
+      const unsigned texel_bytes = util_format_get_blocksize(format);
+      unsigned z;
+
+      pt->stride = align(box->width * texel_bytes, 16);
+      pt->layer_stride = pt->stride * box->height;
+
+      lpt->staging = align_malloc(pt->layer_stride * box->depth, 16);
+      if (!lpt->staging) {
+         pipe_resource_reference(&pt->resource, NULL);
+         FREE(lpt);
+         *transfer = NULL;
+         return NULL;
+      }
+
+      if (map &&
+          !(usage & (PIPE_TRANSFER_DISCARD_RANGE |
+                     PIPE_TRANSFER_DISCARD_WHOLE_RESOURCE))) {
+         for (z = 0; z < box->depth; z++) {
+            llvmpipe_copy_tiled_box(map + z * lpr->img_stride[level],
+                                    lpr->row_stride[level],
+                                    (uint8_t *) lpt->staging +
+                                    z * pt->layer_stride,
+                                    pt->stride,
+                                    texel_bytes,
+                                    box->x, box->y, box->width, box->height,
+                                    FALSE);
+         }
+      }
+
+      return lpt->staging;
    }
 
    map +=
@@ -597,8 +1001,45 @@ static void
 llvmpipe_transfer_unmap(struct pipe_context *pipe,
                         struct pipe_transfer *transfer)
 {
+   struct llvmpipe_transfer *lpt = llvmpipe_transfer(transfer);
+
    assert(transfer->resource);
 
+   if (lpt->staging) {
+      struct llvmpipe_resource *lpr = llvmpipe_resource(transfer->resource);
+      const struct pipe_box *box = &transfer->box;
+      const unsigned level = transfer->level;
+      uint8_t *map;
+      unsigned z;
+
+      if ((transfer->usage & PIPE_TRANSFER_WRITE) &&
+          (map = llvmpipe_resource_map(transfer->resource, level, box->z,
+                                       LP_TEX_USAGE_READ_WRITE))) {
+         for (z = 0; z < box->depth; z++) {
+            uint8_t *dst = map + z * lpr->img_stride[level];
+            uint8_t *src = (uint8_t *) lpt->staging +
+                           z * transfer->layer_stride;
+
+            /* the texture may have been untiled in the meantime */
+            if (lpr->tiled) {
+               llvmpipe_copy_tiled_box(dst, lpr->row_stride[level],
+                                       src, transfer->stride,
+                                       util_format_get_blocksize(lpr->base.format),
+                                       box->x, box->y,
+                                       box->width, box->height,
+                                       TRUE);
+            }
+            else {
+               util_copy_rect(dst, lpr->base.format, lpr->row_stride[level],
+                              box->x, box->y, box->width, box->height,
+                              src, transfer->stride, 0, 0);
+            }
+         }
+      }
+
+      align_free(lpt->staging);
+   }
+
    llvmpipe_resource_unmap(transfer->resource,
                            transfer->level,
                            transfer->box.z);
@@ -708,13 +1149,14 @@ tex_image_face_size(const struct llvmpipe_resource *lpr, unsigned level)
 
 /**
  * Compute size (in bytes) need to store a texture image / mipmap level,
- * including all cube faces or 3D image slices
+ * including all cube faces or 3D image slices and all samples
  */
 static unsigned
 tex_image_size(const struct llvmpipe_resource *lpr, unsigned level)
 {
    const unsigned buf_size = tex_image_face_size(lpr, level);
-   return buf_size * lpr->num_slices_faces[level];
+   const unsigned samples = MAX2(lpr->base.nr_samples, 1);
+   return buf_size * lpr->num_slices_faces[level] * samples;
 }
 
 
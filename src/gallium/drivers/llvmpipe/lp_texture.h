@@ -31,6 +31,7 @@
 
 #include "pipe/p_state.h"
 #include "util/u_debug.h"
+#include "util/u_pack_color.h"
 #include "lp_limits.h"
 
 
@@ -56,6 +57,20 @@ struct llvmpipe_texture_image
 };
 
 
+/**
+ * A clear of a render target tile which the rasterizer hasn't written to
+ * memory yet.
+ */
+struct llvmpipe_tile_clear
+{
+   boolean pending;
+   union {
+      union util_color color;  /**< packed color */
+      uint64_t zs;             /**< packed depth/stencil */
+   } value;
+};
+
+
 /**
  * llvmpipe subclass of pipe_resource.  A texture, drawing surface,
  * vertex buffer, const buffer, etc.
@@ -75,6 +90,11 @@ struct llvmpipe_resource
    unsigned num_slices_faces[LP_MAX_TEXTURE_LEVELS];
    /** Offset to start of mipmap level, in bytes */
    unsigned linear_mip_offsets[LP_MAX_TEXTURE_LEVELS];
+   /**
+    * Offset between the copies of the (single level) image holding the
+    * samples of a multisampled resource, in bytes.  Zero otherwise.
+    */
+   unsigned sample_stride;
 
    /**
     * Display target, for textures with the PIPE_BIND_DISPLAY_TARGET
@@ -92,6 +112,33 @@ struct llvmpipe_resource
     */
    void *data;
 
+   /**
+    * Clears of the tiles of a single level, single layer render target
+    * which are deferred until the memory is accessed other than by the
+    * rasterizer, indexed by tile row and column.  NULL if clears of this
+    * resource are always written immediately.
+    */
+   struct llvmpipe_tile_clear *tile_clears;
+   boolean clears_pending;  /**< tile_clears may hold pending clears */
+
+   /**
+    * Whether each tile of a display target has changed since the display
+    * target was last presented, indexed by tile row and column.  NULL if
+    * the winsys can't present partial updates, or others may write to the
+    * display target.
+    */
+   uint8_t *dirty_tiles;
+   /** The drawable the display target was last presented to in whole */
+   void *presented_to;
+
+   /**
+    * The images are stored in tiles (see LP_SAMPLER_TILE_SIZE) rather than
+    * linearly.  Only fragment shader sampling and transfers deal with this,
+    * everything else switches the texture to the linear layout for good
+    * with llvmpipe_resource_untile().
+    */
+   boolean tiled;
+
    boolean userBuffer;  /** Is this a user-space buffer? */
    unsigned timestamp;
 
@@ -109,6 +156,9 @@ struct llvmpipe_transfer
    struct pipe_transfer base;
 
    unsigned long offset;
+
+   /** Linear copy of the box of a tiled texture, or NULL */
+   void *staging;
 };
 
 
@@ -200,6 +250,14 @@ llvmpipe_resource_stride(struct pipe_resource *resource,
 }
 
 
+static INLINE unsigned
+llvmpipe_sample_stride(struct pipe_resource *resource)
+{
+   struct llvmpipe_resource *lpr = llvmpipe_resource(resource);
+   return lpr->sample_stride;
+}
+
+
 void *
 llvmpipe_resource_map(struct pipe_resource *resource,
                       unsigned level,
@@ -220,6 +278,19 @@ unsigned
 llvmpipe_resource_size(const struct pipe_resource *resource);
 
 
+void
+llvmpipe_resource_resolve_clears(struct llvmpipe_resource *lpr);
+
+
+void
+llvmpipe_resource_damage(struct llvmpipe_resource *lpr,
+                         const struct pipe_box *box);
+
+void
+llvmpipe_resource_untile(struct pipe_context *pipe,
+                         struct llvmpipe_resource *lpr);
+
+
 ubyte *
 llvmpipe_get_texture_image_address(struct llvmpipe_resource *lpr,
                                    unsigned face_slice, unsigned level);
@@ -195,6 +195,7 @@ nv50_screen_get_param(struct pipe_screen *pscreen, enum pipe_cap param)
    case PIPE_CAP_ENDIANNESS:
       return PIPE_ENDIAN_LITTLE;
    case PIPE_CAP_TGSI_VS_LAYER:
+   case PIPE_CAP_SHAREABLE_CSOS:
       return 0;
    default:
       NOUVEAU_ERR("unknown PIPE_CAP %d\n", param);
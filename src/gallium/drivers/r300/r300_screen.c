@@ -165,6 +165,7 @@ static int r300_get_param(struct pipe_screen* pscreen, enum pipe_cap param)
         case PIPE_CAP_TEXTURE_BORDER_COLOR_QUIRK:
         case PIPE_CAP_MAX_TEXTURE_BUFFER_SIZE:
         case PIPE_CAP_TGSI_VS_LAYER:
+        case PIPE_CAP_SHAREABLE_CSOS:
             return 0;
 
         /* SWTCL-only features. */
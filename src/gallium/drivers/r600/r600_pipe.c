@@ -443,6 +443,7 @@ static int r600_get_param(struct pipe_screen* pscreen, enum pipe_cap param)
 	case PIPE_CAP_VERTEX_COLOR_CLAMPED:
 	case PIPE_CAP_USER_VERTEX_BUFFERS:
 	case PIPE_CAP_TGSI_VS_LAYER:
+	case PIPE_CAP_SHAREABLE_CSOS:
 		return 0;
 
 	/* Stream output. */
@@ -0,0 +1,1622 @@
+/**************************************************************************
+ *
+ * Copyright 2013 agent <agent@local>
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/*
+ * A pipe_context wrapper that records calls into command batches and
+ * replays them on a driver thread.
+ *
+ * Calls that only hand state to the driver are recorded along with copies
+ * of their arguments, holding references on any objects they point to
+ * until the driver thread has executed them.  Calls that return something
+ * (object creation, queries, maps, fences) first wait for the driver
+ * thread to go idle and then call the driver directly.
+ */
+
+
+#include "pipe/p_context.h"
+#include "pipe/p_state.h"
+#include "util/u_box.h"
+#include "util/u_framebuffer.h"
+#include "util/u_inlines.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+
+#include "th_context.h"
+
+
+enum th_deferred_type {
+   TH_DEFERRED_SAMPLER_VIEW,
+   TH_DEFERRED_SURFACE,
+   TH_DEFERRED_SO_TARGET
+};
+
+
+/*
+ * Batch management.
+ */
+
+static void
+th_execute_batch(struct threaded_context *th, struct th_batch *batch)
+{
+   uint8_t *ptr = (uint8_t *)batch->buffer;
+   uint8_t *end = ptr + batch->used;
+
+   while (ptr < end) {
+      struct th_call *call = (struct th_call *)ptr;
+
+      call->execute(th->pipe, call + 1);
+      ptr += call->size;
+   }
+
+   batch->used = 0;
+}
+
+/**
+ * Destroy the objects whose last reference went away since the last call.
+ * Must only be called from the driver thread or while it is idle.
+ */
+static void
+th_destroy_deferred(struct threaded_context *th)
+{
+   struct pipe_context *pipe = th->pipe;
+   struct util_dynarray list;
+   struct th_deferred_destroy *d;
+
+   pipe_mutex_lock(th->deferred_mutex);
+   if (!th->deferred.size) {
+      pipe_mutex_unlock(th->deferred_mutex);
+      return;
+   }
+   list = th->deferred;
+   util_dynarray_init(&th->deferred);
+   pipe_mutex_unlock(th->deferred_mutex);
+
+   for (d = util_dynarray_begin(&list);
+        (void *)d < util_dynarray_end(&list); d++) {
+      switch (d->type) {
+      case TH_DEFERRED_SAMPLER_VIEW: {
+         struct pipe_sampler_view *view = d->object;
+         view->context = pipe;
+         pipe->sampler_view_destroy(pipe, view);
+         break;
+      }
+      case TH_DEFERRED_SURFACE: {
+         struct pipe_surface *surf = d->object;
+         surf->context = pipe;
+         pipe->surface_destroy(pipe, surf);
+         break;
+      }
+      case TH_DEFERRED_SO_TARGET: {
+         struct pipe_stream_output_target *target = d->object;
+         target->context = pipe;
+         pipe->stream_output_target_destroy(pipe, target);
+         break;
+      }
+      }
+   }
+
+   util_dynarray_fini(&list);
+}
+
+static void
+th_defer_destroy(struct threaded_context *th, unsigned type, void *object)
+{
+   struct th_deferred_destroy d;
+
+   d.type = type;
+   d.object = object;
+
+   pipe_mutex_lock(th->deferred_mutex);
+   util_dynarray_append(&th->deferred, struct th_deferred_destroy, d);
+   pipe_mutex_unlock(th->deferred_mutex);
+}
+
+static PIPE_THREAD_ROUTINE(th_thread_func, param)
+{
+   struct threaded_context *th = param;
+
+   pipe_mutex_lock(th->mutex);
+   for (;;) {
+      while (th->executed == th->submitted && !th->kill)
+         pipe_condvar_wait(th->cond, th->mutex);
+
+      if (th->executed == th->submitted)
+         break;
+      pipe_mutex_unlock(th->mutex);
+
+      th_execute_batch(th, &th->batches[th->executed % TH_NUM_BATCHES]);
+      th_destroy_deferred(th);
+
+      pipe_mutex_lock(th->mutex);
+      th->executed++;
+      pipe_condvar_broadcast(th->cond);
+   }
+   pipe_mutex_unlock(th->mutex);
+
+   return 0;
+}
+
+/**
+ * Hand the current batch to the driver thread and wait until the next one
+ * is free for recording.
+ */
+static void
+th_submit(struct threaded_context *th)
+{
+   if (!th->batches[th->submitted % TH_NUM_BATCHES].used)
+      return;
+
+   pipe_mutex_lock(th->mutex);
+   th->submitted++;
+   pipe_condvar_broadcast(th->cond);
+   while (th->submitted - th->executed >= TH_NUM_BATCHES)
+      pipe_condvar_wait(th->cond, th->mutex);
+   pipe_mutex_unlock(th->mutex);
+}
+
+/**
+ * Wait until the driver thread has executed everything recorded so far, so
+ * that the driver context can be called directly.
+ */
+static void
+th_sync(struct threaded_context *th)
+{
+   th_submit(th);
+
+   pipe_mutex_lock(th->mutex);
+   while (th->executed != th->submitted)
+      pipe_condvar_wait(th->cond, th->mutex);
+   pipe_mutex_unlock(th->mutex);
+
+   th_destroy_deferred(th);
+}
+
+/**
+ * Record a call and return a pointer to payload_size bytes of storage for
+ * its arguments.
+ */
+static INLINE void *
+th_add_call(struct threaded_context *th, th_execute_func execute,
+            unsigned payload_size)
+{
+   unsigned size = align(sizeof(struct th_call) + payload_size, 8);
+   struct th_batch *batch = &th->batches[th->submitted % TH_NUM_BATCHES];
+   struct th_call *call;
+
+   assert(size <= TH_BATCH_SIZE);
+
+   if (batch->used + size > TH_BATCH_SIZE) {
+      th_submit(th);
+      batch = &th->batches[th->submitted % TH_NUM_BATCHES];
+   }
+
+   call = (struct th_call *)((uint8_t *)batch->buffer + batch->used);
+   call->execute = execute;
+   call->size = size;
+   batch->used += size;
+
+   return call + 1;
+}
+
+static boolean
+th_has_user_buffers(const struct threaded_context *th)
+{
+   unsigned i;
+
+   if (th->user_vertex_buffers || th->user_index_buffer)
+      return TRUE;
+
+   for (i = 0; i < PIPE_SHADER_TYPES; i++) {
+      if (th->user_constant_buffers[i])
+         return TRUE;
+   }
+
+   return FALSE;
+}
+
+
+/*
+ * Drawing and queries.
+ */
+
+static void
+th_exec_draw_vbo(struct pipe_context *pipe, void *payload)
+{
+   struct pipe_draw_info *info = payload;
+
+   pipe->draw_vbo(pipe, info);
+   pipe_so_target_reference(&info->count_from_stream_output, NULL);
+}
+
+static void
+th_draw_vbo(struct pipe_context *_pipe, const struct pipe_draw_info *info)
+{
+   struct threaded_context *th = threaded_context(_pipe);
+   struct pipe_draw_info *p;
+
+   /* User buffers are only valid for the duration of this call. */
+   if (th_has_user_buffers(th)) {
+      th_sync(th);
+      th->pipe->draw_vbo(th->pipe, info);
+      return;
+   }
+
+   p = th_add_call(th, th_exec_draw_vbo, sizeof(*p));
+   *p = *info;
+   p->count_from_stream_output = NULL;
+   pipe_so_target_reference(&p->count_from_stream_output,
+                            info->count_from_stream_output);
+}
+
+struct th_render_condition {
+   struct pipe_query *query;
+   boolean condition;
+   uint mode;
+};
+
+static void
+th_exec_render_condition(struct pipe_context *pipe, void *payload)
+{
+   struct th_render_condition *p = payload;
+
+   pipe->render_condition(pipe, p->query, p->condition, p->mode);
+}
+
+static void
+th_render_condition(struct pipe_context *_pipe,
+                    struct pipe_query *query,
+                    boolean condition,
+                    uint mode)
+{
+   struct th_render_condition *p =
+      th_add_call(threaded_context(_pipe), th_exec_render_condition,
+                  sizeof(*p));
+
+   p->query = query;
+   p->condition = condition;
+   p->mode = mode;
+}
+
+static struct pipe_query *
+th_create_query(struct pipe_context *_pipe, unsigned query_type)
+{
+   struct threaded_context *th = threaded_context(_pipe);
+
+   th_sync(th);
+   return th->pipe->create_query(th->pipe, query_type);
+}
+
+static void
+th_exec_destroy_query(struct pipe_context *pipe, void *payload)
+{
+   pipe->destroy_query(pipe, *(struct pipe_query **)payload);
+}
+
+static void
+th_destroy_query(struct pipe_context *_pipe, struct pipe_query *query)
+{
+   *(struct pipe_query **)th_add_call(threaded_context(_pipe),
+                                      th_exec_destroy_query,
+                                      sizeof(query)) = query;
+}
+
+static void
+th_exec_begin_query(struct pipe_context *pipe, void *payload)
+{
+   pipe->begin_query(pipe, *(struct pipe_query **)payload);
+}
+
+static void
+th_begin_query(struct pipe_context *_pipe, struct pipe_query *query)
+{
+   *(struct pipe_query **)th_add_call(threaded_context(_pipe),
+                                      th_exec_begin_query,
+                                      sizeof(query)) = query;
+}
+
+static void
+th_exec_end_query(struct pipe_context *pipe, void *payload)
+{
+   pipe->end_query(pipe, *(struct pipe_query **)payload);
+}
+
+static void
+th_end_query(struct pipe_context *_pipe, struct pipe_query *query)
+{
+   *(struct pipe_query **)th_add_call(threaded_context(_pipe),
+                                      th_exec_end_query,
+                                      sizeof(query)) = query;
+}
+
+static boolean
+th_get_query_result(struct pipe_context *_pipe,
+                    struct pipe_query *query,
+                    boolean wait,
+                    union pipe_query_result *result)
+{
+   struct threaded_context *th = threaded_context(_pipe);
+
+   th_sync(th);
+   return th->pipe->get_query_result(th->pipe, query, wait, result);
+}
+
+
+/*
+ * Constant state objects.  Creation is synchronous so that the driver
+ * object can be returned, binding and deletion are recorded.
+ */
+
+#define TH_CSO_CREATE(name, state_type)                                      \
+static void *                                                                \
+th_create_##name(struct pipe_context *_pipe, const struct state_type *state) \
+{                                                                            \
+   struct threaded_context *th = threaded_context(_pipe);                    \
+                                                                             \
+   th_sync(th);                                                              \
+   return th->pipe->create_##name(th->pipe, state);                          \
+}
+
+#define TH_CSO_BIND_DELETE(name)                                             \
+static void                                                                  \
+th_exec_bind_##name(struct pipe_context *pipe, void *payload)                \
+{                                                                            \
+   pipe->bind_##name(pipe, *(void **)payload);                               \
+}                                                                            \
+                                                                             \
+static void                                                                  \
+th_bind_##name(struct pipe_context *_pipe, void *state)                      \
+{                                                                            \
+   *(void **)th_add_call(threaded_context(_pipe), th_exec_bind_##name,       \
+                         sizeof(state)) = state;                             \
+}                                                                            \
+                                                                             \
+static void                                                                  \
+th_exec_delete_##name(struct pipe_context *pipe, void *payload)              \
+{                                                                            \
+   pipe->delete_##name(pipe, *(void **)payload);                             \
+}                                                                            \
+                                                                             \
+static void                                                                  \
+th_delete_##name(struct pipe_context *_pipe, void *state)                    \
+{                                                                            \
+   *(void **)th_add_call(threaded_context(_pipe), th_exec_delete_##name,     \
+                         sizeof(state)) = state;                             \
+}
+
+TH_CSO_CREATE(blend_state, pipe_blend_state)
+TH_CSO_BIND_DELETE(blend_state)
+TH_CSO_CREATE(rasterizer_state, pipe_rasterizer_state)
+TH_CSO_BIND_DELETE(rasterizer_state)
+TH_CSO_CREATE(depth_stencil_alpha_state, pipe_depth_stencil_alpha_state)
+TH_CSO_BIND_DELETE(depth_stencil_alpha_state)
+TH_CSO_CREATE(fs_state, pipe_shader_state)
+TH_CSO_BIND_DELETE(fs_state)
+TH_CSO_CREATE(vs_state, pipe_shader_state)
+TH_CSO_BIND_DELETE(vs_state)
+TH_CSO_CREATE(gs_state, pipe_shader_state)
+TH_CSO_BIND_DELETE(gs_state)
+TH_CSO_BIND_DELETE(vertex_elements_state)
+TH_CSO_CREATE(compute_state, pipe_compute_state)
+TH_CSO_BIND_DELETE(compute_state)
+
+static void *
+th_create_sampler_state(struct pipe_context *_pipe,
+                        const struct pipe_sampler_state *state)
+{
+   struct threaded_context *th = threaded_context(_pipe);
+
+   th_sync(th);
+   return th->pipe->create_sampler_state(th->pipe, state);
+}
+
+struct th_bind_sampler_states {
+   unsigned shader, start, count;
+   /* followed by count sampler states */
+};
+
+static void
+th_exec_bind_sampler_states(struct pipe_context *pipe, void *payload)
+{
+   struct th_bind_sampler_states *p = payload;
+
+   pipe->bind_sampler_states(pipe, p->shader, p->start, p->count,
+                             (void **)(p + 1));
+}
+
+static void
+th_bind_sampler_states(struct pipe_context *_pipe,
+                       unsigned shader, unsigned start, unsigned count,
+                       void **states)
+{
+   struct th_bind_sampler_states *p =
+      th_add_call(threaded_context(_pipe), th_exec_bind_sampler_states,
+                  sizeof(*p) + count * sizeof(void *));
+
+   p->shader = shader;
+   p->start = start;
+   p->count = count;
+   if (states)
+      memcpy(p + 1, states, count * sizeof(void *));
+   else
+      memset(p + 1, 0, count * sizeof(void *));
+}
+
+static void
+th_exec_delete_sampler_state(struct pipe_context *pipe, void *payload)
+{
+   pipe->delete_sampler_state(pipe, *(void **)payload);
+}
+
+static void
+th_delete_sampler_state(struct pipe_context *_pipe, void *state)
+{
+   *(void **)th_add_call(threaded_context(_pipe),
+                         th_exec_delete_sampler_state,
+                         sizeof(state)) = state;
+}
+
+static void *
+th_create_vertex_elements_state(struct pipe_context *_pipe,
+                                unsigned num_elements,
+                                const struct pipe_vertex_element *elements)
+{
+   struct threaded_context *th = threaded_context(_pipe);
+
+   th_sync(th);
+   return th->pipe->create_vertex_elements_state(th->pipe, num_elements,
+                                                 elements);
+}
+
+
+/*
+ * Parameter-like state.
+ */
+
+#define TH_SET_STATE(name, state_type)                                       \
+static void                                                                  \
+th_exec_set_##name(struct pipe_context *pipe, void *payload)                 \
+{                                                                            \
+   pipe->set_##name(pipe, payload);                                          \
+}                                                                            \
+                                                                             \
+static void                                                                  \
+th_set_##name(struct pipe_context *_pipe, const struct state_type *state)    \
+{                                                                            \
+   struct state_type *p = th_add_call(threaded_context(_pipe),               \
+                                      th_exec_set_##name, sizeof(*p));       \
+   *p = *state;                                                              \
+}
+
+TH_SET_STATE(blend_color, pipe_blend_color)
+TH_SET_STATE(stencil_ref, pipe_stencil_ref)
+TH_SET_STATE(clip_state, pipe_clip_state)
+TH_SET_STATE(polygon_stipple, pipe_poly_stipple)
+
+static void
+th_exec_set_sample_mask(struct pipe_context *pipe, void *payload)
+{
+   pipe->set_sample_mask(pipe, *(unsigned *)payload);
+}
+
+static void
+th_set_sample_mask(struct pipe_context *_pipe, unsigned sample_mask)
+{
+   *(unsigned *)th_add_call(threaded_context(_pipe), th_exec_set_sample_mask,
+                            sizeof(sample_mask)) = sample_mask;
+}
+
+struct th_state_array {
+   unsigned start, count;
+   /* followed by count states */
+};
+
+static void
+th_exec_set_scissor_states(struct pipe_context *pipe, void *payload)
+{
+   struct th_state_array *p = payload;
+
+   pipe->set_scissor_states(pipe, p->start, p->count,
+                            (struct pipe_scissor_state *)(p + 1));
+}
+
+static void
+th_set_scissor_states(struct pipe_context *_pipe,
+                      unsigned start, unsigned count,
+                      const struct pipe_scissor_state *states)
+{
+   struct th_state_array *p =
+      th_add_call(threaded_context(_pipe), th_exec_set_scissor_states,
+                  sizeof(*p) + count * sizeof(*states));
+
+   p->start = start;
+   p->count = count;
+   memcpy(p + 1, states, count * sizeof(*states));
+}
+
+static void
+th_exec_set_viewport_states(struct pipe_context *pipe, void *payload)
+{
+   struct th_state_array *p = payload;
+
+   pipe->set_viewport_states(pipe, p->start, p->count,
+                             (struct pipe_viewport_state *)(p + 1));
+}
+
+static void
+th_set_viewport_states(struct pipe_context *_pipe,
+                       unsigned start, unsigned count,
+                       const struct pipe_viewport_state *states)
+{
+   struct th_state_array *p =
+      th_add_call(threaded_context(_pipe), th_exec_set_viewport_states,
+                  sizeof(*p) + count * sizeof(*states));
+
+   p->start = start;
+   p->count = count;
+   memcpy(p + 1, states, count * sizeof(*states));
+}
+
+struct th_constant_buffer {
+   uint shader, index;
+   boolean is_null;
+   struct pipe_constant_buffer cb;
+};
+
+static void
+th_exec_set_constant_buffer(struct pipe_context *pipe, void *payload)
+{
+   struct th_constant_buffer *p = payload;
+
+   pipe->set_constant_buffer(pipe, p->shader, p->index,
+                             p->is_null ? NULL : &p->cb);
+   pipe_resource_reference(&p->cb.buffer, NULL);
+}
+
+static void
+th_set_constant_buffer(struct pipe_context *_pipe,
+                       uint shader, uint index,
+                       struct pipe_constant_buffer *cb)
+{
+   struct threaded_context *th = threaded_context(_pipe);
+   struct th_constant_buffer *p;
+
+   if (cb && cb->user_buffer) {
+      th->user_constant_buffers[shader] |= 1u << index;
+      th_sync(th);
+      th->pipe->set_constant_buffer(th->pipe, shader, index, cb);
+      return;
+   }
+   th->user_constant_buffers[shader] &= ~(1u << index);
+
+   p = th_add_call(th, th_exec_set_constant_buffer, sizeof(*p));
+   p->shader = shader;
+   p->index = index;
+   p->is_null = cb == NULL;
+   memset(&p->cb, 0, sizeof(p->cb));
+   if (cb) {
+      pipe_resource_reference(&p->cb.buffer, cb->buffer);
+      p->cb.buffer_offset = cb->buffer_offset;
+      p->cb.buffer_size = cb->buffer_size;
+   }
+}
+
+static void
+th_exec_set_framebuffer_state(struct pipe_context *pipe, void *payload)
+{
+   struct pipe_framebuffer_state *fb = payload;
+
+   pipe->set_framebuffer_state(pipe, fb);
+   util_unreference_framebuffer_state(fb);
+}
+
+static void
+th_set_framebuffer_state(struct pipe_context *_pipe,
+                         const struct pipe_framebuffer_state *state)
+{
+   struct pipe_framebuffer_state *p =
+      th_add_call(threaded_context(_pipe), th_exec_set_framebuffer_state,
+                  sizeof(*p));
+
+   memset(p, 0, sizeof(*p));
+   util_copy_framebuffer_state(p, state);
+}
+
+struct th_sampler_views {
+   unsigned shader, start, count;
+   boolean is_null;
+   /* followed by count views */
+};
+
+static void
+th_exec_set_sampler_views(struct pipe_context *pipe, void *payload)
+{
+   struct th_sampler_views *p = payload;
+   struct pipe_sampler_view **views = (struct pipe_sampler_view **)(p + 1);
+   unsigned i;
+
+   pipe->set_sampler_views(pipe, p->shader, p->start, p->count,
+                           p->is_null ? NULL : views);
+
+   for (i = 0; i < p->count; i++)
+      pipe_sampler_view_reference(&views[i], NULL);
+}
+
+static void
+th_set_sampler_views(struct pipe_context *_pipe,
+                     unsigned shader, unsigned start, unsigned count,
+                     struct pipe_sampler_view **views)
+{
+   struct th_sampler_views *p =
+      th_add_call(threaded_context(_pipe), th_exec_set_sampler_views,
+                  sizeof(*p) + count * sizeof(*views));
+   struct pipe_sampler_view **dst = (struct pipe_sampler_view **)(p + 1);
+   unsigned i;
+
+   p->shader = shader;
+   p->start = start;
+   p->count = count;
+   p->is_null = views == NULL;
+
+   memset(dst, 0, count * sizeof(*views));
+   if (views) {
+      for (i = 0; i < count; i++)
+         pipe_sampler_view_reference(&dst[i], views[i]);
+   }
+}
+
+struct th_vertex_buffers {
+   unsigned start, count;
+   boolean is_null;
+   /* followed by count buffers */
+};
+
+static void
+th_exec_set_vertex_buffers(struct pipe_context *pipe, void *payload)
+{
+   struct th_vertex_buffers *p = payload;
+   struct pipe_vertex_buffer *buffers = (struct pipe_vertex_buffer *)(p + 1);
+   unsigned i;
+
+   pipe->set_vertex_buffers(pipe, p->start, p->count,
+                            p->is_null ? NULL : buffers);
+
+   for (i = 0; i < p->count; i++)
+      pipe_resource_reference(&buffers[i].buffer, NULL);
+}
+
+static void
+th_set_vertex_buffers(struct pipe_context *_pipe,
+                      unsigned start, unsigned count,
+                      const struct pipe_vertex_buffer *buffers)
+{
+   struct threaded_context *th = threaded_context(_pipe);
+   unsigned mask = ((1ull << count) - 1) << start;
+   struct th_vertex_buffers *p;
+   struct pipe_vertex_buffer *dst;
+   unsigned i;
+
+   th->user_vertex_buffers &= ~mask;
+
+   if (buffers) {
+      for (i = 0; i < count; i++) {
+         if (buffers[i].user_buffer)
+            th->user_vertex_buffers |= 1u << (start + i);
+      }
+
+      if (th->user_vertex_buffers & mask) {
+         th_sync(th);
+         th->pipe->set_vertex_buffers(th->pipe, start, count, buffers);
+         return;
+      }
+   }
+
+   p = th_add_call(th, th_exec_set_vertex_buffers,
+                   sizeof(*p) + count * sizeof(*buffers));
+   dst = (struct pipe_vertex_buffer *)(p + 1);
+
+   p->start = start;
+   p->count = count;
+   p->is_null = buffers == NULL;
+
+   memset(dst, 0, count * sizeof(*buffers));
+   if (buffers) {
+      for (i = 0; i < count; i++) {
+         dst[i].stride = buffers[i].stride;
+         dst[i].buffer_offset = buffers[i].buffer_offset;
+         pipe_resource_reference(&dst[i].buffer, buffers[i].buffer);
+      }
+   }
+}
+
+struct th_index_buffer {
+   boolean is_null;
+   struct pipe_index_buffer ib;
+};
+
+static void
+th_exec_set_index_buffer(struct pipe_context *pipe, void *payload)
+{
+   struct th_index_buffer *p = payload;
+
+   pipe->set_index_buffer(pipe, p->is_null ? NULL : &p->ib);
+   pipe_resource_reference(&p->ib.buffer, NULL);
+}
+
+static void
+th_set_index_buffer(struct pipe_context *_pipe,
+                    const struct pipe_index_buffer *ib)
+{
+   struct threaded_context *th = threaded_context(_pipe);
+   struct th_index_buffer *p;
+
+   th->user_index_buffer = ib && ib->user_buffer;
+   if (th->user_index_buffer) {
+      th_sync(th);
+      th->pipe->set_index_buffer(th->pipe, ib);
+      return;
+   }
+
+   p = th_add_call(th, th_exec_set_index_buffer, sizeof(*p));
+   p->is_null = ib == NULL;
+   memset(&p->ib, 0, sizeof(p->ib));
+   if (ib) {
+      p->ib.index_size = ib->index_size;
+      p->ib.offset = ib->offset;
+      pipe_resource_reference(&p->ib.buffer, ib->buffer);
+   }
+}
+
+static void
+th_set_shader_resources(struct pipe_context *_pipe,
+                        unsigned start, unsigned count,
+                        struct pipe_surface **resources)
+{
+   struct threaded_context *th = threaded_context(_pipe);
+
+   th_sync(th);
+   th->pipe->set_shader_resources(th->pipe, start, count, resources);
+}
+
+
+/*
+ * Stream output.
+ */
+
+static struct pipe_stream_output_target *
+th_create_stream_output_target(struct pipe_context *_pipe,
+                               struct pipe_resource *resource,
+                               unsigned buffer_offset,
+                               unsigned buffer_size)
+{
+   struct threaded_context *th = threaded_context(_pipe);
+   struct pipe_stream_output_target *target;
+
+   th_sync(th);
+   target = th->pipe->create_stream_output_target(th->pipe, resource,
+                                                  buffer_offset, buffer_size);
+   if (target)
+      target->context = _pipe;
+   return target;
+}
+
+static void
+th_stream_output_target_destroy(struct pipe_context *_pipe,
+                                struct pipe_stream_output_target *target)
+{
+   th_defer_destroy(threaded_context(_pipe), TH_DEFERRED_SO_TARGET, target);
+}
+
+struct th_so_targets {
+   unsigned count;
+   unsigned append_bitmask;
+   struct pipe_stream_output_target *targets[PIPE_MAX_SO_BUFFERS];
+};
+
+static void
+th_exec_set_stream_output_targets(struct pipe_context *pipe, void *payload)
+{
+   struct th_so_targets *p = payload;
+   unsigned i;
+
+   pipe->set_stream_output_targets(pipe, p->count, p->targets,
+                                   p->append_bitmask);
+
+   for (i = 0; i < p->count; i++)
+      pipe_so_target_reference(&p->targets[i], NULL);
+}
+
+static void
+th_set_stream_output_targets(struct pipe_context *_pipe,
+                             unsigned count,
+                             struct pipe_stream_output_target **targets,
+                             unsigned append_bitmask)
+{
+   struct th_so_targets *p =
+      th_add_call(threaded_context(_pipe), th_exec_set_stream_output_targets,
+                  sizeof(*p));
+   unsigned i;
+
+   assert(count <= PIPE_MAX_SO_BUFFERS);
+
+   p->count = count;
+   p->append_bitmask = append_bitmask;
+   memset(p->targets, 0, sizeof(p->targets));
+   for (i = 0; i < count; i++)
+      pipe_so_target_reference(&p->targets[i], targets[i]);
+}
+
+
+/*
+ * Views and surfaces.  Their context pointer is redirected to the threaded
+ * context, so that dropping the last reference from either thread ends up
+ * in the deferred destruction list.
+ */
+
+static struct pipe_sampler_view *
+th_create_sampler_view(struct pipe_context *_pipe,
+                       struct pipe_resource *resource,
+                       const struct pipe_sampler_view *templ)
+{
+   struct threaded_context *th = threaded_context(_pipe);
+   struct pipe_sampler_view *view;
+
+   th_sync(th);
+   view = th->pipe->create_sampler_view(th->pipe, resource, templ);
+   if (view)
+      view->context = _pipe;
+   return view;
+}
+
+static void
+th_sampler_view_destroy(struct pipe_context *_pipe,
+                        struct pipe_sampler_view *view)
+{
+   th_defer_destroy(threaded_context(_pipe), TH_DEFERRED_SAMPLER_VIEW, view);
+}
+
+static struct pipe_surface *
+th_create_surface(struct pipe_context *_pipe,
+                  struct pipe_resource *resource,
+                  const struct pipe_surface *templ)
+{
+   struct threaded_context *th = threaded_context(_pipe);
+   struct pipe_surface *surf;
+
+   th_sync(th);
+   surf = th->pipe->create_surface(th->pipe, resource, templ);
+   if (surf)
+      surf->context = _pipe;
+   return surf;
+}
+
+static void
+th_surface_destroy(struct pipe_context *_pipe,
+                   struct pipe_surface *surf)
+{
+   th_defer_destroy(threaded_context(_pipe), TH_DEFERRED_SURFACE, surf);
+}
+
+
+/*
+ * Transfers.
+ */
+
+struct th_buffer_write {
+   struct pipe_resource *resource;
+   unsigned usage;
+   struct pipe_box box;
+   const void *data;
+   void *allocation;  /**< freed with align_free() once written */
+};
+
+static void
+th_exec_buffer_write(struct pipe_context *pipe, void *payload)
+{
+   struct th_buffer_write *p = payload;
+
+   pipe->transfer_inline_write(pipe, p->resource, 0, p->usage, &p->box,
+                               p->data, 0, 0);
+   align_free(p->allocation);
+   pipe_resource_reference(&p->resource, NULL);
+}
+
+/**
+ * Record an upload of size bytes at offset into the buffer, taking ownership
+ * of the aligned allocation that holds the data.
+ */
+static void
+th_record_buffer_write(struct threaded_context *th,
+                       struct pipe_resource *resource,
+                       unsigned usage, unsigned offset, unsigned size,
+                       const void *data, void *allocation)
+{
+   struct th_buffer_write *p =
+      th_add_call(th, th_exec_buffer_write, sizeof(*p));
+
+   p->resource = NULL;
+   pipe_resource_reference(&p->resource, resource);
+   p->usage = (usage & ~PIPE_TRANSFER_FLUSH_EXPLICIT) | PIPE_TRANSFER_WRITE;
+   u_box_1d(offset, size, &p->box);
+   p->data = data;
+   p->allocation = allocation;
+}
+
+static INLINE boolean
+th_is_discard_map(unsigned usage)
+{
+   return (usage & (PIPE_TRANSFER_DISCARD_RANGE |
+                    PIPE_TRANSFER_DISCARD_WHOLE_RESOURCE)) != 0;
+}
+
+/**
+ * Whether a map can be served from staging memory instead of waiting for
+ * the driver thread: the caller must not rely on the mapping being the real
+ * storage, and only bytes it writes may be uploaded.
+ *
+ * That holds for discarding maps, where the rest of the range is undefined
+ * anyway, and for unsynchronized maps with explicit flushes, where exactly
+ * the flushed regions are uploaded.
+ */
+static boolean
+th_can_stage_map(const struct pipe_resource *resource, unsigned usage)
+{
+   if (resource->target != PIPE_BUFFER)
+      return FALSE;
+
+   if ((usage & (PIPE_TRANSFER_READ_WRITE | PIPE_TRANSFER_MAP_DIRECTLY)) !=
+       PIPE_TRANSFER_WRITE)
+      return FALSE;
+
+   if (th_is_discard_map(usage))
+      return TRUE;
+
+   return (usage & PIPE_TRANSFER_UNSYNCHRONIZED) &&
+          (usage & PIPE_TRANSFER_FLUSH_EXPLICIT);
+}
+
+static void *
+th_transfer_map(struct pipe_context *_pipe,
+                struct pipe_resource *resource,
+                unsigned level,
+                unsigned usage,
+                const struct pipe_box *box,
+                struct pipe_transfer **transfer)
+{
+   struct threaded_context *th = threaded_context(_pipe);
+   struct threaded_transfer *tt;
+   void *map = NULL;
+
+   tt = CALLOC_STRUCT(threaded_transfer);
+   if (!tt)
+      return NULL;
+
+   if (th_can_stage_map(resource, usage)) {
+      /* Keep the staging pointer aligned like the buffer offset, callers
+       * may use aligned stores.
+       */
+      unsigned misalign = box->x & 15;
+
+      tt->staging = align_malloc(misalign + box->width, 16);
+      if (tt->staging) {
+         tt->map = (uint8_t *)tt->staging + misalign;
+         tt->flushed_start = box->width;
+         tt->flushed_end = 0;
+         map = tt->map;
+      }
+   }
+
+   if (!map) {
+      th_sync(th);
+      map = th->pipe->transfer_map(th->pipe, resource, level, usage, box,
+                                   &tt->transfer);
+      if (!map) {
+         FREE(tt);
+         return NULL;
+      }
+      tt->base.stride = tt->transfer->stride;
+      tt->base.layer_stride = tt->transfer->layer_stride;
+   }
+
+   pipe_resource_reference(&tt->base.resource, resource);
+   tt->base.level = level;
+   tt->base.usage = usage;
+   tt->base.box = *box;
+
+   *transfer = &tt->base;
+   return map;
+}
+
+static void
+th_transfer_flush_region(struct pipe_context *_pipe,
+                         struct pipe_transfer *transfer,
+                         const struct pipe_box *box)
+{
+   struct threaded_context *th = threaded_context(_pipe);
+   struct threaded_transfer *tt = threaded_transfer(transfer);
+
+   if (tt->staging) {
+      const uint8_t *data = tt->map + box->x;
+      void *copy;
+
+      /* The box is relative to the mapped range. */
+      if (th_is_discard_map(transfer->usage)) {
+         tt->flushed_start = MIN2(tt->flushed_start, box->x);
+         tt->flushed_end = MAX2(tt->flushed_end, box->x + box->width);
+         return;
+      }
+
+      /* The rest of the range holds live data, so upload exactly this
+       * region, from a copy as the staging memory may be written again.
+       */
+      copy = align_malloc(box->width, 16);
+      if (copy) {
+         memcpy(copy, data, box->width);
+         th_record_buffer_write(th, transfer->resource, transfer->usage,
+                                transfer->box.x + box->x, box->width,
+                                copy, copy);
+      }
+      else {
+         struct pipe_box dst;
+
+         u_box_1d(transfer->box.x + box->x, box->width, &dst);
+         th_sync(th);
+         th->pipe->transfer_inline_write(th->pipe, transfer->resource, 0,
+                                         (transfer->usage &
+                                          ~PIPE_TRANSFER_FLUSH_EXPLICIT),
+                                         &dst, data, 0, 0);
+      }
+      return;
+   }
+
+   th_sync(th);
+   th->pipe->transfer_flush_region(th->pipe, tt->transfer, box);
+}
+
+static void
+th_transfer_unmap(struct pipe_context *_pipe,
+                  struct pipe_transfer *transfer)
+{
+   struct threaded_context *th = threaded_context(_pipe);
+   struct threaded_transfer *tt = threaded_transfer(transfer);
+
+   if (tt->staging) {
+      unsigned start = 0, end = transfer->box.width;
+
+      if (!th_is_discard_map(transfer->usage)) {
+         /* Flushed regions have been uploaded already. */
+         start = end = 0;
+      }
+      else if (transfer->usage & PIPE_TRANSFER_FLUSH_EXPLICIT) {
+         start = tt->flushed_start;
+         end = tt->flushed_end;
+      }
+
+      if (start < end)
+         th_record_buffer_write(th, transfer->resource, transfer->usage,
+                                transfer->box.x + start, end - start,
+                                tt->map + start, tt->staging);
+      else
+         align_free(tt->staging);
+   }
+   else {
+      th_sync(th);
+      th->pipe->transfer_unmap(th->pipe, tt->transfer);
+   }
+
+   pipe_resource_reference(&tt->base.resource, NULL);
+   FREE(tt);
+}
+
+static void
+th_transfer_inline_write(struct pipe_context *_pipe,
+                         struct pipe_resource *resource,
+                         unsigned level,
+                         unsigned usage,
+                         const struct pipe_box *box,
+                         const void *data,
+                         unsigned stride,
+                         unsigned layer_stride)
+{
+   struct threaded_context *th = threaded_context(_pipe);
+
+   if (resource->target == PIPE_BUFFER) {
+      void *copy = align_malloc(box->width, 16);
+
+      if (copy) {
+         memcpy(copy, data, box->width);
+         th_record_buffer_write(th, resource, usage, box->x, box->width,
+                                copy, copy);
+         return;
+      }
+   }
+
+   th_sync(th);
+   th->pipe->transfer_inline_write(th->pipe, resource, level, usage, box,
+                                   data, stride, layer_stride);
+}
+
+
+/*
+ * Clears, copies and blits.
+ */
+
+struct th_clear {
+   unsigned buffers;
+   boolean has_color;
+   union pipe_color_union color;
+   double depth;
+   unsigned stencil;
+};
+
+static void
+th_exec_clear(struct pipe_context *pipe, void *payload)
+{
+   struct th_clear *p = payload;
+
+   pipe->clear(pipe, p->buffers, p->has_color ? &p->color : NULL,
+               p->depth, p->stencil);
+}
+
+static void
+th_clear(struct pipe_context *_pipe,
+         unsigned buffers,
+         const union pipe_color_union *color,
+         double depth,
+         unsigned stencil)
+{
+   struct th_clear *p =
+      th_add_call(threaded_context(_pipe), th_exec_clear, sizeof(*p));
+
+   p->buffers = buffers;
+   p->has_color = color != NULL;
+   if (color)
+      p->color = *color;
+   p->depth = depth;
+   p->stencil = stencil;
+}
+
+struct th_clear_render_target {
+   struct pipe_surface *dst;
+   union pipe_color_union color;
+   unsigned dstx, dsty, width, height;
+};
+
+static void
+th_exec_clear_render_target(struct pipe_context *pipe, void *payload)
+{
+   struct th_clear_render_target *p = payload;
+
+   pipe->clear_render_target(pipe, p->dst, &p->color,
+                             p->dstx, p->dsty, p->width, p->height);
+   pipe_surface_reference(&p->dst, NULL);
+}
+
+static void
+th_clear_render_target(struct pipe_context *_pipe,
+                       struct pipe_surface *dst,
+                       const union pipe_color_union *color,
+                       unsigned dstx, unsigned dsty,
+                       unsigned width, unsigned height)
+{
+   struct th_clear_render_target *p =
+      th_add_call(threaded_context(_pipe), th_exec_clear_render_target,
+                  sizeof(*p));
+
+   p->dst = NULL;
+   pipe_surface_reference(&p->dst, dst);
+   p->color = *color;
+   p->dstx = dstx;
+   p->dsty = dsty;
+   p->width = width;
+   p->height = height;
+}
+
+struct th_clear_depth_stencil {
+   struct pipe_surface *dst;
+   unsigned clear_flags;
+   double depth;
+   unsigned stencil;
+   unsigned dstx, dsty, width, height;
+};
+
+static void
+th_exec_clear_depth_stencil(struct pipe_context *pipe, void *payload)
+{
+   struct th_clear_depth_stencil *p = payload;
+
+   pipe->clear_depth_stencil(pipe, p->dst, p->clear_flags, p->depth,
+                             p->stencil, p->dstx, p->dsty,
+                             p->width, p->height);
+   pipe_surface_reference(&p->dst, NULL);
+}
+
+static void
+th_clear_depth_stencil(struct pipe_context *_pipe,
+                       struct pipe_surface *dst,
+                       unsigned clear_flags,
+                       double depth,
+                       unsigned stencil,
+                       unsigned dstx, unsigned dsty,
+                       unsigned width, unsigned height)
+{
+   struct th_clear_depth_stencil *p =
+      th_add_call(threaded_context(_pipe), th_exec_clear_depth_stencil,
+                  sizeof(*p));
+
+   p->dst = NULL;
+   pipe_surface_reference(&p->dst, dst);
+   p->clear_flags = clear_flags;
+   p->depth = depth;
+   p->stencil = stencil;
+   p->dstx = dstx;
+   p->dsty = dsty;
+   p->width = width;
+   p->height = height;
+}
+
+struct th_resource_copy_region {
+   struct pipe_resource *dst;
+   unsigned dst_level;
+   unsigned dstx, dsty, dstz;
+   struct pipe_resource *src;
+   unsigned src_level;
+   struct pipe_box src_box;
+};
+
+static void
+th_exec_resource_copy_region(struct pipe_context *pipe, void *payload)
+{
+   struct th_resource_copy_region *p = payload;
+
+   pipe->resource_copy_region(pipe, p->dst, p->dst_level,
+                              p->dstx, p->dsty, p->dstz,
+                              p->src, p->src_level, &p->src_box);
+   pipe_resource_reference(&p->dst, NULL);
+   pipe_resource_reference(&p->src, NULL);
+}
+
+static void
+th_resource_copy_region(struct pipe_context *_pipe,
+                        struct pipe_resource *dst,
+                        unsigned dst_level,
+                        unsigned dstx, unsigned dsty, unsigned dstz,
+                        struct pipe_resource *src,
+                        unsigned src_level,
+                        const struct pipe_box *src_box)
+{
+   struct th_resource_copy_region *p =
+      th_add_call(threaded_context(_pipe), th_exec_resource_copy_region,
+                  sizeof(*p));
+
+   p->dst = NULL;
+   p->src = NULL;
+   pipe_resource_reference(&p->dst, dst);
+   pipe_resource_reference(&p->src, src);
+   p->dst_level = dst_level;
+   p->dstx = dstx;
+   p->dsty = dsty;
+   p->dstz = dstz;
+   p->src_level = src_level;
+   p->src_box = *src_box;
+}
+
+static void
+th_exec_blit(struct pipe_context *pipe, void *payload)
+{
+   struct pipe_blit_info *info = payload;
+
+   pipe->blit(pipe, info);
+   pipe_resource_reference(&info->dst.resource, NULL);
+   pipe_resource_reference(&info->src.resource, NULL);
+}
+
+static void
+th_blit(struct pipe_context *_pipe, const struct pipe_blit_info *info)
+{
+   struct pipe_blit_info *p =
+      th_add_call(threaded_context(_pipe), th_exec_blit, sizeof(*p));
+
+   *p = *info;
+   p->dst.resource = NULL;
+   p->src.resource = NULL;
+   pipe_resource_reference(&p->dst.resource, info->dst.resource);
+   pipe_resource_reference(&p->src.resource, info->src.resource);
+}
+
+static void
+th_exec_flush_resource(struct pipe_context *pipe, void *payload)
+{
+   struct pipe_resource **resource = payload;
+
+   pipe->flush_resource(pipe, *resource);
+   pipe_resource_reference(resource, NULL);
+}
+
+static void
+th_flush_resource(struct pipe_context *_pipe, struct pipe_resource *resource)
+{
+   struct pipe_resource **p =
+      th_add_call(threaded_context(_pipe), th_exec_flush_resource,
+                  sizeof(*p));
+
+   *p = NULL;
+   pipe_resource_reference(p, resource);
+}
+
+static void
+th_exec_texture_barrier(struct pipe_context *pipe, void *payload)
+{
+   pipe->texture_barrier(pipe);
+}
+
+static void
+th_texture_barrier(struct pipe_context *_pipe)
+{
+   th_add_call(threaded_context(_pipe), th_exec_texture_barrier, 0);
+}
+
+
+/*
+ * Synchronous entrypoints.
+ */
+
+static void
+th_flush(struct pipe_context *_pipe,
+         struct pipe_fence_handle **fence,
+         unsigned flags)
+{
+   struct threaded_context *th = threaded_context(_pipe);
+
+   /* Flushes usually precede presentation or sharing with another context,
+    * both of which bypass this context, so drain the queue.
+    */
+   th_sync(th);
+   th->pipe->flush(th->pipe, fence, flags);
+}
+
+static void
+th_set_compute_resources(struct pipe_context *_pipe,
+                         unsigned start, unsigned count,
+                         struct pipe_surface **resources)
+{
+   struct threaded_context *th = threaded_context(_pipe);
+
+   th_sync(th);
+   th->pipe->set_compute_resources(th->pipe, start, count, resources);
+}
+
+static void
+th_set_global_binding(struct pipe_context *_pipe,
+                      unsigned first, unsigned count,
+                      struct pipe_resource **resources,
+                      uint32_t **handles)
+{
+   struct threaded_context *th = threaded_context(_pipe);
+
+   th_sync(th);
+   th->pipe->set_global_binding(th->pipe, first, count, resources, handles);
+}
+
+static void
+th_launch_grid(struct pipe_context *_pipe,
+               const uint *block_layout, const uint *grid_layout,
+               uint32_t pc, const void *input)
+{
+   struct threaded_context *th = threaded_context(_pipe);
+
+   th_sync(th);
+   th->pipe->launch_grid(th->pipe, block_layout, grid_layout, pc, input);
+}
+
+static void
+th_get_sample_position(struct pipe_context *_pipe,
+                       unsigned sample_count,
+                       unsigned sample_index,
+                       float *out_value)
+{
+   struct threaded_context *th = threaded_context(_pipe);
+
+   th_sync(th);
+   th->pipe->get_sample_position(th->pipe, sample_count, sample_index,
+                                 out_value);
+}
+
+/**
+ * Unbind the framebuffer, sampler views and stream output targets in the
+ * driver.
+ */
+static void
+th_unbind_all(struct pipe_context *pipe)
+{
+   struct pipe_sampler_view *views[PIPE_MAX_SHADER_SAMPLER_VIEWS];
+   struct pipe_framebuffer_state fb;
+   unsigned shader;
+
+   memset(&fb, 0, sizeof fb);
+   pipe->set_framebuffer_state(pipe, &fb);
+
+   memset(views, 0, sizeof views);
+   if (pipe->set_sampler_views) {
+      for (shader = 0; shader <= PIPE_SHADER_GEOMETRY; shader++)
+         pipe->set_sampler_views(pipe, shader, 0, Elements(views), views);
+   }
+
+   if (pipe->set_stream_output_targets)
+      pipe->set_stream_output_targets(pipe, 0, NULL, 0);
+}
+
+static void
+th_destroy(struct pipe_context *_pipe)
+{
+   struct threaded_context *th = threaded_context(_pipe);
+   struct pipe_context *pipe = th->pipe;
+
+   th_sync(th);
+
+   pipe_mutex_lock(th->mutex);
+   th->kill = TRUE;
+   pipe_condvar_broadcast(th->cond);
+   pipe_mutex_unlock(th->mutex);
+   pipe_thread_wait(th->thread);
+
+   /* The driver's bindings hold surfaces, views and targets which point
+    * back at us.  Unbind them while the driver is still alive, so that
+    * releasing them goes through the deferred list and back to the driver.
+    */
+   th_unbind_all(pipe);
+   th_destroy_deferred(th);
+
+   pipe->destroy(pipe);
+
+   /* Nothing may be deferred anymore, the driver is gone. */
+   assert(!th->deferred.size);
+   util_dynarray_fini(&th->deferred);
+
+   pipe_condvar_destroy(th->cond);
+   pipe_mutex_destroy(th->mutex);
+   pipe_mutex_destroy(th->deferred_mutex);
+
+   FREE(th);
+}
+
+
+struct pipe_context *
+threaded_context_create(struct pipe_screen *_screen, struct pipe_context *pipe)
+{
+   struct threaded_context *th;
+
+   th = CALLOC_STRUCT(threaded_context);
+   if (!th) {
+      pipe->destroy(pipe);
+      return NULL;
+   }
+
+   th->base.screen = _screen;
+   th->base.priv = pipe->priv;
+   th->base.draw = NULL;
+
+#define CTX_INIT(_member) \
+   th->base._member = pipe->_member ? th_##_member : NULL
+
+   th->base.destroy = th_destroy;
+   CTX_INIT(draw_vbo);
+   CTX_INIT(render_condition);
+   CTX_INIT(create_query);
+   CTX_INIT(destroy_query);
+   CTX_INIT(begin_query);
+   CTX_INIT(end_query);
+   CTX_INIT(get_query_result);
+   CTX_INIT(create_blend_state);
+   CTX_INIT(bind_blend_state);
+   CTX_INIT(delete_blend_state);
+   CTX_INIT(create_sampler_state);
+   CTX_INIT(bind_sampler_states);
+   CTX_INIT(delete_sampler_state);
+   CTX_INIT(create_rasterizer_state);
+   CTX_INIT(bind_rasterizer_state);
+   CTX_INIT(delete_rasterizer_state);
+   CTX_INIT(create_depth_stencil_alpha_state);
+   CTX_INIT(bind_depth_stencil_alpha_state);
+   CTX_INIT(delete_depth_stencil_alpha_state);
+   CTX_INIT(create_fs_state);
+   CTX_INIT(bind_fs_state);
+   CTX_INIT(delete_fs_state);
+   CTX_INIT(create_vs_state);
+   CTX_INIT(bind_vs_state);
+   CTX_INIT(delete_vs_state);
+   CTX_INIT(create_gs_state);
+   CTX_INIT(bind_gs_state);
+   CTX_INIT(delete_gs_state);
+   CTX_INIT(create_vertex_elements_state);
+   CTX_INIT(bind_vertex_elements_state);
+   CTX_INIT(delete_vertex_elements_state);
+   CTX_INIT(set_blend_color);
+   CTX_INIT(set_stencil_ref);
+   CTX_INIT(set_sample_mask);
+   CTX_INIT(set_clip_state);
+   CTX_INIT(set_constant_buffer);
+   CTX_INIT(set_framebuffer_state);
+   CTX_INIT(set_polygon_stipple);
+   CTX_INIT(set_scissor_states);
+   CTX_INIT(set_viewport_states);
+   CTX_INIT(set_sampler_views);
+   CTX_INIT(set_shader_resources);
+   CTX_INIT(set_vertex_buffers);
+   CTX_INIT(set_index_buffer);
+   CTX_INIT(create_stream_output_target);
+   CTX_INIT(stream_output_target_destroy);
+   CTX_INIT(set_stream_output_targets);
+   CTX_INIT(resource_copy_region);
+   CTX_INIT(blit);
+   CTX_INIT(clear);
+   CTX_INIT(clear_render_target);
+   CTX_INIT(clear_depth_stencil);
+   CTX_INIT(flush);
+   CTX_INIT(create_sampler_view);
+   CTX_INIT(sampler_view_destroy);
+   CTX_INIT(create_surface);
+   CTX_INIT(surface_destroy);
+   CTX_INIT(transfer_map);
+   CTX_INIT(transfer_flush_region);
+   CTX_INIT(transfer_unmap);
+   CTX_INIT(transfer_inline_write);
+   CTX_INIT(texture_barrier);
+   CTX_INIT(create_compute_state);
+   CTX_INIT(bind_compute_state);
+   CTX_INIT(delete_compute_state);
+   CTX_INIT(set_compute_resources);
+   CTX_INIT(set_global_binding);
+   CTX_INIT(launch_grid);
+   CTX_INIT(get_sample_position);
+   CTX_INIT(flush_resource);
+
+#undef CTX_INIT
+
+   /* Video codecs would call into the driver context behind our back. */
+   th->base.create_video_codec = NULL;
+   th->base.create_video_buffer = NULL;
+
+   th->pipe = pipe;
+
+   pipe_mutex_init(th->mutex);
+   pipe_mutex_init(th->deferred_mutex);
+   pipe_condvar_init(th->cond);
+   util_dynarray_init(&th->deferred);
+
+   th->thread = pipe_thread_create(th_thread_func, th);
+   if (!th->thread) {
+      pipe_condvar_destroy(th->cond);
+      pipe_mutex_destroy(th->mutex);
+      pipe_mutex_destroy(th->deferred_mutex);
+      pipe->destroy(pipe);
+      FREE(th);
+      return NULL;
+   }
+
+   return &th->base;
+}
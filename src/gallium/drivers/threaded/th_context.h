@@ -0,0 +1,132 @@
+/**************************************************************************
+ *
+ * Copyright 2013 agent <agent@local>
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#ifndef TH_CONTEXT_H
+#define TH_CONTEXT_H
+
+#include "pipe/p_state.h"
+#include "pipe/p_context.h"
+#include "os/os_thread.h"
+#include "util/u_dynarray.h"
+
+
+/** Number of command batches in flight between the two threads */
+#define TH_NUM_BATCHES 4
+
+/** Size in bytes of a single command batch */
+#define TH_BATCH_SIZE (64 * 1024)
+
+
+struct threaded_context;
+
+typedef void (*th_execute_func)(struct pipe_context *pipe, void *payload);
+
+/**
+ * Header of a recorded call.  The call's arguments follow it in the batch.
+ */
+struct th_call {
+   th_execute_func execute;
+   unsigned size;  /**< total size in bytes, including this header */
+};
+
+struct th_batch {
+   unsigned used;  /**< bytes recorded so far */
+   uint64_t buffer[TH_BATCH_SIZE / 8];
+};
+
+/**
+ * A view, surface or stream output target whose last reference was dropped,
+ * waiting for the driver thread to be idle before it is destroyed.
+ */
+struct th_deferred_destroy {
+   unsigned type;
+   void *object;
+};
+
+struct threaded_context {
+   struct pipe_context base;  /**< base class */
+
+   struct pipe_context *pipe;
+
+   pipe_thread thread;
+   pipe_mutex mutex;
+   pipe_condvar cond;
+
+   /* Batches are recorded into batches[submitted % TH_NUM_BATCHES].  Both
+    * counters are protected by the mutex; submitted is only written by the
+    * application thread and executed only by the driver thread.
+    */
+   unsigned submitted;
+   unsigned executed;
+   boolean kill;
+
+   struct th_batch batches[TH_NUM_BATCHES];
+
+   pipe_mutex deferred_mutex;
+   struct util_dynarray deferred;
+
+   /* Bound user buffers force draws to be synchronous. */
+   unsigned user_vertex_buffers;
+   boolean user_index_buffer;
+   unsigned user_constant_buffers[PIPE_SHADER_TYPES];
+};
+
+
+/**
+ * A mapping handed out by the threaded context.  Discarding buffer maps
+ * are staged in malloc'ed memory and uploaded asynchronously on unmap,
+ * everything else wraps the driver's own transfer.
+ */
+struct threaded_transfer {
+   struct pipe_transfer base;
+
+   struct pipe_transfer *transfer;  /**< driver transfer, or NULL if staged */
+
+   void *staging;                   /**< aligned allocation, if staged */
+   uint8_t *map;                    /**< staging data for box.x */
+   unsigned flushed_start, flushed_end;
+};
+
+
+static INLINE struct threaded_context *
+threaded_context(struct pipe_context *pipe)
+{
+   return (struct threaded_context *)pipe;
+}
+
+static INLINE struct threaded_transfer *
+threaded_transfer(struct pipe_transfer *transfer)
+{
+   return (struct threaded_transfer *)transfer;
+}
+
+
+struct pipe_context *
+threaded_context_create(struct pipe_screen *screen, struct pipe_context *pipe);
+
+#endif /* TH_CONTEXT_H */
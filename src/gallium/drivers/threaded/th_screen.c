@@ -0,0 +1,321 @@
+/**************************************************************************
+ *
+ * Copyright 2013 agent <agent@local>
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+
+#include "pipe/p_screen.h"
+#include "pipe/p_state.h"
+#include "util/u_debug.h"
+#include "util/u_memory.h"
+
+#include "th_public.h"
+#include "th_screen.h"
+#include "th_context.h"
+
+
+DEBUG_GET_ONCE_BOOL_OPTION(threaded, "GALLIUM_THREAD", FALSE)
+
+
+static void
+threaded_screen_destroy(struct pipe_screen *_screen)
+{
+   struct threaded_screen *th_screen = threaded_screen(_screen);
+   struct pipe_screen *screen = th_screen->screen;
+
+   screen->destroy(screen);
+
+   FREE(th_screen);
+}
+
+static const char *
+threaded_screen_get_name(struct pipe_screen *_screen)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   return screen->get_name(screen);
+}
+
+static const char *
+threaded_screen_get_vendor(struct pipe_screen *_screen)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   return screen->get_vendor(screen);
+}
+
+static int
+threaded_screen_get_param(struct pipe_screen *_screen,
+                          enum pipe_cap param)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   switch (param) {
+   case PIPE_CAP_USER_VERTEX_BUFFERS:
+   case PIPE_CAP_USER_INDEX_BUFFERS:
+   case PIPE_CAP_USER_CONSTANT_BUFFERS:
+      /* User memory may be gone by the time the driver thread reads it,
+       * so have the state tracker upload it instead.
+       */
+      return 0;
+   case PIPE_CAP_SHAREABLE_CSOS:
+      /* Another context's driver thread may still be about to bind an
+       * object when this context deletes it.
+       */
+      return 0;
+   default:
+      return screen->get_param(screen, param);
+   }
+}
+
+static int
+threaded_screen_get_shader_param(struct pipe_screen *_screen,
+                                 unsigned shader, enum pipe_shader_cap param)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   return screen->get_shader_param(screen, shader, param);
+}
+
+static float
+threaded_screen_get_paramf(struct pipe_screen *_screen,
+                           enum pipe_capf param)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   return screen->get_paramf(screen, param);
+}
+
+static int
+threaded_screen_get_video_param(struct pipe_screen *_screen,
+                                enum pipe_video_profile profile,
+                                enum pipe_video_entrypoint entrypoint,
+                                enum pipe_video_cap param)
+{
+   /* Video codecs talk to the driver context directly, which would race
+    * with the driver thread.
+    */
+   return 0;
+}
+
+static boolean
+threaded_screen_is_video_format_supported(struct pipe_screen *_screen,
+                                          enum pipe_format format,
+                                          enum pipe_video_profile profile,
+                                          enum pipe_video_entrypoint entrypoint)
+{
+   return FALSE;
+}
+
+static int
+threaded_screen_get_compute_param(struct pipe_screen *_screen,
+                                  enum pipe_compute_cap param,
+                                  void *ret)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   return screen->get_compute_param(screen, param, ret);
+}
+
+static uint64_t
+threaded_screen_get_timestamp(struct pipe_screen *_screen)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   return screen->get_timestamp(screen);
+}
+
+static struct pipe_context *
+threaded_screen_context_create(struct pipe_screen *_screen,
+                               void *priv)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+   struct pipe_context *result;
+
+   result = screen->context_create(screen, priv);
+   if (result)
+      return threaded_context_create(_screen, result);
+   return NULL;
+}
+
+static boolean
+threaded_screen_is_format_supported(struct pipe_screen *_screen,
+                                    enum pipe_format format,
+                                    enum pipe_texture_target target,
+                                    unsigned sample_count,
+                                    unsigned tex_usage)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   return screen->is_format_supported(screen, format, target,
+                                      sample_count, tex_usage);
+}
+
+static boolean
+threaded_screen_can_create_resource(struct pipe_screen *_screen,
+                                    const struct pipe_resource *templat)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   return screen->can_create_resource(screen, templat);
+}
+
+static struct pipe_resource *
+threaded_screen_resource_create(struct pipe_screen *_screen,
+                                const struct pipe_resource *templat)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   /* Resources are not wrapped; their screen pointer is the driver's. */
+   return screen->resource_create(screen, templat);
+}
+
+static struct pipe_resource *
+threaded_screen_resource_from_handle(struct pipe_screen *_screen,
+                                     const struct pipe_resource *templ,
+                                     struct winsys_handle *handle)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   return screen->resource_from_handle(screen, templ, handle);
+}
+
+static boolean
+threaded_screen_resource_get_handle(struct pipe_screen *_screen,
+                                    struct pipe_resource *resource,
+                                    struct winsys_handle *handle)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   return screen->resource_get_handle(screen, resource, handle);
+}
+
+static void
+threaded_screen_resource_destroy(struct pipe_screen *_screen,
+                                 struct pipe_resource *resource)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   screen->resource_destroy(screen, resource);
+}
+
+static void
+threaded_screen_flush_frontbuffer(struct pipe_screen *_screen,
+                                  struct pipe_resource *resource,
+                                  unsigned level, unsigned layer,
+                                  void *context_private,
+                                  struct pipe_box *sub_box)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   screen->flush_frontbuffer(screen, resource, level, layer,
+                             context_private, sub_box);
+}
+
+static void
+threaded_screen_fence_reference(struct pipe_screen *_screen,
+                                struct pipe_fence_handle **ptr,
+                                struct pipe_fence_handle *fence)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   screen->fence_reference(screen, ptr, fence);
+}
+
+static boolean
+threaded_screen_fence_signalled(struct pipe_screen *_screen,
+                                struct pipe_fence_handle *fence)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   return screen->fence_signalled(screen, fence);
+}
+
+static boolean
+threaded_screen_fence_finish(struct pipe_screen *_screen,
+                             struct pipe_fence_handle *fence,
+                             uint64_t timeout)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   return screen->fence_finish(screen, fence, timeout);
+}
+
+static int
+threaded_screen_get_driver_query_info(struct pipe_screen *_screen,
+                                      unsigned index,
+                                      struct pipe_driver_query_info *info)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   return screen->get_driver_query_info(screen, index, info);
+}
+
+struct pipe_screen *
+threaded_screen_create(struct pipe_screen *screen)
+{
+   struct threaded_screen *th_screen;
+
+   if (!debug_get_option_threaded())
+      return screen;
+
+   th_screen = CALLOC_STRUCT(threaded_screen);
+   if (!th_screen)
+      return screen;
+
+#define SCR_INIT(_member) \
+   th_screen->base._member = screen->_member ? threaded_screen_##_member : NULL
+
+   th_screen->base.destroy = threaded_screen_destroy;
+   th_screen->base.get_name = threaded_screen_get_name;
+   th_screen->base.get_vendor = threaded_screen_get_vendor;
+   th_screen->base.get_param = threaded_screen_get_param;
+   th_screen->base.get_shader_param = threaded_screen_get_shader_param;
+   th_screen->base.get_paramf = threaded_screen_get_paramf;
+   th_screen->base.get_video_param = threaded_screen_get_video_param;
+   th_screen->base.is_video_format_supported =
+      threaded_screen_is_video_format_supported;
+   SCR_INIT(get_compute_param);
+   SCR_INIT(get_timestamp);
+   th_screen->base.context_create = threaded_screen_context_create;
+   th_screen->base.is_format_supported = threaded_screen_is_format_supported;
+   SCR_INIT(can_create_resource);
+   th_screen->base.resource_create = threaded_screen_resource_create;
+   th_screen->base.resource_from_handle = threaded_screen_resource_from_handle;
+   th_screen->base.resource_get_handle = threaded_screen_resource_get_handle;
+   th_screen->base.resource_destroy = threaded_screen_resource_destroy;
+   th_screen->base.flush_frontbuffer = threaded_screen_flush_frontbuffer;
+   th_screen->base.fence_reference = threaded_screen_fence_reference;
+   th_screen->base.fence_signalled = threaded_screen_fence_signalled;
+   th_screen->base.fence_finish = threaded_screen_fence_finish;
+   SCR_INIT(get_driver_query_info);
+
+#undef SCR_INIT
+
+   th_screen->screen = screen;
+
+   return &th_screen->base;
+}
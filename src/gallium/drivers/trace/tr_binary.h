@@ -0,0 +1,101 @@
+/**************************************************************************
+ *
+ * Copyright 2013 agent <agent@local>
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Binary trace file format.
+ *
+ * A binary trace holds the same calls and value trees as the XML one.  The
+ * file starts with the 8 byte TRACE_BIN_MAGIC and a 32 bit little-endian
+ * TRACE_BIN_VERSION, followed by a stream of one byte opcodes and their
+ * payloads:
+ *
+ *   CALL_BEGIN    varint call number, name class, name method
+ *   CALL_END      varint call duration in microseconds
+ *   ARG           name, then one value
+ *   RET           one value
+ *
+ *   NULL, FALSE, TRUE
+ *   INT           zigzag encoded varint
+ *   UINT, PTR     varint
+ *   FLOAT         32 bit little-endian IEEE float
+ *   DOUBLE        64 bit little-endian IEEE double
+ *   BYTES, STRING varint size, then the data
+ *   BLOB_REF      varint blob number
+ *   ENUM          name
+ *   ARRAY_BEGIN   values, until ARRAY_END
+ *   STRUCT_BEGIN  name, then MEMBER name value pairs until STRUCT_END
+ *
+ * Varints are unsigned LEB128.  A name is a varint index into the table of
+ * names seen so far, starting at 1; index 0 is followed by a varint length
+ * and the characters of a new name, which is appended to the table.
+ *
+ * Every BYTES or STRING of at least TRACE_BIN_MIN_BLOB_SIZE bytes is also
+ * appended to a table of blobs, numbered from 0, and when the same data is
+ * dumped again it is written as a BLOB_REF to the first copy instead.
+ */
+
+#ifndef TR_BINARY_H
+#define TR_BINARY_H
+
+
+#define TRACE_BIN_MAGIC "GTRACEB"
+#define TRACE_BIN_MAGIC_SIZE 8
+
+#define TRACE_BIN_VERSION 1
+
+#define TRACE_BIN_MIN_BLOB_SIZE 64
+
+
+enum trace_bin_opcode
+{
+   TRACE_BIN_CALL_BEGIN = 1,
+   TRACE_BIN_CALL_END,
+   TRACE_BIN_ARG,
+   TRACE_BIN_RET,
+
+   TRACE_BIN_NULL,
+   TRACE_BIN_FALSE,
+   TRACE_BIN_TRUE,
+   TRACE_BIN_INT,
+   TRACE_BIN_UINT,
+   TRACE_BIN_FLOAT,
+   TRACE_BIN_DOUBLE,
+   TRACE_BIN_BYTES,
+   TRACE_BIN_STRING,
+   TRACE_BIN_BLOB_REF,
+   TRACE_BIN_ENUM,
+   TRACE_BIN_PTR,
+   TRACE_BIN_ARRAY_BEGIN,
+   TRACE_BIN_ARRAY_END,
+   TRACE_BIN_STRUCT_BEGIN,
+   TRACE_BIN_MEMBER,
+   TRACE_BIN_STRUCT_END
+};
+
+
+#endif /* TR_BINARY_H */
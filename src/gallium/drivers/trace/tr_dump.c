@@ -30,10 +30,10 @@
  * @file
  * Trace dumping functions.
  *
- * For now we just use standard XML for dumping the trace calls, as this is
- * simple to write, parse, and visually inspect, but the actual representation
- * is abstracted out of this file, so that we can switch to a binary
- * representation if/when it becomes justified.
+ * By default we use standard XML for dumping the trace calls, as this is
+ * simple to write, parse, and visually inspect.  Setting GALLIUM_TRACE_BINARY
+ * switches to the compact binary representation described in tr_binary.h,
+ * which is much cheaper to write and is what the replay tool reads.
  *
  * @author Jose Fonseca <jfonseca@vmware.com>
  */
@@ -51,7 +51,10 @@
 #include "util/u_string.h"
 #include "util/u_math.h"
 #include "util/u_format.h"
+#include "util/u_hash.h"
+#include "util/u_hash_table.h"
 
+#include "tr_binary.h"
 #include "tr_dump.h"
 #include "tr_screen.h"
 #include "tr_texture.h"
@@ -62,6 +65,13 @@ static FILE *stream = NULL;
 pipe_static_mutex(call_mutex);
 static long unsigned call_no = 0;
 static boolean dumping = FALSE;
+static boolean binary = FALSE;
+
+/* Names and blobs already written to a binary trace */
+static struct util_hash_table *bin_names = NULL;
+static unsigned bin_num_names = 0;
+static struct util_hash_table *bin_blobs = NULL;
+static unsigned bin_num_blobs = 0;
 
 
 static INLINE void
@@ -117,6 +127,171 @@ trace_dump_escape(const char *str)
 }
 
 
+/*
+ * Binary encoding.  See tr_binary.h.
+ */
+
+struct trace_bin_blob
+{
+   uint32_t crc;
+   uint32_t fnv;
+   size_t size;
+   const void *data;
+};
+
+
+static unsigned
+trace_bin_name_hash(void *key)
+{
+   const char *name = key;
+   return util_hash_crc32(name, strlen(name));
+}
+
+
+static int
+trace_bin_name_compare(void *key1, void *key2)
+{
+   return strcmp(key1, key2);
+}
+
+
+static unsigned
+trace_bin_blob_hash(void *key)
+{
+   const struct trace_bin_blob *blob = key;
+   return blob->crc;
+}
+
+
+static int
+trace_bin_blob_compare(void *key1, void *key2)
+{
+   const struct trace_bin_blob *blob1 = key1;
+   const struct trace_bin_blob *blob2 = key2;
+   return blob1->crc != blob2->crc ||
+          blob1->fnv != blob2->fnv ||
+          blob1->size != blob2->size ||
+          memcmp(blob1->data, blob2->data, blob1->size) != 0;
+}
+
+
+/**
+ * 32 bit FNV-1a hash, used next to the CRC so that the contents of blobs
+ * rarely need to be compared.
+ */
+static uint32_t
+trace_bin_fnv(const void *data, size_t size)
+{
+   const uint8_t *p = data;
+   uint32_t hash = 2166136261u;
+   size_t i;
+
+   for (i = 0; i < size; ++i) {
+      hash ^= p[i];
+      hash *= 16777619u;
+   }
+   return hash;
+}
+
+
+static INLINE void
+trace_bin_write_opcode(enum trace_bin_opcode opcode)
+{
+   char c = opcode;
+   trace_dump_write(&c, 1);
+}
+
+
+static void
+trace_bin_write_varint(uint64_t value)
+{
+   char buf[10];
+   unsigned len = 0;
+
+   do {
+      buf[len] = value & 0x7f;
+      value >>= 7;
+      if (value)
+         buf[len] |= 0x80;
+      ++len;
+   } while (value);
+
+   trace_dump_write(buf, len);
+}
+
+
+static void
+trace_bin_write_fixed(uint64_t value, unsigned size)
+{
+   char buf[8];
+   unsigned i;
+
+   for (i = 0; i < size; ++i) {
+      buf[i] = value & 0xff;
+      value >>= 8;
+   }
+
+   trace_dump_write(buf, size);
+}
+
+
+static void
+trace_bin_write_name(const char *name)
+{
+   void *index = util_hash_table_get(bin_names, (void *)name);
+
+   if (index) {
+      trace_bin_write_varint((uintptr_t)index);
+   } else {
+      size_t len = strlen(name);
+
+      util_hash_table_set(bin_names, strdup(name),
+                          (void *)(uintptr_t)++bin_num_names);
+
+      trace_bin_write_varint(0);
+      trace_bin_write_varint(len);
+      trace_dump_write(name, len);
+   }
+}
+
+
+static void
+trace_bin_write_data(enum trace_bin_opcode opcode,
+                     const void *data, size_t size)
+{
+   if (size >= TRACE_BIN_MIN_BLOB_SIZE) {
+      struct trace_bin_blob key;
+      struct trace_bin_blob *blob;
+      void *number;
+
+      key.crc = util_hash_crc32(data, size);
+      key.fnv = trace_bin_fnv(data, size);
+      key.size = size;
+      key.data = data;
+
+      number = util_hash_table_get(bin_blobs, &key);
+      if (number) {
+         trace_bin_write_opcode(TRACE_BIN_BLOB_REF);
+         trace_bin_write_varint((uintptr_t)number - 1);
+         return;
+      }
+
+      /* Keep a copy of the contents to compare later blobs against. */
+      blob = MALLOC(sizeof *blob + size);
+      if (blob) {
+         *blob = key;
+         blob->data = memcpy(blob + 1, data, size);
+         util_hash_table_set(bin_blobs, blob,
+                             (void *)(uintptr_t)++bin_num_blobs);
+      }
+   }
+
+   trace_bin_write_opcode(opcode);
+   trace_bin_write_varint(size);
+   trace_dump_write(data, size);
+}
+
+
 static INLINE void
 trace_dump_indent(unsigned level)
 {
@@ -218,7 +393,10 @@ trace_dump_tag_end(const char *name)
 void
 trace_dump_trace_flush(void)
 {
-   if(stream) {
+   /* Binary traces are meant for benchmarking, so don't pay for flushing
+    * after every draw; the stream is flushed when closed at exit.
+    */
+   if(stream && !binary) {
       fflush(stream);
    }
 }
@@ -227,7 +405,8 @@ static void
 trace_dump_trace_close(void)
 {
    if(stream) {
-      trace_dump_writes("</trace>\n");
+      if (!binary)
+         trace_dump_writes("</trace>\n");
       if (close_stream) {
          fclose(stream);
          close_stream = FALSE;
@@ -241,7 +420,11 @@ trace_dump_trace_close(void)
 static void
 trace_dump_call_time(int64_t time)
 {
-   if (stream) {
+   if (binary) {
+      trace_bin_write_opcode(TRACE_BIN_CALL_END);
+      trace_bin_write_varint(time);
+   }
+   else if (stream) {
       trace_dump_indent(2);
       trace_dump_tag_begin("time");
       trace_dump_int(time);
@@ -262,6 +445,8 @@ trace_dump_trace_begin(void)
 
    if(!stream) {
 
+      binary = debug_get_bool_option("GALLIUM_TRACE_BINARY", FALSE);
+
       if (strcmp(filename, "stderr") == 0) {
          close_stream = FALSE;
          stream = stderr;
@@ -272,14 +457,31 @@ trace_dump_trace_begin(void)
       }
       else {
          close_stream = TRUE;
-         stream = fopen(filename, "wt");
+         stream = fopen(filename, binary ? "wb" : "wt");
          if (!stream)
             return FALSE;
       }
 
-      trace_dump_writes("<?xml version='1.0' encoding='UTF-8'?>\n");
-      trace_dump_writes("<?xml-stylesheet type='text/xsl' href='trace.xsl'?>\n");
-      trace_dump_writes("<trace version='0.1'>\n");
+      if (binary) {
+         bin_names = util_hash_table_create(trace_bin_name_hash,
+                                            trace_bin_name_compare);
+         bin_blobs = util_hash_table_create(trace_bin_blob_hash,
+                                            trace_bin_blob_compare);
+         if (!bin_names || !bin_blobs) {
+            if (close_stream)
+               fclose(stream);
+            stream = NULL;
+            return FALSE;
+         }
+
+         trace_dump_write(TRACE_BIN_MAGIC, TRACE_BIN_MAGIC_SIZE);
+         trace_bin_write_fixed(TRACE_BIN_VERSION, 4);
+      }
+      else {
+         trace_dump_writes("<?xml version='1.0' encoding='UTF-8'?>\n");
+         trace_dump_writes("<?xml-stylesheet type='text/xsl' href='trace.xsl'?>\n");
+         trace_dump_writes("<trace version='0.1'>\n");
+      }
 
       /* Many applications don't exit cleanly, others may create and destroy a
        * screen multiple times, so we only write </trace> tag and close at exit
@@ -296,6 +498,11 @@ boolean trace_dump_trace_enabled(void)
    return stream ? TRUE : FALSE;
 }
 
+boolean trace_dump_trace_binary(void)
+{
+   return stream && binary ? TRUE : FALSE;
+}
+
 /*
  * Call lock
  */
@@ -364,6 +571,16 @@ void trace_dump_call_begin_locked(const char *klass, const char *method)
       return;
 
    ++call_no;
+
+   if (binary) {
+      trace_bin_write_opcode(TRACE_BIN_CALL_BEGIN);
+      trace_bin_write_varint(call_no);
+      trace_bin_write_name(klass);
+      trace_bin_write_name(method);
+      call_start_time = os_time_get();
+      return;
+   }
+
    trace_dump_indent(1);
    trace_dump_writes("<call no=\'");
    trace_dump_writef("%lu", call_no);
@@ -387,6 +604,9 @@ void trace_dump_call_end_locked(void)
    call_end_time = os_time_get();
 
    trace_dump_call_time(call_end_time - call_start_time);
+   if (binary)
+      return;
+
    trace_dump_indent(1);
    trace_dump_tag_end("call");
    trace_dump_newline();
@@ -410,6 +630,12 @@ void trace_dump_arg_begin(const char *name)
    if (!dumping)
       return;
 
+   if (binary) {
+      trace_bin_write_opcode(TRACE_BIN_ARG);
+      trace_bin_write_name(name);
+      return;
+   }
+
    trace_dump_indent(2);
    trace_dump_tag_begin1("arg", "name", name);
 }
@@ -419,6 +645,9 @@ void trace_dump_arg_end(void)
    if (!dumping)
       return;
 
+   if (binary)
+      return;
+
    trace_dump_tag_end("arg");
    trace_dump_newline();
 }
@@ -428,6 +657,11 @@ void trace_dump_ret_begin(void)
    if (!dumping)
       return;
 
+   if (binary) {
+      trace_bin_write_opcode(TRACE_BIN_RET);
+      return;
+   }
+
    trace_dump_indent(2);
    trace_dump_tag_begin("ret");
 }
@@ -437,6 +671,9 @@ void trace_dump_ret_end(void)
    if (!dumping)
       return;
 
+   if (binary)
+      return;
+
    trace_dump_tag_end("ret");
    trace_dump_newline();
 }
@@ -446,6 +683,11 @@ void trace_dump_bool(int value)
    if (!dumping)
       return;
 
+   if (binary) {
+      trace_bin_write_opcode(value ? TRACE_BIN_TRUE : TRACE_BIN_FALSE);
+      return;
+   }
+
    trace_dump_writef("<bool>%c</bool>", value ? '1' : '0');
 }
 
@@ -454,6 +696,13 @@ void trace_dump_int(long long int value)
    if (!dumping)
       return;
 
+   if (binary) {
+      /* zigzag, so that small negative numbers stay short */
+      trace_bin_write_opcode(TRACE_BIN_INT);
+      trace_bin_write_varint(((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+      return;
+   }
+
    trace_dump_writef("<int>%lli</int>", value);
 }
 
@@ -462,6 +711,12 @@ void trace_dump_uint(long long unsigned value)
    if (!dumping)
       return;
 
+   if (binary) {
+      trace_bin_write_opcode(TRACE_BIN_UINT);
+      trace_bin_write_varint(value);
+      return;
+   }
+
    trace_dump_writef("<uint>%llu</uint>", value);
 }
 
@@ -470,6 +725,22 @@ void trace_dump_float(double value)
    if (!dumping)
       return;
 
+   if (binary) {
+      union { float f; uint32_t u; } f;
+      union { double d; uint64_t u; } d;
+
+      f.f = (float)value;
+      if (f.f == value) {
+         trace_bin_write_opcode(TRACE_BIN_FLOAT);
+         trace_bin_write_fixed(f.u, 4);
+      } else {
+         d.d = value;
+         trace_bin_write_opcode(TRACE_BIN_DOUBLE);
+         trace_bin_write_fixed(d.u, 8);
+      }
+      return;
+   }
+
    trace_dump_writef("<float>%g</float>", value);
 }
 
@@ -483,6 +754,11 @@ void trace_dump_bytes(const void *data,
    if (!dumping)
       return;
 
+   if (binary) {
+      trace_bin_write_data(TRACE_BIN_BYTES, data, size);
+      return;
+   }
+
    trace_dump_writes("<bytes>");
    for(i = 0; i < size; ++i) {
       uint8_t byte = *p++;
@@ -500,16 +776,24 @@ void trace_dump_box_bytes(const void *data,
 			  unsigned stride,
 			  unsigned slice_stride)
 {
+   enum pipe_format format = resource->format;
    size_t size;
 
    /*
-    * Only dump buffer transfers to avoid huge files.
+    * Only dump buffer transfers to avoid huge files, except in binary
+    * traces, which must hold the texture contents to be replayable.
     * TODO: Make this run-time configurable
     */
    if (resource->target != PIPE_BUFFER) {
-      size = 0;
+      if (binary && box->width > 0 && box->height > 0) {
+         size = (MAX2(box->depth, 1) - 1) * slice_stride +
+                (util_format_get_nblocksy(format, box->height) - 1) * stride +
+                util_format_get_nblocksx(format, box->width) *
+                util_format_get_blocksize(format);
+      } else {
+         size = 0;
+      }
    } else {
-      enum pipe_format format = resource->format;
       if (slice_stride)
          size = box->depth * slice_stride;
       else if (stride)
@@ -527,6 +811,11 @@ void trace_dump_string(const char *str)
    if (!dumping)
       return;
 
+   if (binary) {
+      trace_bin_write_data(TRACE_BIN_STRING, str, strlen(str));
+      return;
+   }
+
    trace_dump_writes("<string>");
    trace_dump_escape(str);
    trace_dump_writes("</string>");
@@ -537,6 +826,12 @@ void trace_dump_enum(const char *value)
    if (!dumping)
       return;
 
+   if (binary) {
+      trace_bin_write_opcode(TRACE_BIN_ENUM);
+      trace_bin_write_name(value);
+      return;
+   }
+
    trace_dump_writes("<enum>");
    trace_dump_escape(value);
    trace_dump_writes("</enum>");
@@ -547,6 +842,11 @@ void trace_dump_array_begin(void)
    if (!dumping)
       return;
 
+   if (binary) {
+      trace_bin_write_opcode(TRACE_BIN_ARRAY_BEGIN);
+      return;
+   }
+
    trace_dump_writes("<array>");
 }
 
@@ -555,6 +855,11 @@ void trace_dump_array_end(void)
    if (!dumping)
       return;
 
+   if (binary) {
+      trace_bin_write_opcode(TRACE_BIN_ARRAY_END);
+      return;
+   }
+
    trace_dump_writes("</array>");
 }
 
@@ -563,6 +868,9 @@ void trace_dump_elem_begin(void)
    if (!dumping)
       return;
 
+   if (binary)
+      return;
+
    trace_dump_writes("<elem>");
 }
 
@@ -571,6 +879,9 @@ void trace_dump_elem_end(void)
    if (!dumping)
       return;
 
+   if (binary)
+      return;
+
    trace_dump_writes("</elem>");
 }
 
@@ -579,6 +890,12 @@ void trace_dump_struct_begin(const char *name)
    if (!dumping)
       return;
 
+   if (binary) {
+      trace_bin_write_opcode(TRACE_BIN_STRUCT_BEGIN);
+      trace_bin_write_name(name);
+      return;
+   }
+
    trace_dump_writef("<struct name='%s'>", name);
 }
 
@@ -587,6 +904,11 @@ void trace_dump_struct_end(void)
    if (!dumping)
       return;
 
+   if (binary) {
+      trace_bin_write_opcode(TRACE_BIN_STRUCT_END);
+      return;
+   }
+
    trace_dump_writes("</struct>");
 }
 
@@ -595,6 +917,12 @@ void trace_dump_member_begin(const char *name)
    if (!dumping)
       return;
 
+   if (binary) {
+      trace_bin_write_opcode(TRACE_BIN_MEMBER);
+      trace_bin_write_name(name);
+      return;
+   }
+
    trace_dump_writef("<member name='%s'>", name);
 }
 
@@ -603,6 +931,9 @@ void trace_dump_member_end(void)
    if (!dumping)
       return;
 
+   if (binary)
+      return;
+
    trace_dump_writes("</member>");
 }
 
@@ -611,6 +942,11 @@ void trace_dump_null(void)
    if (!dumping)
       return;
 
+   if (binary) {
+      trace_bin_write_opcode(TRACE_BIN_NULL);
+      return;
+   }
+
    trace_dump_writes("<null/>");
 }
 
@@ -619,10 +955,14 @@ void trace_dump_ptr(const void *value)
    if (!dumping)
       return;
 
-   if(value)
-      trace_dump_writef("<ptr>0x%08lx</ptr>", (unsigned long)(uintptr_t)value);
-   else
+   if(!value)
       trace_dump_null();
+   else if (binary) {
+      trace_bin_write_opcode(TRACE_BIN_PTR);
+      trace_bin_write_varint((uintptr_t)value);
+   }
+   else
+      trace_dump_writef("<ptr>0x%08lx</ptr>", (unsigned long)(uintptr_t)value);
 }
 
 
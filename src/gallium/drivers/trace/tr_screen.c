@@ -97,6 +97,23 @@ trace_screen_get_param(struct pipe_screen *_screen,
 
    result = screen->get_param(screen, param);
 
+   /*
+    * Binary traces are meant to be replayed, so make the state tracker
+    * upload user vertex, index and constant data into buffers, whose
+    * contents we capture.
+    */
+   if (trace_dump_trace_binary()) {
+      switch (param) {
+      case PIPE_CAP_USER_VERTEX_BUFFERS:
+      case PIPE_CAP_USER_INDEX_BUFFERS:
+      case PIPE_CAP_USER_CONSTANT_BUFFERS:
+         result = 0;
+         break;
+      default:
+         break;
+      }
+   }
+
    trace_dump_ret(int, result);
 
    trace_dump_call_end();
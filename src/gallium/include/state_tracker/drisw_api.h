@@ -15,6 +15,19 @@ struct drisw_loader_funcs
                       void *data, unsigned width, unsigned height);
    void (*put_image2) (struct dri_drawable *dri_drawable,
                        void *data, int x, int y, unsigned width, unsigned height, unsigned stride);
+   /**
+    * Present straight from a shared memory segment, or NULL if the loader
+    * can't.  The winsys then allocates display targets as segments.
+    */
+   void (*put_image_shm) (struct dri_drawable *dri_drawable,
+                          int shmid, char *shmaddr, unsigned offset,
+                          int x, int y, unsigned width, unsigned height,
+                          unsigned stride);
+   /**
+    * Whether the loader can present sub-rectangles, with putImage2 or
+    * putImageShm.  Only then does the winsys present damaged rectangles.
+    */
+   boolean put_damage;
 };
 
 /**
@@ -132,6 +132,20 @@ struct sw_winsys
                              void *context_private,
                              struct pipe_box *box );
 
+   /**
+    * Like displaytarget_display, but only the given rectangles of the
+    * display target have changed since it was last displayed, so only
+    * they need to be copied.
+    *
+    * Optional, displaytarget_display is used if this is NULL.
+    */
+   void
+   (*displaytarget_display_damage)( struct sw_winsys *ws,
+                                    struct sw_displaytarget *dt,
+                                    void *context_private,
+                                    const struct pipe_box *rects,
+                                    unsigned nr_rects );
+
    void 
    (*displaytarget_destroy)( struct sw_winsys *ws, 
                              struct sw_displaytarget *dt );
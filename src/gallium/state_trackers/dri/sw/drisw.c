@@ -28,10 +28,12 @@
 
 /* TODO:
  *
- * xshm / EGLImage:
+ * EGLImage:
  *
- * Allow the loaders to use the XSHM extension. It probably requires callbacks
- * for createImage/destroyImage similar to DRI2 getBuffers.
+ * Loaders with putImageShm get the display targets in shared memory
+ * segments allocated by the winsys. Sharing images with other clients
+ * probably requires callbacks for createImage/destroyImage similar to DRI2
+ * getBuffers.
  */
 
 #include "util/u_format.h"
@@ -83,6 +85,19 @@ put_image2(__DRIdrawable *dPriv, void *data, int x, int y,
                      data, dPriv->loaderPrivate);
 }
 
+static INLINE void
+put_image_shm(__DRIdrawable *dPriv, int shmid, char *shmaddr,
+              unsigned offset, int x, int y,
+              unsigned width, unsigned height, unsigned stride)
+{
+   __DRIscreen *sPriv = dPriv->driScreenPriv;
+   const __DRIswrastLoaderExtension *loader = sPriv->swrast_loader;
+
+   loader->putImageShm(dPriv, __DRI_SWRAST_IMAGE_OP_SWAP,
+                       x, y, width, height, stride,
+                       shmid, shmaddr, offset, dPriv->loaderPrivate);
+}
+
 static INLINE void
 get_image(__DRIdrawable *dPriv, int x, int y, int width, int height, void *data)
 {
@@ -122,6 +137,17 @@ drisw_put_image2(struct dri_drawable *drawable,
    put_image2(dPriv, data, x, y, width, height, stride);
 }
 
+static void
+drisw_put_image_shm(struct dri_drawable *drawable,
+                    int shmid, char *shmaddr, unsigned offset,
+                    int x, int y, unsigned width, unsigned height,
+                    unsigned stride)
+{
+   __DRIdrawable *dPriv = drawable->dPriv;
+
+   put_image_shm(dPriv, shmid, shmaddr, offset, x, y, width, height, stride);
+}
+
 static INLINE void
 drisw_present_texture(__DRIdrawable *dPriv,
                       struct pipe_resource *ptex, struct pipe_box *sub_box)
@@ -356,9 +382,24 @@ static struct drisw_loader_funcs drisw_lf = {
    .put_image2 = drisw_put_image2
 };
 
+static struct drisw_loader_funcs drisw_put_image2_lf = {
+   .put_image = drisw_put_image,
+   .put_image2 = drisw_put_image2,
+   .put_damage = TRUE
+};
+
+static struct drisw_loader_funcs drisw_shm_lf = {
+   .put_image = drisw_put_image,
+   .put_image2 = drisw_put_image2,
+   .put_image_shm = drisw_put_image_shm,
+   .put_damage = TRUE
+};
+
 static const __DRIconfig **
 drisw_init_screen(__DRIscreen * sPriv)
 {
+   const __DRIswrastLoaderExtension *loader = sPriv->swrast_loader;
+   struct drisw_loader_funcs *lf = &drisw_lf;
    const __DRIconfig **configs;
    struct dri_screen *screen;
    struct pipe_screen *pscreen;
@@ -375,7 +416,12 @@ drisw_init_screen(__DRIscreen * sPriv)
    sPriv->driverPrivate = (void *)screen;
    sPriv->extensions = drisw_screen_extensions;
 
-   pscreen = drisw_create_screen(&drisw_lf);
+   if (loader->base.version >= 3 && loader->putImageShm)
+      lf = &drisw_shm_lf;
+   else if (loader->base.version >= 2 && loader->putImage2)
+      lf = &drisw_put_image2_lf;
+
+   pscreen = drisw_create_screen(lf);
    /* dri_init_screen_helper checks pscreen for us */
 
    configs = dri_init_screen_helper(screen, pscreen);
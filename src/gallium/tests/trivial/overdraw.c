@@ -0,0 +1,361 @@
+/**************************************************************************
+ *
+ * Copyright 2013 agent <agent@local>
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/*
+ * Occlusion heavy overdraw benchmark.
+ *
+ * Every frame clears color and depth and then draws a stack of screen
+ * sized quads with a LESS depth test, front to back by default so that all
+ * but the first layer is occluded, or back to front with -b so that every
+ * layer gets shaded.  Prints the average time per frame and checks that
+ * the front layer ended up in the color buffer.
+ *
+ * Comparing the two orders, or running with LP_PERF=no_hiz, shows how much
+ * the driver saves on occluded fragments.
+ *
+ * With -n the layers are drawn back to front without depth test, so every
+ * tile gets completely overwritten after the clear.  Running that at 4K
+ * with -s 3840x2160, with and without LP_PERF=no_fast_clear, shows how much
+ * clearing costs; LP_DEBUG=counters prints the clear bytes never written.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pipe/p_context.h"
+#include "pipe/p_defines.h"
+#include "pipe/p_screen.h"
+#include "pipe/p_shader_tokens.h"
+#include "pipe/p_state.h"
+#include "cso_cache/cso_context.h"
+#include "os/os_time.h"
+#include "util/u_box.h"
+#include "util/u_draw_quad.h"
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+#include "util/u_simple_shaders.h"
+#include "pipe-loader/pipe_loader.h"
+
+
+#define DEFAULT_WIDTH 1024
+#define DEFAULT_HEIGHT 768
+#define MAX_DEVICES 4
+
+#define DEFAULT_LAYERS 32
+#define DEFAULT_FRAMES 20
+
+/* Six vertices of position and color per layer */
+#define VERTS_PER_LAYER 6
+
+
+static unsigned width = DEFAULT_WIDTH;
+static unsigned height = DEFAULT_HEIGHT;
+
+
+static struct pipe_resource *
+create_layers(struct pipe_screen *screen, struct pipe_context *pipe,
+              unsigned num_layers, boolean back_to_front)
+{
+   static const float corners[VERTS_PER_LAYER][2] = {
+      { -1.0f, -1.0f }, {  1.0f, -1.0f }, {  1.0f,  1.0f },
+      { -1.0f, -1.0f }, {  1.0f,  1.0f }, { -1.0f,  1.0f }
+   };
+   struct pipe_resource *vbuf;
+   float (*vertices)[2][4];
+   unsigned size = num_layers * VERTS_PER_LAYER * sizeof *vertices;
+   unsigned i, j;
+
+   vertices = MALLOC(size);
+
+   for (i = 0; i < num_layers; i++) {
+      /* layer 0 is the nearest one, and the only one which is green */
+      unsigned layer = back_to_front ? num_layers - 1 - i : i;
+      float z = -1.0f + 2.0f * (layer + 1) / (num_layers + 1);
+
+      for (j = 0; j < VERTS_PER_LAYER; j++) {
+         float *pos = vertices[i * VERTS_PER_LAYER + j][0];
+         float *color = vertices[i * VERTS_PER_LAYER + j][1];
+
+         pos[0] = corners[j][0];
+         pos[1] = corners[j][1];
+         pos[2] = z;
+         pos[3] = 1.0f;
+
+         color[0] = layer ? 1.0f : 0.0f;
+         color[1] = layer ? 0.0f : 1.0f;
+         color[2] = (float) layer / num_layers;
+         color[3] = 1.0f;
+      }
+   }
+
+   vbuf = pipe_buffer_create(screen, PIPE_BIND_VERTEX_BUFFER,
+                             PIPE_USAGE_STATIC, size);
+   pipe_buffer_write(pipe, vbuf, 0, size, vertices);
+
+   FREE(vertices);
+
+   return vbuf;
+}
+
+
+static struct pipe_resource *
+create_surface_texture(struct pipe_screen *screen, enum pipe_format format,
+                       unsigned bind)
+{
+   struct pipe_resource tmplt;
+
+   memset(&tmplt, 0, sizeof(tmplt));
+   tmplt.target = PIPE_TEXTURE_2D;
+   tmplt.format = format;
+   tmplt.width0 = width;
+   tmplt.height0 = height;
+   tmplt.depth0 = 1;
+   tmplt.array_size = 1;
+   tmplt.bind = bind;
+
+   return screen->resource_create(screen, &tmplt);
+}
+
+
+/**
+ * Check that the center pixel shows the front layer.
+ */
+static boolean
+check_result(struct pipe_context *pipe, struct pipe_resource *target)
+{
+   struct pipe_transfer *transfer;
+   struct pipe_box box;
+   const uint8_t *map;
+   boolean ok;
+
+   u_box_2d(width / 2, height / 2, 1, 1, &box);
+
+   map = pipe->transfer_map(pipe, target, 0, PIPE_TRANSFER_READ,
+                            &box, &transfer);
+   if (!map)
+      return FALSE;
+
+   /* B8G8R8A8_UNORM */
+   ok = map[0] == 0x00 && map[1] == 0xff && map[2] == 0x00;
+
+   pipe->transfer_unmap(pipe, transfer);
+
+   return ok;
+}
+
+
+static void
+usage(const char *name)
+{
+   fprintf(stderr, "usage: %s [-b] [-n] [-l layers] [-f frames] "
+           "[-s WIDTHxHEIGHT]\n", name);
+   exit(1);
+}
+
+
+int main(int argc, char **argv)
+{
+   struct pipe_loader_device *devs[MAX_DEVICES];
+   struct pipe_screen *screen;
+   struct pipe_context *pipe;
+   struct cso_context *cso;
+   struct pipe_resource *target, *zs, *vbuf;
+   struct pipe_surface surf_tmpl, *cbuf, *zsbuf;
+   struct pipe_framebuffer_state fb;
+   struct pipe_blend_state blend;
+   struct pipe_depth_stencil_alpha_state dsa;
+   struct pipe_rasterizer_state rasterizer;
+   struct pipe_viewport_state viewport;
+   struct pipe_vertex_element velem[2];
+   union pipe_color_union clear_color;
+   const uint semantic_names[] = { TGSI_SEMANTIC_POSITION,
+                                   TGSI_SEMANTIC_COLOR };
+   const uint semantic_indexes[] = { 0, 0 };
+   void *vs, *fs;
+   boolean back_to_front = FALSE;
+   boolean depth_test = TRUE;
+   unsigned num_layers = DEFAULT_LAYERS;
+   unsigned num_frames = DEFAULT_FRAMES;
+   unsigned num_devs, frame;
+   int64_t start, end;
+   boolean ok;
+   int i;
+
+   for (i = 1; i < argc; i++) {
+      if (!strcmp(argv[i], "-b"))
+         back_to_front = TRUE;
+      else if (!strcmp(argv[i], "-n")) {
+         back_to_front = TRUE;
+         depth_test = FALSE;
+      }
+      else if (!strcmp(argv[i], "-l") && i + 1 < argc)
+         num_layers = atoi(argv[++i]);
+      else if (!strcmp(argv[i], "-f") && i + 1 < argc)
+         num_frames = atoi(argv[++i]);
+      else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+         if (sscanf(argv[++i], "%ux%u", &width, &height) != 2)
+            usage(argv[0]);
+      }
+      else
+         usage(argv[0]);
+   }
+
+   if (!num_layers || !num_frames || !width || !height)
+      usage(argv[0]);
+
+   /* The null winsys is always the last software device. */
+   num_devs = pipe_loader_sw_probe(devs, MAX_DEVICES);
+   if (!num_devs) {
+      fprintf(stderr, "%s: no software device\n", argv[0]);
+      return 1;
+   }
+
+   screen = pipe_loader_create_screen(devs[num_devs - 1], PIPE_SEARCH_DIR);
+   if (!screen) {
+      fprintf(stderr, "%s: failed to create the screen\n", argv[0]);
+      return 1;
+   }
+
+   pipe = screen->context_create(screen, NULL);
+   cso = cso_create_context(pipe);
+
+   target = create_surface_texture(screen, PIPE_FORMAT_B8G8R8A8_UNORM,
+                                   PIPE_BIND_RENDER_TARGET);
+   zs = create_surface_texture(screen, PIPE_FORMAT_Z24_UNORM_S8_UINT,
+                               PIPE_BIND_DEPTH_STENCIL);
+   vbuf = create_layers(screen, pipe, num_layers, back_to_front);
+
+   memset(&surf_tmpl, 0, sizeof(surf_tmpl));
+   surf_tmpl.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+   cbuf = pipe->create_surface(pipe, target, &surf_tmpl);
+   surf_tmpl.format = PIPE_FORMAT_Z24_UNORM_S8_UINT;
+   zsbuf = pipe->create_surface(pipe, zs, &surf_tmpl);
+
+   memset(&fb, 0, sizeof(fb));
+   fb.width = width;
+   fb.height = height;
+   fb.nr_cbufs = 1;
+   fb.cbufs[0] = cbuf;
+   fb.zsbuf = zsbuf;
+
+   memset(&blend, 0, sizeof(blend));
+   blend.rt[0].colormask = PIPE_MASK_RGBA;
+
+   memset(&dsa, 0, sizeof(dsa));
+   dsa.depth.enabled = depth_test;
+   dsa.depth.writemask = depth_test;
+   dsa.depth.func = PIPE_FUNC_LESS;
+
+   memset(&rasterizer, 0, sizeof(rasterizer));
+   rasterizer.cull_face = PIPE_FACE_NONE;
+   rasterizer.half_pixel_center = 1;
+   rasterizer.bottom_edge_rule = 1;
+   rasterizer.depth_clip = 1;
+
+   viewport.scale[0] = width / 2.0f;
+   viewport.scale[1] = height / 2.0f;
+   viewport.scale[2] = 0.5f;
+   viewport.scale[3] = 1.0f;
+   viewport.translate[0] = width / 2.0f;
+   viewport.translate[1] = height / 2.0f;
+   viewport.translate[2] = 0.5f;
+   viewport.translate[3] = 0.0f;
+
+   memset(velem, 0, sizeof(velem));
+   velem[0].src_offset = 0;
+   velem[0].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+   velem[1].src_offset = 4 * sizeof(float);
+   velem[1].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+
+   vs = util_make_vertex_passthrough_shader(pipe, 2, semantic_names,
+                                            semantic_indexes);
+   fs = util_make_fragment_passthrough_shader(pipe, TGSI_SEMANTIC_COLOR,
+                                              TGSI_INTERPOLATE_PERSPECTIVE,
+                                              TRUE);
+
+   cso_set_framebuffer(cso, &fb);
+   cso_set_blend(cso, &blend);
+   cso_set_depth_stencil_alpha(cso, &dsa);
+   cso_set_rasterizer(cso, &rasterizer);
+   cso_set_viewport(cso, &viewport);
+   cso_set_fragment_shader_handle(cso, fs);
+   cso_set_vertex_shader_handle(cso, vs);
+   cso_set_vertex_elements(cso, 2, velem);
+
+   memset(&clear_color, 0, sizeof(clear_color));
+
+   printf("drawing %u layers of %ux%u %s%s on %s\n",
+          num_layers, width, height,
+          back_to_front ? "back to front" : "front to back",
+          depth_test ? "" : " without depth test",
+          screen->get_name(screen));
+
+   start = os_time_get();
+
+   for (frame = 0; frame < num_frames; frame++) {
+      struct pipe_fence_handle *fence = NULL;
+
+      pipe->clear(pipe, PIPE_CLEAR_COLOR | PIPE_CLEAR_DEPTHSTENCIL,
+                  &clear_color, 1.0, 0);
+
+      util_draw_vertex_buffer(pipe, cso, vbuf, 0, 0,
+                              PIPE_PRIM_TRIANGLES,
+                              num_layers * VERTS_PER_LAYER,  /* verts */
+                              2);                            /* attribs/vert */
+
+      pipe->flush(pipe, &fence, 0);
+      screen->fence_finish(screen, fence, PIPE_TIMEOUT_INFINITE);
+      screen->fence_reference(screen, &fence, NULL);
+   }
+
+   end = os_time_get();
+
+   ok = check_result(pipe, target);
+
+   printf("%.2f ms/frame, %.1f Mpixels/s drawn, result %s\n",
+          (end - start) / 1000.0 / num_frames,
+          (double) width * height * num_layers * num_frames / (end - start),
+          ok ? "ok" : "WRONG");
+
+   cso_release_all(cso);
+   pipe->delete_vs_state(pipe, vs);
+   pipe->delete_fs_state(pipe, fs);
+   pipe_surface_reference(&cbuf, NULL);
+   pipe_surface_reference(&zsbuf, NULL);
+   pipe_resource_reference(&target, NULL);
+   pipe_resource_reference(&zs, NULL);
+   pipe_resource_reference(&vbuf, NULL);
+   cso_destroy_context(cso);
+   pipe->destroy(pipe);
+   screen->destroy(screen);
+   pipe_loader_release(devs, num_devs);
+
+   return ok ? 0 : 1;
+}
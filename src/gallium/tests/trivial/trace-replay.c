@@ -0,0 +1,2620 @@
+/**************************************************************************
+ *
+ * Copyright 2013 agent <agent@local>
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/*
+ * Replays a binary trace, recorded with GALLIUM_TRACE_BINARY=1, on the
+ * software pipe driver (llvmpipe or softpipe, as chosen by GALLIUM_DRIVER)
+ * and reports how long the driver spent in each kind of call and in each
+ * frame.
+ *
+ * Only the time spent inside the driver is counted, not decoding the trace.
+ * A frame ends at a flush with PIPE_FLUSH_END_OF_FRAME or at a
+ * flush_frontbuffer, where we also wait for rendering to finish so that
+ * frame times include the rasterizer threads.
+ *
+ * Calls which can't be replayed (e.g. on objects created before tracing
+ * started, or drawing from user memory in traces recorded without the
+ * binary format) are skipped and counted.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pipe/p_context.h"
+#include "pipe/p_defines.h"
+#include "pipe/p_screen.h"
+#include "pipe/p_state.h"
+#include "os/os_time.h"
+#include "tgsi/tgsi_text.h"
+#include "util/u_dump.h"
+#include "util/u_format.h"
+#include "util/u_hash_table.h"
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+#include "pipe-loader/pipe_loader.h"
+
+#include "trace/tr_binary.h"
+
+
+#define MAX_ARGS 16
+#define MAX_TOKENS (64 * 1024)
+#define MAX_DEVICES 4
+
+
+/*
+ * Decoded trace values.
+ */
+
+enum value_kind
+{
+   VALUE_NULL,
+   VALUE_BOOL,
+   VALUE_INT,
+   VALUE_UINT,
+   VALUE_FLOAT,
+   VALUE_BYTES,
+   VALUE_STRING,
+   VALUE_ENUM,
+   VALUE_PTR,
+   VALUE_ARRAY,
+   VALUE_STRUCT
+};
+
+
+struct value
+{
+   enum value_kind kind;
+
+   union {
+      int64_t i;
+      uint64_t u;       /* uint, bool and ptr */
+      double f;
+      const char *name; /* enum */
+
+      /* bytes and string; strings are nul terminated */
+      struct {
+         const char *data;
+         size_t size;
+         boolean owned;
+      } bytes;
+
+      /* array and struct; arrays have no names */
+      struct {
+         unsigned count;
+         const char **names;
+         struct value **elems;
+      } list;
+   } u;
+};
+
+static struct value null_value = { VALUE_NULL };
+
+
+struct blob
+{
+   enum value_kind kind;
+   char *data;
+   size_t size;
+};
+
+
+struct call
+{
+   unsigned no;
+   const char *klass;
+   const char *method;
+
+   unsigned num_args;
+   const char *arg_names[MAX_ARGS];
+   struct value *args[MAX_ARGS];
+
+   struct value *ret;
+};
+
+
+struct reader
+{
+   FILE *file;
+   boolean error;
+
+   char **names;
+   unsigned num_names;
+   unsigned max_names;
+
+   struct blob *blobs;
+   unsigned num_blobs;
+   unsigned max_blobs;
+};
+
+
+static unsigned
+read_byte(struct reader *rd)
+{
+   int c = getc(rd->file);
+   if (c == EOF) {
+      rd->error = TRUE;
+      return 0;
+   }
+   return c;
+}
+
+
+static uint64_t
+read_varint(struct reader *rd)
+{
+   uint64_t value = 0;
+   unsigned shift = 0;
+   unsigned c;
+
+   do {
+      c = read_byte(rd);
+      if (shift < 64)
+         value |= (uint64_t)(c & 0x7f) << shift;
+      shift += 7;
+   } while ((c & 0x80) && !rd->error);
+
+   return value;
+}
+
+
+static uint64_t
+read_fixed(struct reader *rd, unsigned size)
+{
+   uint64_t value = 0;
+   unsigned i;
+
+   for (i = 0; i < size; ++i)
+      value |= (uint64_t)read_byte(rd) << (8 * i);
+
+   return value;
+}
+
+
+static char *
+read_data(struct reader *rd, size_t size)
+{
+   char *data = MALLOC(size + 1);
+
+   if (!data || fread(data, 1, size, rd->file) != size) {
+      FREE(data);
+      rd->error = TRUE;
+      return NULL;
+   }
+   data[size] = 0;
+   return data;
+}
+
+
+static const char *
+read_name(struct reader *rd)
+{
+   uint64_t index = read_varint(rd);
+   char *name;
+
+   if (index) {
+      if (index > rd->num_names) {
+         rd->error = TRUE;
+         return "";
+      }
+      return rd->names[index - 1];
+   }
+
+   name = read_data(rd, read_varint(rd));
+   if (!name)
+      return "";
+
+   if (rd->num_names == rd->max_names) {
+      unsigned max_names = MAX2(2 * rd->max_names, 64);
+      rd->names = REALLOC(rd->names,
+                          rd->max_names * sizeof *rd->names,
+                          max_names * sizeof *rd->names);
+      rd->max_names = max_names;
+   }
+   rd->names[rd->num_names++] = name;
+   return name;
+}
+
+
+static void
+free_value(struct value *value)
+{
+   unsigned i;
+
+   if (value == &null_value)
+      return;
+
+   switch (value->kind) {
+   case VALUE_BYTES:
+   case VALUE_STRING:
+      if (value->u.bytes.owned)
+         FREE((void *)value->u.bytes.data);
+      break;
+   case VALUE_ARRAY:
+   case VALUE_STRUCT:
+      for (i = 0; i < value->u.list.count; ++i)
+         free_value(value->u.list.elems[i]);
+      FREE(value->u.list.names);
+      FREE(value->u.list.elems);
+      break;
+   default:
+      break;
+   }
+
+   FREE(value);
+}
+
+
+static void
+append_elem(struct value *list, const char *name, struct value *elem)
+{
+   unsigned count = list->u.list.count;
+
+   /* grow at powers of two, starting with four */
+   if (count == 0 || (count >= 4 && (count & (count - 1)) == 0)) {
+      unsigned size = count ? 2 * count : 4;
+      list->u.list.names = REALLOC(list->u.list.names,
+                                   count * sizeof(const char *),
+                                   size * sizeof(const char *));
+      list->u.list.elems = REALLOC(list->u.list.elems,
+                                   count * sizeof(struct value *),
+                                   size * sizeof(struct value *));
+   }
+
+   list->u.list.names[count] = name;
+   list->u.list.elems[count] = elem;
+   list->u.list.count = count + 1;
+}
+
+
+static struct value *
+read_value(struct reader *rd, unsigned opcode)
+{
+   struct value *value;
+   unsigned op;
+
+   if (rd->error)
+      return &null_value;
+
+   value = CALLOC_STRUCT(value);
+   if (!value) {
+      rd->error = TRUE;
+      return &null_value;
+   }
+
+   switch (opcode) {
+   case TRACE_BIN_NULL:
+      value->kind = VALUE_NULL;
+      break;
+   case TRACE_BIN_FALSE:
+   case TRACE_BIN_TRUE:
+      value->kind = VALUE_BOOL;
+      value->u.u = opcode == TRACE_BIN_TRUE;
+      break;
+   case TRACE_BIN_INT: {
+      uint64_t u = read_varint(rd);
+      value->kind = VALUE_INT;
+      value->u.i = (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+      break;
+   }
+   case TRACE_BIN_UINT:
+   case TRACE_BIN_PTR:
+      value->kind = opcode == TRACE_BIN_PTR ? VALUE_PTR : VALUE_UINT;
+      value->u.u = read_varint(rd);
+      break;
+   case TRACE_BIN_FLOAT: {
+      union { float f; uint32_t u; } f;
+      f.u = read_fixed(rd, 4);
+      value->kind = VALUE_FLOAT;
+      value->u.f = f.f;
+      break;
+   }
+   case TRACE_BIN_DOUBLE: {
+      union { double d; uint64_t u; } d;
+      d.u = read_fixed(rd, 8);
+      value->kind = VALUE_FLOAT;
+      value->u.f = d.d;
+      break;
+   }
+   case TRACE_BIN_BYTES:
+   case TRACE_BIN_STRING: {
+      size_t size = read_varint(rd);
+      char *data = read_data(rd, size);
+
+      value->kind = opcode == TRACE_BIN_STRING ? VALUE_STRING : VALUE_BYTES;
+      value->u.bytes.data = data ? data : "";
+      value->u.bytes.size = data ? size : 0;
+      value->u.bytes.owned = data != NULL;
+
+      if (data && size >= TRACE_BIN_MIN_BLOB_SIZE) {
+         if (rd->num_blobs == rd->max_blobs) {
+            unsigned max_blobs = MAX2(2 * rd->max_blobs, 64);
+            rd->blobs = REALLOC(rd->blobs,
+                                rd->max_blobs * sizeof *rd->blobs,
+                                max_blobs * sizeof *rd->blobs);
+            rd->max_blobs = max_blobs;
+         }
+         rd->blobs[rd->num_blobs].kind = value->kind;
+         rd->blobs[rd->num_blobs].data = data;
+         rd->blobs[rd->num_blobs].size = size;
+         rd->num_blobs++;
+         value->u.bytes.owned = FALSE;
+      }
+      break;
+   }
+   case TRACE_BIN_BLOB_REF: {
+      uint64_t number = read_varint(rd);
+      if (number >= rd->num_blobs) {
+         rd->error = TRUE;
+         break;
+      }
+      value->kind = rd->blobs[number].kind;
+      value->u.bytes.data = rd->blobs[number].data;
+      value->u.bytes.size = rd->blobs[number].size;
+      value->u.bytes.owned = FALSE;
+      break;
+   }
+   case TRACE_BIN_ENUM:
+      value->kind = VALUE_ENUM;
+      value->u.name = read_name(rd);
+      break;
+   case TRACE_BIN_ARRAY_BEGIN:
+      value->kind = VALUE_ARRAY;
+      while (!rd->error && (op = read_byte(rd)) != TRACE_BIN_ARRAY_END)
+         append_elem(value, NULL, read_value(rd, op));
+      break;
+   case TRACE_BIN_STRUCT_BEGIN:
+      value->kind = VALUE_STRUCT;
+      read_name(rd);
+      while (!rd->error && (op = read_byte(rd)) != TRACE_BIN_STRUCT_END) {
+         const char *name;
+         if (op != TRACE_BIN_MEMBER) {
+            rd->error = TRUE;
+            break;
+         }
+         name = read_name(rd);
+         append_elem(value, name, read_value(rd, read_byte(rd)));
+      }
+      break;
+   default:
+      rd->error = TRUE;
+      break;
+   }
+
+   return value;
+}
+
+
+static void
+free_call(struct call *call)
+{
+   unsigned i;
+
+   for (i = 0; i < call->num_args; ++i)
+      free_value(call->args[i]);
+   if (call->ret)
+      free_value(call->ret);
+
+   memset(call, 0, sizeof *call);
+}
+
+
+/**
+ * Read the next call, returning FALSE at the end of the trace.
+ */
+static boolean
+read_call(struct reader *rd, struct call *call)
+{
+   unsigned op;
+
+   memset(call, 0, sizeof *call);
+
+   op = read_byte(rd);
+   if (rd->error)
+      return FALSE;
+
+   if (op != TRACE_BIN_CALL_BEGIN) {
+      rd->error = TRUE;
+      return FALSE;
+   }
+
+   call->no = read_varint(rd);
+   call->klass = read_name(rd);
+   call->method = read_name(rd);
+
+   while (!rd->error) {
+      op = read_byte(rd);
+
+      if (op == TRACE_BIN_CALL_END) {
+         /* the capture time */
+         read_varint(rd);
+         break;
+      }
+      else if (op == TRACE_BIN_ARG) {
+         const char *name = read_name(rd);
+         struct value *value = read_value(rd, read_byte(rd));
+         if (call->num_args < MAX_ARGS) {
+            call->arg_names[call->num_args] = name;
+            call->args[call->num_args++] = value;
+         } else {
+            free_value(value);
+         }
+      }
+      else if (op == TRACE_BIN_RET) {
+         if (call->ret)
+            free_value(call->ret);
+         call->ret = read_value(rd, read_byte(rd));
+      }
+      else {
+         rd->error = TRUE;
+      }
+   }
+
+   return !rd->error;
+}
+
+
+/*
+ * Value accessors, returning null or zero for anything missing.
+ */
+
+static struct value *
+arg(const struct call *call, const char *name)
+{
+   unsigned i;
+
+   for (i = 0; i < call->num_args; ++i) {
+      if (strcmp(call->arg_names[i], name) == 0)
+         return call->args[i];
+   }
+   return &null_value;
+}
+
+
+static struct value *
+member(const struct value *value, const char *name)
+{
+   unsigned i;
+
+   if (value->kind != VALUE_STRUCT)
+      return &null_value;
+
+   for (i = 0; i < value->u.list.count; ++i) {
+      if (strcmp(value->u.list.names[i], name) == 0)
+         return value->u.list.elems[i];
+   }
+   return &null_value;
+}
+
+
+static struct value *
+elem(const struct value *value, unsigned index)
+{
+   if (value->kind != VALUE_ARRAY || index >= value->u.list.count)
+      return &null_value;
+   return value->u.list.elems[index];
+}
+
+
+static int64_t
+get_int(const struct value *value)
+{
+   switch (value->kind) {
+   case VALUE_BOOL:
+   case VALUE_UINT:
+   case VALUE_PTR:
+      return (int64_t)value->u.u;
+   case VALUE_INT:
+      return value->u.i;
+   case VALUE_FLOAT:
+      return (int64_t)value->u.f;
+   default:
+      return 0;
+   }
+}
+
+
+static uint64_t
+get_uint(const struct value *value)
+{
+   return (uint64_t)get_int(value);
+}
+
+
+static double
+get_float(const struct value *value)
+{
+   if (value->kind == VALUE_FLOAT)
+      return value->u.f;
+   return (double)get_int(value);
+}
+
+
+static enum pipe_format
+get_format(const struct value *value)
+{
+   unsigned format;
+
+   if (value->kind != VALUE_ENUM)
+      return PIPE_FORMAT_NONE;
+
+   for (format = 0; format < PIPE_FORMAT_COUNT; ++format) {
+      const char *name = util_format_name(format);
+      if (name && strcmp(name, value->u.name) == 0)
+         return format;
+   }
+   return PIPE_FORMAT_NONE;
+}
+
+
+static void
+get_float_array(const struct value *value, float *array, unsigned count)
+{
+   unsigned i;
+
+   for (i = 0; i < count; ++i)
+      array[i] = get_float(elem(value, i));
+}
+
+
+#define GET_UINT(_obj, _value, _member) \
+   (_obj)->_member = get_uint(member(_value, #_member))
+
+#define GET_INT(_obj, _value, _member) \
+   (_obj)->_member = get_int(member(_value, #_member))
+
+#define GET_FLOAT(_obj, _value, _member) \
+   (_obj)->_member = get_float(member(_value, #_member))
+
+
+/*
+ * Objects created by the trace, looked up by their traced pointer.
+ */
+
+enum object_type
+{
+   OBJECT_CONTEXT,
+   OBJECT_RESOURCE,
+   OBJECT_SURFACE,
+   OBJECT_SAMPLER_VIEW,
+   OBJECT_QUERY,
+   OBJECT_SO_TARGET,
+   OBJECT_FENCE,
+   OBJECT_BLEND,
+   OBJECT_SAMPLER,
+   OBJECT_RASTERIZER,
+   OBJECT_DEPTH_STENCIL_ALPHA,
+   OBJECT_FS,
+   OBJECT_VS,
+   OBJECT_GS,
+   OBJECT_VERTEX_ELEMENTS
+};
+
+
+struct object
+{
+   enum object_type type;
+   void *handle;
+   struct pipe_context *pipe;
+};
+
+
+struct method_stats;
+
+struct replay
+{
+   struct pipe_screen *screen;
+   struct util_hash_table *objects;
+
+   /* Context of the last call, for flush_frontbuffer */
+   struct pipe_context *pipe;
+
+   /* Driver time of the current call, in nanoseconds */
+   int64_t call_time;
+
+   /* Current frame */
+   boolean end_of_frame;
+   int64_t frame_time;
+   unsigned frame_calls;
+
+   /* Totals */
+   unsigned num_frames;
+   int64_t total_frame_time;
+   int64_t min_frame_time;
+   int64_t max_frame_time;
+   unsigned skipped;
+
+   boolean verbose;
+   boolean releasing_contexts;
+};
+
+
+#define TIMED(_r, _stmt) \
+   do { \
+      int64_t _start = os_time_get_nano(); \
+      _stmt; \
+      (_r)->call_time += os_time_get_nano() - _start; \
+   } while (0)
+
+
+static unsigned
+object_hash(void *key)
+{
+   uintptr_t ptr = (uintptr_t)key;
+   return (unsigned)(ptr >> 4) ^ (unsigned)(ptr >> 20);
+}
+
+
+static int
+object_compare(void *key1, void *key2)
+{
+   return key1 != key2;
+}
+
+
+/* Traced pointers may be wider than ours when replaying on a different
+ * host; they only need to stay unique. */
+#define OBJECT_KEY(_ptr) ((void *)(uintptr_t)(_ptr))
+
+
+static void
+release_object(struct replay *r, struct object *obj)
+{
+   struct pipe_context *pipe = obj->pipe;
+
+   switch (obj->type) {
+   case OBJECT_CONTEXT:
+      pipe->destroy(pipe);
+      if (r->pipe == pipe)
+         r->pipe = NULL;
+      break;
+   case OBJECT_RESOURCE: {
+      struct pipe_resource *resource = obj->handle;
+      pipe_resource_reference(&resource, NULL);
+      break;
+   }
+   case OBJECT_SURFACE: {
+      struct pipe_surface *surface = obj->handle;
+      pipe_surface_reference(&surface, NULL);
+      break;
+   }
+   case OBJECT_SAMPLER_VIEW: {
+      struct pipe_sampler_view *view = obj->handle;
+      pipe_sampler_view_reference(&view, NULL);
+      break;
+   }
+   case OBJECT_QUERY:
+      pipe->destroy_query(pipe, obj->handle);
+      break;
+   case OBJECT_SO_TARGET: {
+      struct pipe_stream_output_target *target = obj->handle;
+      pipe_so_target_reference(&target, NULL);
+      break;
+   }
+   case OBJECT_FENCE: {
+      struct pipe_fence_handle *fence = obj->handle;
+      r->screen->fence_reference(r->screen, &fence, NULL);
+      break;
+   }
+   case OBJECT_BLEND:
+      pipe->delete_blend_state(pipe, obj->handle);
+      break;
+   case OBJECT_SAMPLER:
+      pipe->delete_sampler_state(pipe, obj->handle);
+      break;
+   case OBJECT_RASTERIZER:
+      pipe->delete_rasterizer_state(pipe, obj->handle);
+      break;
+   case OBJECT_DEPTH_STENCIL_ALPHA:
+      pipe->delete_depth_stencil_alpha_state(pipe, obj->handle);
+      break;
+   case OBJECT_FS:
+      pipe->delete_fs_state(pipe, obj->handle);
+      break;
+   case OBJECT_VS:
+      pipe->delete_vs_state(pipe, obj->handle);
+      break;
+   case OBJECT_GS:
+      pipe->delete_gs_state(pipe, obj->handle);
+      break;
+   case OBJECT_VERTEX_ELEMENTS:
+      pipe->delete_vertex_elements_state(pipe, obj->handle);
+      break;
+   }
+}
+
+
+static void
+add_object(struct replay *r, const struct value *ptr, enum object_type type,
+           void *handle, struct pipe_context *pipe)
+{
+   struct object *obj;
+
+   if (!handle)
+      return;
+
+   if (ptr->kind != VALUE_PTR) {
+      struct object tmp;
+      tmp.type = type;
+      tmp.handle = handle;
+      tmp.pipe = pipe;
+      release_object(r, &tmp);
+      return;
+   }
+
+   /* The traced object may have been freed behind our back, e.g. fences
+    * are released without a traced call, and its address reused. */
+   obj = util_hash_table_get(r->objects, OBJECT_KEY(ptr->u.u));
+   if (obj) {
+      release_object(r, obj);
+   } else {
+      obj = CALLOC_STRUCT(object);
+      if (!obj)
+         return;
+      util_hash_table_set(r->objects, OBJECT_KEY(ptr->u.u), obj);
+   }
+
+   obj->type = type;
+   obj->handle = handle;
+   obj->pipe = pipe;
+}
+
+
+static void *
+lookup_object(struct replay *r, const struct value *ptr,
+              enum object_type type)
+{
+   struct object *obj;
+
+   if (ptr->kind != VALUE_PTR)
+      return NULL;
+
+   obj = util_hash_table_get(r->objects, OBJECT_KEY(ptr->u.u));
+   if (!obj || obj->type != type)
+      return NULL;
+
+   return obj->handle;
+}
+
+
+/**
+ * Look up an object which may be null.  Returns FALSE if a non-null
+ * pointer isn't known, so the call can't be replayed.
+ */
+static boolean
+lookup_optional(struct replay *r, const struct value *ptr,
+                enum object_type type, void **handle)
+{
+   *handle = lookup_object(r, ptr, type);
+   return *handle || ptr->kind != VALUE_PTR;
+}
+
+
+static void
+remove_object(struct replay *r, const struct value *ptr,
+              enum object_type type)
+{
+   struct object *obj;
+
+   if (ptr->kind != VALUE_PTR)
+      return;
+
+   obj = util_hash_table_get(r->objects, OBJECT_KEY(ptr->u.u));
+   if (!obj || obj->type != type) {
+      r->skipped++;
+      return;
+   }
+
+   TIMED(r, release_object(r, obj));
+   util_hash_table_remove(r->objects, OBJECT_KEY(ptr->u.u));
+   FREE(obj);
+}
+
+
+/**
+ * The context a pipe_context call is made on.  This is always the first
+ * argument, called either "pipe" or "context".
+ */
+static struct pipe_context *
+get_context(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe;
+
+   if (!call->num_args)
+      return NULL;
+
+   pipe = lookup_object(r, call->args[0], OBJECT_CONTEXT);
+   if (pipe)
+      r->pipe = pipe;
+   return pipe;
+}
+
+
+/*
+ * pipe_screen calls
+ */
+
+static void
+replay_screen_context_create(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe;
+
+   TIMED(r, pipe = r->screen->context_create(r->screen, NULL));
+   add_object(r, call->ret, OBJECT_CONTEXT, pipe, pipe);
+}
+
+
+static void
+replay_screen_resource_create(struct replay *r, const struct call *call)
+{
+   const struct value *templat = arg(call, "templat");
+   struct pipe_resource templ;
+   struct pipe_resource *resource;
+
+   memset(&templ, 0, sizeof templ);
+   GET_UINT(&templ, templat, target);
+   templ.format = get_format(member(templat, "format"));
+   templ.width0 = get_uint(member(templat, "width"));
+   templ.height0 = get_uint(member(templat, "height"));
+   templ.depth0 = get_uint(member(templat, "depth"));
+   templ.array_size = get_uint(member(templat, "array_size"));
+   GET_UINT(&templ, templat, last_level);
+   GET_UINT(&templ, templat, nr_samples);
+   GET_UINT(&templ, templat, usage);
+   GET_UINT(&templ, templat, bind);
+   GET_UINT(&templ, templat, flags);
+
+   /* We have no window system to present to. */
+   templ.bind &= ~(PIPE_BIND_DISPLAY_TARGET |
+                   PIPE_BIND_SCANOUT |
+                   PIPE_BIND_SHARED);
+
+   TIMED(r, resource = r->screen->resource_create(r->screen, &templ));
+   if (!resource)
+      r->skipped++;
+
+   add_object(r, call->ret, OBJECT_RESOURCE, resource, NULL);
+}
+
+
+static void
+replay_screen_resource_destroy(struct replay *r, const struct call *call)
+{
+   remove_object(r, arg(call, "resource"), OBJECT_RESOURCE);
+}
+
+
+static void
+replay_screen_flush_frontbuffer(struct replay *r, const struct call *call)
+{
+   r->end_of_frame = TRUE;
+}
+
+
+static void
+replay_screen_fence_finish(struct replay *r, const struct call *call)
+{
+   struct pipe_fence_handle *fence;
+
+   fence = lookup_object(r, arg(call, "fence"), OBJECT_FENCE);
+   if (!fence) {
+      r->skipped++;
+      return;
+   }
+
+   TIMED(r, r->screen->fence_finish(r->screen, fence,
+                                    get_uint(arg(call, "timeout"))));
+}
+
+
+/*
+ * pipe_context state object calls
+ */
+
+static void
+replay_create_blend_state(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   const struct value *state = arg(call, "state");
+   const struct value *rts = member(state, "rt");
+   struct pipe_blend_state blend;
+   unsigned i;
+   void *handle;
+
+   if (!pipe)
+      return;
+
+   memset(&blend, 0, sizeof blend);
+   GET_UINT(&blend, state, dither);
+   GET_UINT(&blend, state, logicop_enable);
+   GET_UINT(&blend, state, logicop_func);
+   GET_UINT(&blend, state, independent_blend_enable);
+
+   for (i = 0; i < PIPE_MAX_COLOR_BUFS; ++i) {
+      const struct value *rt = elem(rts, i);
+      GET_UINT(&blend.rt[i], rt, blend_enable);
+      GET_UINT(&blend.rt[i], rt, rgb_func);
+      GET_UINT(&blend.rt[i], rt, rgb_src_factor);
+      GET_UINT(&blend.rt[i], rt, rgb_dst_factor);
+      GET_UINT(&blend.rt[i], rt, alpha_func);
+      GET_UINT(&blend.rt[i], rt, alpha_src_factor);
+      GET_UINT(&blend.rt[i], rt, alpha_dst_factor);
+      GET_UINT(&blend.rt[i], rt, colormask);
+   }
+
+   TIMED(r, handle = pipe->create_blend_state(pipe, &blend));
+   add_object(r, call->ret, OBJECT_BLEND, handle, pipe);
+}
+
+
+static void
+replay_create_sampler_state(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   const struct value *state = arg(call, "state");
+   struct pipe_sampler_state sampler;
+   void *handle;
+
+   if (!pipe)
+      return;
+
+   memset(&sampler, 0, sizeof sampler);
+   GET_UINT(&sampler, state, wrap_s);
+   GET_UINT(&sampler, state, wrap_t);
+   GET_UINT(&sampler, state, wrap_r);
+   GET_UINT(&sampler, state, min_img_filter);
+   GET_UINT(&sampler, state, min_mip_filter);
+   GET_UINT(&sampler, state, mag_img_filter);
+   GET_UINT(&sampler, state, compare_mode);
+   GET_UINT(&sampler, state, compare_func);
+   GET_UINT(&sampler, state, normalized_coords);
+   GET_UINT(&sampler, state, max_anisotropy);
+   GET_UINT(&sampler, state, seamless_cube_map);
+   GET_FLOAT(&sampler, state, lod_bias);
+   GET_FLOAT(&sampler, state, min_lod);
+   GET_FLOAT(&sampler, state, max_lod);
+   get_float_array(member(state, "border_color.f"), sampler.border_color.f, 4);
+
+   TIMED(r, handle = pipe->create_sampler_state(pipe, &sampler));
+   add_object(r, call->ret, OBJECT_SAMPLER, handle, pipe);
+}
+
+
+static void
+replay_create_rasterizer_state(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   const struct value *state = arg(call, "state");
+   struct pipe_rasterizer_state rast;
+   void *handle;
+
+   if (!pipe)
+      return;
+
+   memset(&rast, 0, sizeof rast);
+   GET_UINT(&rast, state, flatshade);
+   GET_UINT(&rast, state, light_twoside);
+   GET_UINT(&rast, state, clamp_vertex_color);
+   GET_UINT(&rast, state, clamp_fragment_color);
+   GET_UINT(&rast, state, front_ccw);
+   GET_UINT(&rast, state, cull_face);
+   GET_UINT(&rast, state, fill_front);
+   GET_UINT(&rast, state, fill_back);
+   GET_UINT(&rast, state, offset_point);
+   GET_UINT(&rast, state, offset_line);
+   GET_UINT(&rast, state, offset_tri);
+   GET_UINT(&rast, state, scissor);
+   GET_UINT(&rast, state, poly_smooth);
+   GET_UINT(&rast, state, poly_stipple_enable);
+   GET_UINT(&rast, state, point_smooth);
+   GET_UINT(&rast, state, sprite_coord_mode);
+   GET_UINT(&rast, state, point_quad_rasterization);
+   GET_UINT(&rast, state, point_size_per_vertex);
+   GET_UINT(&rast, state, multisample);
+   GET_UINT(&rast, state, line_smooth);
+   GET_UINT(&rast, state, line_stipple_enable);
+   GET_UINT(&rast, state, line_last_pixel);
+   GET_UINT(&rast, state, flatshade_first);
+   GET_UINT(&rast, state, half_pixel_center);
+   GET_UINT(&rast, state, bottom_edge_rule);
+   GET_UINT(&rast, state, rasterizer_discard);
+   GET_UINT(&rast, state, depth_clip);
+   GET_UINT(&rast, state, clip_halfz);
+   GET_UINT(&rast, state, clip_plane_enable);
+   GET_UINT(&rast, state, line_stipple_factor);
+   GET_UINT(&rast, state, line_stipple_pattern);
+   GET_UINT(&rast, state, sprite_coord_enable);
+   GET_FLOAT(&rast, state, line_width);
+   GET_FLOAT(&rast, state, point_size);
+   GET_FLOAT(&rast, state, offset_units);
+   GET_FLOAT(&rast, state, offset_scale);
+   GET_FLOAT(&rast, state, offset_clamp);
+
+   TIMED(r, handle = pipe->create_rasterizer_state(pipe, &rast));
+   add_object(r, call->ret, OBJECT_RASTERIZER, handle, pipe);
+}
+
+
+static void
+replay_create_depth_stencil_alpha_state(struct replay *r,
+                                        const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   const struct value *state = arg(call, "state");
+   const struct value *depth = member(state, "depth");
+   const struct value *alpha = member(state, "alpha");
+   struct pipe_depth_stencil_alpha_state dsa;
+   unsigned i;
+   void *handle;
+
+   if (!pipe)
+      return;
+
+   memset(&dsa, 0, sizeof dsa);
+   GET_UINT(&dsa.depth, depth, enabled);
+   GET_UINT(&dsa.depth, depth, writemask);
+   GET_UINT(&dsa.depth, depth, func);
+
+   for (i = 0; i < Elements(dsa.stencil); ++i) {
+      const struct value *stencil = elem(member(state, "stencil"), i);
+      GET_UINT(&dsa.stencil[i], stencil, enabled);
+      GET_UINT(&dsa.stencil[i], stencil, func);
+      GET_UINT(&dsa.stencil[i], stencil, fail_op);
+      GET_UINT(&dsa.stencil[i], stencil, zpass_op);
+      GET_UINT(&dsa.stencil[i], stencil, zfail_op);
+      GET_UINT(&dsa.stencil[i], stencil, valuemask);
+      GET_UINT(&dsa.stencil[i], stencil, writemask);
+   }
+
+   GET_UINT(&dsa.alpha, alpha, enabled);
+   GET_UINT(&dsa.alpha, alpha, func);
+   GET_FLOAT(&dsa.alpha, alpha, ref_value);
+
+   TIMED(r, handle = pipe->create_depth_stencil_alpha_state(pipe, &dsa));
+   add_object(r, call->ret, OBJECT_DEPTH_STENCIL_ALPHA, handle, pipe);
+}
+
+
+static void
+replay_create_shader_state(struct replay *r, const struct call *call,
+                           enum object_type type)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   const struct value *state = arg(call, "state");
+   const struct value *tokens = member(state, "tokens");
+   const struct value *so = member(state, "stream_output");
+   const struct value *outputs = member(so, "output");
+   struct pipe_shader_state shader;
+   struct tgsi_token *tgsi;
+   unsigned i;
+   void *handle = NULL;
+
+   if (!pipe)
+      return;
+
+   if (tokens->kind != VALUE_STRING) {
+      r->skipped++;
+      return;
+   }
+
+   tgsi = MALLOC(MAX_TOKENS * sizeof *tgsi);
+   if (!tgsi)
+      return;
+
+   if (!tgsi_text_translate(tokens->u.bytes.data, tgsi, MAX_TOKENS)) {
+      fprintf(stderr, "call %u: failed to parse shader\n", call->no);
+      r->skipped++;
+      FREE(tgsi);
+      return;
+   }
+
+   memset(&shader, 0, sizeof shader);
+   shader.tokens = tgsi;
+
+   GET_UINT(&shader.stream_output, so, num_outputs);
+   for (i = 0; i < PIPE_MAX_SO_BUFFERS; ++i)
+      shader.stream_output.stride[i] = get_uint(elem(member(so, "stride"), i));
+   for (i = 0; i < shader.stream_output.num_outputs &&
+               i < PIPE_MAX_SO_OUTPUTS; ++i) {
+      const struct value *output = elem(outputs, i);
+      GET_UINT(&shader.stream_output.output[i], output, register_index);
+      GET_UINT(&shader.stream_output.output[i], output, start_component);
+      GET_UINT(&shader.stream_output.output[i], output, num_components);
+      GET_UINT(&shader.stream_output.output[i], output, output_buffer);
+      GET_UINT(&shader.stream_output.output[i], output, dst_offset);
+   }
+
+   switch (type) {
+   case OBJECT_FS:
+      TIMED(r, handle = pipe->create_fs_state(pipe, &shader));
+      break;
+   case OBJECT_VS:
+      TIMED(r, handle = pipe->create_vs_state(pipe, &shader));
+      break;
+   case OBJECT_GS:
+      if (pipe->create_gs_state)
+         TIMED(r, handle = pipe->create_gs_state(pipe, &shader));
+      break;
+   default:
+      assert(0);
+      break;
+   }
+
+   FREE(tgsi);
+
+   add_object(r, call->ret, type, handle, pipe);
+}
+
+
+static void
+replay_create_fs_state(struct replay *r, const struct call *call)
+{
+   replay_create_shader_state(r, call, OBJECT_FS);
+}
+
+
+static void
+replay_create_vs_state(struct replay *r, const struct call *call)
+{
+   replay_create_shader_state(r, call, OBJECT_VS);
+}
+
+
+static void
+replay_create_gs_state(struct replay *r, const struct call *call)
+{
+   replay_create_shader_state(r, call, OBJECT_GS);
+}
+
+
+static void
+replay_create_vertex_elements_state(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   const struct value *elements = arg(call, "elements");
+   struct pipe_vertex_element velems[PIPE_MAX_ATTRIBS];
+   unsigned num_elements = get_uint(arg(call, "num_elements"));
+   unsigned i;
+   void *handle;
+
+   if (!pipe)
+      return;
+
+   num_elements = MIN2(num_elements, PIPE_MAX_ATTRIBS);
+
+   /* instance_divisor isn't traced */
+   memset(velems, 0, sizeof velems);
+   for (i = 0; i < num_elements; ++i) {
+      const struct value *velem = elem(elements, i);
+      GET_UINT(&velems[i], velem, src_offset);
+      GET_UINT(&velems[i], velem, vertex_buffer_index);
+      velems[i].src_format = get_format(member(velem, "src_format"));
+   }
+
+   TIMED(r, handle = pipe->create_vertex_elements_state(pipe, num_elements,
+                                                        velems));
+   add_object(r, call->ret, OBJECT_VERTEX_ELEMENTS, handle, pipe);
+}
+
+
+static void
+replay_bind_state(struct replay *r, const struct call *call,
+                  enum object_type type)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   void *handle;
+
+   if (!pipe)
+      return;
+
+   if (!lookup_optional(r, arg(call, "state"), type, &handle)) {
+      r->skipped++;
+      return;
+   }
+
+   switch (type) {
+   case OBJECT_BLEND:
+      TIMED(r, pipe->bind_blend_state(pipe, handle));
+      break;
+   case OBJECT_RASTERIZER:
+      TIMED(r, pipe->bind_rasterizer_state(pipe, handle));
+      break;
+   case OBJECT_DEPTH_STENCIL_ALPHA:
+      TIMED(r, pipe->bind_depth_stencil_alpha_state(pipe, handle));
+      break;
+   case OBJECT_FS:
+      TIMED(r, pipe->bind_fs_state(pipe, handle));
+      break;
+   case OBJECT_VS:
+      TIMED(r, pipe->bind_vs_state(pipe, handle));
+      break;
+   case OBJECT_GS:
+      if (pipe->bind_gs_state)
+         TIMED(r, pipe->bind_gs_state(pipe, handle));
+      break;
+   case OBJECT_VERTEX_ELEMENTS:
+      TIMED(r, pipe->bind_vertex_elements_state(pipe, handle));
+      break;
+   default:
+      assert(0);
+      break;
+   }
+}
+
+
+static void
+replay_bind_blend_state(struct replay *r, const struct call *call)
+{
+   replay_bind_state(r, call, OBJECT_BLEND);
+}
+
+
+static void
+replay_bind_rasterizer_state(struct replay *r, const struct call *call)
+{
+   replay_bind_state(r, call, OBJECT_RASTERIZER);
+}
+
+
+static void
+replay_bind_depth_stencil_alpha_state(struct replay *r,
+                                      const struct call *call)
+{
+   replay_bind_state(r, call, OBJECT_DEPTH_STENCIL_ALPHA);
+}
+
+
+static void
+replay_bind_fs_state(struct replay *r, const struct call *call)
+{
+   replay_bind_state(r, call, OBJECT_FS);
+}
+
+
+static void
+replay_bind_vs_state(struct replay *r, const struct call *call)
+{
+   replay_bind_state(r, call, OBJECT_VS);
+}
+
+
+static void
+replay_bind_gs_state(struct replay *r, const struct call *call)
+{
+   replay_bind_state(r, call, OBJECT_GS);
+}
+
+
+static void
+replay_bind_vertex_elements_state(struct replay *r, const struct call *call)
+{
+   replay_bind_state(r, call, OBJECT_VERTEX_ELEMENTS);
+}
+
+
+static void
+replay_bind_sampler_states(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   const struct value *states = arg(call, "states");
+   void *handles[PIPE_MAX_SAMPLERS];
+   unsigned start = get_uint(arg(call, "start"));
+   unsigned num_states = get_uint(arg(call, "num_states"));
+   unsigned i;
+
+   if (!pipe || start + num_states > PIPE_MAX_SAMPLERS)
+      return;
+
+   for (i = 0; i < num_states; ++i) {
+      if (!lookup_optional(r, elem(states, i), OBJECT_SAMPLER, &handles[i])) {
+         r->skipped++;
+         return;
+      }
+   }
+
+   TIMED(r, pipe->bind_sampler_states(pipe, get_uint(arg(call, "shader")),
+                                      start, num_states,
+                                      states->kind == VALUE_NULL ?
+                                      NULL : handles));
+}
+
+
+static void
+replay_delete_blend_state(struct replay *r, const struct call *call)
+{
+   remove_object(r, arg(call, "state"), OBJECT_BLEND);
+}
+
+
+static void
+replay_delete_sampler_state(struct replay *r, const struct call *call)
+{
+   remove_object(r, arg(call, "state"), OBJECT_SAMPLER);
+}
+
+
+static void
+replay_delete_rasterizer_state(struct replay *r, const struct call *call)
+{
+   remove_object(r, arg(call, "state"), OBJECT_RASTERIZER);
+}
+
+
+static void
+replay_delete_depth_stencil_alpha_state(struct replay *r,
+                                        const struct call *call)
+{
+   remove_object(r, arg(call, "state"), OBJECT_DEPTH_STENCIL_ALPHA);
+}
+
+
+static void
+replay_delete_fs_state(struct replay *r, const struct call *call)
+{
+   remove_object(r, arg(call, "state"), OBJECT_FS);
+}
+
+
+static void
+replay_delete_vs_state(struct replay *r, const struct call *call)
+{
+   remove_object(r, arg(call, "state"), OBJECT_VS);
+}
+
+
+static void
+replay_delete_gs_state(struct replay *r, const struct call *call)
+{
+   remove_object(r, arg(call, "state"), OBJECT_GS);
+}
+
+
+static void
+replay_delete_vertex_elements_state(struct replay *r, const struct call *call)
+{
+   remove_object(r, arg(call, "state"), OBJECT_VERTEX_ELEMENTS);
+}
+
+
+/*
+ * pipe_context parameter calls
+ */
+
+static void
+replay_set_blend_color(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   struct pipe_blend_color color;
+
+   if (!pipe)
+      return;
+
+   get_float_array(member(arg(call, "state"), "color"), color.color, 4);
+
+   TIMED(r, pipe->set_blend_color(pipe, &color));
+}
+
+
+static void
+replay_set_stencil_ref(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   const struct value *ref_value = member(arg(call, "state"), "ref_value");
+   struct pipe_stencil_ref ref;
+
+   if (!pipe)
+      return;
+
+   ref.ref_value[0] = get_uint(elem(ref_value, 0));
+   ref.ref_value[1] = get_uint(elem(ref_value, 1));
+
+   TIMED(r, pipe->set_stencil_ref(pipe, &ref));
+}
+
+
+static void
+replay_set_clip_state(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   const struct value *ucp = member(arg(call, "state"), "ucp");
+   struct pipe_clip_state clip;
+   unsigned i;
+
+   if (!pipe)
+      return;
+
+   for (i = 0; i < PIPE_MAX_CLIP_PLANES; ++i)
+      get_float_array(elem(ucp, i), clip.ucp[i], 4);
+
+   TIMED(r, pipe->set_clip_state(pipe, &clip));
+}
+
+
+static void
+replay_set_sample_mask(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+
+   if (!pipe)
+      return;
+
+   TIMED(r, pipe->set_sample_mask(pipe,
+                                  get_uint(arg(call, "sample_mask"))));
+}
+
+
+static void
+replay_set_constant_buffer(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   const struct value *value = arg(call, "constant_buffer");
+   struct pipe_constant_buffer cb;
+   struct pipe_constant_buffer *pcb = NULL;
+
+   if (!pipe)
+      return;
+
+   if (value->kind == VALUE_STRUCT) {
+      memset(&cb, 0, sizeof cb);
+      cb.buffer = lookup_object(r, member(value, "buffer"), OBJECT_RESOURCE);
+      GET_UINT(&cb, value, buffer_offset);
+      GET_UINT(&cb, value, buffer_size);
+
+      /* user constant buffers aren't traced */
+      if (!cb.buffer) {
+         r->skipped++;
+         return;
+      }
+      pcb = &cb;
+   }
+
+   TIMED(r, pipe->set_constant_buffer(pipe,
+                                      get_uint(arg(call, "shader")),
+                                      get_uint(arg(call, "index")),
+                                      pcb));
+}
+
+
+static void
+replay_set_framebuffer_state(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   const struct value *state = arg(call, "state");
+   struct pipe_framebuffer_state fb;
+   unsigned i;
+
+   if (!pipe)
+      return;
+
+   memset(&fb, 0, sizeof fb);
+   GET_UINT(&fb, state, width);
+   GET_UINT(&fb, state, height);
+   GET_UINT(&fb, state, nr_cbufs);
+   fb.nr_cbufs = MIN2(fb.nr_cbufs, PIPE_MAX_COLOR_BUFS);
+
+   for (i = 0; i < fb.nr_cbufs; ++i) {
+      if (!lookup_optional(r, elem(member(state, "cbufs"), i),
+                           OBJECT_SURFACE, (void **)&fb.cbufs[i])) {
+         r->skipped++;
+         return;
+      }
+   }
+
+   if (!lookup_optional(r, member(state, "zsbuf"),
+                        OBJECT_SURFACE, (void **)&fb.zsbuf)) {
+      r->skipped++;
+      return;
+   }
+
+   TIMED(r, pipe->set_framebuffer_state(pipe, &fb));
+}
+
+
+static void
+replay_set_polygon_stipple(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   const struct value *stipple = member(arg(call, "state"), "stipple");
+   struct pipe_poly_stipple state;
+   unsigned i;
+
+   if (!pipe)
+      return;
+
+   for (i = 0; i < Elements(state.stipple); ++i)
+      state.stipple[i] = get_uint(elem(stipple, i));
+
+   TIMED(r, pipe->set_polygon_stipple(pipe, &state));
+}
+
+
+static void
+replay_set_scissor_states(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   const struct value *state = arg(call, "states");
+   struct pipe_scissor_state scissors[PIPE_MAX_VIEWPORTS];
+   unsigned start_slot = get_uint(arg(call, "start_slot"));
+   unsigned num_scissors = get_uint(arg(call, "num_scissors"));
+   unsigned i;
+
+   if (!pipe || start_slot + num_scissors > PIPE_MAX_VIEWPORTS)
+      return;
+
+   /* only the first scissor is traced */
+   for (i = 0; i < num_scissors; ++i) {
+      GET_UINT(&scissors[i], state, minx);
+      GET_UINT(&scissors[i], state, miny);
+      GET_UINT(&scissors[i], state, maxx);
+      GET_UINT(&scissors[i], state, maxy);
+   }
+
+   TIMED(r, pipe->set_scissor_states(pipe, start_slot, num_scissors,
+                                     scissors));
+}
+
+
+static void
+replay_set_viewport_states(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   const struct value *state = arg(call, "states");
+   struct pipe_viewport_state viewports[PIPE_MAX_VIEWPORTS];
+   unsigned start_slot = get_uint(arg(call, "start_slot"));
+   unsigned num_viewports = get_uint(arg(call, "num_viewports"));
+   unsigned i;
+
+   if (!pipe || start_slot + num_viewports > PIPE_MAX_VIEWPORTS)
+      return;
+
+   /* only the first viewport is traced */
+   for (i = 0; i < num_viewports; ++i) {
+      get_float_array(member(state, "scale"), viewports[i].scale, 4);
+      get_float_array(member(state, "translate"), viewports[i].translate, 4);
+   }
+
+   TIMED(r, pipe->set_viewport_states(pipe, start_slot, num_viewports,
+                                      viewports));
+}
+
+
+static void
+replay_create_sampler_view(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   const struct value *templ = arg(call, "templ");
+   const struct value *u = member(templ, "u");
+   struct pipe_resource *resource;
+   struct pipe_sampler_view tmpl;
+   struct pipe_sampler_view *view;
+
+   if (!pipe)
+      return;
+
+   resource = lookup_object(r, arg(call, "resource"), OBJECT_RESOURCE);
+   if (!resource) {
+      r->skipped++;
+      return;
+   }
+
+   memset(&tmpl, 0, sizeof tmpl);
+   tmpl.format = get_format(member(templ, "format"));
+   if (resource->target == PIPE_BUFFER) {
+      GET_UINT(&tmpl.u.buf, member(u, "buf"), first_element);
+      GET_UINT(&tmpl.u.buf, member(u, "buf"), last_element);
+   } else {
+      GET_UINT(&tmpl.u.tex, member(u, "tex"), first_layer);
+      GET_UINT(&tmpl.u.tex, member(u, "tex"), last_layer);
+      GET_UINT(&tmpl.u.tex, member(u, "tex"), first_level);
+      GET_UINT(&tmpl.u.tex, member(u, "tex"), last_level);
+   }
+   GET_UINT(&tmpl, templ, swizzle_r);
+   GET_UINT(&tmpl, templ, swizzle_g);
+   GET_UINT(&tmpl, templ, swizzle_b);
+   GET_UINT(&tmpl, templ, swizzle_a);
+
+   TIMED(r, view = pipe->create_sampler_view(pipe, resource, &tmpl));
+   add_object(r, call->ret, OBJECT_SAMPLER_VIEW, view, pipe);
+}
+
+
+static void
+replay_sampler_view_destroy(struct replay *r, const struct call *call)
+{
+   remove_object(r, arg(call, "view"), OBJECT_SAMPLER_VIEW);
+}
+
+
+static void
+replay_set_sampler_views(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   const struct value *views = arg(call, "views");
+   struct pipe_sampler_view *handles[PIPE_MAX_SHADER_SAMPLER_VIEWS];
+   unsigned start = get_uint(arg(call, "start"));
+   unsigned num = get_uint(arg(call, "num"));
+   unsigned i;
+
+   if (!pipe || start + num > PIPE_MAX_SHADER_SAMPLER_VIEWS)
+      return;
+
+   for (i = 0; i < num; ++i) {
+      if (!lookup_optional(r, elem(views, i), OBJECT_SAMPLER_VIEW,
+                           (void **)&handles[i])) {
+         r->skipped++;
+         return;
+      }
+   }
+
+   TIMED(r, pipe->set_sampler_views(pipe, get_uint(arg(call, "shader")),
+                                    start, num,
+                                    views->kind == VALUE_NULL ?
+                                    NULL : handles));
+}
+
+
+static void
+replay_create_surface(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   const struct value *templ = arg(call, "surf_tmpl");
+   const struct value *u = member(templ, "u");
+   struct pipe_resource *resource;
+   struct pipe_surface tmpl;
+   struct pipe_surface *surface;
+
+   if (!pipe)
+      return;
+
+   resource = lookup_object(r, arg(call, "resource"), OBJECT_RESOURCE);
+   if (!resource) {
+      r->skipped++;
+      return;
+   }
+
+   memset(&tmpl, 0, sizeof tmpl);
+   tmpl.format = get_format(member(templ, "format"));
+   GET_UINT(&tmpl, templ, width);
+   GET_UINT(&tmpl, templ, height);
+   if (resource->target == PIPE_BUFFER) {
+      GET_UINT(&tmpl.u.buf, member(u, "buf"), first_element);
+      GET_UINT(&tmpl.u.buf, member(u, "buf"), last_element);
+   } else {
+      GET_UINT(&tmpl.u.tex, member(u, "tex"), level);
+      GET_UINT(&tmpl.u.tex, member(u, "tex"), first_layer);
+      GET_UINT(&tmpl.u.tex, member(u, "tex"), last_layer);
+   }
+
+   TIMED(r, surface = pipe->create_surface(pipe, resource, &tmpl));
+   add_object(r, call->ret, OBJECT_SURFACE, surface, pipe);
+}
+
+
+static void
+replay_surface_destroy(struct replay *r, const struct call *call)
+{
+   remove_object(r, arg(call, "surface"), OBJECT_SURFACE);
+}
+
+
+static void
+replay_set_vertex_buffers(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   const struct value *buffers = arg(call, "buffers");
+   struct pipe_vertex_buffer vbs[PIPE_MAX_ATTRIBS];
+   unsigned start_slot = get_uint(arg(call, "start_slot"));
+   unsigned num_buffers = get_uint(arg(call, "num_buffers"));
+   unsigned i;
+
+   if (!pipe || start_slot + num_buffers > PIPE_MAX_ATTRIBS)
+      return;
+
+   memset(vbs, 0, sizeof vbs);
+   for (i = 0; i < num_buffers; ++i) {
+      const struct value *vb = elem(buffers, i);
+
+      GET_UINT(&vbs[i], vb, stride);
+      GET_UINT(&vbs[i], vb, buffer_offset);
+
+      /* the contents of user buffers aren't traced */
+      if (!lookup_optional(r, member(vb, "buffer"), OBJECT_RESOURCE,
+                           (void **)&vbs[i].buffer) ||
+          member(vb, "user_buffer")->kind == VALUE_PTR) {
+         r->skipped++;
+         return;
+      }
+   }
+
+   TIMED(r, pipe->set_vertex_buffers(pipe, start_slot, num_buffers,
+                                     buffers->kind == VALUE_NULL ?
+                                     NULL : vbs));
+}
+
+
+static void
+replay_set_index_buffer(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   const struct value *value = arg(call, "ib");
+   struct pipe_index_buffer ib;
+
+   if (!pipe)
+      return;
+
+   if (value->kind != VALUE_STRUCT) {
+      TIMED(r, pipe->set_index_buffer(pipe, NULL));
+      return;
+   }
+
+   memset(&ib, 0, sizeof ib);
+   GET_UINT(&ib, value, index_size);
+   GET_UINT(&ib, value, offset);
+
+   if (!lookup_optional(r, member(value, "buffer"), OBJECT_RESOURCE,
+                        (void **)&ib.buffer) ||
+       member(value, "user_buffer")->kind == VALUE_PTR) {
+      r->skipped++;
+      return;
+   }
+
+   TIMED(r, pipe->set_index_buffer(pipe, &ib));
+}
+
+
+/*
+ * pipe_context queries and stream output
+ */
+
+static void
+replay_create_query(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   const struct value *type = arg(call, "query_type");
+   struct pipe_query *query;
+   unsigned query_type;
+
+   if (!pipe)
+      return;
+
+   if (type->kind == VALUE_ENUM) {
+      for (query_type = 0; query_type < PIPE_QUERY_TYPES; ++query_type) {
+         if (strcmp(util_dump_query_type(query_type, FALSE),
+                    type->u.name) == 0)
+            break;
+      }
+      if (query_type == PIPE_QUERY_TYPES) {
+         r->skipped++;
+         return;
+      }
+   } else {
+      query_type = get_uint(type);
+   }
+
+   TIMED(r, query = pipe->create_query(pipe, query_type));
+   add_object(r, call->ret, OBJECT_QUERY, query, pipe);
+}
+
+
+static void
+replay_destroy_query(struct replay *r, const struct call *call)
+{
+   remove_object(r, arg(call, "query"), OBJECT_QUERY);
+}
+
+
+static void
+replay_begin_query(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   struct pipe_query *query;
+
+   query = lookup_object(r, arg(call, "query"), OBJECT_QUERY);
+   if (!pipe || !query) {
+      r->skipped++;
+      return;
+   }
+
+   TIMED(r, pipe->begin_query(pipe, query));
+}
+
+
+static void
+replay_end_query(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   struct pipe_query *query;
+
+   query = lookup_object(r, arg(call, "query"), OBJECT_QUERY);
+   if (!pipe || !query) {
+      r->skipped++;
+      return;
+   }
+
+   TIMED(r, pipe->end_query(pipe, query));
+}
+
+
+static void
+replay_get_query_result(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   struct pipe_query *query;
+   union pipe_query_result result;
+   boolean wait;
+
+   query = lookup_object(r, arg(call, "query"), OBJECT_QUERY);
+   if (!pipe || !query) {
+      r->skipped++;
+      return;
+   }
+
+   /* Whether the application waited isn't traced, but if the result was
+    * available then, make sure it is now too. */
+   wait = call->ret && get_uint(call->ret);
+
+   TIMED(r, pipe->get_query_result(pipe, query, wait, &result));
+}
+
+
+static void
+replay_render_condition(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   void *query;
+
+   if (!pipe)
+      return;
+
+   if (!lookup_optional(r, arg(call, "query"), OBJECT_QUERY, &query)) {
+      r->skipped++;
+      return;
+   }
+
+   TIMED(r, pipe->render_condition(pipe, query,
+                                   get_uint(arg(call, "condition")),
+                                   get_uint(arg(call, "mode"))));
+}
+
+
+static void
+replay_create_stream_output_target(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   struct pipe_stream_output_target *target;
+   struct pipe_resource *res;
+
+   res = lookup_object(r, arg(call, "res"), OBJECT_RESOURCE);
+   if (!pipe || !res) {
+      r->skipped++;
+      return;
+   }
+
+   TIMED(r, target = pipe->create_stream_output_target(pipe, res,
+                        get_uint(arg(call, "buffer_offset")),
+                        get_uint(arg(call, "buffer_size"))));
+   add_object(r, call->ret, OBJECT_SO_TARGET, target, pipe);
+}
+
+
+static void
+replay_stream_output_target_destroy(struct replay *r, const struct call *call)
+{
+   remove_object(r, arg(call, "target"), OBJECT_SO_TARGET);
+}
+
+
+static void
+replay_set_stream_output_targets(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   struct pipe_stream_output_target *targets[PIPE_MAX_SO_BUFFERS];
+   unsigned num_targets = get_uint(arg(call, "num_targets"));
+   unsigned i;
+
+   if (!pipe || num_targets > PIPE_MAX_SO_BUFFERS)
+      return;
+
+   for (i = 0; i < num_targets; ++i) {
+      if (!lookup_optional(r, elem(arg(call, "tgs"), i), OBJECT_SO_TARGET,
+                           (void **)&targets[i])) {
+         r->skipped++;
+         return;
+      }
+   }
+
+   TIMED(r, pipe->set_stream_output_targets(pipe, num_targets, targets,
+                                            get_uint(arg(call,
+                                                     "append_bitmask"))));
+}
+
+
+/*
+ * pipe_context drawing and data calls
+ */
+
+static void
+replay_draw_vbo(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   const struct value *value = arg(call, "info");
+   struct pipe_draw_info info;
+
+   if (!pipe)
+      return;
+
+   memset(&info, 0, sizeof info);
+   GET_UINT(&info, value, indexed);
+   GET_UINT(&info, value, mode);
+   GET_UINT(&info, value, start);
+   GET_UINT(&info, value, count);
+   GET_UINT(&info, value, start_instance);
+   GET_UINT(&info, value, instance_count);
+   GET_INT(&info, value, index_bias);
+   GET_UINT(&info, value, min_index);
+   GET_UINT(&info, value, max_index);
+   GET_UINT(&info, value, primitive_restart);
+   GET_UINT(&info, value, restart_index);
+
+   if (!lookup_optional(r, member(value, "count_from_stream_output"),
+                        OBJECT_SO_TARGET,
+                        (void **)&info.count_from_stream_output)) {
+      r->skipped++;
+      return;
+   }
+
+   TIMED(r, pipe->draw_vbo(pipe, &info));
+}
+
+
+static void
+replay_transfer_inline_write(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   const struct value *value = arg(call, "box");
+   const struct value *data = arg(call, "data");
+   struct pipe_resource *resource;
+   struct pipe_box box;
+
+   if (!pipe)
+      return;
+
+   resource = lookup_object(r, arg(call, "resource"), OBJECT_RESOURCE);
+
+   /* XML traces don't hold texture contents */
+   if (!resource || data->kind != VALUE_BYTES || !data->u.bytes.size) {
+      r->skipped++;
+      return;
+   }
+
+   GET_INT(&box, value, x);
+   GET_INT(&box, value, y);
+   GET_INT(&box, value, z);
+   GET_INT(&box, value, width);
+   GET_INT(&box, value, height);
+   GET_INT(&box, value, depth);
+
+   TIMED(r, pipe->transfer_inline_write(pipe, resource,
+                                        get_uint(arg(call, "level")),
+                                        get_uint(arg(call, "usage")) &
+                                        ~PIPE_TRANSFER_READ,
+                                        &box, data->u.bytes.data,
+                                        get_uint(arg(call, "stride")),
+                                        get_uint(arg(call, "layer_stride"))));
+}
+
+
+static void
+replay_resource_copy_region(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   const struct value *value = arg(call, "src_box");
+   struct pipe_resource *dst, *src;
+   struct pipe_box box;
+
+   dst = lookup_object(r, arg(call, "dst"), OBJECT_RESOURCE);
+   src = lookup_object(r, arg(call, "src"), OBJECT_RESOURCE);
+   if (!pipe || !dst || !src) {
+      r->skipped++;
+      return;
+   }
+
+   GET_INT(&box, value, x);
+   GET_INT(&box, value, y);
+   GET_INT(&box, value, z);
+   GET_INT(&box, value, width);
+   GET_INT(&box, value, height);
+   GET_INT(&box, value, depth);
+
+   TIMED(r, pipe->resource_copy_region(pipe,
+                                       dst, get_uint(arg(call, "dst_level")),
+                                       get_uint(arg(call, "dstx")),
+                                       get_uint(arg(call, "dsty")),
+                                       get_uint(arg(call, "dstz")),
+                                       src, get_uint(arg(call, "src_level")),
+                                       &box));
+}
+
+
+static boolean
+get_blit_image(struct replay *r, const struct value *value,
+               struct pipe_blit_info *info, boolean dst)
+{
+   const struct value *box = member(value, "box");
+   struct pipe_resource *resource;
+   unsigned level;
+   enum pipe_format format;
+   struct pipe_box b;
+
+   resource = lookup_object(r, member(value, "resource"), OBJECT_RESOURCE);
+   if (!resource)
+      return FALSE;
+
+   level = get_uint(member(value, "level"));
+   format = get_format(member(value, "format"));
+
+   GET_INT(&b, box, x);
+   GET_INT(&b, box, y);
+   GET_INT(&b, box, z);
+   GET_INT(&b, box, width);
+   GET_INT(&b, box, height);
+   GET_INT(&b, box, depth);
+
+   if (dst) {
+      info->dst.resource = resource;
+      info->dst.level = level;
+      info->dst.format = format;
+      info->dst.box = b;
+   } else {
+      info->src.resource = resource;
+      info->src.level = level;
+      info->src.format = format;
+      info->src.box = b;
+   }
+   return TRUE;
+}
+
+
+static void
+replay_blit(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   const struct value *value = arg(call, "_info");
+   const struct value *mask = member(value, "mask");
+   const struct value *scissor = member(value, "scissor");
+   struct pipe_blit_info info;
+   static const unsigned mask_bits[6] = {
+      PIPE_MASK_R, PIPE_MASK_G, PIPE_MASK_B,
+      PIPE_MASK_A, PIPE_MASK_Z, PIPE_MASK_S
+   };
+   unsigned i;
+
+   if (!pipe)
+      return;
+
+   memset(&info, 0, sizeof info);
+   if (!get_blit_image(r, member(value, "dst"), &info, TRUE) ||
+       !get_blit_image(r, member(value, "src"), &info, FALSE)) {
+      r->skipped++;
+      return;
+   }
+
+   /* the mask is traced as a "RGBAZS" string, with '-' for unset bits */
+   if (mask->kind == VALUE_STRING) {
+      for (i = 0; i < 6 && i < mask->u.bytes.size; ++i) {
+         if (mask->u.bytes.data[i] != '-')
+            info.mask |= mask_bits[i];
+      }
+   }
+
+   GET_UINT(&info, value, filter);
+   GET_UINT(&info, value, scissor_enable);
+   GET_UINT(&info.scissor, scissor, minx);
+   GET_UINT(&info.scissor, scissor, miny);
+   GET_UINT(&info.scissor, scissor, maxx);
+   GET_UINT(&info.scissor, scissor, maxy);
+
+   TIMED(r, pipe->blit(pipe, &info));
+}
+
+
+static void
+replay_flush_resource(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   struct pipe_resource *resource;
+
+   resource = lookup_object(r, arg(call, "resource"), OBJECT_RESOURCE);
+   if (!pipe || !resource) {
+      r->skipped++;
+      return;
+   }
+
+   if (pipe->flush_resource)
+      TIMED(r, pipe->flush_resource(pipe, resource));
+}
+
+
+static void
+replay_clear(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   union pipe_color_union color;
+
+   if (!pipe)
+      return;
+
+   get_float_array(arg(call, "color"), color.f, 4);
+
+   TIMED(r, pipe->clear(pipe, get_uint(arg(call, "buffers")), &color,
+                        get_float(arg(call, "depth")),
+                        get_uint(arg(call, "stencil"))));
+}
+
+
+static void
+replay_clear_render_target(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   struct pipe_surface *dst;
+   union pipe_color_union color;
+
+   dst = lookup_object(r, arg(call, "dst"), OBJECT_SURFACE);
+   if (!pipe || !dst) {
+      r->skipped++;
+      return;
+   }
+
+   get_float_array(arg(call, "color->f"), color.f, 4);
+
+   TIMED(r, pipe->clear_render_target(pipe, dst, &color,
+                                      get_uint(arg(call, "dstx")),
+                                      get_uint(arg(call, "dsty")),
+                                      get_uint(arg(call, "width")),
+                                      get_uint(arg(call, "height"))));
+}
+
+
+static void
+replay_clear_depth_stencil(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   struct pipe_surface *dst;
+
+   dst = lookup_object(r, arg(call, "dst"), OBJECT_SURFACE);
+   if (!pipe || !dst) {
+      r->skipped++;
+      return;
+   }
+
+   TIMED(r, pipe->clear_depth_stencil(pipe, dst,
+                                      get_uint(arg(call, "clear_flags")),
+                                      get_float(arg(call, "depth")),
+                                      get_uint(arg(call, "stencil")),
+                                      get_uint(arg(call, "dstx")),
+                                      get_uint(arg(call, "dsty")),
+                                      get_uint(arg(call, "width")),
+                                      get_uint(arg(call, "height"))));
+}
+
+
+static void
+replay_flush(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+   struct pipe_fence_handle *fence = NULL;
+   unsigned flags = get_uint(arg(call, "flags"));
+
+   if (!pipe)
+      return;
+
+   TIMED(r, pipe->flush(pipe, call->ret ? &fence : NULL, flags));
+
+   if (call->ret)
+      add_object(r, call->ret, OBJECT_FENCE, fence, pipe);
+
+   if (flags & PIPE_FLUSH_END_OF_FRAME)
+      r->end_of_frame = TRUE;
+}
+
+
+static void
+replay_texture_barrier(struct replay *r, const struct call *call)
+{
+   struct pipe_context *pipe = get_context(r, call);
+
+   if (!pipe)
+      return;
+
+   TIMED(r, pipe->texture_barrier(pipe));
+}
+
+
+static void
+replay_context_destroy(struct replay *r, const struct call *call)
+{
+   remove_object(r, arg(call, "pipe"), OBJECT_CONTEXT);
+}
+
+
+/**
+ * Calls which don't change any state.
+ */
+static void
+replay_ignore(struct replay *r, const struct call *call)
+{
+}
+
+
+/*
+ * Dispatch
+ */
+
+struct method_stats
+{
+   const char *klass;
+   const char *method;
+   void (*replay)(struct replay *r, const struct call *call);
+
+   unsigned count;
+   int64_t total_time;
+   int64_t max_time;
+};
+
+
+#define SCREEN(_method, _func) { "pipe_screen", #_method, _func, 0, 0, 0 }
+#define CONTEXT(_method) { "pipe_context", #_method, replay_##_method, 0, 0, 0 }
+
+static struct method_stats methods[] = {
+   { "", "pipe_screen_create", replay_ignore, 0, 0, 0 },
+   SCREEN(get_name, replay_ignore),
+   SCREEN(get_vendor, replay_ignore),
+   SCREEN(get_param, replay_ignore),
+   SCREEN(get_shader_param, replay_ignore),
+   SCREEN(get_paramf, replay_ignore),
+   SCREEN(is_format_supported, replay_ignore),
+   SCREEN(fence_reference, replay_ignore),
+   SCREEN(fence_signalled, replay_ignore),
+   SCREEN(get_timestamp, replay_ignore),
+   SCREEN(destroy, replay_ignore),
+   SCREEN(context_create, replay_screen_context_create),
+   SCREEN(resource_create, replay_screen_resource_create),
+   SCREEN(resource_destroy, replay_screen_resource_destroy),
+   SCREEN(flush_frontbuffer, replay_screen_flush_frontbuffer),
+   SCREEN(fence_finish, replay_screen_fence_finish),
+   CONTEXT(draw_vbo),
+   CONTEXT(create_query),
+   CONTEXT(destroy_query),
+   CONTEXT(begin_query),
+   CONTEXT(end_query),
+   CONTEXT(get_query_result),
+   CONTEXT(create_blend_state),
+   CONTEXT(bind_blend_state),
+   CONTEXT(delete_blend_state),
+   CONTEXT(create_sampler_state),
+   CONTEXT(bind_sampler_states),
+   CONTEXT(delete_sampler_state),
+   CONTEXT(create_rasterizer_state),
+   CONTEXT(bind_rasterizer_state),
+   CONTEXT(delete_rasterizer_state),
+   CONTEXT(create_depth_stencil_alpha_state),
+   CONTEXT(bind_depth_stencil_alpha_state),
+   CONTEXT(delete_depth_stencil_alpha_state),
+   CONTEXT(create_fs_state),
+   CONTEXT(bind_fs_state),
+   CONTEXT(delete_fs_state),
+   CONTEXT(create_vs_state),
+   CONTEXT(bind_vs_state),
+   CONTEXT(delete_vs_state),
+   CONTEXT(create_gs_state),
+   CONTEXT(bind_gs_state),
+   CONTEXT(delete_gs_state),
+   CONTEXT(create_vertex_elements_state),
+   CONTEXT(bind_vertex_elements_state),
+   CONTEXT(delete_vertex_elements_state),
+   CONTEXT(set_blend_color),
+   CONTEXT(set_stencil_ref),
+   CONTEXT(set_clip_state),
+   CONTEXT(set_sample_mask),
+   CONTEXT(set_constant_buffer),
+   CONTEXT(set_framebuffer_state),
+   CONTEXT(set_polygon_stipple),
+   CONTEXT(set_scissor_states),
+   CONTEXT(set_viewport_states),
+   CONTEXT(create_sampler_view),
+   CONTEXT(sampler_view_destroy),
+   CONTEXT(create_surface),
+   CONTEXT(surface_destroy),
+   CONTEXT(set_sampler_views),
+   CONTEXT(set_vertex_buffers),
+   CONTEXT(set_index_buffer),
+   CONTEXT(create_stream_output_target),
+   CONTEXT(stream_output_target_destroy),
+   CONTEXT(set_stream_output_targets),
+   CONTEXT(resource_copy_region),
+   CONTEXT(blit),
+   CONTEXT(flush_resource),
+   CONTEXT(clear),
+   CONTEXT(clear_render_target),
+   CONTEXT(clear_depth_stencil),
+   CONTEXT(flush),
+   { "pipe_context", "destroy", replay_context_destroy, 0, 0, 0 },
+   CONTEXT(transfer_inline_write),
+   CONTEXT(render_condition),
+   CONTEXT(texture_barrier)
+};
+
+/* Time spent waiting for each frame to finish rendering */
+static struct method_stats frame_finish = { "", "(end of frame)", NULL, 0, 0, 0 };
+
+
+static struct method_stats *
+find_method(const struct call *call)
+{
+   unsigned i;
+
+   for (i = 0; i < Elements(methods); ++i) {
+      if (strcmp(methods[i].method, call->method) == 0 &&
+          strcmp(methods[i].klass, call->klass) == 0)
+         return &methods[i];
+   }
+   return NULL;
+}
+
+
+static void
+account(struct method_stats *stats, int64_t time)
+{
+   stats->count++;
+   stats->total_time += time;
+   stats->max_time = MAX2(stats->max_time, time);
+}
+
+
+static void
+end_frame(struct replay *r)
+{
+   struct pipe_context *pipe = r->pipe;
+
+   /* Wait for the rasterizer, so that its time lands in this frame. */
+   r->call_time = 0;
+   if (pipe) {
+      struct pipe_fence_handle *fence = NULL;
+      int64_t start = os_time_get_nano();
+
+      pipe->flush(pipe, &fence, 0);
+      if (fence)
+         r->screen->fence_finish(r->screen, fence, PIPE_TIMEOUT_INFINITE);
+
+      r->call_time = os_time_get_nano() - start;
+      r->screen->fence_reference(r->screen, &fence, NULL);
+   }
+   account(&frame_finish, r->call_time);
+   r->frame_time += r->call_time;
+
+   if (r->verbose)
+      printf("frame %u: %.3f ms, %u calls\n",
+             r->num_frames, r->frame_time / 1e6, r->frame_calls);
+
+   if (!r->num_frames || r->frame_time < r->min_frame_time)
+      r->min_frame_time = r->frame_time;
+   r->max_frame_time = MAX2(r->max_frame_time, r->frame_time);
+   r->total_frame_time += r->frame_time;
+   r->num_frames++;
+
+   r->end_of_frame = FALSE;
+   r->frame_time = 0;
+   r->frame_calls = 0;
+}
+
+
+static enum pipe_error
+release_remaining(void *key, void *value, void *data)
+{
+   struct replay *r = data;
+   struct object *obj = value;
+
+   /* contexts go last, after the objects created with them */
+   if ((obj->type == OBJECT_CONTEXT) == r->releasing_contexts)
+      release_object(r, obj);
+   if (r->releasing_contexts)
+      FREE(obj);
+
+   return PIPE_OK;
+}
+
+
+static int
+compare_stats(const void *a, const void *b)
+{
+   const struct method_stats *sa = *(const struct method_stats * const *)a;
+   const struct method_stats *sb = *(const struct method_stats * const *)b;
+
+   if (sa->total_time != sb->total_time)
+      return sa->total_time < sb->total_time ? 1 : -1;
+   return 0;
+}
+
+
+static void
+print_stats(const struct replay *r, unsigned num_calls, unsigned unknown)
+{
+   const struct method_stats *sorted[Elements(methods) + 1];
+   unsigned num_sorted = 0;
+   unsigned i;
+
+   for (i = 0; i < Elements(methods); ++i) {
+      if (methods[i].count && methods[i].replay != replay_ignore)
+         sorted[num_sorted++] = &methods[i];
+   }
+   if (frame_finish.count)
+      sorted[num_sorted++] = &frame_finish;
+
+   qsort(sorted, num_sorted, sizeof sorted[0], compare_stats);
+
+   printf("\n%u calls, %u frames, %u skipped, %u unknown\n",
+          num_calls, r->num_frames, r->skipped, unknown);
+
+   if (r->num_frames) {
+      printf("frame time: avg %.3f ms, min %.3f ms, max %.3f ms\n",
+             r->total_frame_time / 1e6 / r->num_frames,
+             r->min_frame_time / 1e6, r->max_frame_time / 1e6);
+   }
+
+   printf("\n%-36s %8s %12s %10s %10s\n",
+          "call", "count", "total ms", "avg us", "max us");
+   for (i = 0; i < num_sorted; ++i) {
+      const struct method_stats *stats = sorted[i];
+      printf("%-36s %8u %12.3f %10.3f %10.3f\n",
+             stats->method, stats->count,
+             stats->total_time / 1e6,
+             stats->total_time / 1e3 / stats->count,
+             stats->max_time / 1e3);
+   }
+}
+
+
+static void
+usage(const char *name)
+{
+   fprintf(stderr, "usage: %s [-q] TRACE\n", name);
+   fprintf(stderr, "\n");
+   fprintf(stderr, "Replays a binary trace, recorded with GALLIUM_TRACE and\n");
+   fprintf(stderr, "GALLIUM_TRACE_BINARY=1, on the software pipe driver.\n");
+   fprintf(stderr, "\n");
+   fprintf(stderr, "  -q    don't print the time of each frame\n");
+   exit(1);
+}
+
+
+int main(int argc, char **argv)
+{
+   struct pipe_loader_device *devs[MAX_DEVICES];
+   struct replay r;
+   struct reader rd;
+   struct call call;
+   const char *filename = NULL;
+   char magic[TRACE_BIN_MAGIC_SIZE];
+   unsigned num_devs, num_calls = 0, unknown = 0;
+   unsigned version;
+   int i;
+
+   memset(&r, 0, sizeof r);
+   memset(&rd, 0, sizeof rd);
+   r.verbose = TRUE;
+
+   for (i = 1; i < argc; ++i) {
+      if (strcmp(argv[i], "-q") == 0)
+         r.verbose = FALSE;
+      else if (argv[i][0] == '-' || filename)
+         usage(argv[0]);
+      else
+         filename = argv[i];
+   }
+   if (!filename)
+      usage(argv[0]);
+
+   rd.file = fopen(filename, "rb");
+   if (!rd.file) {
+      fprintf(stderr, "%s: failed to open %s\n", argv[0], filename);
+      return 1;
+   }
+
+   if (fread(magic, 1, sizeof magic, rd.file) != sizeof magic ||
+       memcmp(magic, TRACE_BIN_MAGIC, TRACE_BIN_MAGIC_SIZE) != 0) {
+      fprintf(stderr, "%s: %s is not a binary trace\n", argv[0], filename);
+      return 1;
+   }
+
+   version = read_fixed(&rd, 4);
+   if (version != TRACE_BIN_VERSION) {
+      fprintf(stderr, "%s: unsupported trace version %u\n", argv[0], version);
+      return 1;
+   }
+
+   /* The null winsys is always the last software device. */
+   num_devs = pipe_loader_sw_probe(devs, MAX_DEVICES);
+   if (!num_devs) {
+      fprintf(stderr, "%s: no software device\n", argv[0]);
+      return 1;
+   }
+
+   r.screen = pipe_loader_create_screen(devs[num_devs - 1], PIPE_SEARCH_DIR);
+   if (!r.screen) {
+      fprintf(stderr, "%s: failed to create the screen\n", argv[0]);
+      return 1;
+   }
+
+   r.objects = util_hash_table_create(object_hash, object_compare);
+
+   printf("replaying %s on %s\n", filename, r.screen->get_name(r.screen));
+
+   while (read_call(&rd, &call)) {
+      struct method_stats *stats = find_method(&call);
+
+      num_calls++;
+
+      if (!stats) {
+         if (!unknown++)
+            fprintf(stderr, "call %u: skipping unknown call %s::%s\n",
+                    call.no, call.klass, call.method);
+         free_call(&call);
+         continue;
+      }
+
+      r.call_time = 0;
+      stats->replay(&r, &call);
+      account(stats, r.call_time);
+      r.frame_time += r.call_time;
+      r.frame_calls++;
+
+      if (r.end_of_frame)
+         end_frame(&r);
+
+      free_call(&call);
+   }
+
+   if (!feof(rd.file))
+      fprintf(stderr, "%s: corrupt trace after call %u\n", argv[0], num_calls);
+
+   if (r.frame_calls)
+      end_frame(&r);
+
+   print_stats(&r, num_calls, unknown);
+
+   util_hash_table_foreach(r.objects, release_remaining, &r);
+   r.releasing_contexts = TRUE;
+   util_hash_table_foreach(r.objects, release_remaining, &r);
+   util_hash_table_destroy(r.objects);
+   r.screen->destroy(r.screen);
+   pipe_loader_release(devs, num_devs);
+   fclose(rd.file);
+
+   return 0;
+}
@@ -0,0 +1,262 @@
+/**************************************************************************
+ *
+ * Copyright 2013 agent <agent@local>
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/*
+ *  Contention test for multithreaded util_slab pools.
+ *
+ *  Several threads allocate and free blocks of the same pool, first each
+ *  on its own and then freeing blocks allocated by another thread.  Every
+ *  block is filled with its owner's id and checked before it is freed, so
+ *  the test fails if the pool ever hands out the same block twice.
+ *
+ *  The multithreaded pool is timed against a single-threaded pool behind
+ *  one mutex, which is how multithreaded pools used to work.
+ *
+ *  Finally many pools are created at once, and multithreaded pools are
+ *  created over and over, to check that pools don't run out of
+ *  thread-specific data keys.
+ */
+
+
+#include <stdio.h>
+
+#include "os/os_thread.h"
+#include "os/os_time.h"
+#include "util/u_slab.h"
+
+
+#define NUM_THREADS 4
+#define NUM_ITERATIONS 20000
+#define NUM_CROSS_ITERATIONS 200
+#define BATCH_SIZE 48
+#define ITEM_SIZE 64          /* about a pipe_transfer */
+#define NUM_POOLS 2048        /* more than PTHREAD_KEYS_MAX */
+
+
+static struct util_slab_mempool pool;
+static pipe_mutex pool_mutex;
+static boolean use_mutex;
+
+static pipe_thread threads[NUM_THREADS];
+static pipe_barrier barrier;
+static int thread_ids[NUM_THREADS];
+static unsigned errors[NUM_THREADS];
+
+/* Blocks handed from each thread to the next one. */
+static unsigned *handoff[NUM_THREADS][BATCH_SIZE];
+
+
+static unsigned *
+test_alloc(void)
+{
+   unsigned *ptr;
+
+   if (use_mutex) {
+      pipe_mutex_lock(pool_mutex);
+      ptr = util_slab_alloc(&pool);
+      pipe_mutex_unlock(pool_mutex);
+   } else {
+      ptr = util_slab_alloc(&pool);
+   }
+   return ptr;
+}
+
+
+static void
+test_free(unsigned *ptr)
+{
+   if (use_mutex) {
+      pipe_mutex_lock(pool_mutex);
+      util_slab_free(&pool, ptr);
+      pipe_mutex_unlock(pool_mutex);
+   } else {
+      util_slab_free(&pool, ptr);
+   }
+}
+
+
+static void
+fill(unsigned *ptr, unsigned value)
+{
+   unsigned i;
+
+   for (i = 0; i < ITEM_SIZE / sizeof(unsigned); i++)
+      ptr[i] = value;
+}
+
+
+static boolean
+check(const unsigned *ptr, unsigned value)
+{
+   unsigned i;
+
+   for (i = 0; i < ITEM_SIZE / sizeof(unsigned); i++) {
+      if (ptr[i] != value)
+         return FALSE;
+   }
+   return TRUE;
+}
+
+
+static PIPE_THREAD_ROUTINE(thread_function, thread_data)
+{
+   int thread_id = *((int *) thread_data);
+   int next = (thread_id + 1) % NUM_THREADS;
+   unsigned *blocks[BATCH_SIZE];
+   unsigned iter, i;
+
+   /* Private allocations: the common case for transfers. */
+   for (iter = 0; iter < NUM_ITERATIONS; iter++) {
+      unsigned count = 1 + iter % BATCH_SIZE;
+
+      for (i = 0; i < count; i++) {
+         blocks[i] = test_alloc();
+         fill(blocks[i], thread_id);
+      }
+
+      for (i = 0; i < count; i++) {
+         if (!check(blocks[i], thread_id))
+            errors[thread_id]++;
+         test_free(blocks[i]);
+      }
+   }
+
+   /* Cross-thread frees. */
+   for (iter = 0; iter < NUM_CROSS_ITERATIONS; iter++) {
+      for (i = 0; i < BATCH_SIZE; i++) {
+         handoff[next][i] = test_alloc();
+         fill(handoff[next][i], thread_id);
+      }
+
+      pipe_barrier_wait(&barrier);
+
+      for (i = 0; i < BATCH_SIZE; i++) {
+         unsigned *ptr = handoff[thread_id][i];
+         if (!check(ptr, (thread_id + NUM_THREADS - 1) % NUM_THREADS))
+            errors[thread_id]++;
+         test_free(ptr);
+      }
+
+      pipe_barrier_wait(&barrier);
+   }
+
+   return NULL;
+}
+
+
+static unsigned
+run_test(const char *name, enum util_slab_threading threading,
+         boolean mutex)
+{
+   unsigned num_errors = 0;
+   int64_t start, end;
+   int i;
+
+   util_slab_create(&pool, ITEM_SIZE, 16, threading);
+   use_mutex = mutex;
+
+   start = os_time_get();
+
+   for (i = 0; i < NUM_THREADS; i++) {
+      thread_ids[i] = i;
+      errors[i] = 0;
+      threads[i] = pipe_thread_create(thread_function, (void *) &thread_ids[i]);
+   }
+
+   for (i = 0; i < NUM_THREADS; i++) {
+      pipe_thread_wait(threads[i]);
+      num_errors += errors[i];
+   }
+
+   end = os_time_get();
+
+   util_slab_destroy(&pool);
+
+   printf("%s: %.1f ms, %u errors\n", name, (end - start) / 1000.0,
+          num_errors);
+
+   return num_errors;
+}
+
+
+static unsigned
+run_pool_count_test(void)
+{
+   static struct util_slab_mempool pools[NUM_POOLS];
+   unsigned num_errors = 0;
+   unsigned *ptr;
+   int i;
+
+   for (i = 0; i < NUM_POOLS; i++)
+      util_slab_create(&pools[i], ITEM_SIZE, 16, UTIL_SLAB_SINGLETHREADED);
+
+   for (i = 0; i < NUM_POOLS; i++) {
+      ptr = util_slab_alloc(&pools[i]);
+      fill(ptr, i);
+      if (!check(ptr, i))
+         num_errors++;
+      util_slab_free(&pools[i], ptr);
+      util_slab_destroy(&pools[i]);
+   }
+
+   for (i = 0; i < NUM_POOLS; i++) {
+      util_slab_create(&pool, ITEM_SIZE, 16, UTIL_SLAB_MULTITHREADED);
+      ptr = util_slab_alloc(&pool);
+      fill(ptr, i);
+      if (!check(ptr, i))
+         num_errors++;
+      util_slab_free(&pool, ptr);
+      util_slab_destroy(&pool);
+   }
+
+   printf("%d pools: %u errors\n", NUM_POOLS, num_errors);
+
+   return num_errors;
+}
+
+
+int main()
+{
+   unsigned num_errors = 0;
+
+   printf("u_slab_test starting\n");
+
+   pipe_mutex_init(pool_mutex);
+   pipe_barrier_init(&barrier, NUM_THREADS);
+
+   num_errors += run_test("single pool mutex", UTIL_SLAB_SINGLETHREADED, TRUE);
+   num_errors += run_test("multithreaded", UTIL_SLAB_MULTITHREADED, FALSE);
+   num_errors += run_pool_count_test();
+
+   pipe_barrier_destroy(&barrier);
+   pipe_mutex_destroy(pool_mutex);
+
+   printf("u_slab_test %s\n", num_errors ? "FAILED" : "passed");
+
+   return num_errors ? 1 : 0;
+}
@@ -26,9 +26,15 @@
  *
  **************************************************************************/
 
+#ifdef HAVE_SYS_SHM_H
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#endif
+
 #include "pipe/p_compiler.h"
 #include "pipe/p_format.h"
 #include "util/u_inlines.h"
+#include "util/u_box.h"
 #include "util/u_format.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
@@ -46,6 +52,9 @@ struct dri_sw_displaytarget
 
    void *data;
    void *mapped;
+
+   /** Shared memory segment holding data, or -1 */
+   int shmid;
 };
 
 struct dri_sw_winsys
@@ -77,6 +86,36 @@ dri_sw_is_displaytarget_format_supported( struct sw_winsys *ws,
    return TRUE;
 }
 
+#ifdef HAVE_SYS_SHM_H
+/**
+ * Allocate the storage of a display target as a shared memory segment,
+ * which the loader can have the X server read from without a copy.
+ */
+static char *
+alloc_shm(struct dri_sw_displaytarget *dri_sw_dt, unsigned size)
+{
+   char *addr;
+
+   dri_sw_dt->shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+   if (dri_sw_dt->shmid < 0)
+      return NULL;
+
+   addr = (char *) shmat(dri_sw_dt->shmid, NULL, 0);
+
+   /* Mark the segment for deletion right away, so that it doesn't outlive
+    * the process.  It stays around until everybody has detached it.
+    */
+   shmctl(dri_sw_dt->shmid, IPC_RMID, NULL);
+
+   if (addr == (char *) -1) {
+      dri_sw_dt->shmid = -1;
+      return NULL;
+   }
+
+   return addr;
+}
+#endif
+
 static struct sw_displaytarget *
 dri_sw_displaytarget_create(struct sw_winsys *winsys,
                             unsigned tex_usage,
@@ -95,6 +134,7 @@ dri_sw_displaytarget_create(struct sw_winsys *winsys,
    dri_sw_dt->format = format;
    dri_sw_dt->width = width;
    dri_sw_dt->height = height;
+   dri_sw_dt->shmid = -1;
 
    format_stride = util_format_get_stride(format, width);
    dri_sw_dt->stride = align(format_stride, alignment);
@@ -102,7 +142,14 @@ dri_sw_displaytarget_create(struct sw_winsys *winsys,
    nblocksy = util_format_get_nblocksy(format, height);
    size = dri_sw_dt->stride * nblocksy;
 
-   dri_sw_dt->data = align_malloc(size, alignment);
+#ifdef HAVE_SYS_SHM_H
+   /* segments are page aligned */
+   if (dri_sw_winsys(winsys)->lf->put_image_shm)
+      dri_sw_dt->data = alloc_shm(dri_sw_dt, size);
+#endif
+
+   if(!dri_sw_dt->data)
+      dri_sw_dt->data = align_malloc(size, alignment);
    if(!dri_sw_dt->data)
       goto no_data;
 
@@ -121,7 +168,15 @@ dri_sw_displaytarget_destroy(struct sw_winsys *ws,
 {
    struct dri_sw_displaytarget *dri_sw_dt = dri_sw_displaytarget(dt);
 
-   FREE(dri_sw_dt->data);
+#ifdef HAVE_SYS_SHM_H
+   if (dri_sw_dt->shmid >= 0) {
+      shmdt(dri_sw_dt->data);
+   }
+   else
+#endif
+   {
+      align_free(dri_sw_dt->data);
+   }
 
    FREE(dri_sw_dt);
 }
@@ -183,7 +238,21 @@ dri_sw_displaytarget_display(struct sw_winsys *ws,
 
    height = dri_sw_dt->height;
 
-   if (box) {
+   if (dri_sw_dt->shmid >= 0) {
+       /* the X server reads the image straight from the segment */
+       struct pipe_box full_box;
+       unsigned offset;
+
+       if (!box) {
+          u_box_2d(0, 0, width, height, &full_box);
+          box = &full_box;
+       }
+       offset = dri_sw_dt->stride * box->y + box->x * blsize;
+       dri_sw_ws->lf->put_image_shm(dri_drawable, dri_sw_dt->shmid,
+                                    dri_sw_dt->data, offset,
+                                    box->x, box->y, box->width, box->height,
+                                    dri_sw_dt->stride);
+   } else if (box) {
        void *data;
        data = dri_sw_dt->data + (dri_sw_dt->stride * box->y) + box->x * blsize;
        dri_sw_ws->lf->put_image2(dri_drawable, data,
@@ -193,6 +262,21 @@ dri_sw_displaytarget_display(struct sw_winsys *ws,
    }
 }
 
+static void
+dri_sw_displaytarget_display_damage(struct sw_winsys *ws,
+                                    struct sw_displaytarget *dt,
+                                    void *context_private,
+                                    const struct pipe_box *rects,
+                                    unsigned nr_rects)
+{
+   unsigned i;
+
+   for (i = 0; i < nr_rects; i++) {
+      struct pipe_box box = rects[i];
+      dri_sw_displaytarget_display(ws, dt, context_private, &box);
+   }
+}
+
 static void
 dri_destroy_sw_winsys(struct sw_winsys *winsys)
 {
@@ -224,6 +308,8 @@ dri_create_sw_winsys(struct drisw_loader_funcs *lf)
    ws->base.displaytarget_unmap = dri_sw_displaytarget_unmap;
 
    ws->base.displaytarget_display = dri_sw_displaytarget_display;
+   if (lf->put_damage)
+      ws->base.displaytarget_display_damage = dri_sw_displaytarget_display_damage;
 
    return &ws->base;
 }
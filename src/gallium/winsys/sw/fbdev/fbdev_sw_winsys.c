@@ -30,6 +30,7 @@
 #include <linux/fb.h>
 
 #include "pipe/p_compiler.h"
+#include "util/u_box.h"
 #include "util/u_format.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
@@ -72,16 +73,17 @@ fbdev_sw_winsys(struct sw_winsys *ws)
 }
 
 static void
-fbdev_displaytarget_display(struct sw_winsys *ws,
-                            struct sw_displaytarget *dt,
-                            void *winsys_private,
-                            struct pipe_box *box)
+fbdev_displaytarget_display_damage(struct sw_winsys *ws,
+                                   struct sw_displaytarget *dt,
+                                   void *winsys_private,
+                                   const struct pipe_box *rects,
+                                   unsigned nr_rects)
 {
    struct fbdev_sw_winsys *fbdev = fbdev_sw_winsys(ws);
    struct fbdev_sw_displaytarget *src = fbdev_sw_displaytarget(dt);
    const struct fbdev_sw_drawable *dst =
       (const struct fbdev_sw_drawable *) winsys_private;
-   unsigned height, row_offset, row_len, i;
+   unsigned height, row_offset, row_len, i, r;
    void *fbmem;
 
    /* FIXME format conversion */
@@ -114,16 +116,43 @@ fbdev_displaytarget_display(struct sw_winsys *ws,
    if (fbmem == MAP_FAILED)
       return;
 
-   for (i = 0; i < height; i++) {
-      char *from = (char *) src->data + src->stride * i;
-      char *to = (char *) fbmem + fbdev->stride * (dst->y + i) + row_offset;
+   for (r = 0; r < nr_rects; r++) {
+      /* clip the rectangle to the visible part of the drawable */
+      const unsigned x0 = util_format_get_stride(dst->format, rects[r].x);
+      const unsigned x1 = MIN2(util_format_get_stride(dst->format,
+                                                      rects[r].x + rects[r].width),
+                               row_len);
+      const unsigned y1 = MIN2(rects[r].y + rects[r].height, height);
+
+      if (x0 >= x1)
+         continue;
 
-      memcpy(to, from, row_len);
+      for (i = rects[r].y; i < y1; i++) {
+         char *from = (char *) src->data + src->stride * i + x0;
+         char *to = (char *) fbmem + fbdev->stride * (dst->y + i) +
+                    row_offset + x0;
+
+         memcpy(to, from, x1 - x0);
+      }
    }
 
    munmap(fbmem, fbdev->finfo.smem_len);
 }
 
+static void
+fbdev_displaytarget_display(struct sw_winsys *ws,
+                            struct sw_displaytarget *dt,
+                            void *winsys_private,
+                            struct pipe_box *box)
+{
+   const struct fbdev_sw_drawable *dst =
+      (const struct fbdev_sw_drawable *) winsys_private;
+   struct pipe_box rect;
+
+   u_box_2d(0, 0, dst->width, dst->height, &rect);
+   fbdev_displaytarget_display_damage(ws, dt, winsys_private, &rect, 1);
+}
+
 static void
 fbdev_displaytarget_unmap(struct sw_winsys *ws,
                            struct sw_displaytarget *dt)
@@ -234,6 +263,8 @@ fbdev_create_sw_winsys(int fd)
    fbdev->base.displaytarget_unmap = fbdev_displaytarget_unmap;
 
    fbdev->base.displaytarget_display = fbdev_displaytarget_display;
+   fbdev->base.displaytarget_display_damage =
+      fbdev_displaytarget_display_damage;
 
    return &fbdev->base;
 }
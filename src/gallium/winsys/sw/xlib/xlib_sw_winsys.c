@@ -35,6 +35,7 @@
 #include "pipe/p_format.h"
 #include "pipe/p_context.h"
 #include "util/u_inlines.h"
+#include "util/u_box.h"
 #include "util/u_format.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
@@ -288,18 +289,21 @@ xlib_displaytarget_destroy(struct sw_winsys *ws,
 
 
 /**
- * Display/copy the image in the surface into the X window specified
- * by the display target.
+ * Display/copy the given rectangles of the image in the surface into the
+ * X window specified by the display target.
  */
 static void
 xlib_sw_display(struct xlib_drawable *xlib_drawable,
-                struct sw_displaytarget *dt)
+                struct sw_displaytarget *dt,
+                const struct pipe_box *rects,
+                unsigned nr_rects)
 {
    static boolean no_swap = 0;
    static boolean firsttime = 1;
    struct xlib_displaytarget *xlib_dt = xlib_displaytarget(dt);
    Display *display = xlib_dt->display;
    XImage *ximage;
+   unsigned i;
 
    if (firsttime) {
       no_swap = getenv("SP_NO_RAST") != NULL;
@@ -343,8 +347,11 @@ xlib_sw_display(struct xlib_drawable *xlib_drawable,
       ximage->data = xlib_dt->data;
 
       /* _debug_printf("XSHM\n"); */
-      XShmPutImage(xlib_dt->display, xlib_drawable->drawable, xlib_dt->gc,
-                   ximage, 0, 0, 0, 0, xlib_dt->width, xlib_dt->height, False);
+      for (i = 0; i < nr_rects; i++) {
+         XShmPutImage(xlib_dt->display, xlib_drawable->drawable, xlib_dt->gc,
+                      ximage, rects[i].x, rects[i].y, rects[i].x, rects[i].y,
+                      rects[i].width, rects[i].height, False);
+      }
    }
    else {
       /* display image in Window */
@@ -361,8 +368,11 @@ xlib_sw_display(struct xlib_drawable *xlib_drawable,
       ximage->bytes_per_line = xlib_dt->stride;
 
       /* _debug_printf("XPUT\n"); */
-      XPutImage(xlib_dt->display, xlib_drawable->drawable, xlib_dt->gc,
-                ximage, 0, 0, 0, 0, xlib_dt->width, xlib_dt->height);
+      for (i = 0; i < nr_rects; i++) {
+         XPutImage(xlib_dt->display, xlib_drawable->drawable, xlib_dt->gc,
+                   ximage, rects[i].x, rects[i].y, rects[i].x, rects[i].y,
+                   rects[i].width, rects[i].height);
+      }
    }
 
    XFlush(xlib_dt->display);
@@ -380,7 +390,26 @@ xlib_displaytarget_display(struct sw_winsys *ws,
                            struct pipe_box *box)
 {
    struct xlib_drawable *xlib_drawable = (struct xlib_drawable *)context_private;
-   xlib_sw_display(xlib_drawable, dt);
+   struct xlib_displaytarget *xlib_dt = xlib_displaytarget(dt);
+   struct pipe_box full;
+
+   u_box_2d(0, 0, xlib_dt->width, xlib_dt->height, &full);
+   xlib_sw_display(xlib_drawable, dt, &full, 1);
+}
+
+
+/**
+ * Display/copy only the damaged rectangles of the surface.
+ */
+static void
+xlib_displaytarget_display_damage(struct sw_winsys *ws,
+                                  struct sw_displaytarget *dt,
+                                  void *context_private,
+                                  const struct pipe_box *rects,
+                                  unsigned nr_rects)
+{
+   struct xlib_drawable *xlib_drawable = (struct xlib_drawable *)context_private;
+   xlib_sw_display(xlib_drawable, dt, rects, nr_rects);
 }
 
 
@@ -481,6 +510,7 @@ xlib_create_sw_winsys(Display *display)
    ws->base.displaytarget_destroy = xlib_displaytarget_destroy;
 
    ws->base.displaytarget_display = xlib_displaytarget_display;
+   ws->base.displaytarget_display_damage = xlib_displaytarget_display_damage;
 
    return &ws->base;
 }
@@ -76,6 +76,12 @@ struct gl_uniform_driver_storage {
     * Pointer to the base of the data.
     */
    void *data;
+
+   /**
+    * Parameter list containing \c data, if any.  Writes to the uniform
+    * extend the list's dirty range.
+    */
+   struct gl_program_parameter_list *params;
 };
 
 struct gl_uniform_storage {
@@ -24,6 +24,7 @@
 #if defined(GLX_DIRECT_RENDERING) && !defined(GLX_USE_APPLEGL)
 
 #include <X11/Xlib.h>
+#include <X11/extensions/XShm.h>
 #include "glxclient.h"
 #include <dlfcn.h>
 #include "dri_common.h"
@@ -66,6 +67,10 @@ struct drisw_drawable
    __DRIdrawable *driDrawable;
    XVisualInfo *visinfo;
    XImage *ximage;
+
+   /* the driver's shared memory segment attached to the server, if any */
+   XShmSegmentInfo shminfo;
+   XImage *shm_ximage;
 };
 
 static Bool
@@ -112,12 +117,98 @@ XCreateDrawable(struct drisw_drawable * pdp,
   if (pdp->ximage->bits_per_pixel == 24)
      pdp->ximage->bits_per_pixel = 32;
 
+   pdp->shminfo.shmid = -1;
+   pdp->shminfo.shmaddr = (char *) -1;
+   pdp->shm_ximage = NULL;
+
+   return True;
+}
+
+static void
+XDetachShm(struct drisw_drawable * pdp, Display * dpy)
+{
+   if (pdp->shm_ximage) {
+      XShmDetach(dpy, &pdp->shminfo);
+      XDestroyImage(pdp->shm_ximage);
+      pdp->shm_ximage = NULL;
+   }
+
+   pdp->shminfo.shmid = -1;
+   pdp->shminfo.shmaddr = (char *) -1;
+}
+
+static int xshm_error = 0;
+
+static int
+xshm_error_handler(Display * dpy, XErrorEvent * event)
+{
+   xshm_error = 1;
+   return 0;
+}
+
+/**
+ * Make the server attach the driver's shared memory segment, unless it
+ * has already been attached, or been found to be unusable.
+ *
+ * \return True if the segment can be used with XShmPutImage.
+ */
+static Bool
+XAttachShm(struct drisw_drawable * pdp, Display * dpy,
+           int shmid, char *shmaddr)
+{
+   int (*old_handler)(Display *, XErrorEvent *);
+
+   if (pdp->shminfo.shmid == shmid && pdp->shminfo.shmaddr == shmaddr)
+      return pdp->shm_ximage != NULL;
+
+   XDetachShm(pdp, dpy);
+
+   /* remember the segment even if it can't be attached, not to retry */
+   pdp->shminfo.shmid = shmid;
+   pdp->shminfo.shmaddr = shmaddr;
+   pdp->shminfo.readOnly = True;
+
+   if (!XShmQueryExtension(dpy))
+      return False;
+
+   pdp->shm_ximage = XShmCreateImage(dpy,
+                                     pdp->visinfo->visual,
+                                     pdp->visinfo->depth,
+                                     ZPixmap,
+                                     NULL,    /* data */
+                                     &pdp->shminfo,
+                                     0, 0);   /* width, height */
+   if (!pdp->shm_ximage)
+      return False;
+
+   /* the server can't convert 32 bpp images to 24 bpp for us here */
+   if (pdp->shm_ximage->bits_per_pixel != pdp->ximage->bits_per_pixel) {
+      XDestroyImage(pdp->shm_ximage);
+      pdp->shm_ximage = NULL;
+      return False;
+   }
+
+   /* attaching fails for remote displays */
+   XSync(dpy, False);
+   xshm_error = 0;
+   old_handler = XSetErrorHandler(xshm_error_handler);
+   XShmAttach(dpy, &pdp->shminfo);
+   XSync(dpy, False);
+   XSetErrorHandler(old_handler);
+
+   if (xshm_error) {
+      XDestroyImage(pdp->shm_ximage);
+      pdp->shm_ximage = NULL;
+      return False;
+   }
+
    return True;
 }
 
 static void
 XDestroyDrawable(struct drisw_drawable * pdp, Display * dpy, XID drawable)
 {
+   XDetachShm(pdp, dpy);
    XDestroyImage(pdp->ximage);
    free(pdp->visinfo);
 
@@ -215,6 +306,58 @@ swrastPutImage(__DRIdrawable * draw, int op,
    swrastPutImage2(draw, op, x, y, w, h, 0, data, loaderPrivate);
 }
 
+/**
+ * Present an image from the driver's shared memory segment.  This needs no
+ * copy on either side, except when the segment can't be attached, in which
+ * case the image is sent with XPutImage instead.
+ */
+static void
+swrastPutImageShm(__DRIdrawable * draw, int op,
+                  int x, int y, int w, int h, int stride,
+                  int shmid, char *shmaddr, unsigned offset,
+                  void *loaderPrivate)
+{
+   struct drisw_drawable *pdp = loaderPrivate;
+   __GLXDRIdrawable *pdraw = &(pdp->base);
+   Display *dpy = pdraw->psc->dpy;
+   XImage *ximage;
+   GC gc;
+   int cpp;
+
+   if (!XAttachShm(pdp, dpy, shmid, shmaddr)) {
+      swrastPutImage2(draw, op, x, y, w, h, stride, shmaddr + offset,
+                      loaderPrivate);
+      return;
+   }
+
+   switch (op) {
+   case __DRI_SWRAST_IMAGE_OP_DRAW:
+      gc = pdp->gc;
+      break;
+   case __DRI_SWRAST_IMAGE_OP_SWAP:
+      gc = pdp->swapgc;
+      break;
+   default:
+      return;
+   }
+
+   /* The server finds the image at data - shmaddr in the segment, and
+    * checks that the source rectangle lies within it, so the image starts
+    * at the beginning of the first row and is read from x.
+    */
+   ximage = pdp->shm_ximage;
+   cpp = (ximage->bits_per_pixel + 7) / 8;
+   ximage->data = shmaddr + offset - x * cpp;
+   ximage->width = stride / cpp;
+   ximage->height = h;
+   ximage->bytes_per_line = stride;
+
+   XShmPutImage(dpy, pdraw->xDrawable, gc, ximage, x, 0, x, y, w, h, False);
+   XFlush(dpy);
+
+   ximage->data = NULL;
+}
+
 static void
 swrastGetImage(__DRIdrawable * read,
                int x, int y, int w, int h,
@@ -245,6 +388,7 @@ static const __DRIswrastLoaderExtension swrastLoaderExtension = {
    swrastPutImage,
    swrastGetImage,
    swrastPutImage2,
+   swrastPutImageShm,
 };
 
 static const __DRIextension *loader_extensions[] = {
@@ -0,0 +1,493 @@
+#!/usr/bin/env python
+
+# Copyright (C) 2013 agent <agent@local>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the "Software"),
+# to deal in the Software without restriction, including without limitation
+# the rights to use, copy, modify, merge, publish, distribute, sublicense,
+# and/or sell copies of the Software, and to permit persons to whom the
+# Software is furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice (including the next
+# paragraph) shall be included in all copies or substantial portions of the
+# Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+# THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+# IN THE SOFTWARE.
+
+# This script generates the file marshal_generated.c, which contains the
+# dispatch table used when GL calls are marshalled to a separate thread
+# (see main/marshal.c), along with the code that serializes each call into
+# a command and the code that executes the commands on the GL thread.
+
+import license
+import gl_XML
+import sys, getopt
+
+
+header = """
+#include "main/api_exec.h"
+#include "main/context.h"
+#include "main/dispatch.h"
+#include "main/macros.h"
+#include "main/marshal.h"
+"""
+
+
+# Functions whose pointer parameters are stored by GL rather than read
+# during the call: either buffer offsets, or client array addresses that
+# are only read by later draws.  The pointer value is marshalled, not the
+# data it points to.
+pointer_value_functions = set([
+    'VertexPointer',
+    'NormalPointer',
+    'ColorPointer',
+    'SecondaryColorPointer',
+    'FogCoordPointer',
+    'IndexPointer',
+    'EdgeFlagPointer',
+    'TexCoordPointer',
+    'PointSizePointerOES',
+    'VertexAttribPointer',
+    'VertexAttribIPointer',
+    'DrawElements',
+    'DrawRangeElements',
+    'DrawElementsBaseVertex',
+    'DrawRangeElementsBaseVertex',
+    'DrawElementsInstancedARB',
+    'DrawElementsInstancedBaseVertex',
+    'DrawElementsInstancedBaseInstance',
+    'DrawElementsInstancedBaseVertexBaseInstance',
+    'DrawArraysIndirect',
+    'DrawElementsIndirect',
+    ])
+
+
+# Calls that read client vertex arrays or indices when executed.  They are
+# executed synchronously whenever that memory isn't in a buffer object,
+# since the application may modify it as soon as the call returns.
+_arrays = '_mesa_glthread_has_user_arrays(ctx)'
+_indices = '_mesa_glthread_has_user_arrays(ctx) || ' \
+           '_mesa_glthread_has_user_indices(ctx)'
+
+sync_conditions = {
+    'ArrayElement': _arrays,
+    'DrawArrays': _arrays,
+    'MultiDrawArrays': _arrays,
+    'DrawArraysInstancedARB': _arrays,
+    'DrawArraysInstancedBaseInstance': _arrays,
+    'DrawArraysIndirect': _arrays,
+    'DrawTransformFeedback': _arrays,
+    'DrawTransformFeedbackStream': _arrays,
+    'DrawTransformFeedbackInstanced': _arrays,
+    'DrawTransformFeedbackStreamInstanced': _arrays,
+    'DrawElements': _indices,
+    'DrawRangeElements': _indices,
+    'DrawElementsBaseVertex': _indices,
+    'DrawRangeElementsBaseVertex': _indices,
+    'DrawElementsInstancedARB': _indices,
+    'DrawElementsInstancedBaseVertex': _indices,
+    'DrawElementsInstancedBaseInstance': _indices,
+    'DrawElementsInstancedBaseVertexBaseInstance': _indices,
+    'DrawElementsIndirect': _indices,
+    }
+
+
+# Bookkeeping done on the application thread before a call is marshalled,
+# so that sync_conditions can be evaluated without asking the GL thread.
+hooks = {
+    'DeleteBuffers': '_mesa_glthread_DeleteBuffers(ctx, n, buffer)',
+    'DeleteVertexArrays':
+        '_mesa_glthread_DeleteVertexArrays(ctx, n, arrays)',
+    'ClientActiveTexture':
+        '_mesa_glthread_ClientActiveTexture(ctx, texture)',
+    'EnableClientState': '_mesa_glthread_ClientState(ctx, array, GL_TRUE)',
+    'DisableClientState':
+        '_mesa_glthread_ClientState(ctx, array, GL_FALSE)',
+    'Enable': '_mesa_glthread_ClientState(ctx, cap, GL_TRUE)',
+    'Disable': '_mesa_glthread_ClientState(ctx, cap, GL_FALSE)',
+    'EnableVertexAttribArray':
+        '_mesa_glthread_VertexAttribArray(ctx, index, GL_TRUE)',
+    'DisableVertexAttribArray':
+        '_mesa_glthread_VertexAttribArray(ctx, index, GL_FALSE)',
+    'VertexPointer': '_mesa_glthread_AttribPointer(ctx, VERT_ATTRIB_POS)',
+    'NormalPointer': '_mesa_glthread_AttribPointer(ctx, VERT_ATTRIB_NORMAL)',
+    'ColorPointer': '_mesa_glthread_AttribPointer(ctx, VERT_ATTRIB_COLOR0)',
+    'SecondaryColorPointer':
+        '_mesa_glthread_AttribPointer(ctx, VERT_ATTRIB_COLOR1)',
+    'FogCoordPointer': '_mesa_glthread_AttribPointer(ctx, VERT_ATTRIB_FOG)',
+    'IndexPointer':
+        '_mesa_glthread_AttribPointer(ctx, VERT_ATTRIB_COLOR_INDEX)',
+    'EdgeFlagPointer':
+        '_mesa_glthread_AttribPointer(ctx, VERT_ATTRIB_EDGEFLAG)',
+    'PointSizePointerOES':
+        '_mesa_glthread_AttribPointer(ctx, VERT_ATTRIB_POINT_SIZE)',
+    'TexCoordPointer': '_mesa_glthread_TexCoordPointer(ctx)',
+    'VertexAttribPointer': '_mesa_glthread_VertexAttribPointer(ctx, index)',
+    'VertexAttribIPointer': '_mesa_glthread_VertexAttribPointer(ctx, index)',
+    'InterleavedArrays': '_mesa_glthread_InterleavedArrays(ctx, format)',
+    'VertexAttribBinding':
+        '_mesa_glthread_VertexAttribBinding(ctx, attribindex, bindingindex)',
+    'PushClientAttrib': '_mesa_glthread_PushClientAttrib(ctx, mask)',
+    'PopClientAttrib': '_mesa_glthread_PopClientAttrib(ctx)',
+    }
+
+
+# Hooks for binds which fail when the name doesn't exist.  They return
+# false, leaving the shadowed state alone, when they can't tell whether the
+# name is valid; the call is then executed synchronously and the shadowed
+# bindings are reloaded from the context.
+bind_hooks = {
+    'BindBuffer': '_mesa_glthread_BindBuffer(ctx, target, buffer)',
+    'BindVertexArray':
+        '_mesa_glthread_BindVertexArray(ctx, array, GL_TRUE)',
+    'BindVertexArrayAPPLE':
+        '_mesa_glthread_BindVertexArray(ctx, array, GL_FALSE)',
+    'BindVertexBuffer':
+        '_mesa_glthread_BindVertexBuffer(ctx, bindingindex, buffer)',
+    }
+
+
+# Calls with no return value that must still wait for the GL thread.  The
+# compressed image calls take an offset rather than client memory when a
+# pixel unpack buffer is bound, so their data can't be copied blindly.
+sync_functions = set([
+    'Finish',
+    'CompressedTexImage1D',
+    'CompressedTexImage2D',
+    'CompressedTexImage3D',
+    'CompressedTexSubImage1D',
+    'CompressedTexSubImage2D',
+    'CompressedTexSubImage3D',
+    ])
+
+
+# Calls that must reach the GL thread promptly.
+flush_functions = set([
+    'Flush',
+    ])
+
+
+signed_types = set(['GLint', 'GLsizei', 'GLintptr', 'GLsizeiptr'])
+
+
+def c_type(p):
+    """Type used to store a scalar or pointer-value parameter."""
+    return p.type_string()
+
+
+def element_size(p):
+    base = p.get_base_type_string()
+    if base in ('GLvoid', 'void'):
+        return '1'
+    return 'sizeof(%s)' % (base)
+
+
+def variable_size(p):
+    """C expression for the size in bytes of a variable-length parameter."""
+    size = '(size_t) %s' % (p.counter)
+    if p.count_scale > 1:
+        size += ' * %d' % (p.count_scale)
+    return '%s * %s' % (size, element_size(p))
+
+
+class marshal_function(object):
+    def __init__(self, f):
+        self.f = f
+        self.name = f.name
+        self.fixed_params = []
+        self.array_params = []
+        self.variable_params = []
+        self.is_async = self.classify()
+
+    def classify(self):
+        f = self.f
+
+        if f.return_type != 'void' or f.name in sync_functions:
+            return False
+
+        for p in f.parameterIterator():
+            if p.is_padding:
+                continue
+            if not p.is_pointer() or f.name in pointer_value_functions:
+                self.fixed_params.append(p)
+                continue
+            if p.is_output or p.is_image() or p.count_parameter_list:
+                return False
+            if p.type_string().count('*') > 1:
+                return False
+            if p.count:
+                self.array_params.append(p)
+            elif p.counter:
+                self.variable_params.append(p)
+            else:
+                return False
+
+        return True
+
+    def counter_checks(self):
+        """Conditions under which a variable-length call is too big to
+        marshal, or invalid and left for the GL thread to report."""
+        checks = []
+        for p in self.variable_params:
+            counter = [q for q in self.f.parameterIterator()
+                       if q.name == p.counter][0]
+            if counter.type_string() in signed_types:
+                check = '%s < 0 || %s > MARSHAL_MAX_CMD_SIZE' % (p.counter,
+                                                                 p.counter)
+            else:
+                check = '%s > MARSHAL_MAX_CMD_SIZE' % (p.counter)
+            if check not in checks:
+                checks.append(check)
+        return checks
+
+    def print_struct(self):
+        print '/* %s: marshalled asynchronously */' % (self.name)
+        print 'struct marshal_cmd_%s' % (self.name)
+        print '{'
+        print '   struct marshal_cmd_base cmd_base;'
+        for p in self.fixed_params:
+            print '   %s %s;' % (c_type(p), p.name)
+        for p in self.array_params:
+            print '   %s %s[%d];' % (p.get_base_type_string(), p.name,
+                                     p.count * p.count_scale)
+        for p in self.variable_params:
+            print '   GLboolean %s_null;' % (p.name)
+        for p in self.variable_params:
+            print '   /* Followed by %s bytes of %s, padded to 8 bytes */' \
+                % (variable_size(p), p.name)
+        print '};'
+
+    def print_unmarshal(self):
+        print 'static inline void'
+        print '_mesa_unmarshal_%s(struct gl_context *ctx, ' \
+            'const struct marshal_cmd_%s *cmd)' % (self.name, self.name)
+        print '{'
+        for p in self.fixed_params:
+            print '   %s %s = cmd->%s;' % (c_type(p), p.name, p.name)
+        for p in self.array_params:
+            print '   const %s *%s = cmd->%s;' % (p.get_base_type_string(),
+                                                 p.name, p.name)
+        if self.variable_params:
+            for p in self.variable_params:
+                print '   %s %s;' % (c_type(p), p.name)
+            print '   const char *variable_data = (const char *) (cmd + 1);'
+            for p in self.variable_params:
+                print '   %s = cmd->%s_null ? NULL : (%s) variable_data;' % (
+                    p.name, p.name, c_type(p))
+                if p != self.variable_params[-1]:
+                    print '   variable_data += ALIGN(%s, 8);' % (
+                        variable_size(p))
+        print '   CALL_%s(ctx->CurrentDispatch, (%s));' % (
+            self.name, self.f.get_called_parameter_string())
+        print '}'
+
+    def print_sync_call(self):
+        """Execute the call on the application thread once the GL thread is
+        idle.  The call may switch dispatch tables (e.g. glCallLists running
+        a glBegin), so point the application thread back at the marshalling
+        table afterwards."""
+        call = 'CALL_%s(ctx->CurrentDispatch, (%s))' % (
+            self.name, self.f.get_called_parameter_string())
+        print '   _mesa_glthread_finish(ctx);'
+        if self.f.return_type != 'void':
+            print '   result = %s;' % (call)
+        else:
+            print '   %s;' % (call)
+        print '   _mesa_glthread_restore_dispatch(ctx);'
+        if self.name in bind_hooks:
+            print '   _mesa_glthread_update_bindings(ctx);'
+        if self.f.return_type != 'void':
+            print '   return result;'
+
+    def print_marshal(self):
+        f = self.f
+
+        print 'static %s GLAPIENTRY' % (f.return_type)
+        print '_mesa_marshal_%s(%s)' % (self.name, f.get_parameter_string())
+        print '{'
+        print '   GET_CURRENT_CONTEXT(ctx);'
+
+        if not self.is_async:
+            if f.return_type != 'void':
+                print '   %s result;' % (f.return_type)
+            if self.name in hooks:
+                print '   %s;' % (hooks[self.name])
+            self.print_sync_call()
+            print '}'
+            return
+
+        has_data = self.fixed_params or self.array_params or \
+                   self.variable_params
+        if has_data:
+            print '   struct marshal_cmd_%s *cmd;' % (self.name)
+        print '   size_t cmd_size = sizeof(struct marshal_cmd_%s);' % (
+            self.name)
+        for p in self.variable_params:
+            print '   size_t %s_size = 0;' % (p.name)
+
+        if self.name in hooks:
+            print '   %s;' % (hooks[self.name])
+
+        checks = self.counter_checks()
+        if self.name in sync_conditions:
+            checks.append(sync_conditions[self.name])
+        if self.name in bind_hooks:
+            checks.append('!%s' % (bind_hooks[self.name]))
+        if checks:
+            print '   if (%s)' % (' ||\n       '.join(checks))
+            print '      goto fallback_to_sync;'
+
+        for p in self.variable_params:
+            print '   %s_size = %s;' % (p.name, variable_size(p))
+            print '   cmd_size += ALIGN(%s_size, 8);' % (p.name)
+
+        print '   if (cmd_size <= MARSHAL_MAX_CMD_SIZE) {'
+        if self.variable_params:
+            print '      char *variable_data;'
+        print '      %s_mesa_glthread_allocate_command(ctx, ' \
+            'DISPATCH_CMD_%s, cmd_size);' % ('cmd = ' if has_data else '',
+                                             self.name)
+        for p in self.fixed_params:
+            print '      cmd->%s = %s;' % (p.name, p.name)
+        for p in self.array_params:
+            print '      memcpy(cmd->%s, %s, sizeof(cmd->%s));' % (
+                p.name, p.name, p.name)
+        if self.variable_params:
+            print '      variable_data = (char *) (cmd + 1);'
+            for p in self.variable_params:
+                print '      cmd->%s_null = %s == NULL;' % (p.name, p.name)
+                print '      if (%s)' % (p.name)
+                print '         memcpy(variable_data, %s, %s_size);' % (
+                    p.name, p.name)
+                if p != self.variable_params[-1]:
+                    print '      variable_data += ALIGN(%s_size, 8);' % (
+                        p.name)
+        if self.name in flush_functions:
+            print '      _mesa_glthread_flush_batch(ctx);'
+        print '      return;'
+        print '   }'
+        print ''
+        if checks:
+            print 'fallback_to_sync:'
+        self.print_sync_call()
+        print '}'
+
+
+class PrintCode(gl_XML.gl_print_base):
+
+    def __init__(self):
+        gl_XML.gl_print_base.__init__(self)
+
+        self.name = 'gl_marshal.py'
+        self.license = license.bsd_license_template % (
+            'Copyright (C) 2013 agent <agent@local>',
+            'THE AUTHORS')
+
+    def printRealHeader(self):
+        print header
+
+    def printRealFooter(self):
+        pass
+
+    def printBody(self, api):
+        functions = []
+        for f in sorted(api.functionIterateByOffset(), key = lambda f: f.name):
+            if f.exec_flavor == 'skip':
+                # Mesa doesn't implement this function.
+                continue
+            if not f.desktop and not f.api_map:
+                # This function does not exist in any API.
+                continue
+            functions.append(marshal_function(f))
+
+        names = set([m.name for m in functions])
+        for name in (pointer_value_functions | set(sync_conditions.keys()) |
+                     set(hooks.keys()) | set(bind_hooks.keys()) |
+                     sync_functions | flush_functions):
+            if name not in names:
+                raise Exception('Unknown function {0!r}'.format(name))
+
+        async_functions = [m for m in functions if m.is_async]
+
+        print 'enum marshal_dispatch_cmd_id'
+        print '{'
+        for m in async_functions:
+            print '   DISPATCH_CMD_%s,' % (m.name)
+        print '   NUM_DISPATCH_CMD'
+        print '};'
+        print ''
+
+        for m in functions:
+            if m.is_async:
+                m.print_struct()
+                m.print_unmarshal()
+            else:
+                print '/* %s: marshalled synchronously */' % (m.name)
+            m.print_marshal()
+            print ''
+
+        print 'size_t'
+        print '_mesa_unmarshal_dispatch_cmd(struct gl_context *ctx, ' \
+            'const void *cmd)'
+        print '{'
+        print '   const struct marshal_cmd_base *cmd_base = cmd;'
+        print ''
+        print '   switch (cmd_base->cmd_id) {'
+        for m in async_functions:
+            print '   case DISPATCH_CMD_%s:' % (m.name)
+            print '      _mesa_unmarshal_%s(ctx, ' \
+                '(const struct marshal_cmd_%s *) cmd);' % (m.name, m.name)
+            print '      break;'
+        print '   default:'
+        print '      assert(!"Unknown marshal command");'
+        print '      break;'
+        print '   }'
+        print ''
+        print '   return cmd_base->cmd_size;'
+        print '}'
+        print ''
+
+        print 'struct _glapi_table *'
+        print '_mesa_create_marshal_table(void)'
+        print '{'
+        print '   struct _glapi_table *table;'
+        print ''
+        print '   table = _mesa_alloc_dispatch_table();'
+        print '   if (table == NULL)'
+        print '      return NULL;'
+        print ''
+        for m in functions:
+            print '   SET_%s(table, _mesa_marshal_%s);' % (m.name, m.name)
+        print ''
+        print '   return table;'
+        print '}'
+
+
+def show_usage():
+    print "Usage: %s [-f input_file_name]" % sys.argv[0]
+    sys.exit(1)
+
+
+if __name__ == '__main__':
+    file_name = "gl_and_es_API.xml"
+
+    try:
+        (args, trail) = getopt.getopt(sys.argv[1:], "f:")
+    except Exception,e:
+        show_usage()
+
+    for (arg,val) in args:
+        if arg == "-f":
+            file_name = val
+
+    printer = PrintCode()
+
+    api = gl_XML.parse_GL_API(file_name)
+    printer.Print(api)
@@ -794,6 +794,29 @@ enum shader_time_shader_type {
    ST_FS16_RESET,
 };
 
+/**
+ * Kinds of native program tracked in brw_context::compile_stats.
+ */
+enum brw_compile_stats_type {
+   BRW_STATS_VS,
+   BRW_STATS_GS,
+   BRW_STATS_FS8,
+   BRW_STATS_FS16,
+   BRW_STATS_COUNT
+};
+
+struct brw_compile_stats {
+   /** Native instructions generated, before compaction. */
+   unsigned instructions;
+
+   /**
+    * Execution time estimated by the last scheduling pass.  For fragment
+    * programs that allocated without spilling this is the pre-allocation
+    * schedule, which treats every instruction as single-cycle latency.
+    */
+   unsigned cycles;
+};
+
 /* Flags for brw->state.cache.
  */
 #define CACHE_NEW_CC_VP                  (1<<BRW_CC_VP)
@@ -1485,6 +1508,14 @@ struct brw_context
       double report_time;
    } shader_time;
 
+   /**
+    * Statistics about the most recently generated program of each kind.
+    *
+    * These are only informational: nothing in the driver reads them, but the
+    * standalone i965_compiler reports them after each compile.
+    */
+   struct brw_compile_stats compile_stats[BRW_STATS_COUNT];
+
    __DRIcontext *driContext;
    struct intel_screen *intelScreen;
 };
@@ -2261,12 +2261,16 @@ bool
 fs_visitor::register_coalesce()
 {
    bool progress = false;
+   int next_ip = 0;
 
    calculate_live_intervals();
 
    foreach_list_safe(node, &this->instructions) {
       fs_inst *inst = (fs_inst *)node;
 
+      int ip = next_ip;
+      next_ip++;
+
       if (inst->opcode != BRW_OPCODE_MOV ||
 	  inst->is_partial_write() ||
 	  inst->saturate ||
@@ -2309,13 +2313,18 @@ fs_visitor::register_coalesce()
 	 }
       }
 
+      live_intervals->merge_vars(var_to, var_from);
+      live_intervals->remove_instruction(ip);
       inst->remove();
       progress = true;
       continue;
    }
 
+   /* Coalescing only renames registers and removes the MOVs, so the live
+    * ranges can be kept up to date rather than recomputed.
+    */
    if (progress)
-      invalidate_live_intervals();
+      update_live_intervals();
 
    return progress;
 }
@@ -2365,9 +2374,10 @@ fs_visitor::compute_to_mrf()
        * rewrite the thing that made this GRF to write into the MRF.
        */
       fs_inst *scan_inst;
+      int scan_ip = ip - 1;
       for (scan_inst = (fs_inst *)inst->prev;
 	   scan_inst->prev != NULL;
-	   scan_inst = (fs_inst *)scan_inst->prev) {
+	   scan_inst = (fs_inst *)scan_inst->prev, scan_ip--) {
 	 if (scan_inst->dst.file == GRF &&
 	     scan_inst->dst.reg == inst->src[0].reg) {
 	    /* Found the last thing to write our reg we want to turn
@@ -2403,6 +2413,15 @@ fs_visitor::compute_to_mrf()
 
 	    if (scan_inst->dst.reg_offset == inst->src[0].reg_offset) {
 	       /* Found the creator of our MRF's source value. */
+	       int var = live_intervals->var_from_reg(&inst->src[0]);
+
+	       /* If these were the only accesses of the GRF, it's dead now.
+		* Otherwise its range still covers what's left.
+		*/
+	       if (live_intervals->start[var] >= scan_ip)
+		  live_intervals->clear_var(var);
+	       live_intervals->remove_instruction(ip);
+
 	       scan_inst->dst.file = MRF;
 	       scan_inst->dst.reg = inst->dst.reg;
 	       scan_inst->saturate |= inst->saturate;
@@ -2476,8 +2495,9 @@ fs_visitor::compute_to_mrf()
       }
    }
 
+   /* The rewritten GRF writes and removed MOVs were accounted for above. */
    if (progress)
-      invalidate_live_intervals();
+      update_live_intervals();
 
    return progress;
 }
@@ -3209,10 +3229,19 @@ fs_visitor::run()
 
       static enum instruction_scheduler_mode pre_modes[] = {
          SCHEDULE_PRE,
+         SCHEDULE_PRE_CRITICAL_PATH,
          SCHEDULE_PRE_NON_LIFO,
          SCHEDULE_PRE_LIFO,
       };
 
+      /* Graph coloring is quadratic in the number of virtual GRFs, so for
+       * huge shaders try the cheaper linear scan allocator first, and only
+       * build the interference graph if that doesn't fit.
+       */
+      bool try_linear_scan =
+         virtual_grf_count > LINEAR_SCAN_VIRTUAL_GRF_THRESHOLD ||
+         unlikely(INTEL_DEBUG & DEBUG_LINEAR_RA);
+
       /* Try each scheduling heuristic to see if it can successfully register
        * allocate without spilling.  They should be ordered by decreasing
        * performance but increasing likelihood of allocating.
@@ -3223,12 +3252,15 @@ fs_visitor::run()
          if (0) {
             assign_regs_trivial();
             allocated_without_spills = true;
+         } else if (try_linear_scan && assign_regs_linear_scan()) {
+            allocated_without_spills = true;
          } else {
             allocated_without_spills = assign_regs(false);
          }
          if (allocated_without_spills)
             break;
       }
+      invalidate_schedule_dag();
 
       if (!allocated_without_spills) {
          /* We assume that any spilling is worse than just dropping back to
@@ -3332,7 +3364,15 @@ brw_wm_fs_emit(struct brw_context *brw, struct brw_wm_compile *c,
    exec_list *simd16_instructions = NULL;
    fs_visitor v2(brw, c, prog, fp, 16);
    if (brw->gen >= 5 && likely(!(INTEL_DEBUG & DEBUG_NO16))) {
-      if (c->prog_data.nr_pull_params == 0) {
+      if (v.spilled_any_registers) {
+         /* SIMD16 needs twice the register space for every virtual GRF, so
+          * if the 8-wide program couldn't be allocated without spilling, the
+          * 16-wide one is certain to fail too (and we refuse to spill in
+          * 16-wide anyway).  Don't spend another full optimize/schedule/
+          * register-allocate pipeline finding that out.
+          */
+         perf_debug("Skipping 16-wide due to register spilling in 8-wide.\n");
+      } else if (c->prog_data.nr_pull_params == 0) {
          /* Try a 16-wide compile */
          v2.import_uniforms(&v);
          if (!v2.run()) {
@@ -50,7 +50,14 @@ extern "C" {
 #include "glsl/glsl_types.h"
 #include "glsl/ir.h"
 
+/**
+ * Number of virtual GRFs above which register allocation first tries the
+ * linear scan allocator before falling back to graph coloring.
+ */
+#define LINEAR_SCAN_VIRTUAL_GRF_THRESHOLD 2048
+
 class bblock_t;
+class fs_instruction_scheduler;
 namespace {
    struct acp_entry;
 }
@@ -293,8 +300,11 @@ public:
    void calculate_urb_setup();
    void assign_urb_setup();
    bool assign_regs(bool allow_spilling);
+   bool assign_regs_linear_scan();
    void assign_regs_trivial();
    void get_used_mrfs(bool *mrf_used);
+   void calculate_payload_ranges(int payload_node_count,
+                                 int *payload_last_use_ip);
    void setup_payload_interference(struct ra_graph *g, int payload_reg_count,
                                    int first_payload_node);
    void setup_mrf_hack_interference(struct ra_graph *g,
@@ -307,6 +317,7 @@ public:
    void setup_pull_constants();
    void invalidate_live_intervals();
    void calculate_live_intervals();
+   void update_live_intervals();
    bool opt_algebraic();
    bool opt_cse();
    bool opt_cse_local(bblock_t *block, exec_list *aeb);
@@ -323,6 +334,7 @@ public:
    bool remove_duplicate_mrf_writes();
    bool virtual_grf_interferes(int a, int b);
    void schedule_instructions(instruction_scheduler_mode mode);
+   void invalidate_schedule_dag();
    void insert_gen4_send_dependency_workarounds();
    void insert_gen4_pre_send_dependency_workarounds(fs_inst *inst);
    void insert_gen4_post_send_dependency_workarounds(fs_inst *inst);
@@ -445,6 +457,12 @@ public:
    int *virtual_grf_end;
    brw::fs_live_variables *live_intervals;
 
+   /**
+    * Pre-register-allocation scheduler, kept around so that each of the
+    * pre_modes heuristics can reuse the dependency DAG built by the first.
+    */
+   fs_instruction_scheduler *pre_ra_scheduler;
+
    /* This is the map from UNIFORM hw_reg + reg_offset as generated by
     * the visitor to the packed uniform number after
     * remove_dead_constants() that represents the actual uploaded
@@ -1815,8 +1815,12 @@ fs_generator::generate_assembly(exec_list *simd8_instructions,
    assert(simd8_instructions || simd16_instructions);
 
    if (simd8_instructions) {
+      int start_insn = p->nr_insn;
+
       dispatch_width = 8;
       generate_code(simd8_instructions);
+      brw->compile_stats[BRW_STATS_FS8].instructions =
+         p->nr_insn - start_insn;
    }
 
    if (simd16_instructions) {
@@ -1836,8 +1840,12 @@ fs_generator::generate_assembly(exec_list *simd8_instructions,
 
       brw_set_compression_control(p, BRW_COMPRESSION_COMPRESSED);
 
+      int start_insn = p->nr_insn;
+
       dispatch_width = 16;
       generate_code(simd16_instructions);
+      brw->compile_stats[BRW_STATS_FS16].instructions =
+         p->nr_insn - start_insn;
    }
 
    return brw_get_program(p, assembly_size);
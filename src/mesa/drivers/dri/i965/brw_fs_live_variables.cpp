@@ -176,40 +176,52 @@ fs_live_variables::setup_def_use()
  * propagating it through control flow.  It will eventually terminate
  * because it only ever adds bits, and stops when no bits are added in
  * a pass.
+ *
+ * Liveness flows backwards, so we visit the blocks in reverse order and
+ * update each block's liveout from its successors before its livein.  In
+ * the absence of loops that reaches the fixed point in a single pass (plus
+ * one to notice nothing changed), instead of one pass per block.
+ *
+ * The sets are merged with live_bitset_merge(), which only visits the
+ * nonzero words of sparse sets, and does dense ones with SIMD.
  */
 void
 fs_live_variables::compute_live_variables()
 {
    bool cont = true;
 
+   /* livein = use | (liveout & ~def), and use never changes. */
+   for (int b = 0; b < cfg->num_blocks; b++) {
+      memcpy(bd[b].livein, bd[b].use, bitset_words * sizeof(BITSET_WORD));
+      bd[b].num_livein_words =
+         live_bitset_list_words(bd[b].livein, bd[b].livein_words,
+                                bitset_words);
+   }
+
    while (cont) {
       cont = false;
 
-      for (int b = 0; b < cfg->num_blocks; b++) {
-	 /* Update livein */
-	 for (int i = 0; i < bitset_words; i++) {
-            BITSET_WORD new_livein = (bd[b].use[i] |
-                                      (bd[b].liveout[i] & ~bd[b].def[i]));
-	    if (new_livein & ~bd[b].livein[i]) {
-               bd[b].livein[i] |= new_livein;
-               cont = true;
-	    }
-	 }
-
+      for (int b = cfg->num_blocks - 1; b >= 0; b--) {
 	 /* Update liveout */
 	 foreach_list(block_node, &cfg->blocks[b]->children) {
 	    bblock_link *link = (bblock_link *)block_node;
-	    bblock_t *block = link->block;
-
-	    for (int i = 0; i < bitset_words; i++) {
-               BITSET_WORD new_liveout = (bd[block->block_num].livein[i] &
-                                          ~bd[b].liveout[i]);
-               if (new_liveout) {
-                  bd[b].liveout[i] |= new_liveout;
-                  cont = true;
-               }
-	    }
+	    struct block_data *child = &bd[link->block->block_num];
+
+            if (live_bitset_merge(bd[b].liveout, bd[b].liveout_words,
+                                  &bd[b].num_liveout_words,
+                                  child->livein, child->livein_words,
+                                  child->num_livein_words,
+                                  NULL, bitset_words))
+               cont = true;
 	 }
+
+	 /* Update livein */
+         if (live_bitset_merge(bd[b].livein, bd[b].livein_words,
+                               &bd[b].num_livein_words,
+                               bd[b].liveout, bd[b].liveout_words,
+                               bd[b].num_liveout_words,
+                               bd[b].def, bitset_words))
+            cont = true;
       }
    }
 }
@@ -217,22 +229,42 @@ fs_live_variables::compute_live_variables()
 /**
  * Extend the start/end ranges for each variable to account for the
  * new information calculated from control flow.
+ *
+ * Most blocks only have a handful of variables live across their
+ * boundaries, so walk the set bits of the nonzero words rather than testing
+ * every variable.
  */
 void
 fs_live_variables::compute_start_end()
 {
    for (int b = 0; b < cfg->num_blocks; b++) {
-      for (int i = 0; i < num_vars; i++) {
-	 if (BITSET_TEST(bd[b].livein, i)) {
-	    start[i] = MIN2(start[i], cfg->blocks[b]->start_ip);
-	    end[i] = MAX2(end[i], cfg->blocks[b]->start_ip);
-	 }
+      int start_ip = cfg->blocks[b]->start_ip;
+      int end_ip = cfg->blocks[b]->end_ip;
 
-	 if (BITSET_TEST(bd[b].liveout, i)) {
-	    start[i] = MIN2(start[i], cfg->blocks[b]->end_ip);
-	    end[i] = MAX2(end[i], cfg->blocks[b]->end_ip);
-	 }
+      for (int k = 0; k < bd[b].num_livein_words; k++) {
+         int w = bd[b].livein_words[k];
+         BITSET_WORD livein = bd[b].livein[w];
+
+         while (livein) {
+            int i = w * BITSET_WORDBITS + ffs(livein) - 1;
+            livein &= livein - 1;
 
+	    start[i] = MIN2(start[i], start_ip);
+	    end[i] = MAX2(end[i], start_ip);
+         }
+      }
+
+      for (int k = 0; k < bd[b].num_liveout_words; k++) {
+         int w = bd[b].liveout_words[k];
+         BITSET_WORD liveout = bd[b].liveout[w];
+
+         while (liveout) {
+            int i = w * BITSET_WORDBITS + ffs(liveout) - 1;
+            liveout &= liveout - 1;
+
+	    start[i] = MIN2(start[i], end_ip);
+	    end[i] = MAX2(end[i], end_ip);
+         }
       }
    }
 }
@@ -272,12 +304,18 @@ fs_live_variables::fs_live_variables(fs_visitor *v, cfg_t *cfg)
 
    bd = rzalloc_array(mem_ctx, struct block_data, cfg->num_blocks);
 
+   removed_ips = NULL;
+   num_removed_ips = 0;
+   removed_ips_size = 0;
+
    bitset_words = BITSET_WORDS(num_vars);
    for (int i = 0; i < cfg->num_blocks; i++) {
       bd[i].def = rzalloc_array(mem_ctx, BITSET_WORD, bitset_words);
       bd[i].use = rzalloc_array(mem_ctx, BITSET_WORD, bitset_words);
       bd[i].livein = rzalloc_array(mem_ctx, BITSET_WORD, bitset_words);
       bd[i].liveout = rzalloc_array(mem_ctx, BITSET_WORD, bitset_words);
+      bd[i].livein_words = ralloc_array(mem_ctx, int, bitset_words);
+      bd[i].liveout_words = ralloc_array(mem_ctx, int, bitset_words);
    }
 
    setup_def_use();
@@ -290,6 +328,103 @@ fs_live_variables::~fs_live_variables()
    ralloc_free(mem_ctx);
 }
 
+/**
+ * Updates the ranges after all accesses of \p from were renamed to \p to,
+ * as register coalescing does.
+ *
+ * The ranges are the hull of the accesses, so the new range of \p to is the
+ * hull of both, and \p from is no longer live anywhere.
+ */
+void
+fs_live_variables::merge_vars(int to, int from)
+{
+   if (to == from)
+      return;
+
+   start[to] = MIN2(start[to], start[from]);
+   end[to] = MAX2(end[to], end[from]);
+   clear_var(from);
+}
+
+/**
+ * Marks \p var as not accessed anywhere anymore.
+ */
+void
+fs_live_variables::clear_var(int var)
+{
+   start[var] = MAX_INSTRUCTION;
+   end[var] = -1;
+}
+
+/**
+ * Records the removal of the instruction at \p ip, in the numbering the
+ * ranges currently use.  Calls must come in increasing ip order, and be
+ * followed by renumber() once the pass is done walking the instructions.
+ */
+void
+fs_live_variables::remove_instruction(int ip)
+{
+   assert(num_removed_ips == 0 || removed_ips[num_removed_ips - 1] < ip);
+
+   if (num_removed_ips == removed_ips_size) {
+      removed_ips_size = MAX2(16, removed_ips_size * 2);
+      removed_ips = reralloc(mem_ctx, removed_ips, int, removed_ips_size);
+   }
+   removed_ips[num_removed_ips++] = ip;
+}
+
+/**
+ * Returns the number of removed instructions before \p ip.
+ */
+static int
+count_removed_before(const int *removed_ips, int num_removed_ips, int ip)
+{
+   int lo = 0, hi = num_removed_ips;
+
+   while (lo < hi) {
+      int mid = (lo + hi) / 2;
+      if (removed_ips[mid] < ip)
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+
+   return lo;
+}
+
+/**
+ * Renumbers the ranges for the instructions removed since the last call.
+ *
+ * A range starting at a removed instruction now starts at the next one, and
+ * a range ending at one ends at the previous one, which still covers all the
+ * remaining accesses.  This lets local passes which only delete instructions
+ * and rename registers keep the ranges instead of recomputing them.  The
+ * per-block data is not updated.
+ */
+void
+fs_live_variables::renumber()
+{
+   if (num_removed_ips == 0)
+      return;
+
+   for (int i = 0; i < num_vars; i++) {
+      if (end[i] < start[i])
+         continue;
+
+      int start_removed = count_removed_before(removed_ips, num_removed_ips,
+                                               start[i]);
+      int end_removed = count_removed_before(removed_ips, num_removed_ips,
+                                             end[i]);
+      bool end_was_removed = (end_removed < num_removed_ips &&
+                              removed_ips[end_removed] == end[i]);
+
+      start[i] -= start_removed;
+      end[i] -= end_removed + (end_was_removed ? 1 : 0);
+   }
+
+   num_removed_ips = 0;
+}
+
 void
 fs_visitor::invalidate_live_intervals()
 {
@@ -315,14 +450,27 @@ fs_visitor::calculate_live_intervals()
    virtual_grf_start = ralloc_array(mem_ctx, int, num_vgrfs);
    virtual_grf_end = ralloc_array(mem_ctx, int, num_vgrfs);
 
-   for (int i = 0; i < num_vgrfs; i++) {
+   cfg_t cfg(&instructions);
+   this->live_intervals = new(mem_ctx) fs_live_variables(this, &cfg);
+
+   update_live_intervals();
+}
+
+/**
+ * Renumbers the live ranges after a pass removed instructions and coalesced
+ * registers with fs_live_variables::remove_instruction() and merge_vars(),
+ * and merges the per-component ranges to whole VGRF ranges again.
+ */
+void
+fs_visitor::update_live_intervals()
+{
+   live_intervals->renumber();
+
+   for (int i = 0; i < live_intervals->num_vgrfs; i++) {
       virtual_grf_start[i] = MAX_INSTRUCTION;
       virtual_grf_end[i] = -1;
    }
 
-   cfg_t cfg(&instructions);
-   this->live_intervals = new(mem_ctx) fs_live_variables(this, &cfg);
-
    /* Merge the per-component live ranges to whole VGRF live ranges. */
    for (int i = 0; i < live_intervals->num_vars; i++) {
       int vgrf = live_intervals->vgrf_from_var[i];
@@ -26,7 +26,7 @@
  */
 
 #include "brw_fs.h"
-#include "main/bitset.h"
+#include "brw_live_bitset.h"
 
 class cfg_t;
 
@@ -51,6 +51,17 @@ struct block_data {
 
    /** Which defs reach the exit point of the block. */
    BITSET_WORD *liveout;
+
+   /** @{
+    * Indices of the nonzero words of livein and liveout.
+    *
+    * See brw_live_bitset.h.
+    */
+   int *livein_words;
+   int num_livein_words;
+   int *liveout_words;
+   int num_liveout_words;
+   /** @} */
 };
 
 class fs_live_variables {
@@ -69,6 +80,11 @@ public:
    bool vars_interfere(int a, int b);
    int var_from_reg(fs_reg *reg);
 
+   void merge_vars(int to, int from);
+   void clear_var(int var);
+   void remove_instruction(int ip);
+   void renumber();
+
    fs_visitor *v;
    cfg_t *cfg;
    void *mem_ctx;
@@ -98,6 +114,14 @@ public:
 
    /** Per-basic-block information on live variables */
    struct block_data *bd;
+
+   /**
+    * Instructions removed since start[] and end[] were last renumbered, in
+    * increasing order of their ip in the old numbering.
+    */
+   int *removed_ips;
+   int num_removed_ips;
+   int removed_ips_size;
 };
 
 } /* namespace brw */
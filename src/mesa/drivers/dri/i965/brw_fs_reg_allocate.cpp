@@ -211,12 +211,7 @@ count_to_loop_end(fs_inst *do_inst)
 }
 
 /**
- * Sets up interference between thread payload registers and the virtual GRFs
- * to be allocated for program temporaries.
- *
- * We want to be able to reallocate the payload for our virtual GRFs, notably
- * because the setup coefficients for a full set of 16 FS inputs takes up 8 of
- * our 128 registers.
+ * Computes the ip of the last use of each thread payload register.
  *
  * The layout of the payload registers is:
  *
@@ -228,16 +223,14 @@ count_to_loop_end(fs_inst *do_inst)
  * (note that in 16-wide, a node is two registers).
  */
 void
-fs_visitor::setup_payload_interference(struct ra_graph *g,
-                                       int payload_node_count,
-                                       int first_payload_node)
+fs_visitor::calculate_payload_ranges(int payload_node_count,
+                                     int *payload_last_use_ip)
 {
    int reg_width = dispatch_width / 8;
    int loop_depth = 0;
    int loop_end_ip = 0;
 
-   int payload_last_use_ip[payload_node_count];
-   memset(payload_last_use_ip, 0, sizeof(payload_last_use_ip));
+   memset(payload_last_use_ip, 0, payload_node_count * sizeof(int));
    int ip = 0;
    foreach_list(node, &this->instructions) {
       fs_inst *inst = (fs_inst *)node;
@@ -319,6 +312,23 @@ fs_visitor::setup_payload_interference(struct ra_graph *g,
 
       ip++;
    }
+}
+
+/**
+ * Sets up interference between thread payload registers and the virtual GRFs
+ * to be allocated for program temporaries.
+ *
+ * We want to be able to reallocate the payload for our virtual GRFs, notably
+ * because the setup coefficients for a full set of 16 FS inputs takes up 8 of
+ * our 128 registers.
+ */
+void
+fs_visitor::setup_payload_interference(struct ra_graph *g,
+                                       int payload_node_count,
+                                       int first_payload_node)
+{
+   int payload_last_use_ip[payload_node_count];
+   calculate_payload_ranges(payload_node_count, payload_last_use_ip);
 
    for (int i = 0; i < payload_node_count; i++) {
       /* Mark the payload node as interfering with any virtual grf that is
@@ -533,6 +543,134 @@ fs_visitor::assign_regs(bool allow_spilling)
    return true;
 }
 
+/**
+ * Allocates registers with a single linear scan over the live intervals.
+ *
+ * Building and coloring the interference graph in assign_regs() is
+ * quadratic in the number of virtual GRFs, which gets expensive for very
+ * large shaders.  This walks the virtual GRFs in order of the start of their
+ * live intervals and gives each the lowest free block of registers, which
+ * is linear apart from the register search but packs less tightly, so it
+ * can fail where graph coloring would have succeeded.  It never spills: on
+ * failure nothing is modified and false is returned.
+ */
+bool
+fs_visitor::assign_regs_linear_scan()
+{
+   int reg_width = dispatch_width / 8;
+   int hw_reg_mapping[this->virtual_grf_count];
+   int payload_node_count = (ALIGN(this->first_non_payload_grf, reg_width) /
+                            reg_width);
+   int rsi = reg_width - 1; /* Which brw->wm.reg_sets[] to use */
+   calculate_live_intervals();
+
+   /* The ip from which each hardware register is free to be reused.  A
+    * virtual GRF may take a register whose previous occupant's live interval
+    * ends at or before its own start, the same as virtual_grf_interferes().
+    */
+   int reg_free_ip[BRW_MAX_GRF];
+   memset(reg_free_ip, 0, sizeof(reg_free_ip));
+
+   /* Payload registers are busy up to and including their last use (see the
+    * <= comparison in setup_payload_interference()).
+    */
+   int payload_last_use_ip[payload_node_count];
+   calculate_payload_ranges(payload_node_count, payload_last_use_ip);
+   for (int i = 0; i < payload_node_count; i++) {
+      for (int r = 0; r < reg_width; r++)
+         reg_free_ip[i * reg_width + r] = payload_last_use_ip[i] + 1;
+   }
+
+   /* MRFs living in the top GRFs are never reusable, as in
+    * setup_mrf_hack_interference().
+    */
+   if (brw->gen >= 7) {
+      bool mrf_used[BRW_MAX_MRF];
+      get_used_mrfs(mrf_used);
+
+      for (int i = 0; i < BRW_MAX_MRF; i++) {
+         if (!mrf_used[i])
+            continue;
+
+         int reg = (GEN7_MRF_HACK_START + i) / reg_width * reg_width;
+         for (int r = 0; r < reg_width; r++)
+            reg_free_ip[reg + r] = INT_MAX;
+      }
+   }
+
+   /* Bucket the virtual GRFs by the start of their live interval, so that
+    * we visit them in order without a sort.
+    */
+   int ip_count = 0;
+   foreach_list(node, &this->instructions)
+      ip_count++;
+
+   int first_at_ip[ip_count];
+   int next_at_ip[this->virtual_grf_count];
+   for (int ip = 0; ip < ip_count; ip++)
+      first_at_ip[ip] = -1;
+
+   for (int i = this->virtual_grf_count - 1; i >= 0; i--) {
+      hw_reg_mapping[i] = 0;
+
+      /* Never-used virtual GRFs don't appear in any instruction. */
+      if (virtual_grf_start[i] >= ip_count ||
+          virtual_grf_end[i] < virtual_grf_start[i])
+         continue;
+
+      next_at_ip[i] = first_at_ip[virtual_grf_start[i]];
+      first_at_ip[virtual_grf_start[i]] = i;
+   }
+
+   int grf_used = payload_node_count * reg_width;
+
+   for (int ip = 0; ip < ip_count; ip++) {
+      for (int i = first_at_ip[ip]; i != -1; i = next_at_ip[i]) {
+         int size = this->virtual_grf_sizes[i] * reg_width;
+         int align = reg_width;
+
+         /* See the aligned_pairs_class special case in assign_regs(). */
+         if (brw->wm.reg_sets[rsi].aligned_pairs_class >= 0 &&
+             this->delta_x[BRW_WM_PERSPECTIVE_PIXEL_BARYCENTRIC].reg == i) {
+            align = 2;
+         }
+
+         int reg;
+         for (reg = 0; reg + size <= BRW_MAX_GRF; reg += align) {
+            int r;
+            for (r = 0; r < size; r++) {
+               if (reg_free_ip[reg + r] > ip)
+                  break;
+            }
+            if (r == size)
+               break;
+         }
+
+         if (reg + size > BRW_MAX_GRF)
+            return false;
+
+         for (int r = 0; r < size; r++)
+            reg_free_ip[reg + r] = virtual_grf_end[i];
+
+         hw_reg_mapping[i] = reg;
+         grf_used = MAX2(grf_used, reg + size);
+      }
+   }
+
+   this->grf_used = grf_used;
+
+   foreach_list(node, &this->instructions) {
+      fs_inst *inst = (fs_inst *)node;
+
+      assign_reg(hw_reg_mapping, &inst->dst, reg_width);
+      assign_reg(hw_reg_mapping, &inst->src[0], reg_width);
+      assign_reg(hw_reg_mapping, &inst->src[1], reg_width);
+      assign_reg(hw_reg_mapping, &inst->src[2], reg_width);
+   }
+
+   return true;
+}
+
 void
 fs_visitor::emit_unspill(fs_inst *inst, fs_reg dst, uint32_t spill_offset,
                          int count)
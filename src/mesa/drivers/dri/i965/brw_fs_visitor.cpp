@@ -2932,6 +2932,7 @@ fs_visitor::fs_visitor(struct brw_context *brw,
    this->virtual_grf_start = NULL;
    this->virtual_grf_end = NULL;
    this->live_intervals = NULL;
+   this->pre_ra_scheduler = NULL;
 
    this->params_remap = NULL;
    this->nr_params_remap = 0;
@@ -2945,6 +2946,7 @@ fs_visitor::fs_visitor(struct brw_context *brw,
 
 fs_visitor::~fs_visitor()
 {
+   invalidate_schedule_dag();
    ralloc_free(this->mem_ctx);
    hash_table_dtor(this->variable_ht);
 }
@@ -0,0 +1,133 @@
+/*
+ * Copyright © 2013 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/** @file brw_live_bitset.h
+ *
+ * Bitset operations for the live variable dataflow.
+ *
+ * Each livein/liveout set keeps, next to its bits, the list of its nonzero
+ * words.  Most blocks only have a few variables live across their
+ * boundaries, so merging a set into another only visits the nonzero words
+ * of the source.  Dense sources are merged with a vector loop over the
+ * whole set instead.
+ */
+
+#pragma once
+
+#include "main/bitset.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * dst |= src & ~mask over all \p words words, with a NULL mask meaning none.
+ * Returns whether any bits were added to dst.
+ */
+static inline bool
+live_bitset_or_dense(BITSET_WORD *dst, const BITSET_WORD *src,
+                     const BITSET_WORD *mask, int words)
+{
+   BITSET_WORD added = 0;
+   int i = 0;
+
+#ifdef __SSE2__
+   __m128i vadded = _mm_setzero_si128();
+
+   for (; i + 4 <= words; i += 4) {
+      __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+      __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+
+      if (mask)
+         s = _mm_andnot_si128(_mm_loadu_si128((const __m128i *)(mask + i)), s);
+
+      vadded = _mm_or_si128(vadded, _mm_andnot_si128(d, s));
+      _mm_storeu_si128((__m128i *)(dst + i), _mm_or_si128(d, s));
+   }
+
+   if (_mm_movemask_epi8(_mm_cmpeq_epi8(vadded, _mm_setzero_si128())) != 0xffff)
+      added = 1;
+#endif
+
+   for (; i < words; i++) {
+      BITSET_WORD s = mask ? src[i] & ~mask[i] : src[i];
+
+      added |= s & ~dst[i];
+      dst[i] |= s;
+   }
+
+   return added != 0;
+}
+
+/**
+ * Fills \p list with the indices of the nonzero words of \p set, and
+ * returns their number.
+ */
+static inline int
+live_bitset_list_words(const BITSET_WORD *set, int *list, int words)
+{
+   int n = 0;
+
+   for (int i = 0; i < words; i++) {
+      if (set[i])
+         list[n++] = i;
+   }
+
+   return n;
+}
+
+/**
+ * dst |= src & ~mask, where \p src_words lists the nonzero words of src and
+ * \p dst_words those of dst, which is kept up to date.  Returns whether any
+ * bits were added to dst.
+ */
+static inline bool
+live_bitset_merge(BITSET_WORD *dst, int *dst_words, int *num_dst_words,
+                  const BITSET_WORD *src, const int *src_words,
+                  int num_src_words, const BITSET_WORD *mask, int words)
+{
+   bool progress = false;
+
+   if (num_src_words * 4 >= words) {
+      if (live_bitset_or_dense(dst, src, mask, words)) {
+         *num_dst_words = live_bitset_list_words(dst, dst_words, words);
+         progress = true;
+      }
+      return progress;
+   }
+
+   for (int k = 0; k < num_src_words; k++) {
+      int w = src_words[k];
+      BITSET_WORD s = mask ? src[w] & ~mask[w] : src[w];
+      BITSET_WORD added = s & ~dst[w];
+
+      if (added) {
+         if (!dst[w])
+            dst_words[(*num_dst_words)++] = w;
+         dst[w] |= added;
+         progress = true;
+      }
+   }
+
+   return progress;
+}
@@ -70,6 +70,12 @@ public:
    int *child_latency;
    int child_count;
    int parent_count;
+
+   /**
+    * Number of parents in the DAG, so that parent_count can be restored when
+    * the block is scheduled again with a different heuristic.
+    */
+   int dag_parent_count;
    int child_array_size;
    int unblocked_time;
    int latency;
@@ -404,6 +410,9 @@ public:
       this->post_reg_alloc = (mode == SCHEDULE_POST);
       this->mode = mode;
       this->time = 0;
+      this->total_time = 0;
+      this->dag_nodes = NULL;
+      this->dag_node_count = 0;
       if (!post_reg_alloc) {
          this->remaining_grf_uses = rzalloc_array(mem_ctx, int, grf_count);
          this->grf_active = rzalloc_array(mem_ctx, bool, grf_count);
@@ -413,7 +422,7 @@ public:
       }
    }
 
-   ~instruction_scheduler()
+   virtual ~instruction_scheduler()
    {
       ralloc_free(this->mem_ctx);
    }
@@ -423,6 +432,7 @@ public:
 
    void run(exec_list *instructions);
    void add_inst(backend_instruction *inst);
+   void reuse_dag_node(schedule_node *n);
    void compute_delay(schedule_node *node);
    virtual void calculate_deps() = 0;
    virtual schedule_node *choose_instruction_to_schedule() = 0;
@@ -448,7 +458,20 @@ public:
    int instructions_to_schedule;
    int grf_count;
    int time;
+
+   /** Sum of the estimated execution time of all the blocks scheduled. */
+   int total_time;
    exec_list instructions;
+
+   /**
+    * Every node of the dependency DAG, in original program order.
+    *
+    * The DAG only depends on the instructions, not on the order they were
+    * scheduled in, so it's built on the first run() and reused when the
+    * same instructions are scheduled again with another heuristic.
+    */
+   schedule_node **dag_nodes;
+   int dag_node_count;
    backend_visitor *bv;
 
    instruction_scheduler_mode mode;
@@ -608,6 +631,7 @@ schedule_node::schedule_node(backend_instruction *inst,
    this->child_latency = NULL;
    this->child_count = 0;
    this->parent_count = 0;
+   this->dag_parent_count = 0;
    this->unblocked_time = 0;
    this->cand_generation = 0;
    this->delay = 0;
@@ -637,6 +661,22 @@ instruction_scheduler::add_inst(backend_instruction *inst)
    instructions.push_tail(n);
 }
 
+/**
+ * Puts a node from an earlier run back on the list to be scheduled, with
+ * its scheduling state reset.  The edges and delay are unchanged.
+ */
+void
+instruction_scheduler::reuse_dag_node(schedule_node *n)
+{
+   n->parent_count = n->dag_parent_count;
+   n->unblocked_time = 0;
+   n->cand_generation = 0;
+
+   this->instructions_to_schedule++;
+
+   instructions.push_tail(n);
+}
+
 /** Recursive computation of the delay member of a node. */
 void
 instruction_scheduler::compute_delay(schedule_node *n)
@@ -667,11 +707,16 @@ instruction_scheduler::add_dep(schedule_node *before, schedule_node *after,
 
    assert(before != after);
 
-   for (int i = 0; i < before->child_count; i++) {
-      if (before->children[i] == after) {
-	 before->child_latency[i] = MAX2(before->child_latency[i], latency);
-	 return;
-      }
+   /* Repeated edges come from several operands of the same instruction, so
+    * they're always the most recently added child.  Checking just that one
+    * keeps DAG construction linear; an occasional duplicate edge elsewhere
+    * is harmless, since parent_count counts edges rather than parents.
+    */
+   if (before->child_count > 0 &&
+       before->children[before->child_count - 1] == after) {
+      int i = before->child_count - 1;
+      before->child_latency[i] = MAX2(before->child_latency[i], latency);
+      return;
    }
 
    if (before->child_array_size <= before->child_count) {
@@ -1154,6 +1199,21 @@ fs_instruction_scheduler::choose_instruction_to_schedule()
             chosen_time = n->unblocked_time;
          }
       }
+   } else if (mode == SCHEDULE_PRE_CRITICAL_PATH) {
+      /* Choose the instruction with the longest chain of dependent work
+       * below it, so that the chains feeding the end of the block (texturing
+       * and math results, mostly) get started as early as possible.  Among
+       * equally critical ones, take the one that's been ready the longest.
+       */
+      foreach_list(node, &instructions) {
+         schedule_node *n = (schedule_node *)node;
+
+         if (!chosen || n->delay > chosen->delay ||
+             (n->delay == chosen->delay &&
+              n->unblocked_time < chosen->unblocked_time)) {
+            chosen = n;
+         }
+      }
    } else {
       /* Before register allocation, we don't care about the latencies of
        * instructions.  All we care about is reducing live intervals of
@@ -1370,11 +1430,19 @@ instruction_scheduler::schedule_instructions(backend_instruction *next_block_hea
    assert(instructions_to_schedule == 0);
 }
 
+/**
+ * Schedules each basic block of the program in turn.
+ *
+ * The dependency DAG is built on the first run and reused by later runs of
+ * the same scheduler, which only need to reset the per-schedule state.
+ */
 void
 instruction_scheduler::run(exec_list *all_instructions)
 {
    backend_instruction *next_block_header =
       (backend_instruction *)all_instructions->head;
+   bool reuse_dag = dag_nodes != NULL;
+   int ip = 0;
 
    if (debug) {
       printf("\nInstructions before scheduling (reg_alloc %d)\n", post_reg_alloc);
@@ -1385,31 +1453,62 @@ instruction_scheduler::run(exec_list *all_instructions)
     * scheduling.
     */
    if (remaining_grf_uses) {
+      memset(remaining_grf_uses, 0, grf_count * sizeof(*remaining_grf_uses));
+      memset(grf_active, 0, grf_count * sizeof(*grf_active));
+
       foreach_list(node, all_instructions) {
          count_remaining_grf_uses((backend_instruction *)node);
       }
    }
 
+   if (!reuse_dag) {
+      foreach_list(node, all_instructions) {
+         dag_node_count++;
+      }
+      dag_nodes = ralloc_array(mem_ctx, schedule_node *, dag_node_count);
+   }
+
+   total_time = 0;
+
    while (!next_block_header->is_tail_sentinel()) {
       /* Add things to be scheduled until we get to a new BB. */
       while (!next_block_header->is_tail_sentinel()) {
 	 backend_instruction *inst = next_block_header;
 	 next_block_header = (backend_instruction *)next_block_header->next;
 
-	 add_inst(inst);
+         /* The block's instructions are still contiguous, just in the order
+          * the last heuristic left them, so pair them up with the nodes by
+          * count.  The control flow instruction ending the block was kept
+          * last by its barrier deps, which keeps the blocks in step.
+          */
+         if (reuse_dag) {
+            inst->remove();
+            reuse_dag_node(dag_nodes[ip++]);
+         } else {
+            add_inst(inst);
+            dag_nodes[ip++] = (schedule_node *)instructions.get_tail();
+         }
+
          if (inst->is_control_flow())
 	    break;
       }
-      calculate_deps();
 
-      foreach_list(node, &instructions) {
-         schedule_node *n = (schedule_node *)node;
-         compute_delay(n);
+      if (!reuse_dag) {
+         calculate_deps();
+
+         foreach_list(node, &instructions) {
+            schedule_node *n = (schedule_node *)node;
+            compute_delay(n);
+            n->dag_parent_count = n->parent_count;
+         }
       }
 
       schedule_instructions(next_block_header);
+      total_time += time;
    }
 
+   assert(ip == dag_node_count);
+
    if (debug) {
       printf("\nInstructions after scheduling (reg_alloc %d)\n", post_reg_alloc);
       bv->dump_instructions();
@@ -1419,31 +1518,76 @@ instruction_scheduler::run(exec_list *all_instructions)
 void
 fs_visitor::schedule_instructions(instruction_scheduler_mode mode)
 {
-   int grf_count;
-   if (mode == SCHEDULE_POST)
-      grf_count = grf_used;
-   else
-      grf_count = virtual_grf_count;
+   /* Indexed by instruction_scheduler_mode. */
+   static const char *mode_name[] = {
+      "pre",
+      "pre non-lifo",
+      "pre lifo",
+      "pre critical path",
+      "post",
+   };
+   fs_instruction_scheduler *sched;
+
+   /* The pre-regalloc heuristics all work on the same instructions, so keep
+    * the scheduler (and its DAG) around until invalidate_schedule_dag().
+    * After register allocation the dependencies are between hardware
+    * registers instead, so always start from scratch.
+    */
+   if (mode == SCHEDULE_POST) {
+      invalidate_schedule_dag();
+      sched = new fs_instruction_scheduler(this, grf_used, mode);
+   } else {
+      if (!pre_ra_scheduler) {
+         pre_ra_scheduler = new fs_instruction_scheduler(this,
+                                                         virtual_grf_count,
+                                                         mode);
+      }
+      sched = pre_ra_scheduler;
+      sched->mode = mode;
+   }
 
-   fs_instruction_scheduler sched(this, grf_count, mode);
-   sched.run(&instructions);
+   sched->run(&instructions);
+
+   brw->compile_stats[dispatch_width == 8 ? BRW_STATS_FS8 :
+                      BRW_STATS_FS16].cycles = sched->total_time;
 
-   if (unlikely(INTEL_DEBUG & DEBUG_WM) && mode == SCHEDULE_POST) {
-      printf("fs%d estimated execution time: %d cycles\n",
-             dispatch_width, sched.time);
+   if (unlikely(INTEL_DEBUG & DEBUG_WM)) {
+      printf("fs%d estimated execution time (%s): %d cycles\n",
+             dispatch_width, mode_name[mode], sched->total_time);
    }
 
+   if (sched != pre_ra_scheduler)
+      delete sched;
+
    invalidate_live_intervals();
 }
 
+/**
+ * Drops the cached pre-regalloc dependency DAG.  This must be called once
+ * the instructions change in any way other than being reordered by the
+ * scheduler.
+ */
+void
+fs_visitor::invalidate_schedule_dag()
+{
+   delete pre_ra_scheduler;
+   pre_ra_scheduler = NULL;
+}
+
 void
 vec4_visitor::opt_schedule_instructions()
 {
    vec4_instruction_scheduler sched(this, prog_data->total_grf);
    sched.run(&instructions);
 
+   if (prog) {
+      int stats = prog->Target == MESA_GEOMETRY_PROGRAM ?
+         BRW_STATS_GS : BRW_STATS_VS;
+      brw->compile_stats[stats].cycles = sched.total_time;
+   }
+
    if (unlikely(debug_flag)) {
-      printf("vec4 estimated execution time: %d cycles\n", sched.time);
+      printf("vec4 estimated execution time: %d cycles\n", sched.total_time);
    }
 
    invalidate_live_intervals();
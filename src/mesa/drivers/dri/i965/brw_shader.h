@@ -63,6 +63,7 @@ enum instruction_scheduler_mode {
    SCHEDULE_PRE,
    SCHEDULE_PRE_NON_LIFO,
    SCHEDULE_PRE_LIFO,
+   SCHEDULE_PRE_CRITICAL_PATH,
    SCHEDULE_POST,
 };
 
@@ -1328,6 +1328,13 @@ vec4_generator::generate_assembly(exec_list *instructions,
 {
    brw_set_access_mode(p, BRW_ALIGN_16);
    generate_code(instructions);
+
+   if (prog) {
+      int stats = prog->Target == MESA_GEOMETRY_PROGRAM ?
+         BRW_STATS_GS : BRW_STATS_VS;
+      brw->compile_stats[stats].instructions = p->nr_insn;
+   }
+
    return brw_get_program(p, assembly_size);
 }
 
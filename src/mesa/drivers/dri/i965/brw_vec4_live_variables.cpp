@@ -121,34 +121,39 @@ vec4_live_variables::compute_live_variables()
 {
    bool cont = true;
 
+   /* livein = use | (liveout & ~def), and use never changes. */
+   for (int b = 0; b < cfg->num_blocks; b++) {
+      memcpy(bd[b].livein, bd[b].use, bitset_words * sizeof(BITSET_WORD));
+      bd[b].num_livein_words =
+         live_bitset_list_words(bd[b].livein, bd[b].livein_words,
+                                bitset_words);
+   }
+
    while (cont) {
       cont = false;
 
-      for (int b = 0; b < cfg->num_blocks; b++) {
-	 /* Update livein */
-	 for (int i = 0; i < bitset_words; i++) {
-            BITSET_WORD new_livein = (bd[b].use[i] |
-                                      (bd[b].liveout[i] & ~bd[b].def[i]));
-            if (new_livein & ~bd[b].livein[i]) {
-               bd[b].livein[i] |= new_livein;
-               cont = true;
-	    }
-	 }
-
+      /* Liveness flows backwards: see fs_live_variables. */
+      for (int b = cfg->num_blocks - 1; b >= 0; b--) {
 	 /* Update liveout */
 	 foreach_list(block_node, &cfg->blocks[b]->children) {
 	    bblock_link *link = (bblock_link *)block_node;
-	    bblock_t *block = link->block;
-
-	    for (int i = 0; i < bitset_words; i++) {
-               BITSET_WORD new_liveout = (bd[block->block_num].livein[i] &
-                                          ~bd[b].liveout[i]);
-               if (new_liveout) {
-                  bd[b].liveout[i] |= new_liveout;
-		  cont = true;
-	       }
-	    }
+	    struct block_data *child = &bd[link->block->block_num];
+
+            if (live_bitset_merge(bd[b].liveout, bd[b].liveout_words,
+                                  &bd[b].num_liveout_words,
+                                  child->livein, child->livein_words,
+                                  child->num_livein_words,
+                                  NULL, bitset_words))
+               cont = true;
 	 }
+
+	 /* Update livein */
+         if (live_bitset_merge(bd[b].livein, bd[b].livein_words,
+                               &bd[b].num_livein_words,
+                               bd[b].liveout, bd[b].liveout_words,
+                               bd[b].num_liveout_words,
+                               bd[b].def, bitset_words))
+            cont = true;
       }
    }
 }
@@ -167,6 +172,8 @@ vec4_live_variables::vec4_live_variables(vec4_visitor *v, cfg_t *cfg)
       bd[i].use = rzalloc_array(mem_ctx, BITSET_WORD, bitset_words);
       bd[i].livein = rzalloc_array(mem_ctx, BITSET_WORD, bitset_words);
       bd[i].liveout = rzalloc_array(mem_ctx, BITSET_WORD, bitset_words);
+      bd[i].livein_words = ralloc_array(mem_ctx, int, bitset_words);
+      bd[i].liveout_words = ralloc_array(mem_ctx, int, bitset_words);
    }
 
    setup_def_use();
@@ -250,16 +257,38 @@ vec4_visitor::calculate_live_intervals()
    vec4_live_variables livevars(this, &cfg);
 
    for (int b = 0; b < cfg.num_blocks; b++) {
-      for (int i = 0; i < livevars.num_vars; i++) {
-	 if (BITSET_TEST(livevars.bd[b].livein, i)) {
-	    start[i / 4] = MIN2(start[i / 4], cfg.blocks[b]->start_ip);
-	    end[i / 4] = MAX2(end[i / 4], cfg.blocks[b]->start_ip);
-	 }
+      int start_ip = cfg.blocks[b]->start_ip;
+      int end_ip = cfg.blocks[b]->end_ip;
 
-	 if (BITSET_TEST(livevars.bd[b].liveout, i)) {
-	    start[i / 4] = MIN2(start[i / 4], cfg.blocks[b]->end_ip);
-	    end[i / 4] = MAX2(end[i / 4], cfg.blocks[b]->end_ip);
-	 }
+      /* Only a few channels are live at block boundaries, so just visit the
+       * set bits of the nonzero words.
+       */
+      struct block_data *bd = &livevars.bd[b];
+
+      for (int k = 0; k < bd->num_livein_words; k++) {
+         int w = bd->livein_words[k];
+         BITSET_WORD livein = bd->livein[w];
+
+         while (livein) {
+            int i = w * BITSET_WORDBITS + ffs(livein) - 1;
+            livein &= livein - 1;
+
+	    start[i / 4] = MIN2(start[i / 4], start_ip);
+	    end[i / 4] = MAX2(end[i / 4], start_ip);
+         }
+      }
+
+      for (int k = 0; k < bd->num_liveout_words; k++) {
+         int w = bd->liveout_words[k];
+         BITSET_WORD liveout = bd->liveout[w];
+
+         while (liveout) {
+            int i = w * BITSET_WORDBITS + ffs(liveout) - 1;
+            liveout &= liveout - 1;
+
+	    start[i / 4] = MIN2(start[i / 4], end_ip);
+	    end[i / 4] = MAX2(end[i / 4], end_ip);
+         }
       }
    }
 
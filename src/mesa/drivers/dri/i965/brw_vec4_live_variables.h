@@ -25,7 +25,7 @@
  *
  */
 
-#include "main/bitset.h"
+#include "brw_live_bitset.h"
 #include "brw_vec4.h"
 
 namespace brw {
@@ -49,6 +49,17 @@ struct block_data {
 
    /** Which defs reach the exit point of the block. */
    BITSET_WORD *liveout;
+
+   /** @{
+    * Indices of the nonzero words of livein and liveout.
+    *
+    * See brw_live_bitset.h.
+    */
+   int *livein_words;
+   int num_livein_words;
+   int *liveout_words;
+   int num_liveout_words;
+   /** @} */
 };
 
 class vec4_live_variables {
@@ -0,0 +1,464 @@
+/*
+ * Copyright © 2014 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/** @file i965_compiler.cpp
+ *
+ * Standalone driver for the i965 backend compilers.
+ *
+ * Compiles and links GLSL shaders the same way the driver does, then runs
+ * the VS, GS and FS precompiles against a stub brw_context set up for the
+ * chosen PCI ID.  Programs are uploaded to a fake buffer manager, so no GPU
+ * (or even a DRM device) is needed, which makes this usable for measuring
+ * compile time and generated code on build machines.
+ *
+ * Every file in the given directories (or each file given directly) ending
+ * in .vert, .geom or .frag is compiled; files sharing a basename are linked
+ * into a single program.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "brw_fs.h"
+#include "brw_vs.h"
+#include "brw_vec4_gs.h"
+#include "intel_mipmap_tree.h"
+#include "brw_state.h"
+
+extern "C" {
+#include "drivers/common/driverfuncs.h"
+#include "main/context.h"
+#include "main/framebuffer.h"
+#include "main/shaderobj.h"
+}
+
+#include "glsl/program.h"
+#include "program/ir_to_mesa.h"
+
+/* Size of the fake aperture backing the program cache. */
+#define APERTURE_SIZE (64 * 1024 * 1024)
+
+static int devid = 0x0162; /* Ivybridge GT2 desktop */
+static int iterations = 1;
+
+static const struct option compiler_opts[] = {
+   { "devid",      required_argument, NULL, 'd' },
+   { "iterations", required_argument, NULL, 'n' },
+   { NULL, 0, NULL, 0 }
+};
+
+static void
+usage_fail(const char *name)
+{
+   printf("usage: %s [options] <directory | file.vert | file.geom | "
+          "file.frag>...\n"
+          "\n"
+          "Possible options are:\n"
+          "    --devid <pci id>     device to compile for (default 0x%04x)\n"
+          "    --iterations <n>     compile each program n times\n",
+          name, devid);
+   exit(EXIT_FAILURE);
+}
+
+static char *
+load_text_file(void *mem_ctx, const char *file_name)
+{
+   FILE *fp = fopen(file_name, "rb");
+   if (!fp)
+      return NULL;
+
+   fseek(fp, 0L, SEEK_END);
+   size_t size = ftell(fp);
+   fseek(fp, 0L, SEEK_SET);
+
+   char *text = (char *) ralloc_size(mem_ctx, size + 1);
+   if (fread(text, 1, size, fp) != size) {
+      ralloc_free(text);
+      text = NULL;
+   } else {
+      text[size] = '\0';
+   }
+
+   fclose(fp);
+   return text;
+}
+
+static GLenum
+shader_type_for_file(const char *file_name)
+{
+   const char *ext = strrchr(file_name, '.');
+
+   if (!ext)
+      return GL_NONE;
+   if (strcmp(ext, ".vert") == 0)
+      return GL_VERTEX_SHADER;
+   if (strcmp(ext, ".geom") == 0)
+      return GL_GEOMETRY_SHADER;
+   if (strcmp(ext, ".frag") == 0)
+      return GL_FRAGMENT_SHADER;
+   return GL_NONE;
+}
+
+/**
+ * Sets up the bits of brw_context and gl_context that the compiler looks at.
+ *
+ * This mirrors brwCreateContext(), minus everything that needs a screen or
+ * talks to the kernel.  Limits are the ones brw_initialize_context_constants()
+ * and intelInitExtensions() would pick for the generation.
+ */
+static struct brw_context *
+create_context(const struct brw_device_info *devinfo)
+{
+   struct brw_context *brw = rzalloc(NULL, struct brw_context);
+   struct gl_context *ctx = &brw->ctx;
+   struct dd_function_table functions;
+   struct gl_config visual;
+
+   brw->gen = devinfo->gen;
+   brw->gt = devinfo->gt;
+   brw->is_g4x = devinfo->is_g4x;
+   brw->is_baytrail = devinfo->is_baytrail;
+   brw->is_haswell = devinfo->is_haswell;
+   brw->has_llc = devinfo->has_llc;
+   brw->has_pln = devinfo->has_pln;
+   brw->has_compr4 = devinfo->has_compr4;
+   brw->has_negative_rhw_bug = devinfo->has_negative_rhw_bug;
+   brw->needs_unlit_centroid_workaround =
+      devinfo->needs_unlit_centroid_workaround;
+   brw->max_vs_threads = devinfo->max_vs_threads;
+   brw->max_gs_threads = devinfo->max_gs_threads;
+   brw->max_wm_threads = devinfo->max_wm_threads;
+
+   brw->bufmgr = drm_intel_bufmgr_fake_init(-1, 0, malloc(APERTURE_SIZE),
+                                            APERTURE_SIZE, NULL);
+
+   /* Linking and precompiling happen explicitly in compile_program(). */
+   brw->precompile = false;
+
+   _mesa_init_driver_functions(&functions);
+   brwInitFragProgFuncs(&functions);
+
+   memset(&visual, 0, sizeof visual);
+   if (!_mesa_initialize_context(ctx, API_OPENGL_COMPAT, &visual, NULL,
+                                 &functions)) {
+      fprintf(stderr, "failed to initialize the GL context\n");
+      exit(EXIT_FAILURE);
+   }
+
+   brw_process_intel_debug_variable(brw);
+
+   if (brw->gen >= 7)
+      ctx->Const.GLSLVersion = 330;
+   else if (brw->gen >= 6)
+      ctx->Const.GLSLVersion = 140;
+   else
+      ctx->Const.GLSLVersion = 120;
+
+   ctx->Extensions.ARB_ES3_compatibility = brw->gen >= 6;
+   ctx->Extensions.ARB_shading_language_packing = brw->gen >= 7;
+   ctx->Extensions.ARB_texture_gather = brw->gen >= 7;
+   ctx->Extensions.ARB_shader_atomic_counters = brw->gen >= 7;
+   ctx->Extensions.EXT_shader_integer_mix = ctx->Const.GLSLVersion >= 130;
+   ctx->Extensions.ARB_texture_query_levels = ctx->Const.GLSLVersion >= 130;
+
+   ctx->Const.MaxDrawBuffers = BRW_MAX_DRAW_BUFFERS;
+   ctx->Const.MaxTextureCoordUnits = 8;
+   for (int i = 0; i < MESA_SHADER_STAGES; i++)
+      ctx->Const.Program[i].MaxTextureImageUnits = BRW_MAX_TEX_UNIT;
+   if (brw->gen < 7)
+      ctx->Const.Program[MESA_SHADER_GEOMETRY].MaxTextureImageUnits = 0;
+   ctx->Const.MaxCombinedTextureImageUnits = 3 * BRW_MAX_TEX_UNIT;
+   if (brw->gen >= 5 || brw->is_g4x)
+      ctx->Const.MaxClipPlanes = 8;
+
+   if (brw->gen >= 6) {
+      ctx->Const.MaxVarying = 32;
+      ctx->Const.Program[MESA_SHADER_VERTEX].MaxOutputComponents = 128;
+      ctx->Const.Program[MESA_SHADER_GEOMETRY].MaxInputComponents = 64;
+      ctx->Const.Program[MESA_SHADER_GEOMETRY].MaxOutputComponents = 128;
+      ctx->Const.Program[MESA_SHADER_FRAGMENT].MaxInputComponents = 128;
+   }
+
+   ctx->Const.NativeIntegers = true;
+   ctx->Const.UniformBooleanTrue = 1;
+
+   for (int i = 0; i < MESA_SHADER_STAGES; i++) {
+      ctx->ShaderCompilerOptions[i].MaxIfDepth = brw->gen < 6 ? 16 : UINT_MAX;
+      ctx->ShaderCompilerOptions[i].EmitCondCodes = true;
+      ctx->ShaderCompilerOptions[i].EmitNoNoise = true;
+      ctx->ShaderCompilerOptions[i].EmitNoMainReturn = true;
+      ctx->ShaderCompilerOptions[i].EmitNoIndirectInput = true;
+      ctx->ShaderCompilerOptions[i].EmitNoIndirectOutput = true;
+      ctx->ShaderCompilerOptions[i].EmitNoIndirectUniform =
+         (i == MESA_SHADER_FRAGMENT);
+      ctx->ShaderCompilerOptions[i].EmitNoIndirectTemp =
+         (i == MESA_SHADER_FRAGMENT);
+      ctx->ShaderCompilerOptions[i].LowerClipDistance = true;
+   }
+   ctx->ShaderCompilerOptions[MESA_SHADER_VERTEX].PreferDP4 = true;
+
+   brw_init_caches(brw);
+
+   /* The FS precompile looks at the drawable for gl_FragCoord setup. */
+   struct gl_framebuffer *fb = _mesa_create_framebuffer(&visual);
+   _mesa_make_current(ctx, fb, fb);
+
+   return brw;
+}
+
+struct program_stats {
+   const char *name;
+   gl_shader_stage stage;
+   bool (*precompile)(struct gl_context *, struct gl_shader_program *);
+   enum brw_compile_stats_type stats[2];
+};
+
+static const struct program_stats stages[] = {
+   { "VS", MESA_SHADER_VERTEX, brw_vs_precompile,
+     { BRW_STATS_VS, BRW_STATS_COUNT } },
+   { "GS", MESA_SHADER_GEOMETRY, brw_gs_precompile,
+     { BRW_STATS_GS, BRW_STATS_COUNT } },
+   { "FS", MESA_SHADER_FRAGMENT, brw_fs_precompile,
+     { BRW_STATS_FS8, BRW_STATS_FS16 } },
+};
+
+/**
+ * Compiles, links and precompiles the shaders in \p files[0..count), which
+ * all share a basename, printing one line of statistics per native program.
+ */
+static bool
+compile_program(struct brw_context *brw, const char *name,
+                char **files, unsigned count)
+{
+   struct gl_context *ctx = &brw->ctx;
+   struct gl_shader_program *prog = ctx->Driver.NewShaderProgram(ctx, 0);
+   double link_time = 0, stage_time[ARRAY_SIZE(stages)];
+   bool success = true;
+
+   memset(stage_time, 0, sizeof(stage_time));
+
+   prog->Shaders = rzalloc_array(prog, struct gl_shader *, count);
+   for (unsigned i = 0; i < count; i++) {
+      GLenum type = shader_type_for_file(files[i]);
+      struct gl_shader *shader = ctx->Driver.NewShader(ctx, 0, type);
+
+      prog->Shaders[prog->NumShaders++] = shader;
+
+      shader->Source = load_text_file(shader, files[i]);
+      if (!shader->Source) {
+         fprintf(stderr, "%s: could not read file\n", files[i]);
+         success = false;
+         goto done;
+      }
+   }
+
+   for (int n = 0; n < iterations && success; n++) {
+      double start = get_time();
+
+      for (unsigned i = 0; i < prog->NumShaders; i++) {
+         _mesa_glsl_compile_shader(ctx, prog->Shaders[i], false, false);
+         if (!prog->Shaders[i]->CompileStatus) {
+            fprintf(stderr, "%s: compile failed:\n%s\n", files[i],
+                    prog->Shaders[i]->InfoLog);
+            success = false;
+            goto done;
+         }
+      }
+
+      _mesa_glsl_link_shader(ctx, prog);
+      if (!prog->LinkStatus) {
+         fprintf(stderr, "%s: link failed:\n%s\n", name, prog->InfoLog);
+         success = false;
+         goto done;
+      }
+
+      link_time += get_time() - start;
+
+      memset(brw->compile_stats, 0, sizeof(brw->compile_stats));
+
+      for (unsigned s = 0; s < ARRAY_SIZE(stages); s++) {
+         if (!prog->_LinkedShaders[stages[s].stage])
+            continue;
+
+         start = get_time();
+         success = stages[s].precompile(ctx, prog) && success;
+         stage_time[s] += get_time() - start;
+      }
+   }
+
+   printf("%s: link %.3f ms\n", name, link_time * 1000 / iterations);
+
+   for (unsigned s = 0; s < ARRAY_SIZE(stages); s++) {
+      if (!prog->_LinkedShaders[stages[s].stage])
+         continue;
+
+      printf("%s %s: compile %.3f ms", name, stages[s].name,
+             stage_time[s] * 1000 / iterations);
+
+      for (int i = 0; i < 2; i++) {
+         if (stages[s].stats[i] == BRW_STATS_COUNT)
+            break;
+
+         const struct brw_compile_stats *stats =
+            &brw->compile_stats[stages[s].stats[i]];
+
+         if (stats->instructions == 0)
+            continue;
+
+         if (stages[s].stats[i] == BRW_STATS_FS8)
+            printf(", SIMD8");
+         else if (stages[s].stats[i] == BRW_STATS_FS16)
+            printf(", SIMD16");
+         printf(" %u instructions, %u cycles",
+                stats->instructions, stats->cycles);
+      }
+      printf("%s\n", success ? "" : " (failed)");
+   }
+
+done:
+   _mesa_reference_shader_program(ctx, &prog, NULL);
+
+   return success;
+}
+
+static int
+compare_strings(const void *a, const void *b)
+{
+   return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+/** Appends the shader sources named by \p path to \p files. */
+static void
+collect_files(void *mem_ctx, const char *path, char ***files,
+              unsigned *count)
+{
+   struct stat st;
+
+   if (stat(path, &st) != 0) {
+      fprintf(stderr, "%s: no such file or directory\n", path);
+      exit(EXIT_FAILURE);
+   }
+
+   if (!S_ISDIR(st.st_mode)) {
+      if (shader_type_for_file(path) == GL_NONE) {
+         fprintf(stderr, "%s: unknown shader type\n", path);
+         exit(EXIT_FAILURE);
+      }
+      *files = reralloc(mem_ctx, *files, char *, *count + 1);
+      (*files)[(*count)++] = ralloc_strdup(mem_ctx, path);
+      return;
+   }
+
+   DIR *dir = opendir(path);
+   struct dirent *entry;
+
+   if (!dir) {
+      fprintf(stderr, "%s: %s\n", path, strerror(errno));
+      return;
+   }
+
+   while ((entry = readdir(dir)) != NULL) {
+      if (shader_type_for_file(entry->d_name) == GL_NONE)
+         continue;
+
+      *files = reralloc(mem_ctx, *files, char *, *count + 1);
+      (*files)[(*count)++] = ralloc_asprintf(mem_ctx, "%s/%s",
+                                             path, entry->d_name);
+   }
+
+   closedir(dir);
+}
+
+int
+main(int argc, char **argv)
+{
+   int c, idx = 0;
+
+   while ((c = getopt_long(argc, argv, "", compiler_opts, &idx)) != -1) {
+      switch (c) {
+      case 'd':
+         devid = strtol(optarg, NULL, 0);
+         break;
+      case 'n':
+         iterations = MAX2(1, atoi(optarg));
+         break;
+      default:
+         usage_fail(argv[0]);
+      }
+   }
+
+   if (argc <= optind)
+      usage_fail(argv[0]);
+
+   const struct brw_device_info *devinfo = brw_get_device_info(devid);
+   if (!devinfo) {
+      fprintf(stderr, "Unknown PCI ID 0x%x\n", devid);
+      return EXIT_FAILURE;
+   }
+
+   void *mem_ctx = ralloc_context(NULL);
+   char **files = NULL;
+   unsigned count = 0;
+
+   for (; optind < argc; optind++)
+      collect_files(mem_ctx, argv[optind], &files, &count);
+
+   qsort(files, count, sizeof(*files), compare_strings);
+
+   struct brw_context *brw = create_context(devinfo);
+   int status = EXIT_SUCCESS;
+   double start = get_time();
+
+   /* Sorting puts files with a common basename next to each other. */
+   for (unsigned first = 0; first < count; ) {
+      const char *ext = strrchr(files[first], '.');
+      size_t base_len = ext - files[first];
+      unsigned last = first + 1;
+
+      while (last < count &&
+             strncmp(files[first], files[last], base_len) == 0 &&
+             files[last][base_len] == '.')
+         last++;
+
+      char *name = ralloc_strndup(mem_ctx, files[first], base_len);
+      if (!compile_program(brw, name, &files[first], last - first))
+         status = EXIT_FAILURE;
+
+      first = last;
+   }
+
+   printf("total: %.3f ms for %u shaders\n",
+          (get_time() - start) * 1000, count);
+
+   ralloc_free(mem_ctx);
+   _mesa_glsl_release_types();
+   _mesa_glsl_release_builtin_functions();
+
+   return status;
+}
@@ -50,6 +50,7 @@ extern int INTEL_DEBUG;
 #define DEBUG_VERTS	  0x8000
 #define DEBUG_DRI         0x10000
 #define DEBUG_SF          0x20000
+#define DEBUG_LINEAR_RA   0x80000
 #define DEBUG_STATS       0x100000
 #define DEBUG_WM          0x400000
 #define DEBUG_URB         0x800000
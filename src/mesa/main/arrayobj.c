@@ -425,7 +425,7 @@ bind_vertex_array(struct gl_context *ctx, GLuint id, GLboolean genRequired)
       }
    }
 
-   ctx->NewState |= _NEW_ARRAY;
+   FLUSH_VERTICES(ctx, _NEW_ARRAY);
    _mesa_reference_array_object(ctx, &ctx->Array.ArrayObj, newObj);
 
    /* Pass BindVertexArray call to device driver */
@@ -950,6 +950,12 @@ bind_buffer_object(struct gl_context *ctx, GLenum target, GLuint buffer)
          return;
    }
    
+   /* Pixel packing writes to the buffer behind our back, so its contents
+    * can't be cached by the VBO module.
+    */
+   if (target == GL_PIXEL_PACK_BUFFER)
+      newBufObj->GPUWritten = GL_TRUE;
+
    /* bind new buffer */
    _mesa_reference_buffer_object(ctx, bindTarget, newBufObj);
 
@@ -1297,6 +1303,7 @@ _mesa_BufferData(GLenum target, GLsizeiptrARB size,
    FLUSH_VERTICES(ctx, _NEW_BUFFER_OBJECT);
 
    bufObj->Written = GL_TRUE;
+   _mesa_bufferobj_invalidate_index_ranges(bufObj);
 
 #ifdef VBO_DEBUG
    printf("glBufferDataARB(%u, sz %ld, from %p, usage 0x%x)\n",
@@ -1332,7 +1339,10 @@ _mesa_BufferSubData(GLenum target, GLintptrARB offset,
    if (size == 0)
       return;
 
+   FLUSH_VERTICES(ctx, 0);
+
    bufObj->Written = GL_TRUE;
+   _mesa_bufferobj_invalidate_index_ranges(bufObj);
 
    ASSERT(ctx->Driver.BufferSubData);
    ctx->Driver.BufferSubData( ctx, offset, size, data, bufObj );
@@ -1354,6 +1364,8 @@ _mesa_GetBufferSubData(GLenum target, GLintptrARB offset,
       return;
    }
 
+   FLUSH_VERTICES(ctx, 0);
+
    ASSERT(ctx->Driver.GetBufferSubData);
    ctx->Driver.GetBufferSubData( ctx, offset, size, data, bufObj );
 }
@@ -1395,6 +1407,10 @@ _mesa_ClearBufferData(GLenum target, GLenum internalformat, GLenum format,
       return;
    }
 
+   FLUSH_VERTICES(ctx, 0);
+
+   _mesa_bufferobj_invalidate_index_ranges(bufObj);
+
    if (data == NULL) {
       /* clear to zeros, per the spec */
       ctx->Driver.ClearBufferSubData(ctx, 0, bufObj->Size,
@@ -1446,6 +1462,10 @@ _mesa_ClearBufferSubData(GLenum target, GLenum internalformat,
       return;
    }
 
+   FLUSH_VERTICES(ctx, 0);
+
+   _mesa_bufferobj_invalidate_index_ranges(bufObj);
+
    if (data == NULL) {
       /* clear to zeros, per the spec */
       ctx->Driver.ClearBufferSubData(ctx, offset, size,
@@ -1513,6 +1533,8 @@ _mesa_MapBuffer(GLenum target, GLenum access)
       return NULL;
    }
 
+   FLUSH_VERTICES(ctx, 0);
+
    ASSERT(ctx->Driver.MapBufferRange);
    map = ctx->Driver.MapBufferRange(ctx, 0, bufObj->Size, accessFlags, bufObj);
    if (!map) {
@@ -1530,8 +1552,10 @@ _mesa_MapBuffer(GLenum target, GLenum access)
       bufObj->AccessFlags = accessFlags;
    }
 
-   if (access == GL_WRITE_ONLY_ARB || access == GL_READ_WRITE_ARB)
+   if (access == GL_WRITE_ONLY_ARB || access == GL_READ_WRITE_ARB) {
       bufObj->Written = GL_TRUE;
+      _mesa_bufferobj_invalidate_index_ranges(bufObj);
+   }
 
 #ifdef VBO_DEBUG
    printf("glMapBufferARB(%u, sz %ld, access 0x%x)\n",
@@ -1822,6 +1846,10 @@ _mesa_CopyBufferSubData(GLenum readTarget, GLenum writeTarget,
       }
    }
 
+   FLUSH_VERTICES(ctx, 0);
+
+   _mesa_bufferobj_invalidate_index_ranges(dst);
+
    ctx->Driver.CopyBufferSubData(ctx, src, dst, readOffset, writeOffset, size);
 }
 
@@ -1935,6 +1963,11 @@ _mesa_MapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length,
       return bufObj->Pointer;
    }
 
+   FLUSH_VERTICES(ctx, 0);
+
+   if (access & GL_MAP_WRITE_BIT)
+      _mesa_bufferobj_invalidate_index_ranges(bufObj);
+
    ASSERT(ctx->Driver.MapBufferRange);
    map = ctx->Driver.MapBufferRange(ctx, offset, length, access, bufObj);
    if (!map) {
@@ -2495,6 +2528,7 @@ set_atomic_buffer_binding(struct gl_context *ctx,
    }
 
    _mesa_reference_buffer_object(ctx, &ctx->AtomicBuffer, bufObj);
+   bufObj->GPUWritten = GL_TRUE;
 
    binding = &ctx->AtomicBufferBindings[index];
    if (binding->BufferObject == bufObj &&
@@ -29,6 +29,7 @@
 #define BUFFEROBJ_H
 
 #include <stdbool.h>
+#include <string.h>
 #include "mtypes.h"
 
 
@@ -56,6 +57,19 @@ _mesa_is_bufferobj(const struct gl_buffer_object *obj)
 }
 
 
+/**
+ * Forget the min/max indices cached for the buffer, because its contents
+ * are about to change.
+ */
+static inline void
+_mesa_bufferobj_invalidate_index_ranges(struct gl_buffer_object *obj)
+{
+   _glthread_LOCK_MUTEX(obj->Mutex);
+   memset(obj->IndexRanges, 0, sizeof(obj->IndexRanges));
+   _glthread_UNLOCK_MUTEX(obj->Mutex);
+}
+
+
 extern void
 _mesa_init_buffer_objects(struct gl_context *ctx);
 
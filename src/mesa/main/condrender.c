@@ -98,6 +98,8 @@ _mesa_BeginConditionalRender(GLuint queryId, GLenum mode)
       return;
    }
 
+   FLUSH_VERTICES(ctx, 0);
+
    ctx->Query.CondRenderQuery = q;
    ctx->Query.CondRenderMode = mode;
 
@@ -103,6 +103,7 @@
 #include "light.h"
 #include "lines.h"
 #include "macros.h"
+#include "marshal.h"
 #include "matrix.h"
 #include "multisample.h"
 #include "performance_monitor.h"
@@ -168,6 +169,7 @@ _mesa_notifySwapBuffers(struct gl_context *ctx)
 {
    if (MESA_VERBOSE & VERBOSE_SWAPBUFFERS)
       _mesa_debug(ctx, "SwapBuffers\n");
+   _mesa_glthread_finish(ctx);
    FLUSH_CURRENT( ctx, 0 );
    if (ctx->Driver.Flush) {
       ctx->Driver.Flush(ctx);
@@ -1164,6 +1166,8 @@ _mesa_free_context_data( struct gl_context *ctx )
       _mesa_make_current(ctx, NULL, NULL);
    }
 
+   _mesa_glthread_destroy(ctx);
+
    /* unreference WinSysDraw/Read buffers */
    _mesa_reference_framebuffer(&ctx->WinSysDrawBuffer, NULL);
    _mesa_reference_framebuffer(&ctx->WinSysReadBuffer, NULL);
@@ -1457,6 +1461,14 @@ _mesa_make_current( struct gl_context *newCtx,
    if (MESA_VERBOSE & VERBOSE_API)
       _mesa_debug(newCtx, "_mesa_make_current()\n");
 
+   /* Queued commands must execute before the contexts are flushed, unbound
+    * or have their framebuffers changed.
+    */
+   if (curCtx)
+      _mesa_glthread_finish(curCtx);
+   if (newCtx && newCtx != curCtx)
+      _mesa_glthread_finish(newCtx);
+
    /* Check that the context's and framebuffer's visuals are compatible.
     */
    if (newCtx && drawBuffer && newCtx->WinSysDrawBuffer != drawBuffer) {
@@ -1488,7 +1500,8 @@ _mesa_make_current( struct gl_context *newCtx,
       _glapi_set_dispatch(NULL);  /* none current */
    }
    else {
-      _glapi_set_dispatch(newCtx->CurrentDispatch);
+      _glapi_set_dispatch(newCtx->GLThread ? newCtx->MarshalExec
+                                           : newCtx->CurrentDispatch);
 
       if (drawBuffer && readBuffer) {
          ASSERT(_mesa_is_winsys_fbo(drawBuffer));
@@ -1539,6 +1552,13 @@ _mesa_make_current( struct gl_context *newCtx,
 	    _mesa_print_info(newCtx);
 	 }
 
+         /* Marshal GL calls to a separate thread. */
+         if (_mesa_getenv("MESA_GLTHREAD")) {
+            _mesa_glthread_init(newCtx);
+            if (newCtx->GLThread)
+               _glapi_set_dispatch(newCtx->MarshalExec);
+         }
+
 	 newCtx->FirstTimeCurrent = GL_FALSE;
       }
    }
@@ -0,0 +1,740 @@
+/*
+ * Copyright © 2013 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file marshal.c
+ * The GL thread which executes marshalled commands, and the application
+ * thread's shadow of the client vertex array state.
+ */
+
+#include "glheader.h"
+#include "context.h"
+#include "hash.h"
+#include "imports.h"
+#include "marshal.h"
+#include "mtypes.h"
+
+
+#ifdef HAVE_PTHREAD
+
+static void
+glthread_execute_batch(struct gl_context *ctx,
+                       const struct glthread_batch *batch)
+{
+   const uint8_t *buffer = (const uint8_t *) batch->buffer;
+   size_t pos = 0;
+
+   while (pos < batch->used)
+      pos += _mesa_unmarshal_dispatch_cmd(ctx, buffer + pos);
+
+   assert(pos == batch->used);
+}
+
+
+static void *
+glthread_worker(void *data)
+{
+   struct gl_context *ctx = data;
+   struct glthread_state *glthread = ctx->GLThread;
+
+   /* The context is current in both threads.  The application thread only
+    * touches it while this one is idle.
+    */
+   _glapi_check_multithread();
+   _glapi_set_context(ctx);
+   _glapi_set_dispatch(ctx->CurrentDispatch);
+
+   pthread_mutex_lock(&glthread->mutex);
+   for (;;) {
+      const struct glthread_batch *batch;
+
+      while (glthread->executed == glthread->submitted &&
+             !glthread->shutdown)
+         pthread_cond_wait(&glthread->cond, &glthread->mutex);
+
+      if (glthread->executed == glthread->submitted)
+         break;
+
+      batch = &glthread->batches[glthread->executed % MARSHAL_NUM_BATCHES];
+      pthread_mutex_unlock(&glthread->mutex);
+
+      glthread_execute_batch(ctx, batch);
+
+      pthread_mutex_lock(&glthread->mutex);
+      glthread->executed++;
+      pthread_cond_broadcast(&glthread->cond);
+   }
+   pthread_mutex_unlock(&glthread->mutex);
+
+   return NULL;
+}
+
+
+static void
+init_vao(struct glthread_vao *vao, GLuint name)
+{
+   GLuint i;
+
+   memset(vao, 0, sizeof(*vao));
+   vao->Name = name;
+   for (i = 0; i < VERT_ATTRIB_MAX; i++)
+      vao->AttribBinding[i] = i;
+}
+
+
+static void
+delete_vao_cb(GLuint key, void *data, void *userData)
+{
+   free(data);
+}
+
+
+/**
+ * Start marshalling GL calls for \p ctx to a new thread.  On failure the
+ * context is left executing calls directly.
+ */
+void
+_mesa_glthread_init(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = calloc(1, sizeof(*glthread));
+
+   if (!glthread)
+      return;
+
+   ctx->MarshalExec = _mesa_create_marshal_table();
+   glthread->VAOs = _mesa_NewHashTable();
+   glthread->Buffers = _mesa_NewHashTable();
+   if (!ctx->MarshalExec || !glthread->VAOs || !glthread->Buffers)
+      goto fail;
+
+   init_vao(&glthread->DefaultVAO, 0);
+   glthread->CurrentVAO = &glthread->DefaultVAO;
+   glthread->batch = &glthread->batches[0];
+
+   pthread_mutex_init(&glthread->mutex, NULL);
+   pthread_cond_init(&glthread->cond, NULL);
+
+   ctx->GLThread = glthread;
+   if (pthread_create(&glthread->thread, NULL, glthread_worker, ctx) != 0) {
+      ctx->GLThread = NULL;
+      pthread_cond_destroy(&glthread->cond);
+      pthread_mutex_destroy(&glthread->mutex);
+      goto fail;
+   }
+
+   return;
+
+fail:
+   if (glthread->VAOs)
+      _mesa_DeleteHashTable(glthread->VAOs);
+   if (glthread->Buffers)
+      _mesa_DeleteHashTable(glthread->Buffers);
+   free(ctx->MarshalExec);
+   ctx->MarshalExec = NULL;
+   free(glthread);
+}
+
+
+/**
+ * Execute any pending commands, stop the GL thread, and switch the context
+ * back to executing calls directly.
+ */
+void
+_mesa_glthread_destroy(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (!glthread)
+      return;
+
+   _mesa_glthread_flush_batch(ctx);
+
+   pthread_mutex_lock(&glthread->mutex);
+   glthread->shutdown = GL_TRUE;
+   pthread_cond_broadcast(&glthread->cond);
+   pthread_mutex_unlock(&glthread->mutex);
+
+   pthread_join(glthread->thread, NULL);
+   pthread_cond_destroy(&glthread->cond);
+   pthread_mutex_destroy(&glthread->mutex);
+
+   _mesa_HashDeleteAll(glthread->VAOs, delete_vao_cb, NULL);
+   _mesa_DeleteHashTable(glthread->VAOs);
+   _mesa_DeleteHashTable(glthread->Buffers);
+   free(glthread);
+   ctx->GLThread = NULL;
+
+   if (_mesa_get_current_context() == ctx)
+      _glapi_set_dispatch(ctx->CurrentDispatch);
+
+   free(ctx->MarshalExec);
+   ctx->MarshalExec = NULL;
+}
+
+
+/**
+ * Hand the batch being recorded to the GL thread, and start recording into
+ * the next one, waiting for the GL thread to finish with it if necessary.
+ */
+void
+_mesa_glthread_flush_batch(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (!glthread || glthread->batch->used == 0)
+      return;
+
+   pthread_mutex_lock(&glthread->mutex);
+   glthread->submitted++;
+   pthread_cond_broadcast(&glthread->cond);
+   while (glthread->submitted - glthread->executed >= MARSHAL_NUM_BATCHES)
+      pthread_cond_wait(&glthread->cond, &glthread->mutex);
+   pthread_mutex_unlock(&glthread->mutex);
+
+   glthread->batch =
+      &glthread->batches[glthread->submitted % MARSHAL_NUM_BATCHES];
+   glthread->batch->used = 0;
+}
+
+
+/**
+ * Wait until every command recorded so far has been executed, after which
+ * the application thread may use the context directly.
+ */
+void
+_mesa_glthread_finish(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   /* Driver code executing on the GL thread may end up here (e.g. through
+    * a flush); there's nothing to wait for in that case.
+    */
+   if (!glthread || pthread_equal(pthread_self(), glthread->thread))
+      return;
+
+   _mesa_glthread_flush_batch(ctx);
+
+   pthread_mutex_lock(&glthread->mutex);
+   while (glthread->executed != glthread->submitted)
+      pthread_cond_wait(&glthread->cond, &glthread->mutex);
+   pthread_mutex_unlock(&glthread->mutex);
+}
+
+#else /* HAVE_PTHREAD */
+
+void
+_mesa_glthread_init(struct gl_context *ctx)
+{
+}
+
+void
+_mesa_glthread_destroy(struct gl_context *ctx)
+{
+}
+
+void
+_mesa_glthread_flush_batch(struct gl_context *ctx)
+{
+}
+
+void
+_mesa_glthread_finish(struct gl_context *ctx)
+{
+}
+
+#endif /* HAVE_PTHREAD */
+
+
+/**
+ * Called after executing a call on the application thread, since the call
+ * may have installed one of the context's dispatch tables there.
+ */
+void
+_mesa_glthread_restore_dispatch(struct gl_context *ctx)
+{
+   if (_glapi_get_dispatch() != ctx->MarshalExec)
+      _glapi_set_dispatch(ctx->MarshalExec);
+}
+
+
+/**
+ * Recompute the mask of enabled arrays which aren't sourced from a buffer
+ * object.
+ */
+static void
+update_user_pointers(struct glthread_vao *vao)
+{
+   GLuint i;
+
+   vao->UserPointerMask = 0;
+   for (i = 0; i < VERT_ATTRIB_MAX; i++) {
+      if ((vao->Enabled & BITFIELD64_BIT(i)) &&
+          vao->BindingBuffer[vao->AttribBinding[i]] == 0)
+         vao->UserPointerMask |= BITFIELD64_BIT(i);
+   }
+}
+
+
+static void
+set_enabled(struct glthread_vao *vao, gl_vert_attrib attrib, GLboolean state)
+{
+   if (state)
+      vao->Enabled |= BITFIELD64_BIT(attrib);
+   else
+      vao->Enabled &= ~BITFIELD64_BIT(attrib);
+}
+
+
+static void
+set_pointer(struct glthread_state *glthread, gl_vert_attrib attrib)
+{
+   struct glthread_vao *vao = glthread->CurrentVAO;
+
+   /* Setting a pointer also resets the attribute's vertex buffer binding */
+   vao->AttribBinding[attrib] = attrib;
+   vao->BindingBuffer[attrib] = glthread->CurrentArrayBuffer;
+}
+
+
+static struct glthread_vao *
+lookup_vao(struct glthread_state *glthread, GLuint name)
+{
+   struct glthread_vao *vao;
+
+   if (name == 0)
+      return &glthread->DefaultVAO;
+
+   vao = _mesa_HashLookup(glthread->VAOs, name);
+   if (!vao) {
+      vao = malloc(sizeof(*vao));
+      if (!vao)
+         return &glthread->DefaultVAO;
+      init_vao(vao, name);
+      _mesa_HashInsert(glthread->VAOs, name, vao);
+   }
+
+   return vao;
+}
+
+
+/**
+ * Whether binding buffer \p name is known to succeed.  Outside core
+ * profiles binding any name creates the buffer; in core profiles the name
+ * must have been seen bound before.
+ */
+static GLboolean
+is_valid_buffer(const struct gl_context *ctx, GLuint name)
+{
+   return name == 0 || ctx->API != API_OPENGL_CORE ||
+          _mesa_HashLookup(ctx->GLThread->Buffers, name) != NULL;
+}
+
+
+static void
+add_valid_buffer(struct glthread_state *glthread, GLuint name)
+{
+   /* Only the key matters; the name itself is a non-NULL value. */
+   if (name != 0)
+      _mesa_HashInsert(glthread->Buffers, name, (void *) (uintptr_t) name);
+}
+
+
+/**
+ * Reload the shadowed bindings from the context, after a bind whose
+ * result couldn't be predicted was executed synchronously.
+ */
+void
+_mesa_glthread_update_bindings(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   const struct gl_array_object *obj = ctx->Array.ArrayObj;
+   struct glthread_vao *vao = lookup_vao(glthread, obj->Name);
+   GLuint i;
+
+   glthread->CurrentVAO = vao;
+   glthread->CurrentArrayBuffer = ctx->Array.ArrayBufferObj->Name;
+   vao->ElementArrayBuffer = obj->ElementArrayBufferObj->Name;
+   for (i = 0; i < VERT_ATTRIB_MAX; i++)
+      vao->BindingBuffer[i] = obj->VertexBinding[i].BufferObj->Name;
+   update_user_pointers(vao);
+
+   add_valid_buffer(glthread, glthread->CurrentArrayBuffer);
+   add_valid_buffer(glthread, vao->ElementArrayBuffer);
+   for (i = 0; i < VERT_ATTRIB_MAX; i++)
+      add_valid_buffer(glthread, vao->BindingBuffer[i]);
+}
+
+
+GLboolean
+_mesa_glthread_BindBuffer(struct gl_context *ctx, GLenum target,
+                          GLuint buffer)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   switch (target) {
+   case GL_ARRAY_BUFFER:
+      if (!is_valid_buffer(ctx, buffer))
+         return GL_FALSE;
+      glthread->CurrentArrayBuffer = buffer;
+      break;
+   case GL_ELEMENT_ARRAY_BUFFER:
+      if (!is_valid_buffer(ctx, buffer))
+         return GL_FALSE;
+      glthread->CurrentVAO->ElementArrayBuffer = buffer;
+      break;
+   }
+
+   return GL_TRUE;
+}
+
+
+void
+_mesa_glthread_DeleteBuffers(struct gl_context *ctx, GLsizei n,
+                             const GLuint *buffers)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct glthread_vao *vao = glthread->CurrentVAO;
+   GLsizei i;
+   GLuint j;
+
+   if (n < 0 || !buffers)
+      return;
+
+   /* Deleting a buffer unbinds it from the current VAO, leaving the
+    * affected arrays pointing at client memory.
+    */
+   for (i = 0; i < n; i++) {
+      const GLuint id = buffers[i];
+
+      if (id == 0)
+         continue;
+
+      _mesa_HashRemove(glthread->Buffers, id);
+
+      if (glthread->CurrentArrayBuffer == id)
+         glthread->CurrentArrayBuffer = 0;
+      if (vao->ElementArrayBuffer == id)
+         vao->ElementArrayBuffer = 0;
+      for (j = 0; j < VERT_ATTRIB_MAX; j++) {
+         if (vao->BindingBuffer[j] == id)
+            vao->BindingBuffer[j] = 0;
+      }
+   }
+
+   update_user_pointers(vao);
+}
+
+
+/**
+ * \param gen_required  whether \p array must name an existing VAO, as for
+ *                      glBindVertexArray, rather than being created
+ */
+GLboolean
+_mesa_glthread_BindVertexArray(struct gl_context *ctx, GLuint array,
+                               GLboolean gen_required)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   /* VAOs are only added to the table once they have been bound, so an
+    * unknown name may not exist.
+    */
+   if (gen_required && array != 0 &&
+       !_mesa_HashLookup(glthread->VAOs, array))
+      return GL_FALSE;
+
+   glthread->CurrentVAO = lookup_vao(glthread, array);
+   return GL_TRUE;
+}
+
+
+void
+_mesa_glthread_DeleteVertexArrays(struct gl_context *ctx, GLsizei n,
+                                  const GLuint *arrays)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   GLsizei i;
+
+   if (n < 0 || !arrays)
+      return;
+
+   for (i = 0; i < n; i++) {
+      struct glthread_vao *vao;
+
+      if (arrays[i] == 0)
+         continue;
+
+      vao = _mesa_HashLookup(glthread->VAOs, arrays[i]);
+      if (!vao)
+         continue;
+
+      if (glthread->CurrentVAO == vao)
+         glthread->CurrentVAO = &glthread->DefaultVAO;
+
+      _mesa_HashRemove(glthread->VAOs, arrays[i]);
+      free(vao);
+   }
+}
+
+
+void
+_mesa_glthread_ClientActiveTexture(struct gl_context *ctx, GLenum texture)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   const GLuint unit = texture - GL_TEXTURE0;
+
+   if (unit < MAX_TEXTURE_COORD_UNITS)
+      glthread->ClientActiveTexture = unit;
+}
+
+
+void
+_mesa_glthread_ClientState(struct gl_context *ctx, GLenum cap,
+                           GLboolean state)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   gl_vert_attrib attrib;
+
+   switch (cap) {
+   case GL_VERTEX_ARRAY:
+      attrib = VERT_ATTRIB_POS;
+      break;
+   case GL_NORMAL_ARRAY:
+      attrib = VERT_ATTRIB_NORMAL;
+      break;
+   case GL_COLOR_ARRAY:
+      attrib = VERT_ATTRIB_COLOR0;
+      break;
+   case GL_INDEX_ARRAY:
+      attrib = VERT_ATTRIB_COLOR_INDEX;
+      break;
+   case GL_TEXTURE_COORD_ARRAY:
+      attrib = VERT_ATTRIB_TEX(glthread->ClientActiveTexture);
+      break;
+   case GL_EDGE_FLAG_ARRAY:
+      attrib = VERT_ATTRIB_EDGEFLAG;
+      break;
+   case GL_FOG_COORDINATE_ARRAY_EXT:
+      attrib = VERT_ATTRIB_FOG;
+      break;
+   case GL_SECONDARY_COLOR_ARRAY_EXT:
+      attrib = VERT_ATTRIB_COLOR1;
+      break;
+   case GL_POINT_SIZE_ARRAY_OES:
+      attrib = VERT_ATTRIB_POINT_SIZE;
+      break;
+   default:
+      /* Not a vertex array */
+      return;
+   }
+
+   set_enabled(glthread->CurrentVAO, attrib, state);
+   update_user_pointers(glthread->CurrentVAO);
+}
+
+
+void
+_mesa_glthread_VertexAttribArray(struct gl_context *ctx, GLuint index,
+                                 GLboolean state)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (index >= VERT_ATTRIB_GENERIC_MAX)
+      return;
+
+   set_enabled(glthread->CurrentVAO, VERT_ATTRIB_GENERIC(index), state);
+   update_user_pointers(glthread->CurrentVAO);
+}
+
+
+void
+_mesa_glthread_AttribPointer(struct gl_context *ctx, gl_vert_attrib attrib)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   set_pointer(glthread, attrib);
+   update_user_pointers(glthread->CurrentVAO);
+}
+
+
+void
+_mesa_glthread_TexCoordPointer(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   _mesa_glthread_AttribPointer(ctx,
+                                VERT_ATTRIB_TEX(glthread->ClientActiveTexture));
+}
+
+
+void
+_mesa_glthread_VertexAttribPointer(struct gl_context *ctx, GLuint index)
+{
+   if (index < VERT_ATTRIB_GENERIC_MAX)
+      _mesa_glthread_AttribPointer(ctx, VERT_ATTRIB_GENERIC(index));
+}
+
+
+/**
+ * Mirrors the array enables and pointers set by _mesa_InterleavedArrays().
+ */
+void
+_mesa_glthread_InterleavedArrays(struct gl_context *ctx, GLenum format)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct glthread_vao *vao = glthread->CurrentVAO;
+   const gl_vert_attrib tex = VERT_ATTRIB_TEX(glthread->ClientActiveTexture);
+   GLboolean tflag, cflag, nflag;
+
+   switch (format) {
+   case GL_V2F:
+   case GL_V3F:
+      tflag = GL_FALSE;  cflag = GL_FALSE;  nflag = GL_FALSE;
+      break;
+   case GL_C4UB_V2F:
+   case GL_C4UB_V3F:
+   case GL_C3F_V3F:
+      tflag = GL_FALSE;  cflag = GL_TRUE;  nflag = GL_FALSE;
+      break;
+   case GL_N3F_V3F:
+      tflag = GL_FALSE;  cflag = GL_FALSE;  nflag = GL_TRUE;
+      break;
+   case GL_C4F_N3F_V3F:
+      tflag = GL_FALSE;  cflag = GL_TRUE;  nflag = GL_TRUE;
+      break;
+   case GL_T2F_V3F:
+   case GL_T4F_V4F:
+      tflag = GL_TRUE;  cflag = GL_FALSE;  nflag = GL_FALSE;
+      break;
+   case GL_T2F_C4UB_V3F:
+   case GL_T2F_C3F_V3F:
+      tflag = GL_TRUE;  cflag = GL_TRUE;  nflag = GL_FALSE;
+      break;
+   case GL_T2F_N3F_V3F:
+      tflag = GL_TRUE;  cflag = GL_FALSE;  nflag = GL_TRUE;
+      break;
+   case GL_T2F_C4F_N3F_V3F:
+   case GL_T4F_C4F_N3F_V4F:
+      tflag = GL_TRUE;  cflag = GL_TRUE;  nflag = GL_TRUE;
+      break;
+   default:
+      /* Invalid format; no state changes */
+      return;
+   }
+
+   set_enabled(vao, VERT_ATTRIB_EDGEFLAG, GL_FALSE);
+   set_enabled(vao, VERT_ATTRIB_COLOR_INDEX, GL_FALSE);
+   set_enabled(vao, VERT_ATTRIB_COLOR1, GL_FALSE);
+   set_enabled(vao, VERT_ATTRIB_FOG, GL_FALSE);
+
+   set_enabled(vao, tex, tflag);
+   if (tflag)
+      set_pointer(glthread, tex);
+
+   set_enabled(vao, VERT_ATTRIB_COLOR0, cflag);
+   if (cflag)
+      set_pointer(glthread, VERT_ATTRIB_COLOR0);
+
+   set_enabled(vao, VERT_ATTRIB_NORMAL, nflag);
+   if (nflag)
+      set_pointer(glthread, VERT_ATTRIB_NORMAL);
+
+   set_enabled(vao, VERT_ATTRIB_POS, GL_TRUE);
+   set_pointer(glthread, VERT_ATTRIB_POS);
+
+   update_user_pointers(vao);
+}
+
+
+GLboolean
+_mesa_glthread_BindVertexBuffer(struct gl_context *ctx, GLuint bindingindex,
+                                GLuint buffer)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (bindingindex >= VERT_ATTRIB_GENERIC_MAX)
+      return GL_TRUE;
+
+   if (!is_valid_buffer(ctx, buffer))
+      return GL_FALSE;
+
+   glthread->CurrentVAO->BindingBuffer[VERT_ATTRIB_GENERIC(bindingindex)] =
+      buffer;
+   update_user_pointers(glthread->CurrentVAO);
+   return GL_TRUE;
+}
+
+
+void
+_mesa_glthread_VertexAttribBinding(struct gl_context *ctx,
+                                   GLuint attribindex, GLuint bindingindex)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (attribindex >= VERT_ATTRIB_GENERIC_MAX ||
+       bindingindex >= VERT_ATTRIB_GENERIC_MAX)
+      return;
+
+   glthread->CurrentVAO->AttribBinding[VERT_ATTRIB_GENERIC(attribindex)] =
+      VERT_ATTRIB_GENERIC(bindingindex);
+   update_user_pointers(glthread->CurrentVAO);
+}
+
+
+void
+_mesa_glthread_PushClientAttrib(struct gl_context *ctx, GLbitfield mask)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct glthread_client_attrib *attrib;
+
+   if (glthread->ClientAttribStackDepth >= MAX_CLIENT_ATTRIB_STACK_DEPTH)
+      return;
+
+   attrib = &glthread->ClientAttribStack[glthread->ClientAttribStackDepth++];
+   attrib->Valid = (mask & GL_CLIENT_VERTEX_ARRAY_BIT) != 0;
+   if (attrib->Valid) {
+      attrib->VAO = *glthread->CurrentVAO;
+      attrib->ArrayBuffer = glthread->CurrentArrayBuffer;
+      attrib->ClientActiveTexture = glthread->ClientActiveTexture;
+   }
+}
+
+
+void
+_mesa_glthread_PopClientAttrib(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct glthread_client_attrib *attrib;
+
+   if (glthread->ClientAttribStackDepth == 0)
+      return;
+
+   attrib = &glthread->ClientAttribStack[--glthread->ClientAttribStackDepth];
+   if (!attrib->Valid)
+      return;
+
+   /* Like the GL, rebind the saved VAO and restore its contents */
+   glthread->CurrentVAO = lookup_vao(glthread, attrib->VAO.Name);
+   *glthread->CurrentVAO = attrib->VAO;
+   glthread->CurrentArrayBuffer = attrib->ArrayBuffer;
+   glthread->ClientActiveTexture = attrib->ClientActiveTexture;
+}
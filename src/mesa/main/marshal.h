@@ -0,0 +1,290 @@
+/*
+ * Copyright © 2013 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file marshal.h
+ * GL command marshalling.
+ *
+ * When enabled, the application's GL calls go through a dispatch table
+ * (generated by gl_marshal.py) that records each call as a command in a
+ * batch buffer.  Full batches are handed to a separate thread that
+ * executes them on the context's real dispatch table.  Calls which return
+ * data, or which read client memory whose size can't be determined up
+ * front, wait for the thread to go idle and are executed directly.
+ *
+ * To decide whether a draw reads client vertex arrays or indices, the
+ * application thread keeps its own shadow copy of the buffer bindings and
+ * array enables, updated by the hooks declared below.  Binds of names that
+ * may not exist are executed synchronously instead, and the shadow copy is
+ * reloaded from the context afterwards.
+ */
+
+#ifndef MARSHAL_H
+#define MARSHAL_H
+
+#include <stdint.h>
+#include "glheader.h"
+#include "macros.h"
+#include "mtypes.h"
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+struct _glapi_table;
+struct _mesa_HashTable;
+
+/** Number of batch buffers cycled between the two threads */
+#define MARSHAL_NUM_BATCHES 4
+
+/** Size of each batch buffer, in bytes */
+#define MARSHAL_BATCH_SIZE (64 * 1024)
+
+/** Largest command that is marshalled; bigger calls execute synchronously */
+#define MARSHAL_MAX_CMD_SIZE (8 * 1024)
+
+
+/**
+ * Header of every marshalled command.  The command data follows, padded
+ * to a multiple of 8 bytes.
+ */
+struct marshal_cmd_base
+{
+   /** Type of command, from enum marshal_dispatch_cmd_id */
+   uint16_t cmd_id;
+
+   /** Size of the command in bytes, including this header */
+   uint16_t cmd_size;
+};
+
+
+struct glthread_batch
+{
+   /** Bytes of commands recorded in buffer */
+   size_t used;
+
+   /** The commands; uint64_t keeps them 8-byte aligned */
+   uint64_t buffer[MARSHAL_BATCH_SIZE / 8];
+};
+
+
+/**
+ * The application thread's view of a vertex array object.
+ */
+struct glthread_vao
+{
+   GLuint Name;
+   GLuint ElementArrayBuffer;
+
+   /** Mask of VERT_BIT_x for enabled arrays */
+   GLbitfield64 Enabled;
+
+   /** Mask of enabled arrays that source client memory */
+   GLbitfield64 UserPointerMask;
+
+   /** Vertex buffer binding index used by each attribute */
+   GLubyte AttribBinding[VERT_ATTRIB_MAX];
+
+   /** Buffer object name bound to each vertex buffer binding index */
+   GLuint BindingBuffer[VERT_ATTRIB_MAX];
+};
+
+
+/** Client vertex array state saved by glPushClientAttrib */
+struct glthread_client_attrib
+{
+   GLboolean Valid;
+   struct glthread_vao VAO;
+   GLuint ArrayBuffer;
+   GLuint ClientActiveTexture;
+};
+
+
+struct glthread_state
+{
+#ifdef HAVE_PTHREAD
+   pthread_t thread;
+
+   /** Protects submitted, executed and shutdown */
+   pthread_mutex_t mutex;
+
+   /** Signalled when a batch is submitted or finishes executing */
+   pthread_cond_t cond;
+#endif
+
+   /** Counts of batches handed to and completed by the GL thread */
+   unsigned submitted;
+   unsigned executed;
+
+   GLboolean shutdown;
+
+   struct glthread_batch batches[MARSHAL_NUM_BATCHES];
+
+   /** Batch being recorded by the application thread */
+   struct glthread_batch *batch;
+
+   /* Shadowed client state, only accessed by the application thread. */
+   GLuint CurrentArrayBuffer;
+   GLuint ClientActiveTexture;
+
+   struct glthread_vao DefaultVAO;
+   struct glthread_vao *CurrentVAO;
+
+   /** Vertex array objects which have been bound, by name */
+   struct _mesa_HashTable *VAOs;
+
+   /** Names of buffer objects which are known to exist */
+   struct _mesa_HashTable *Buffers;
+
+   GLuint ClientAttribStackDepth;
+   struct glthread_client_attrib ClientAttribStack[MAX_CLIENT_ATTRIB_STACK_DEPTH];
+};
+
+
+extern void
+_mesa_glthread_init(struct gl_context *ctx);
+
+extern void
+_mesa_glthread_destroy(struct gl_context *ctx);
+
+extern void
+_mesa_glthread_flush_batch(struct gl_context *ctx);
+
+extern void
+_mesa_glthread_finish(struct gl_context *ctx);
+
+extern void
+_mesa_glthread_restore_dispatch(struct gl_context *ctx);
+
+
+/**
+ * Reserve space for a command of \p size bytes in the current batch,
+ * submitting the batch first if it is full.
+ */
+static inline void *
+_mesa_glthread_allocate_command(struct gl_context *ctx,
+                                uint16_t cmd_id, size_t size)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct marshal_cmd_base *cmd_base;
+
+   size = ALIGN(size, 8);
+   assert(size <= MARSHAL_MAX_CMD_SIZE);
+
+   if (glthread->batch->used + size > MARSHAL_BATCH_SIZE)
+      _mesa_glthread_flush_batch(ctx);
+
+   cmd_base = (struct marshal_cmd_base *)
+      ((uint8_t *) glthread->batch->buffer + glthread->batch->used);
+   glthread->batch->used += size;
+   cmd_base->cmd_id = cmd_id;
+   cmd_base->cmd_size = size;
+   return cmd_base;
+}
+
+
+/**
+ * Whether a non-indexed draw would read vertex data from client memory.
+ */
+static inline bool
+_mesa_glthread_has_user_arrays(const struct gl_context *ctx)
+{
+   return ctx->GLThread->CurrentVAO->UserPointerMask != 0;
+}
+
+/**
+ * Whether an indexed draw would read its indices from client memory.
+ */
+static inline bool
+_mesa_glthread_has_user_indices(const struct gl_context *ctx)
+{
+   return ctx->GLThread->CurrentVAO->ElementArrayBuffer == 0;
+}
+
+
+extern void
+_mesa_glthread_update_bindings(struct gl_context *ctx);
+
+extern GLboolean
+_mesa_glthread_BindBuffer(struct gl_context *ctx, GLenum target,
+                          GLuint buffer);
+
+extern void
+_mesa_glthread_DeleteBuffers(struct gl_context *ctx, GLsizei n,
+                             const GLuint *buffers);
+
+extern GLboolean
+_mesa_glthread_BindVertexArray(struct gl_context *ctx, GLuint array,
+                               GLboolean gen_required);
+
+extern void
+_mesa_glthread_DeleteVertexArrays(struct gl_context *ctx, GLsizei n,
+                                  const GLuint *arrays);
+
+extern void
+_mesa_glthread_ClientActiveTexture(struct gl_context *ctx, GLenum texture);
+
+extern void
+_mesa_glthread_ClientState(struct gl_context *ctx, GLenum cap,
+                           GLboolean state);
+
+extern void
+_mesa_glthread_VertexAttribArray(struct gl_context *ctx, GLuint index,
+                                 GLboolean state);
+
+extern void
+_mesa_glthread_AttribPointer(struct gl_context *ctx, gl_vert_attrib attrib);
+
+extern void
+_mesa_glthread_TexCoordPointer(struct gl_context *ctx);
+
+extern void
+_mesa_glthread_VertexAttribPointer(struct gl_context *ctx, GLuint index);
+
+extern void
+_mesa_glthread_InterleavedArrays(struct gl_context *ctx, GLenum format);
+
+extern GLboolean
+_mesa_glthread_BindVertexBuffer(struct gl_context *ctx, GLuint bindingindex,
+                                GLuint buffer);
+
+extern void
+_mesa_glthread_VertexAttribBinding(struct gl_context *ctx,
+                                   GLuint attribindex, GLuint bindingindex);
+
+extern void
+_mesa_glthread_PushClientAttrib(struct gl_context *ctx, GLbitfield mask);
+
+extern void
+_mesa_glthread_PopClientAttrib(struct gl_context *ctx);
+
+
+/* In marshal_generated.c */
+
+extern size_t
+_mesa_unmarshal_dispatch_cmd(struct gl_context *ctx, const void *cmd);
+
+extern struct _glapi_table *
+_mesa_create_marshal_table(void);
+
+#endif /* MARSHAL_H */
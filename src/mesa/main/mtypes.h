@@ -84,6 +84,7 @@ struct gl_program_parameter_list;
 struct set;
 struct set_entry;
 struct vbo_context;
+struct glthread_state;
 /*@}*/
 
 
@@ -1435,6 +1436,24 @@ struct gl_viewport_attrib
 };
 
 
+/**
+ * Min/max index found in a range of an index buffer, cached so that static
+ * index buffers don't get scanned on every glDrawElements without a range.
+ * See vbo_get_minmax_index().
+ */
+struct gl_index_range
+{
+   GLintptr Offset;        /**< Byte offset of the first index */
+   GLuint Count;           /**< Number of indices, or 0 if unused */
+   GLenum Type;            /**< GL_UNSIGNED_BYTE/SHORT/INT */
+   GLboolean Restart;      /**< Was primitive restart enabled? */
+   GLuint RestartIndex;
+   GLuint Min, Max;
+};
+
+#define MAX_INDEX_RANGES 8
+
+
 /**
  * GL_ARB_vertex/pixel_buffer_object buffer object
  */
@@ -1457,6 +1476,12 @@ struct gl_buffer_object
    GLboolean DeletePending;   /**< true if buffer object is removed from the hash */
    GLboolean Written;   /**< Ever written to? (for debugging) */
    GLboolean Purgeable; /**< Is the buffer purgeable under memory pressure? */
+
+   /** Index range cache, cleared whenever the buffer contents change. */
+   /*@{*/
+   struct gl_index_range IndexRanges[MAX_INDEX_RANGES];
+   GLboolean GPUWritten; /**< May be written by the GPU, so never cached */
+   /*@}*/
 };
 
 
@@ -3900,8 +3925,16 @@ struct gl_context
     * re-set on glXMakeCurrent().
     */
    struct _glapi_table *CurrentDispatch;
+   /**
+    * The dispatch table installed for the application when GL calls are
+    * marshalled to a separate thread (see GLThread).
+    */
+   struct _glapi_table *MarshalExec;
    /*@}*/
 
+   /** GL command marshalling state, or NULL if calls execute directly */
+   struct glthread_state *GLThread;
+
    struct gl_config Visual;
    struct gl_framebuffer *DrawBuffer;	/**< buffer for writing */
    struct gl_framebuffer *ReadBuffer;	/**< buffer for reading */
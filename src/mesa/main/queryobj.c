@@ -483,6 +483,8 @@ _mesa_QueryCounter(GLuint id, GLenum target)
    q->Ready = GL_FALSE;
    q->EverBound = GL_TRUE;
 
+   FLUSH_VERTICES(ctx, 0);
+
    if (ctx->Driver.QueryCounter) {
       ctx->Driver.QueryCounter(ctx, q);
    } else {
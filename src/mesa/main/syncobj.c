@@ -286,6 +286,7 @@ _mesa_FenceSync(GLenum condition, GLbitfield flags)
       syncObj->Flags = flags;
       syncObj->StatusFlag = 0;
 
+      FLUSH_VERTICES(ctx, 0);
       ctx->Driver.FenceSync(ctx, syncObj, condition, flags);
 
       _glthread_LOCK_MUTEX(ctx->Shared->Mutex);
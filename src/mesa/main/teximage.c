@@ -4192,6 +4192,12 @@ texbufferrange(struct gl_context *ctx, GLenum target, GLenum internalFormat,
 
    texObj = _mesa_get_current_tex_object(ctx, target);
 
+   /* Shaders may write to the buffer through image units, so the VBO
+    * module can't cache its contents.
+    */
+   if (bufObj)
+      bufObj->GPUWritten = GL_TRUE;
+
    _mesa_lock_texture(ctx, texObj);
    {
       _mesa_reference_buffer_object(ctx, &texObj->BufferObject, bufObj);
@@ -49,5 +49,7 @@ _mesa_TextureBarrierNV(void)
 {
    GET_CURRENT_CONTEXT(ctx);
 
+   FLUSH_VERTICES(ctx, 0);
+
    ctx->Driver.TextureBarrier(ctx);
 }
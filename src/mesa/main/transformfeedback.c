@@ -511,6 +511,7 @@ bind_buffer_range(struct gl_context *ctx, GLuint index,
                                  bufObj);
 
    obj->BufferNames[index] = bufObj->Name;
+   bufObj->GPUWritten = GL_TRUE;
 
    obj->Offset[index] = offset;
    obj->RequestedSize[index] = size;
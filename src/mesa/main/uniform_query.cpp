@@ -580,6 +580,18 @@ _mesa_propagate_uniforms_to_driver_storage(struct gl_uniform_storage *uni,
 	 assert(!"Should not get here.");
 	 break;
       }
+
+      if (store->params) {
+	 const uint8_t *values = (uint8_t *) store->params->ParameterValues;
+	 const unsigned start = (uint8_t *) store->data
+	    + array_index * store->element_stride - values;
+	 const unsigned end = start + count * store->element_stride;
+	 const unsigned param_size = sizeof(store->params->ParameterValues[0]);
+	 const unsigned first = start / param_size;
+	 const unsigned last = (end + param_size - 1) / param_size;
+
+	 _mesa_mark_parameters_dirty(store->params, first, last - first);
+      }
    }
 }
 
@@ -97,13 +97,15 @@ _mesa_update_shader_textures_used(struct gl_shader_program *shProg,
  * \param format         Conversion from native format to driver format
  *                       required by the driver.
  * \param data           Location to dump the data.
+ * \param params         Parameter list containing \p data, or NULL.
  */
 void
 _mesa_uniform_attach_driver_storage(struct gl_uniform_storage *uni,
 				    unsigned element_stride,
 				    unsigned vector_stride,
 				    enum gl_uniform_driver_format format,
-				    void *data)
+				    void *data,
+				    struct gl_program_parameter_list *params)
 {
    uni->driver_storage =
       realloc(uni->driver_storage,
@@ -114,6 +116,7 @@ _mesa_uniform_attach_driver_storage(struct gl_uniform_storage *uni,
    uni->driver_storage[uni->num_driver_storage].vector_stride = vector_stride;
    uni->driver_storage[uni->num_driver_storage].format = (uint8_t) format;
    uni->driver_storage[uni->num_driver_storage].data = data;
+   uni->driver_storage[uni->num_driver_storage].params = params;
 
    uni->num_driver_storage++;
 }
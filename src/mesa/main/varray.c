@@ -329,6 +329,9 @@ update_array_format(struct gl_context *ctx,
    elementSize = _mesa_bytes_per_vertex_attrib(size, type);
    assert(elementSize != -1);
 
+   /* Draws held back by the vbo module still read the old format. */
+   FLUSH_VERTICES(ctx, _NEW_ARRAY);
+
    array = &ctx->Array.ArrayObj->VertexAttrib[attrib];
    array->Size = size;
    array->Type = type;
@@ -339,7 +342,6 @@ update_array_format(struct gl_context *ctx,
    array->_ElementSize = elementSize;
 
    ctx->Array.ArrayObj->NewArrays |= VERT_BIT(attrib);
-   ctx->NewState |= _NEW_ARRAY;
 
    return true;
 }
@@ -413,6 +415,8 @@ update_array(struct gl_context *ctx,
       return;
    }
 
+   FLUSH_VERTICES(ctx, 0);
+
    if (!update_array_format(ctx, func, attrib, legalTypesMask, sizeMin,
                             sizeMax, size, type, normalized, integer, 0)) {
       return;
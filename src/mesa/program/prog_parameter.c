@@ -185,6 +185,8 @@ _mesa_add_parameter(struct gl_program_parameter_list *paramList,
             paramList->Parameters[oldNum].StateIndexes[i] = state[i];
       }
 
+      _mesa_mark_parameters_dirty(paramList, oldNum, sz4);
+
       return (GLint) oldNum;
    }
 }
@@ -264,6 +266,7 @@ _mesa_add_typed_unnamed_constant(struct gl_program_parameter_list *paramList,
             GLuint swz = p->Size; /* 1, 2 or 3 for Y, Z, W */
             pVal[p->Size] = values[0];
             p->Size++;
+            _mesa_mark_parameters_dirty(paramList, pos, 1);
             *swizzleOut = MAKE_SWIZZLE4(swz, swz, swz, swz);
             return pos;
          }
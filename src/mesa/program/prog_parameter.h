@@ -87,6 +87,11 @@ struct gl_program_parameter_list
    gl_constant_value (*ParameterValues)[4]; /**< Array [Size] of constant[4] */
    GLbitfield StateFlags; /**< _NEW_* flags indicating which state changes
                                might invalidate ParameterValues[] */
+   /**
+    * Range [DirtyStart, DirtyEnd) of ParameterValues[] written since the
+    * driver last consumed them.  Empty if DirtyStart >= DirtyEnd.
+    */
+   GLuint DirtyStart, DirtyEnd;
 };
 
 
@@ -112,6 +117,39 @@ _mesa_num_parameters(const struct gl_program_parameter_list *list)
    return list ? list->NumParameters : 0;
 }
 
+/**
+ * Extend the list's dirty range to include parameters [first, first+count).
+ */
+static inline void
+_mesa_mark_parameters_dirty(struct gl_program_parameter_list *list,
+                            GLuint first, GLuint count)
+{
+   const GLuint end = first + count;
+
+   if (list->DirtyStart >= list->DirtyEnd) {
+      list->DirtyStart = first;
+      list->DirtyEnd = end;
+   }
+   else {
+      if (first < list->DirtyStart)
+         list->DirtyStart = first;
+      if (end > list->DirtyEnd)
+         list->DirtyEnd = end;
+   }
+}
+
+static inline GLboolean
+_mesa_parameters_dirty(const struct gl_program_parameter_list *list)
+{
+   return list->DirtyStart < list->DirtyEnd;
+}
+
+static inline void
+_mesa_clear_parameters_dirty(struct gl_program_parameter_list *list)
+{
+   list->DirtyStart = list->DirtyEnd = 0;
+}
+
 extern GLint
 _mesa_add_parameter(struct gl_program_parameter_list *paramList,
                     gl_register_file type, const char *name,
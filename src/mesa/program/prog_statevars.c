@@ -1096,9 +1096,20 @@ _mesa_load_state_parameters(struct gl_context *ctx,
 
    for (i = 0; i < paramList->NumParameters; i++) {
       if (paramList->Parameters[i].Type == PROGRAM_STATE_VAR) {
+         gl_constant_value value[4];
+
+         /* Only values which actually change dirty the list, so that
+          * drivers can skip re-uploading unchanged constants.  Some states
+          * don't write all four components.
+          */
+         COPY_4V(value, paramList->ParameterValues[i]);
          _mesa_fetch_state(ctx,
 			   paramList->Parameters[i].StateIndexes,
-                           &paramList->ParameterValues[i][0].f);
+                           &value[0].f);
+         if (memcmp(value, paramList->ParameterValues[i], sizeof(value))) {
+            COPY_4V(paramList->ParameterValues[i], value);
+            _mesa_mark_parameters_dirty(paramList, i, 1);
+         }
       }
    }
 }
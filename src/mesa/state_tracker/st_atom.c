@@ -30,6 +30,7 @@
 #include "main/context.h"
 
 #include "pipe/p_defines.h"
+#include "hud/hud_timer.h"
 #include "st_context.h"
 #include "st_atom.h"
 #include "st_cb_bitmap.h"
@@ -153,6 +154,7 @@ static void check_attrib_edgeflag(struct st_context *st)
 void st_validate_state( struct st_context *st )
 {
    struct st_state_flags *state = &st->dirty;
+   int64_t start;
    GLuint i;
 
    /* Get Mesa driver state. */
@@ -171,6 +173,8 @@ void st_validate_state( struct st_context *st )
    if (state->st == 0)
       return;
 
+   start = hud_timer_begin();
+
    /*printf("%s %x/%x\n", __FUNCTION__, state->mesa, state->st);*/
 
 #ifdef DEBUG
@@ -224,6 +228,8 @@ void st_validate_state( struct st_context *st )
    }
 
    memset(state, 0, sizeof(*state));
+
+   hud_timer_end(HUD_TIMER_VALIDATE, start);
 }
 
 
@@ -73,6 +73,29 @@ void st_upload_constants( struct st_context *st,
        */
       _mesa_load_state_parameters(st->ctx, params);
 
+      /* _NEW_PROGRAM_CONSTANTS is raised for uniform changes in any stage.
+       * Skip the upload if this stage's parameters are already bound and
+       * none of them changed.  When the programs are shared, another
+       * context may have consumed the dirty range, so always upload then.
+       */
+      if (st->state.constants[shader_type].ptr == params->ParameterValues &&
+          st->state.constants[shader_type].size == paramBytes &&
+          !_mesa_parameters_dirty(params) &&
+          st->ctx->Shared->RefCount == 1) {
+         st->constbuf_stats.skipped++;
+         return;
+      }
+
+      if (st->state.constants[shader_type].ptr != params->ParameterValues) {
+         st->constbuf_stats.dirty_bytes += paramBytes;
+      }
+      else if (_mesa_parameters_dirty(params)) {
+         st->constbuf_stats.dirty_bytes +=
+            (params->DirtyEnd - params->DirtyStart) * sizeof(GLfloat) * 4;
+      }
+      st->constbuf_stats.uploaded_bytes += paramBytes;
+      _mesa_clear_parameters_dirty(params);
+
       /* We always need to get a new buffer, to keep the drivers simple and
        * avoid gratuitous rendering synchronization.
        * Let's use a user buffer to avoid an unnecessary copy.
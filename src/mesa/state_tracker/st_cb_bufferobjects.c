@@ -42,6 +42,7 @@
 
 #include "pipe/p_context.h"
 #include "pipe/p_defines.h"
+#include "hud/hud_timer.h"
 #include "util/u_inlines.h"
 
 
@@ -100,6 +101,7 @@ st_bufferobj_subdata(struct gl_context *ctx,
 		     const GLvoid * data, struct gl_buffer_object *obj)
 {
    struct st_buffer_object *st_obj = st_buffer_object(obj);
+   int64_t start;
 
    /* we may be called from VBO code, so double-check params here */
    ASSERT(offset >= 0);
@@ -128,9 +130,11 @@ st_bufferobj_subdata(struct gl_context *ctx,
     * just queue the upload as dma rather than mapping the underlying
     * buffer directly.
     */
+   start = hud_timer_begin();
    pipe_buffer_write(st_context(ctx)->pipe,
 		     st_obj->buffer,
 		     offset, size, data);
+   hud_timer_end(HUD_TIMER_MAP, start);
 }
 
 
@@ -144,6 +148,7 @@ st_bufferobj_get_subdata(struct gl_context *ctx,
                          GLvoid * data, struct gl_buffer_object *obj)
 {
    struct st_buffer_object *st_obj = st_buffer_object(obj);
+   int64_t start;
 
    /* we may be called from VBO code, so double-check params here */
    ASSERT(offset >= 0);
@@ -158,8 +163,10 @@ st_bufferobj_get_subdata(struct gl_context *ctx,
       return;
    }
 
+   start = hud_timer_begin();
    pipe_buffer_read(st_context(ctx)->pipe, st_obj->buffer,
                     offset, size, data);
+   hud_timer_end(HUD_TIMER_MAP, start);
 }
 
 
@@ -283,6 +290,7 @@ st_bufferobj_map_range(struct gl_context *ctx,
    struct pipe_context *pipe = st_context(ctx)->pipe;
    struct st_buffer_object *st_obj = st_buffer_object(obj);
    enum pipe_transfer_usage flags = 0x0;
+   int64_t start;
 
    if (access & GL_MAP_WRITE_BIT)
       flags |= PIPE_TRANSFER_WRITE;
@@ -317,11 +325,13 @@ st_bufferobj_map_range(struct gl_context *ctx,
    assert(offset < obj->Size);
    assert(offset + length <= obj->Size);
 
+   start = hud_timer_begin();
    obj->Pointer = pipe_buffer_map_range(pipe,
                                         st_obj->buffer,
                                         offset, length,
                                         flags,
                                         &st_obj->transfer);
+   hud_timer_end(HUD_TIMER_MAP, start);
    if (obj->Pointer) {
       obj->Offset = offset;
       obj->Length = length;
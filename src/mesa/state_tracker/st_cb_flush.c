@@ -43,7 +43,9 @@
 #include "pipe/p_context.h"
 #include "pipe/p_defines.h"
 #include "pipe/p_screen.h"
+#include "hud/hud_timer.h"
 #include "util/u_gen_mipmap.h"
+#include "util/u_upload_mgr.h"
 
 
 /** Check if we have a front color buffer and if it's been drawn to. */
@@ -79,12 +81,34 @@ void st_flush(struct st_context *st,
               struct pipe_fence_handle **fence,
               unsigned flags)
 {
+   struct pipe_screen *screen = st->pipe->screen;
+   struct pipe_fence_handle *upload_fence = NULL;
+   int64_t start;
+
    FLUSH_VERTICES(st->ctx, 0);
    FLUSH_CURRENT(st->ctx, 0);
 
    st_flush_bitmap_cache(st);
 
-   st->pipe->flush(st->pipe, fence, flags);
+   /* The upload managers need a fence to know when they can reuse the
+    * space handed out so far.
+    */
+   start = hud_timer_begin();
+   st->pipe->flush(st->pipe, &upload_fence, flags);
+   hud_timer_end(HUD_TIMER_FLUSH, start);
+
+   if (upload_fence) {
+      u_upload_fence(st->uploader, upload_fence);
+      if (st->indexbuf_uploader)
+         u_upload_fence(st->indexbuf_uploader, upload_fence);
+      if (st->constbuf_uploader)
+         u_upload_fence(st->constbuf_uploader, upload_fence);
+   }
+
+   if (fence)
+      screen->fence_reference(screen, fence, upload_fence);
+   if (upload_fence)
+      screen->fence_reference(screen, &upload_fence, NULL);
 }
 
 
@@ -98,8 +122,11 @@ void st_finish( struct st_context *st )
    st_flush(st, &fence, 0);
 
    if(fence) {
+      int64_t start = hud_timer_begin();
+
       st->pipe->screen->fence_finish(st->pipe->screen, fence,
                                      PIPE_TIMEOUT_INFINITE);
+      hud_timer_end(HUD_TIMER_FLUSH, start);
       st->pipe->screen->fence_reference(st->pipe->screen, &fence, NULL);
    }
 }
@@ -34,6 +34,7 @@
 #include "main/macros.h"
 #include "pipe/p_context.h"
 #include "pipe/p_screen.h"
+#include "hud/hud_timer.h"
 #include "st_context.h"
 #include "st_cb_syncobj.h"
 
@@ -97,10 +98,16 @@ static void st_client_wait_sync(struct gl_context *ctx,
    /* We don't care about GL_SYNC_FLUSH_COMMANDS_BIT, because flush is
     * already called when creating a fence. */
 
-   if (so->fence &&
-       screen->fence_finish(screen, so->fence, timeout)) {
-      screen->fence_reference(screen, &so->fence, NULL);
-      so->b.StatusFlag = GL_TRUE;
+   if (so->fence) {
+      int64_t start = hud_timer_begin();
+      boolean signalled = screen->fence_finish(screen, so->fence, timeout);
+
+      hud_timer_end(HUD_TIMER_FLUSH, start);
+
+      if (signalled) {
+         screen->fence_reference(screen, &so->fence, NULL);
+         so->b.StatusFlag = GL_TRUE;
+      }
    }
 }
 
@@ -74,6 +74,9 @@
 
 DEBUG_GET_ONCE_BOOL_OPTION(mesa_mvp_dp4, "MESA_MVP_DP4", FALSE)
 
+/** Size of the ring buffers used by the upload managers */
+#define ST_UPLOAD_RING_SIZE (1024 * 1024)
+
 
 /**
  * Called via ctx->Driver.UpdateState()
@@ -144,6 +147,18 @@ st_create_context_priv( struct gl_context *ctx, struct pipe_context *pipe,
                                               PIPE_BIND_CONSTANT_BUFFER);
    }
 
+   /* Recycle upload space once the GPU is done with it, rather than
+    * allocating a new buffer each time one fills up.  st_flush() passes
+    * the fences along.
+    */
+   if (screen->fence_signalled) {
+      u_upload_enable_ring(st->uploader, ST_UPLOAD_RING_SIZE);
+      if (st->indexbuf_uploader)
+         u_upload_enable_ring(st->indexbuf_uploader, ST_UPLOAD_RING_SIZE);
+      if (st->constbuf_uploader)
+         u_upload_enable_ring(st->constbuf_uploader, ST_UPLOAD_RING_SIZE);
+   }
+
    st->cso_context = cso_create_context(pipe);
 
    st_init_atoms( st );
@@ -177,6 +192,9 @@ st_create_context_priv( struct gl_context *ctx, struct pipe_context *pipe,
    /* make sure that no VBOs are left mapped when we're drawing. */
    vbo_always_unmap_buffers(ctx);
 
+   /* let runs of glDrawElements calls reach us as one draw_vbo call. */
+   vbo_merge_draws(ctx);
+
    /* Need these flags:
     */
    st->ctx->FragmentProgram._MaintainTexEnvProgram = GL_TRUE;
@@ -124,6 +124,13 @@ struct st_context
       GLuint fb_orientation;
    } state;
 
+   /** Constant buffer traffic since the end of the last frame */
+   struct {
+      unsigned uploaded_bytes;  /**< bytes handed to the driver */
+      unsigned dirty_bytes;     /**< bytes of those which had changed */
+      unsigned skipped;         /**< uploads skipped as nothing changed */
+   } constbuf_stats;
+
    char vendor[100];
    char renderer[100];
 
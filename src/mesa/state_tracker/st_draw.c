@@ -59,6 +59,7 @@
 #include "util/u_draw_quad.h"
 #include "util/u_upload_mgr.h"
 #include "draw/draw_context.h"
+#include "hud/hud_timer.h"
 #include "cso_cache/cso_context.h"
 
 #include "../glsl/ir_uniform.h"
@@ -202,6 +203,7 @@ st_draw_vbo(struct gl_context *ctx,
    struct pipe_index_buffer ibuffer = {0};
    struct pipe_draw_info info;
    const struct gl_client_array **arrays = ctx->Array._DrawArrays;
+   int64_t start;
    unsigned i;
 
    /* Mesa core state should have been validated already */
@@ -224,6 +226,8 @@ st_draw_vbo(struct gl_context *ctx,
       return;
    }
 
+   start = hud_timer_begin();
+
    util_draw_init_info(&info);
 
    if (ib) {
@@ -235,6 +239,7 @@ st_draw_vbo(struct gl_context *ctx,
 
       if (!setup_index_buffer(st, ib, &ibuffer)) {
          _mesa_error(ctx, GL_OUT_OF_MEMORY, "glBegin/DrawElements/DrawArray");
+         hud_timer_end(HUD_TIMER_DRAW, start);
          return;
       }
 
@@ -294,6 +299,8 @@ st_draw_vbo(struct gl_context *ctx,
    if (ib && st->indexbuf_uploader && !_mesa_is_bufferobj(ib->obj)) {
       pipe_resource_reference(&ibuffer.buffer, NULL);
    }
+
+   hud_timer_end(HUD_TIMER_DRAW, start);
 }
 
 
@@ -63,6 +63,7 @@ extern "C" {
 #include "util/u_math.h"
 #include "tgsi/tgsi_ureg.h"
 #include "tgsi/tgsi_info.h"
+#include "hud/hud_timer.h"
 #include "st_context.h"
 #include "st_program.h"
 #include "st_glsl_to_tgsi.h"
@@ -5228,6 +5229,8 @@ st_new_shader_program(struct gl_context *ctx, GLuint name)
 GLboolean
 st_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
 {
+   int64_t start = hud_timer_begin();
+
    assert(prog->LinkStatus);
 
    for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
@@ -5317,6 +5320,7 @@ st_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
 	    _mesa_reference_program(ctx, &prog->_LinkedShaders[i]->Program,
 				    NULL);
             _mesa_reference_program(ctx, &linked_prog, NULL);
+            hud_timer_end(HUD_TIMER_SHADER, start);
             return GL_FALSE;
          }
       }
@@ -5324,6 +5328,7 @@ st_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
       _mesa_reference_program(ctx, &linked_prog, NULL);
    }
 
+   hud_timer_end(HUD_TIMER_SHADER, start);
    return GL_TRUE;
 }
 
@@ -32,10 +32,12 @@
 #include "main/texstate.h"
 #include "main/framebuffer.h"
 #include "main/fbobject.h"
+#include "main/marshal.h"
 #include "main/renderbuffer.h"
 #include "main/version.h"
 #include "st_texture.h"
 
+#include "st_debug.h"
 #include "st_context.h"
 #include "st_format.h"
 #include "st_cb_fbo.h"
@@ -452,6 +454,8 @@ st_context_flush(struct st_context_iface *stctxi, unsigned flags,
    struct st_context *st = (struct st_context *) stctxi;
    unsigned pipe_flags = 0;
 
+   _mesa_glthread_finish(st->ctx);
+
    if (flags & ST_FLUSH_END_OF_FRAME) {
       pipe_flags |= PIPE_FLUSH_END_OF_FRAME;
    }
@@ -459,6 +463,17 @@ st_context_flush(struct st_context_iface *stctxi, unsigned flags,
    st_flush(st, fence, pipe_flags);
    if (flags & ST_FLUSH_FRONT)
       st_manager_flush_frontbuffer(st);
+
+   if (flags & ST_FLUSH_END_OF_FRAME) {
+      if (ST_DEBUG & DEBUG_CONSTANTS) {
+         debug_printf("st: constants: %u bytes uploaded, %u bytes dirty, "
+                      "%u uploads skipped\n",
+                      st->constbuf_stats.uploaded_bytes,
+                      st->constbuf_stats.dirty_bytes,
+                      st->constbuf_stats.skipped);
+      }
+      memset(&st->constbuf_stats, 0, sizeof(st->constbuf_stats));
+   }
 }
 
 static boolean
@@ -478,6 +493,8 @@ st_context_teximage(struct st_context_iface *stctxi,
    GLuint width, height, depth;
    GLenum target;
 
+   _mesa_glthread_finish(ctx);
+
    switch (tex_type) {
    case ST_TEXTURE_1D:
       target = GL_TEXTURE_1D;
@@ -703,6 +720,8 @@ st_api_make_current(struct st_api *stapi, struct st_context_iface *stctxi,
    _glapi_check_multithread();
 
    if (st) {
+      _mesa_glthread_finish(st->ctx);
+
       /* reuse or create the draw fb */
       stdraw = st_framebuffer_reuse_or_create(st->ctx->WinSysDrawBuffer,
                                               stdrawi);
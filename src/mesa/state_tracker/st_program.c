@@ -42,6 +42,7 @@
 #include "pipe/p_defines.h"
 #include "pipe/p_shader_tokens.h"
 #include "draw/draw_context.h"
+#include "hud/hud_timer.h"
 #include "tgsi/tgsi_dump.h"
 #include "tgsi/tgsi_ureg.h"
 
@@ -427,7 +428,9 @@ st_get_vp_variant(struct st_context *st,
 
    if (!vpv) {
       /* create now */
+      int64_t start = hud_timer_begin();
       vpv = st_translate_vertex_program(st, stvp, key);
+      hud_timer_end(HUD_TIMER_SHADER, start);
       if (vpv) {
          /* insert into list */
          vpv->next = stvp->variants;
@@ -811,7 +814,9 @@ st_get_fp_variant(struct st_context *st,
 
    if (!fpv) {
       /* create new */
+      int64_t start = hud_timer_begin();
       fpv = st_translate_fragment_program(st, stfp, key);
+      hud_timer_end(HUD_TIMER_SHADER, start);
       if (fpv) {
          /* insert into list */
          fpv->next = stfp->variants;
@@ -1175,7 +1180,9 @@ st_get_gp_variant(struct st_context *st,
 
    if (!gpv) {
       /* create new */
+      int64_t start = hud_timer_begin();
       gpv = st_translate_geometry_program(st, stgp, key);
+      hud_timer_end(HUD_TIMER_SHADER, start);
       if (gpv) {
          /* insert into list */
          gpv->next = stgp->variants;
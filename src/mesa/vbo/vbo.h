@@ -163,6 +163,8 @@ void vbo_use_buffer_objects(struct gl_context *ctx);
 
 void vbo_always_unmap_buffers(struct gl_context *ctx);
 
+void vbo_merge_draws(struct gl_context *ctx);
+
 void vbo_set_draw_func(struct gl_context *ctx, vbo_draw_func func);
 
 void vbo_check_buffers_are_unmapped(struct gl_context *ctx);
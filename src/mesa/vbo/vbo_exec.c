@@ -27,6 +27,7 @@
 
 
 #include "main/api_arrayelt.h"
+#include "main/bufferobj.h"
 #include "main/glheader.h"
 #include "main/mtypes.h"
 #include "main/vtxfmt.h"
@@ -67,6 +68,8 @@ void vbo_exec_destroy( struct gl_context *ctx )
    }
 
    vbo_exec_vtx_destroy( exec );
+
+   _mesa_reference_buffer_object(ctx, &exec->array.merge.ib.obj, NULL);
 }
 
 
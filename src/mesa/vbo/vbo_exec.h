@@ -44,6 +44,11 @@ USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 #define VBO_MAX_PRIM 64
 
+/**
+ * Max number of glDrawElements calls merged into one draw_prims call.
+ */
+#define VBO_MAX_MERGED_PRIM 64
+
 
 /**
  * Size of the VBO to use for glBegin/glVertex/glEnd-style rendering.
@@ -128,6 +133,20 @@ struct vbo_exec_context
        */
       const struct gl_client_array *inputs[VERT_ATTRIB_MAX];
       GLboolean recalculate_inputs;
+
+      /* glDrawElements calls waiting to be drawn together with the
+       * following ones, see vbo_merge_drawelements():
+       */
+      struct {
+         GLboolean enabled;
+         struct _mesa_prim prim[VBO_MAX_MERGED_PRIM];
+         GLuint prim_count;
+         struct _mesa_index_buffer ib;
+         GLintptr ib_end;          /* offset just past the last index */
+         GLboolean index_bounds_valid;
+         GLuint min_index, max_index;
+         GLbitfield driver_state;  /* ctx->NewDriverState at the first draw */
+      } merge;
    } array;
 
    /* Which flags to set in vbo_exec_BeginVertices() */
@@ -160,6 +179,8 @@ void vbo_exec_vtx_destroy( struct vbo_exec_context *exec );
 void vbo_exec_vtx_flush( struct vbo_exec_context *exec, GLboolean unmap );
 void vbo_exec_vtx_map( struct vbo_exec_context *exec );
 
+void vbo_exec_array_flush( struct vbo_exec_context *exec );
+
 
 void vbo_exec_vtx_wrap( struct vbo_exec_context *exec );
 
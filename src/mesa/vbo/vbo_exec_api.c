@@ -672,6 +672,8 @@ static void GLAPIENTRY vbo_exec_Begin( GLenum mode )
       return;
    }
 
+   vbo_exec_array_flush(exec);
+
    vbo_draw_method(vbo_context(ctx), DRAW_BEGIN_END);
 
    if (ctx->NewState) {
@@ -1018,6 +1020,20 @@ vbo_always_unmap_buffers(struct gl_context *ctx)
 }
 
 
+/**
+ * If this function is called, consecutive glDrawElements calls which
+ * source all their data from buffer objects are held back and handed to
+ * the driver together, in a single draw_prims call, when the next state
+ * change flushes them.
+ */
+void
+vbo_merge_draws(struct gl_context *ctx)
+{
+   struct vbo_exec_context *exec = &vbo_context(ctx)->exec;
+   exec->array.merge.enabled = GL_TRUE;
+}
+
+
 void vbo_exec_vtx_init( struct vbo_exec_context *exec )
 {
    struct gl_context *ctx = exec->ctx;
@@ -1160,6 +1176,9 @@ void vbo_exec_FlushVertices( struct gl_context *ctx, GLuint flags )
       return;
    }
 
+   /* Draw any merged glDrawElements calls */
+   vbo_exec_array_flush(exec);
+
    /* Flush (draw), and make sure VBO is left unmapped when done */
    vbo_exec_FlushVertices_internal(exec, GL_TRUE);
 
@@ -39,6 +39,10 @@
 
 #include "vbo_context.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 
 /**
  * All vertex buffers should be in an unmapped state when we're about
@@ -78,11 +82,164 @@ vbo_check_buffers_are_unmapped(struct gl_context *ctx)
 
 
 
+/**
+ * Scan 32-bit indices for their min and max, skipping restart indices if
+ * requested.
+ */
+static void
+minmax_uint(const GLuint *ui_indices, GLuint count,
+            GLboolean restart, GLuint restartIndex,
+            GLuint *min_index, GLuint *max_index)
+{
+   GLuint max_ui = 0;
+   GLuint min_ui = ~0U;
+   GLuint i = 0;
+
+#ifdef __SSE2__
+   if (count >= 8) {
+      /* SSE2 only has signed 32-bit compares, so flip the sign bits to get
+       * unsigned ordering.  Restart indices are masked out of the updates.
+       */
+      const __m128i bias = _mm_set1_epi32(0x80000000);
+      const __m128i restart4 = _mm_set1_epi32(restartIndex);
+      __m128i vmin = _mm_xor_si128(_mm_set1_epi32(~0), bias);
+      __m128i vmax = bias;
+      GLuint lanes[4];
+      int j;
+
+      for (; i + 4 <= count; i += 4) {
+         __m128i v = _mm_loadu_si128((const __m128i *) &ui_indices[i]);
+         __m128i skip = restart ? _mm_cmpeq_epi32(v, restart4)
+                                : _mm_setzero_si128();
+         __m128i lt, gt;
+
+         v = _mm_xor_si128(v, bias);
+         lt = _mm_andnot_si128(skip, _mm_cmplt_epi32(v, vmin));
+         gt = _mm_andnot_si128(skip, _mm_cmpgt_epi32(v, vmax));
+         vmin = _mm_or_si128(_mm_and_si128(lt, v), _mm_andnot_si128(lt, vmin));
+         vmax = _mm_or_si128(_mm_and_si128(gt, v), _mm_andnot_si128(gt, vmax));
+      }
+
+      _mm_storeu_si128((__m128i *) lanes, _mm_xor_si128(vmin, bias));
+      for (j = 0; j < 4; j++)
+         min_ui = MIN2(min_ui, lanes[j]);
+      _mm_storeu_si128((__m128i *) lanes, _mm_xor_si128(vmax, bias));
+      for (j = 0; j < 4; j++)
+         max_ui = MAX2(max_ui, lanes[j]);
+   }
+#endif
+
+   for (; i < count; i++) {
+      if (restart && ui_indices[i] == restartIndex)
+         continue;
+      if (ui_indices[i] > max_ui) max_ui = ui_indices[i];
+      if (ui_indices[i] < min_ui) min_ui = ui_indices[i];
+   }
+
+   *min_index = min_ui;
+   *max_index = max_ui;
+}
+
+
+/**
+ * Scan 16-bit indices for their min and max, skipping restart indices if
+ * requested.
+ */
+static void
+minmax_ushort(const GLushort *us_indices, GLuint count,
+              GLboolean restart, GLuint restartIndex,
+              GLuint *min_index, GLuint *max_index)
+{
+   GLuint max_us = 0;
+   GLuint min_us = ~0U;
+   GLuint i = 0;
+
+   /* A 16-bit index can never match a larger restart index. */
+   if (restartIndex > 0xffff)
+      restart = GL_FALSE;
+
+#ifdef __SSE2__
+   if (count >= 16) {
+      /* As above, but with signed 16-bit min/max.  Restart indices are
+       * replaced with values that don't affect the result.
+       */
+      const __m128i bias = _mm_set1_epi16((short) 0x8000);
+      const __m128i restart8 = _mm_set1_epi16((short) restartIndex);
+      const __m128i min_identity = _mm_set1_epi16(0x7fff);
+      const __m128i max_identity = bias;
+      __m128i vmin = min_identity;
+      __m128i vmax = max_identity;
+      GLushort lanes[8];
+      int j;
+
+      for (; i + 8 <= count; i += 8) {
+         __m128i v = _mm_loadu_si128((const __m128i *) &us_indices[i]);
+
+         if (restart) {
+            __m128i skip = _mm_cmpeq_epi16(v, restart8);
+
+            v = _mm_xor_si128(v, bias);
+            vmin = _mm_min_epi16(vmin,
+                                 _mm_or_si128(_mm_and_si128(skip, min_identity),
+                                              _mm_andnot_si128(skip, v)));
+            vmax = _mm_max_epi16(vmax,
+                                 _mm_or_si128(_mm_and_si128(skip, max_identity),
+                                              _mm_andnot_si128(skip, v)));
+         } else {
+            v = _mm_xor_si128(v, bias);
+            vmin = _mm_min_epi16(vmin, v);
+            vmax = _mm_max_epi16(vmax, v);
+         }
+      }
+
+      _mm_storeu_si128((__m128i *) lanes, _mm_xor_si128(vmin, bias));
+      for (j = 0; j < 8; j++)
+         min_us = MIN2(min_us, lanes[j]);
+      _mm_storeu_si128((__m128i *) lanes, _mm_xor_si128(vmax, bias));
+      for (j = 0; j < 8; j++)
+         max_us = MAX2(max_us, lanes[j]);
+   }
+#endif
+
+   for (; i < count; i++) {
+      if (restart && us_indices[i] == restartIndex)
+         continue;
+      if (us_indices[i] > max_us) max_us = us_indices[i];
+      if (us_indices[i] < min_us) min_us = us_indices[i];
+   }
+
+   /* If every index was a restart index, the vector path leaves 0xffff as
+    * the minimum.  Report ~0 like the scalar loop would.
+    */
+   if (min_us > max_us)
+      min_us = ~0U;
+
+   *min_index = min_us;
+   *max_index = max_us;
+}
+
+
+/**
+ * Find the cache slot for a range of an index buffer.  The buffer's mutex
+ * must be held.
+ */
+static struct gl_index_range *
+index_range_slot(struct gl_buffer_object *obj, GLintptr offset, GLuint count)
+{
+   GLuint hash = (GLuint) offset ^ (GLuint) (offset >> 12) ^ count;
+
+   return &obj->IndexRanges[hash % MAX_INDEX_RANGES];
+}
+
+
 /**
  * Compute min and max elements by scanning the index buffer for
  * glDraw[Range]Elements() calls.
  * If primitive restart is enabled, we need to ignore restart
  * indexes when computing min/max.
+ *
+ * Results for index buffer objects are cached in the buffer object (see
+ * gl_index_range), so static meshes only get scanned once.
  */
 static void
 vbo_get_minmax_index(struct gl_context *ctx,
@@ -94,61 +251,45 @@ vbo_get_minmax_index(struct gl_context *ctx,
    const GLboolean restart = ctx->Array._PrimitiveRestart;
    const GLuint restartIndex = _mesa_primitive_restart_index(ctx, ib->type);
    const int index_size = vbo_sizeof_ib_type(ib->type);
+   const GLintptr offset = (GLintptr) ib->ptr + prim->start * index_size;
+   const GLboolean use_cache = _mesa_is_bufferobj(ib->obj) &&
+                               !ib->obj->GPUWritten;
+   struct gl_index_range *range = NULL;
    const char *indices;
    GLuint i;
 
-   indices = (char *) ib->ptr + prim->start * index_size;
+   if (use_cache) {
+      _glthread_LOCK_MUTEX(ib->obj->Mutex);
+      range = index_range_slot(ib->obj, offset, count);
+      if (range->Count == count &&
+          range->Offset == offset &&
+          range->Type == ib->type &&
+          range->Restart == restart &&
+          (!restart || range->RestartIndex == restartIndex)) {
+         *min_index = range->Min;
+         *max_index = range->Max;
+         _glthread_UNLOCK_MUTEX(ib->obj->Mutex);
+         return;
+      }
+      _glthread_UNLOCK_MUTEX(ib->obj->Mutex);
+   }
+
+   indices = (char *) offset;
    if (_mesa_is_bufferobj(ib->obj)) {
       GLsizeiptr size = MIN2(count * index_size, ib->obj->Size);
-      indices = ctx->Driver.MapBufferRange(ctx, (GLintptr) indices, size,
+      indices = ctx->Driver.MapBufferRange(ctx, offset, size,
                                            GL_MAP_READ_BIT, ib->obj);
    }
 
    switch (ib->type) {
-   case GL_UNSIGNED_INT: {
-      const GLuint *ui_indices = (const GLuint *)indices;
-      GLuint max_ui = 0;
-      GLuint min_ui = ~0U;
-      if (restart) {
-         for (i = 0; i < count; i++) {
-            if (ui_indices[i] != restartIndex) {
-               if (ui_indices[i] > max_ui) max_ui = ui_indices[i];
-               if (ui_indices[i] < min_ui) min_ui = ui_indices[i];
-            }
-         }
-      }
-      else {
-         for (i = 0; i < count; i++) {
-            if (ui_indices[i] > max_ui) max_ui = ui_indices[i];
-            if (ui_indices[i] < min_ui) min_ui = ui_indices[i];
-         }
-      }
-      *min_index = min_ui;
-      *max_index = max_ui;
+   case GL_UNSIGNED_INT:
+      minmax_uint((const GLuint *) indices, count, restart, restartIndex,
+                  min_index, max_index);
       break;
-   }
-   case GL_UNSIGNED_SHORT: {
-      const GLushort *us_indices = (const GLushort *)indices;
-      GLuint max_us = 0;
-      GLuint min_us = ~0U;
-      if (restart) {
-         for (i = 0; i < count; i++) {
-            if (us_indices[i] != restartIndex) {
-               if (us_indices[i] > max_us) max_us = us_indices[i];
-               if (us_indices[i] < min_us) min_us = us_indices[i];
-            }
-         }
-      }
-      else {
-         for (i = 0; i < count; i++) {
-            if (us_indices[i] > max_us) max_us = us_indices[i];
-            if (us_indices[i] < min_us) min_us = us_indices[i];
-         }
-      }
-      *min_index = min_us;
-      *max_index = max_us;
+   case GL_UNSIGNED_SHORT:
+      minmax_ushort((const GLushort *) indices, count, restart, restartIndex,
+                    min_index, max_index);
       break;
-   }
    case GL_UNSIGNED_BYTE: {
       const GLubyte *ub_indices = (const GLubyte *)indices;
       GLuint max_ub = 0;
@@ -179,6 +320,18 @@ vbo_get_minmax_index(struct gl_context *ctx,
    if (_mesa_is_bufferobj(ib->obj)) {
       ctx->Driver.UnmapBuffer(ctx, ib->obj);
    }
+
+   if (use_cache && count > 0) {
+      _glthread_LOCK_MUTEX(ib->obj->Mutex);
+      range->Offset = offset;
+      range->Count = count;
+      range->Type = ib->type;
+      range->Restart = restart;
+      range->RestartIndex = restartIndex;
+      range->Min = *min_index;
+      range->Max = *max_index;
+      _glthread_UNLOCK_MUTEX(ib->obj->Mutex);
+   }
 }
 
 /**
@@ -534,6 +687,9 @@ vbo_bind_arrays(struct gl_context *ctx)
    struct vbo_context *vbo = vbo_context(ctx);
    struct vbo_exec_context *exec = &vbo->exec;
 
+   /* Merged draws were recorded with the bindings we're about to replace */
+   vbo_exec_array_flush(exec);
+
    vbo_draw_method(vbo, DRAW_ARRAYS);
 
    if (exec->array.recalculate_inputs) {
@@ -932,6 +1088,172 @@ dump_element_buffer(struct gl_context *ctx, GLenum type)
 #endif
 
 
+/**
+ * Draw the glDrawElements calls held back by vbo_merge_drawelements(),
+ * all with one draw_prims call.
+ */
+void
+vbo_exec_array_flush(struct vbo_exec_context *exec)
+{
+   struct gl_context *ctx = exec->ctx;
+   struct vbo_context *vbo = vbo_context(ctx);
+   GLuint prim_count = exec->array.merge.prim_count;
+
+   if (prim_count == 0)
+      return;
+
+   /* The driver may flush vertices again while drawing. */
+   exec->array.merge.prim_count = 0;
+
+   /* State changed since the draws were merged must be validated before
+    * the driver sees them.  They were merged with the same inputs, so keep
+    * _mesa_update_state from invalidating them.
+    */
+   if (ctx->NewState) {
+      exec->validating = GL_TRUE;
+      _mesa_update_state(ctx);
+      exec->validating = GL_FALSE;
+   }
+
+   check_buffers_are_unmapped(exec->array.inputs);
+   vbo->draw_prims(ctx, exec->array.merge.prim, prim_count,
+                   &exec->array.merge.ib,
+                   exec->array.merge.index_bounds_valid,
+                   exec->array.merge.min_index,
+                   exec->array.merge.max_index, NULL, NULL);
+
+   _mesa_reference_buffer_object(ctx, &exec->array.merge.ib.obj, NULL);
+}
+
+
+/**
+ * Add a glDrawElements call to the merged draws, which use the same index
+ * buffer.  The indices are addressed relative to the lowest index pointer,
+ * as in vbo_validated_multidrawelements(), and contiguous independent
+ * primitives are concatenated into one.
+ */
+static void
+vbo_append_merged_draw(struct vbo_exec_context *exec,
+                       const struct _mesa_prim *prim,
+                       const struct _mesa_index_buffer *ib,
+                       GLboolean index_bounds_valid,
+                       GLuint min_index, GLuint max_index)
+{
+   const GLuint index_size = vbo_sizeof_ib_type(ib->type);
+   const GLintptr ptr = (GLintptr) ib->ptr;
+   GLintptr base = (GLintptr) exec->array.merge.ib.ptr;
+   struct _mesa_prim *last;
+   struct _mesa_prim p;
+
+   if (ptr < base) {
+      const GLuint shift = (base - ptr) / index_size;
+      GLuint i;
+
+      for (i = 0; i < exec->array.merge.prim_count; i++)
+         exec->array.merge.prim[i].start += shift;
+
+      exec->array.merge.ib.ptr = ib->ptr;
+      base = ptr;
+   }
+
+   exec->array.merge.ib_end = MAX2(exec->array.merge.ib_end,
+                                   ptr + ib->count * index_size);
+   exec->array.merge.ib.count =
+      (exec->array.merge.ib_end - base) / index_size;
+
+   /* The bounds cover all the prims, so they only stay valid if every
+    * draw has them and they are relative to the same base vertex.
+    */
+   if (exec->array.merge.index_bounds_valid && index_bounds_valid &&
+       prim->basevertex == exec->array.merge.prim[0].basevertex) {
+      exec->array.merge.min_index = MIN2(exec->array.merge.min_index,
+                                         min_index);
+      exec->array.merge.max_index = MAX2(exec->array.merge.max_index,
+                                         max_index);
+   }
+   else {
+      exec->array.merge.index_bounds_valid = GL_FALSE;
+   }
+
+   p = *prim;
+   p.start = (ptr - base) / index_size;
+
+   last = &exec->array.merge.prim[exec->array.merge.prim_count - 1];
+   if (vbo_can_merge_prims(last, &p))
+      vbo_merge_prims(last, &p);
+   else
+      exec->array.merge.prim[exec->array.merge.prim_count++] = p;
+}
+
+
+/**
+ * Try to hold back a glDrawElements call so that it can be drawn together
+ * with the following ones.  Consecutive calls are merged as long as they
+ * use the same index buffer and index type and no state changes in
+ * between; every state change does FLUSH_VERTICES() first, which draws
+ * them.
+ *
+ * Only draws which read their indices and vertices from unmapped buffer
+ * objects are held back, since client memory could change without any GL
+ * call.
+ *
+ * \return GL_TRUE if the draw was recorded, GL_FALSE if the caller must
+ * draw it now.
+ */
+static GLboolean
+vbo_merge_drawelements(struct gl_context *ctx,
+                       const struct _mesa_prim *prim,
+                       const struct _mesa_index_buffer *ib,
+                       GLboolean index_bounds_valid,
+                       GLuint min_index, GLuint max_index)
+{
+   struct vbo_exec_context *exec = &vbo_context(ctx)->exec;
+   const GLuint index_size = vbo_sizeof_ib_type(ib->type);
+
+   if (!_mesa_is_bufferobj(ib->obj) ||
+       _mesa_bufferobj_mapped(ib->obj) ||
+       (GLintptr) ib->ptr % index_size != 0 ||
+       (ctx->Const.PrimitiveRestartInSoftware &&
+        ctx->Array._PrimitiveRestart) ||
+       (MESA_DEBUG_FLAGS & DEBUG_ALWAYS_FLUSH))
+      return GL_FALSE;
+
+   if (exec->array.merge.prim_count) {
+      if (exec->array.merge.ib.obj == ib->obj &&
+          exec->array.merge.ib.type == ib->type &&
+          exec->array.merge.prim_count < VBO_MAX_MERGED_PRIM &&
+          exec->array.merge.driver_state == ctx->NewDriverState &&
+          !exec->array.recalculate_inputs) {
+         vbo_append_merged_draw(exec, prim, ib, index_bounds_valid,
+                                min_index, max_index);
+         return GL_TRUE;
+      }
+
+      vbo_exec_array_flush(exec);
+   }
+
+   vbo_bind_arrays(ctx);
+
+   if (!vbo_all_varyings_in_vbos(exec->array.inputs))
+      return GL_FALSE;
+
+   exec->array.merge.prim[0] = *prim;
+   exec->array.merge.prim_count = 1;
+   exec->array.merge.ib.count = ib->count;
+   exec->array.merge.ib.type = ib->type;
+   exec->array.merge.ib.ptr = ib->ptr;
+   _mesa_reference_buffer_object(ctx, &exec->array.merge.ib.obj, ib->obj);
+   exec->array.merge.ib_end = (GLintptr) ib->ptr + ib->count * index_size;
+   exec->array.merge.index_bounds_valid = index_bounds_valid;
+   exec->array.merge.min_index = min_index;
+   exec->array.merge.max_index = max_index;
+   exec->array.merge.driver_state = ctx->NewDriverState;
+
+   ctx->Driver.NeedFlush |= FLUSH_STORED_VERTICES;
+   return GL_TRUE;
+}
+
+
 /**
  * Inner support for both _mesa_DrawElements and _mesa_DrawRangeElements.
  * Do the rendering for a glDrawElements or glDrawRangeElements call after
@@ -951,8 +1273,6 @@ vbo_validated_drawrangeelements(struct gl_context *ctx, GLenum mode,
    struct _mesa_index_buffer ib;
    struct _mesa_prim prim[1];
 
-   vbo_bind_arrays(ctx);
-
    ib.count = count;
    ib.type = type;
    ib.obj = ctx->Array.ArrayObj->ElementArrayBufferObj;
@@ -971,6 +1291,13 @@ vbo_validated_drawrangeelements(struct gl_context *ctx, GLenum mode,
    prim[0].num_instances = numInstances;
    prim[0].base_instance = baseInstance;
 
+   if (exec->array.merge.enabled &&
+       vbo_merge_drawelements(ctx, &prim[0], &ib,
+                              index_bounds_valid, start, end))
+      return;
+
+   vbo_bind_arrays(ctx);
+
    /* Need to give special consideration to rendering a range of
     * indices starting somewhere above zero.  Typically the
     * application is issuing multiple DrawRangeElements() to draw
@@ -266,6 +266,9 @@ vbo_save_playback_vertex_list(struct gl_context *ctx, void *data)
 
    FLUSH_CURRENT(ctx, 0);
 
+   /* Draw any merged glDrawElements calls before the list's primitives */
+   vbo_exec_array_flush(&vbo_context(ctx)->exec);
+
    if (node->prim_count > 0) {
 
       if (_mesa_inside_begin_end(ctx) && node->prim[0].begin) {